@@ -0,0 +1,92 @@
+#ifndef BEAM_MODEL_GUARD_HPP
+#define BEAM_MODEL_GUARD_HPP
+/// \file
+/// \brief Beam model of a laser range finder with a ray-cast range table
+///
+/// Each beam is scored against the range expected by casting a ray through
+/// the map, as a mixture of a Gaussian around the expected range (z_hit),
+/// an exponential for objects in front of it (z_short), a spike at the max
+/// range (z_max), and a uniform (z_rand) (Table 6.1 Probabilistic Robotics).
+/// Casting rays while scoring is slow, so the expected range is kept in a
+/// table per cell and per quantized direction. The table is filled the first
+/// time an entry is needed and is reused until the revision of the map changes.
+
+#include <cstdint>
+#include <vector>
+
+#include <rigid2d/rigid2d.hpp>
+#include "bmapping/block_grid.hpp"
+#include "bmapping/grid_mapper.hpp"
+
+
+namespace bmapping
+{
+  /// \brief Scores scans with the beam model, the range table is filled
+  ///        while scoring so a model is not shared between threads
+  class BeamModel
+  {
+  public:
+    /// \brief Creates the model
+    /// \param map - the map and laser properties, read only and must outlive the model
+    /// \param num_angles - number of directions in one revolution of the range table
+    /// \param lambda_short - rate of the exponential distribution of short readings
+    /// \throws std::invalid_argument if num_angles, lambda_short, the variance
+    ///         of the laser, or its max range is not positive
+    BeamModel(const GridMapper &map, int num_angles, double lambda_short);
+
+    /// \brief Log of the scan likelihood P(z|m,x)
+    /// \param scan - range measurements
+    /// \param pose - pose of robot in world (Twr)
+    /// \param step - every step-th beam is scored
+    /// \returns log likelihood
+    double logLikelihood(const std::vector<float> &scan, const Transform2D &pose,
+                         unsigned int step = 1);
+
+    /// \brief Range to the nearest obstacle from the range table
+    /// \param gc - cell of the scanner
+    /// \param angle - direction of the beam in world
+    /// \returns expected range, the max range if no obstacle is reached
+    double expectedRange(const GridCoordinates &gc, double angle);
+
+    /// \brief Number of cells with an entry in the range table
+    /// \returns cells
+    std::size_t cachedCells() const;
+
+  private:
+    /// \brief Clears the range table if the map changed since it was filled
+    void checkRevision();
+
+    /// \brief Entries of the range table of a cell, allocated on first use
+    /// \param gc - cell of the scanner
+    /// \returns pointer to num_angles_ entries, valid until the next cell is allocated
+    uint16_t *cellRanges(const GridCoordinates &gc);
+
+    /// \brief Expected range of an entry in the range table, cast on first use
+    /// \param gc - cell of the scanner
+    /// \param ranges - entries of the cell
+    /// \param a - index of the direction
+    /// \returns expected range
+    double tableRange(const GridCoordinates &gc, uint16_t *ranges, int a);
+
+    /// \brief Log likelihood of one beam, the mixture of the four components
+    /// \param z - measured range
+    /// \param z_exp - expected range
+    /// \returns log likelihood
+    double beamLogLikelihood(double z, double z_exp) const;
+
+
+    const GridMapper &map_;                 // map and laser properties
+    int num_angles_;                        // directions in one revolution
+    double lambda_short_;                   // rate of short readings
+    double angle_step_;                     // angle between directions
+    double range_max_;                      // max range of laser
+    double range_quantum_;                  // range of one unit in the table
+    double var_hit_, hit_norm_;             // variance and normalizer of the Gaussian
+
+    BlockGrid<int32_t> offsets_;            // first entry of each cell in ranges_, -1 if none
+    std::vector<uint16_t> ranges_;          // quantized expected ranges
+    unsigned long revision_;                // revision of the map the table was filled from
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef BLOCK_GRID_GUARD_HPP
+#define BLOCK_GRID_GUARD_HPP
+/// \file
+/// \brief Unbounded grid that allocates square blocks of cells on demand
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace bmapping
+{
+  /// \brief Smallest rectangle of blocks containing every allocated block
+  struct BlockBounds
+  {
+    int bi_min = std::numeric_limits<int>::max();     // first block row
+    int bi_max = std::numeric_limits<int>::min();     // last block row
+    int bj_min = std::numeric_limits<int>::max();     // first block column
+    int bj_max = std::numeric_limits<int>::min();     // last block column
+
+    /// \brief Checks for blocks
+    /// \return true if no block is in the bounds
+    bool empty() const
+    {
+      return bi_min > bi_max;
+    }
+
+    /// \brief Grows the bounds to contain a block
+    /// \param bi - block row
+    /// \param bj - block column
+    void add(int bi, int bj)
+    {
+      bi_min = std::min(bi_min, bi);
+      bi_max = std::max(bi_max, bi);
+      bj_min = std::min(bj_min, bj);
+      bj_max = std::max(bj_max, bj);
+    }
+  };
+
+
+  /// \brief Grid of cells indexed by any integer coordinates. Cells are
+  ///        stored in blocks of block_size x block_size allocated the first
+  ///        time one of their cells is written, so the memory grows with the
+  ///        area visited rather than a bounding box. The block of the last
+  ///        lookup on each thread is cached, consecutive lookups in the same
+  ///        block skip the hash table.
+  template <typename T>
+  class BlockGrid
+  {
+  public:
+    static constexpr int block_bits = 5;                          // log2 of block_size
+    static constexpr int block_size = 1 << block_bits;            // cells along the edge of a block
+    static constexpr int block_cells = block_size * block_size;   // cells in a block
+
+    /// \brief Empty grid
+    /// \param fill - value of cells that have not been written
+    explicit BlockGrid(const T &fill = T())
+      : fill_(fill), id_(nextId())
+    {
+    }
+
+    /// \brief Copies the cells of a grid
+    /// \param other - grid to copy
+    BlockGrid(const BlockGrid &other)
+      : cells_(other.cells_), index_(other.index_), bounds_(other.bounds_), fill_(other.fill_), id_(nextId())
+    {
+    }
+
+    /// \brief Moves the cells of a grid, the other grid is left empty
+    /// \param other - grid to move
+    BlockGrid(BlockGrid &&other)
+      : cells_(std::move(other.cells_)), index_(std::move(other.index_)), bounds_(other.bounds_),
+        fill_(other.fill_), id_(nextId())
+    {
+      other.clear();
+    }
+
+    /// \brief Copies the cells of a grid
+    /// \param other - grid to copy
+    /// \return this grid
+    BlockGrid &operator=(const BlockGrid &other)
+    {
+      if (this != &other)
+      {
+        cells_ = other.cells_;
+        index_ = other.index_;
+        bounds_ = other.bounds_;
+        fill_ = other.fill_;
+        id_ = nextId();
+      }
+      return *this;
+    }
+
+    /// \brief Moves the cells of a grid, the other grid is left empty
+    /// \param other - grid to move
+    /// \return this grid
+    BlockGrid &operator=(BlockGrid &&other)
+    {
+      if (this != &other)
+      {
+        cells_ = std::move(other.cells_);
+        index_ = std::move(other.index_);
+        bounds_ = other.bounds_;
+        fill_ = other.fill_;
+        id_ = nextId();
+        other.clear();
+      }
+      return *this;
+    }
+
+    /// \brief Value of a cell
+    /// \param i - row
+    /// \param j - column
+    /// \return value, the fill value if the block is not allocated
+    const T &get(int i, int j) const
+    {
+      const auto *cell = find(i, j);
+      return cell ? *cell : fill_;
+    }
+
+    /// \brief Looks up a cell without allocating it
+    /// \param i - row
+    /// \param j - column
+    /// \return pointer to cell, nullptr if the block is not allocated.
+    ///         Valid until the next block is allocated.
+    const T *find(int i, int j) const
+    {
+      const auto s = slot(i, j);
+      return (s < 0) ? nullptr : &cells_[s * block_cells + local(i, j)];
+    }
+
+    /// \copydoc find(int, int) const
+    T *find(int i, int j)
+    {
+      const auto s = slot(i, j);
+      return (s < 0) ? nullptr : &cells_[s * block_cells + local(i, j)];
+    }
+
+    /// \brief Looks up a cell, allocating its block if needed
+    /// \param i - row
+    /// \param j - column
+    /// \return reference to cell, valid until the next block is allocated
+    T &at(int i, int j)
+    {
+      auto s = slot(i, j);
+      if (s < 0)
+      {
+        s = static_cast<int>(index_.size());
+        index_.emplace(blockKey(i >> block_bits, j >> block_bits), s);
+        cells_.resize(cells_.size() + block_cells, fill_);
+        bounds_.add(i >> block_bits, j >> block_bits);
+
+        auto &c = cache();
+        c.owner = id_;
+        c.key = blockKey(i >> block_bits, j >> block_bits);
+        c.slot = s;
+      }
+
+      return cells_[s * block_cells + local(i, j)];
+    }
+
+    /// \brief Removes every block, the memory is kept for reuse
+    void clear()
+    {
+      cells_.clear();
+      index_.clear();
+      bounds_ = BlockBounds();
+      id_ = nextId();
+    }
+
+    /// \brief Number of allocated blocks
+    /// \return blocks
+    std::size_t numBlocks() const
+    {
+      return index_.size();
+    }
+
+    /// \brief Bounds of the allocated blocks
+    /// \return block rows and columns spanned, empty if no block is allocated
+    const BlockBounds &blockBounds() const
+    {
+      return bounds_;
+    }
+
+    /// \brief Coordinates of the allocated blocks
+    /// blocks[out] - block row and column, in the order of the blocks in cellData
+    void blocks(std::vector<std::pair<int, int>> &blocks) const
+    {
+      blocks.resize(index_.size());
+      for(const auto &entry : index_)
+      {
+        blocks[entry.second] = {static_cast<std::int32_t>(entry.first >> 32),
+                                static_cast<std::int32_t>(static_cast<std::uint32_t>(entry.first))};
+      }
+    }
+
+    /// \brief Cells of every allocated block
+    /// \return block_cells values per block in row major order
+    const T *cellData() const
+    {
+      return cells_.data();
+    }
+
+    /// \brief Replaces every block
+    /// \param blocks - block row and column of each block
+    /// \param cells - block_cells values per block in the order of blocks
+    void assign(const std::vector<std::pair<int, int>> &blocks, const T *cells)
+    {
+      clear();
+      cells_.assign(cells, cells + blocks.size() * block_cells);
+      index_.reserve(blocks.size());
+      for(std::size_t s = 0; s < blocks.size(); s++)
+      {
+        index_.emplace(blockKey(blocks[s].first, blocks[s].second), static_cast<int>(s));
+        bounds_.add(blocks[s].first, blocks[s].second);
+      }
+    }
+
+    /// \brief Memory used by the cells and the index
+    /// \return bytes
+    std::size_t memoryBytes() const
+    {
+      return cells_.capacity() * sizeof(T) +
+             index_.size() * (sizeof(std::uint64_t) + sizeof(int) + 2 * sizeof(void *)) +
+             index_.bucket_count() * sizeof(void *);
+    }
+
+  private:
+    /// \brief Block last looked up on a thread
+    struct Cache
+    {
+      std::uint64_t owner = 0;    // id of grid
+      std::uint64_t key = 0;      // block coordinates
+      int slot = -1;              // block index in cells_
+    };
+
+    /// \brief Unique id of a grid, changes when the blocks are removed
+    /// \return id
+    static std::uint64_t nextId()
+    {
+      static std::atomic<std::uint64_t> next(1);
+      return next++;
+    }
+
+    /// \brief Cache of the calling thread
+    /// \return cache
+    static Cache &cache()
+    {
+      thread_local Cache c;
+      return c;
+    }
+
+    /// \brief Hash key of a block
+    /// \param bi - block row
+    /// \param bj - block column
+    /// \return key
+    static std::uint64_t blockKey(int bi, int bj)
+    {
+      return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(bi)) << 32) |
+              static_cast<std::uint32_t>(bj);
+    }
+
+    /// \brief Index of a cell within its block
+    /// \param i - row
+    /// \param j - column
+    /// \return index in row major order
+    static int local(int i, int j)
+    {
+      return ((i & (block_size - 1)) << block_bits) | (j & (block_size - 1));
+    }
+
+    /// \brief Index of the block of a cell
+    /// \param i - row
+    /// \param j - column
+    /// \return slot, -1 if the block is not allocated
+    int slot(int i, int j) const
+    {
+      // the arithmetic shift rounds negative coordinates down
+      const auto key = blockKey(i >> block_bits, j >> block_bits);
+
+      auto &c = cache();
+      if (c.owner == id_ && c.key == key)
+      {
+        return c.slot;
+      }
+
+      const auto it = index_.find(key);
+      if (it == index_.end())
+      {
+        return -1;
+      }
+
+      c.owner = id_;
+      c.key = key;
+      c.slot = it->second;
+      return it->second;
+    }
+
+
+    std::vector<T> cells_;                              // cells of every block
+    std::unordered_map<std::uint64_t, int> index_;      // slot of each block
+    BlockBounds bounds_;                                // rows and columns of the blocks
+    T fill_;                                            // value of cells not written
+    std::uint64_t id_;                                  // identifies the grid in the caches
+  };
+} // end namespace
+
+#endif
@@ -23,6 +23,7 @@ namespace bmapping
   using rigid2d::Vector2D;
   using rigid2d::Transform2D;
   using rigid2d::TransformData2D;
+  using rigid2d::PointBatchf;
 
   /// \brief compose transform between two point clouds
   class ScanAlignment
@@ -72,6 +73,7 @@ namespace bmapping
     Transform2D Trs_;                         // robot to laser scanner
     float beam_min_, beam_max_, beam_delta_;  // start, end, increment scan angles
     float range_min_, range_max_;             // min and max range limit for laser
+    PointBatchf beam_dirs_;                   // cosine and sine of each beam angle
 
     bool first_scan_recieved;                 // whether the first scan has been recieved
 
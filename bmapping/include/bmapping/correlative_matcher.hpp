@@ -0,0 +1,99 @@
+#ifndef CORRELATIVE_MATCHER_GUARD_HPP
+#define CORRELATIVE_MATCHER_GUARD_HPP
+/// \file
+/// \brief Correlative scan matcher with branch and bound over multi-resolution
+///        likelihood grids
+///
+/// The scan is scored at every pose of a lattice in an (x, y, theta) window
+/// against the likelihood field of an occupancy grid. Rather than scoring each
+/// pose, the window is split into squares of 2^depth cells scored against a
+/// grid where each cell holds the max likelihood of the square starting at it.
+/// The score of a square bounds the score of every pose inside it, so squares
+/// that can not beat the best pose found so far are pruned before they are
+/// split (Olson, Real-Time Correlative Scan Matching).
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <rigid2d/rigid2d.hpp>
+#include "bmapping/grid_mapper.hpp"
+
+
+namespace bmapping
+{
+  using Eigen::Vector3d;
+  using Eigen::Matrix3d;
+
+
+  /// \brief Result of a scan match
+  struct ScanMatch
+  {
+    Vector3d pose = Vector3d::Zero();             // best pose (theta, x, y)
+    Matrix3d covariance = Matrix3d::Zero();       // covariance of the pose (theta, x, y)
+    double score = 0.0;                           // mean log likelihood of a beam at the best pose
+  };
+
+
+  /// \brief Searches a window around a pose for the best match of a scan
+  class CorrelativeScanMatcher
+  {
+  public:
+    /// \brief Matcher with a window of +/- 0.1 m and +/- 0.1 rad
+    CorrelativeScanMatcher();
+
+    /// \brief Creates a scan matcher
+    /// \param linear_window - max distance searched along x and y from the initial guess
+    /// \param angular_window - max rotation searched from the initial guess
+    /// \param depth - number of coarser grids, squares of 2^depth cells are scored first
+    /// \param min_score - lowest mean log likelihood of a beam accepted as a match
+    /// \throws std::invalid_argument if a window is negative or the depth is negative
+    CorrelativeScanMatcher(double linear_window, double angular_window, int depth, double min_score);
+
+    /// \brief Finds the pose in the window with the highest scan likelihood
+    /// \param grid - map and laser model
+    /// \param scan - range measurements
+    /// \param guess - initial guess (theta, x, y)
+    /// match[out] - best pose and its covariance from the likelihood of the
+    ///              poses next to it on the lattice
+    /// \returns false if the map is empty, the scan has no valid beams, or
+    ///          no pose scores above the min score
+    bool match(const GridMapper &grid, const std::vector<float> &scan,
+               const Vector3d &guess, ScanMatch &match);
+
+  private:
+    /// \brief Square of the search lattice
+    struct Candidate
+    {
+      int k;          // rotation index
+      int dx, dy;     // offset of first cell along rows and columns
+      float score;    // sum of beam log likelihoods, an upper bound above level 0
+    };
+
+    /// \brief Scores a candidate against one level of the grids
+    /// \param level - level of the grids
+    /// \param candidate - square to score, score[out]
+    void score(int level, Candidate &candidate) const;
+
+    /// \brief Depth first search of the squares, best first
+    /// \param level - level of the candidates
+    /// \param candidates - scored squares, sorted in place
+    /// best[in/out] - best leaf found so far
+    void branchAndBound(int level, std::vector<Candidate> &candidates, Candidate &best) const;
+
+
+    double linear_window_;            // search distance along x and y
+    double angular_window_;           // search rotation
+    int depth_;                       // number of coarser grids
+    double min_score_;                // min mean log likelihood of a match
+
+    // state of the current match, the buffers are reused between matches
+    std::vector<std::vector<float>> levels_;  // log likelihood grids, max pooled above level 0
+    std::vector<int> cells_;                  // grid index of each beam at each rotation with no offset
+    int cols_;                                // columns in the grids
+    int num_points_;                          // beams in each rotation
+    int window_;                              // linear window in cells
+  };
+} // end namespace
+
+#endif
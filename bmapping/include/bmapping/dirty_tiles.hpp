@@ -0,0 +1,93 @@
+#ifndef DIRTY_TILES_GUARD_HPP
+#define DIRTY_TILES_GUARD_HPP
+/// \file
+/// \brief Tracks the changed regions of a 2D map in square tiles
+
+#include <vector>
+#include <cstdint>
+
+
+namespace bmapping
+{
+  /// \brief Rectangle of cells in a map
+  struct MapRegion
+  {
+    unsigned int x = 0;         // first column
+    unsigned int y = 0;         // first row
+    unsigned int width = 0;     // number of columns
+    unsigned int height = 0;    // number of rows
+  };
+
+
+  /// \brief Copies a region out of a row major map
+  /// \param map - the map
+  /// \param width - number of columns in the map
+  /// \param region - rectangle in the map
+  /// data[out] - values of the region in row major order
+  void copyRegion(const std::vector<int8_t> &map, unsigned int width,
+                  const MapRegion &region, std::vector<int8_t> &data);
+
+  /// \brief Writes a region into a row major map
+  /// \param width - number of columns in the map
+  /// \param region - rectangle in the map
+  /// \param data - values of the region in row major order
+  /// map[out] - the map
+  void pasteRegion(std::vector<int8_t> &map, unsigned int width,
+                   const MapRegion &region, const std::vector<int8_t> &data);
+
+
+  /// \brief Bitmap of the tiles of a map that changed
+  class DirtyTiles
+  {
+  public:
+    /// \brief Empty bitmap
+    DirtyTiles();
+
+    /// \brief Bitmap for a map
+    /// \param width - number of columns in the map
+    /// \param height - number of rows in the map
+    /// \param tile_size - number of cells along the edge of a tile
+    DirtyTiles(unsigned int width, unsigned int height, unsigned int tile_size);
+
+    /// \brief Marks the tile containing a cell
+    /// \param x - column of cell
+    /// \param y - row of cell
+    void mark(unsigned int x, unsigned int y)
+    {
+      const auto tile = (y / tile_size_) * tiles_x_ + (x / tile_size_);
+      if (!tiles_[tile])
+      {
+        tiles_[tile] = 1;
+        count_++;
+      }
+    }
+
+    /// \brief Marks all tiles overlapping a region
+    /// \param region - region of the map
+    void markRegion(const MapRegion &region);
+
+    /// \brief Marks every tile
+    void markAll();
+
+    /// \brief Clears all marks
+    void clear();
+
+    /// \brief Checks for marked tiles
+    /// \return true if no tile is marked
+    bool empty() const;
+
+    /// \brief Rectangles covering the marked tiles, runs of
+    ///        marked tiles in a tile row are merged
+    /// regions[out] - rectangles clipped to the map
+    void regions(std::vector<MapRegion> &regions) const;
+
+  private:
+    unsigned int width_, height_;           // map size
+    unsigned int tile_size_;                // cells along the edge of a tile
+    unsigned int tiles_x_, tiles_y_;        // number of tiles along columns and rows
+    unsigned int count_;                    // number of marked tiles
+    std::vector<std::uint8_t> tiles_;       // 1 if tile is marked
+  };
+} // end namespace
+
+#endif
@@ -4,13 +4,18 @@
 /// \brief Creates a 2D occupancy grid
 
 #include <cmath>
+#include <cstdint>
 #include <iosfwd>
+#include <memory>
+#include <string>
 #include <vector>
 #include <queue>
 #include <unordered_set>
 
 #include <rigid2d/rigid2d.hpp>
 #include "bmapping/sensor_model.hpp"
+#include "bmapping/dirty_tiles.hpp"
+#include "bmapping/block_grid.hpp"
 
 
 
@@ -20,6 +25,8 @@ namespace bmapping
   using rigid2d::Transform2D;
   using rigid2d::TransformData2D;
 
+  struct MapSnapshot;
+
 
   /// \brief Convert log odds to a probability
   /// \parma l - log odds
@@ -38,12 +45,45 @@ namespace bmapping
   }
 
 
+  /// \brief Log odds stored in fixed point
+  typedef int16_t FixedLogOdds;
+
+  /// \brief Fixed point units per log odd
+  constexpr double log_odds_scale = 1024.0;
+
+  /// \brief Magnitude of the largest fixed point log odds, a probability of 1 - 2e-9
+  constexpr int log_odds_limit = 20 * 1024;
+
+  /// \brief Convert log odds to fixed point, rounded and clamped
+  /// \param l - log odds
+  /// \return fixed point log odds
+  FixedLogOdds toFixedLogOdds(double l);
+
+  /// \brief Convert fixed point log odds to a probability with a look up table
+  /// \param l - fixed point log odds
+  /// \return probability based on log odds
+  double fixedLogOdds2Prob(FixedLogOdds l);
+
+
   /// \brief probability density function zero mean
   /// \param a - arguement to compute probability of
   /// \param b - variance of the distribution
   /// \returns the likelihood of a
   double pdfNormal(double a, double b);
 
+  /// \brief Log of the probability density function zero mean
+  /// \param a - arguement to compute probability of
+  /// \param b - variance of the distribution
+  /// \returns the log likelihood of a
+  /// \throws std::invalid_argument if the variance is 0
+  double logPdfNormal(double a, double b);
+
+  /// \brief Normalize weights kept as logs with log-sum-exp, the largest is
+  ///        subtracted before exponentiating so they do not underflow
+  /// weights[in,out] - log weights, replaced by the normalized weights
+  /// \returns log of the sum of the weights
+  double normalizeLogWeights(std::vector<double> &weights);
+
   /// \brief Dimensions of map
   /// \param lower - lower limit
   /// \param upper - upper limit
@@ -60,64 +100,63 @@ namespace bmapping
   };
 
 
-  /// \brief a grid cell in the map
-  ///        -1 unkown, 0 free, 1 occupied
+  /// \brief a grid cell in the map. The cell state is -1 unkown, 0 free,
+  ///        1 occupied, and is derived from the log odds.
   struct Cell
   {
-    double log_odds;     // log odds
-    double prob;         // probability of occupied [0 100]
-    double occ_dist;     // distance to nearest occupied cell
-    int state;           // occupied state
-
-    int i, j;            // index location in grid
-    int src_i, src_j;    // index location of nearest obstacle in grid
-
+    FixedLogOdds log_odds;    // fixed point log odds
+    uint16_t occ_dist;        // distance to nearest occupied cell in units of the distance quantum
 
     /// \brief default values
-    Cell() : log_odds(0.0),
-             prob(0.0),
-             occ_dist(0.0),
-             state(-1),
-             i(0),
-             j(0),
-             src_i(0),
-             src_j(0) {}
+    Cell() : log_odds(0),
+             occ_dist(0) {}
 
     /// \brief set cell values
-    /// \param log_odds - log odds probability
-    /// \param dist - distance to nearst obstacle
-    /// \param s - state of cell
-    /// \param cell_prob - probability of cell being occupied
-    Cell(double log_odds, double cell_prob, double dist, int s)
+    /// \param log_odds - fixed point log odds
+    /// \param dist - quantized distance to nearst obstacle
+    Cell(FixedLogOdds log_odds, uint16_t dist)
                                        : log_odds(log_odds),
-                                         prob(cell_prob),
-                                         occ_dist(dist),
-                                         state(s),
-                                         i(0),
-                                         j(0),
-                                         src_i(0),
-                                         src_j(0) {}
+                                         occ_dist(dist) {}
 
   };
 
 
+  /// \brief Cell on the ESDF wavefront and the obstacle nearest to it,
+  ///        only exists while the ESDF is composed
+  struct EsdfNode
+  {
+    double dist;         // distance to nearest obstacle
+    int i, j;            // index location in grid
+    int src_i, src_j;    // index location of nearest obstacle in grid
+  };
+
+
   /// \brief Comparator for ESDF priority queue
   struct CompareDistance
   {
-    bool operator()(const Cell &a, const Cell &b)
+    bool operator()(const EsdfNode &a, const EsdfNode &b) const
     {
-      return a.occ_dist > b.occ_dist;
+      return a.dist > b.dist;
     }
   };
 
 
   // TODO: inherit from probability
 
-  ///\brief Occuapncy grid mapping with known poses
+  ///\brief Occuapncy grid mapping with known poses. The grid is unbounded,
+  ///        cells are allocated in blocks as scans reach them.
   class GridMapper : public LaserScanner
   {
   public:
     /// \brief Constructs a 2D occupancy grid
+    /// \param resolution - size of a cell
+    /// \param xmin - lower x bound of the rviz map, origin of the grid
+    /// \param xmax - upper x bound of the rviz map
+    /// \param ymin - lower y bound of the rviz map, origin of the grid
+    /// \param ymax - upper y bound of the rviz map
+    /// \param props - laser scanner properties
+    /// \param Trs - transform from robot to scanner
+    /// \note the rviz map grows beyond the bounds to cover every allocated block
     GridMapper(double resolution, double xmin, double xmax, double ymin, double ymax,
                      const LaserProperties &props, const Transform2D &Trs);
 
@@ -128,17 +167,143 @@ namespace bmapping
     double likelihoodFieldModel(const std::vector<float> &beam_length,
                                 const Transform2D &pose) const;
 
+    /// \brief Compose the log of the scan likelihood P(z|m,x), the sum of
+    ///        beamLogLikelihood over the end points. Does not underflow
+    ///        however many beams are scored.
+    /// \param beam_length - range measurements from recent scan
+    /// \param pose - recent pose of robot in world fram
+    /// \return the log likelihood of scan given pose and previous map
+    /// \throws std::invalid_argument if the variance of the model is 0
+    double logLikelihoodFieldModel(const std::vector<float> &beam_length,
+                                   const Transform2D &pose) const;
+
     /// \brief Updates the the grid map
     /// \param beam_length - range measurements from recent scan
     /// \param pose - recent pose of robot in world fram
     void integrateScan(const std::vector<float> &beam_length,
                        const Transform2D &pose);
 
+    /// \brief Replaces the map with one composed by gridMap, the distance
+    ///        field is composed from the occupied cells
+    /// \param map - rviz map in row major order
+    /// \throws std::invalid_argument if the size differs from the rviz map
+    void loadMap(const std::vector<int8_t> &map);
+
+    /// \brief Writes the cells, their distance field, and the bounds to a map file
+    /// \param filename - file to write
+    /// \returns true if the file was written
+    bool saveMapFile(const std::string &filename) const;
+
+    /// \brief Copies what saveMapFile writes
+    /// snapshot[out] - cells, occupied cells, and metadata of the map
+    void snapshot(MapSnapshot &snapshot) const;
+
+    /// \brief Replaces the map with one written by saveMapFile. The file is
+    ///        mapped into memory, checked, and its distance field used as is.
+    /// \param filename - file to read
+    /// \returns true if the map was loaded, the map is unchanged otherwise.
+    ///          The file must have the resolution and origin of this grid.
+    bool loadMapFile(const std::string &filename);
+
+    /// \brief Log of the likelihood field model of a beam ending at a point
+    /// \param x - x position of end point in world
+    /// \param y - y position of end point in world
+    /// \returns log likelihood, one term of the log of likelihoodFieldModel
+    /// \throws std::invalid_argument if the variance of the model is 0
+    float beamLogLikelihood(double x, double y) const;
+
+    /// \brief Log of the likelihood field model of a beam ending in each
+    ///        cell of a rectangle, one term of the log of likelihoodFieldModel
+    /// \param i0 - first row in the grid
+    /// \param j0 - first column in the grid
+    /// \param rows - number of rows
+    /// \param cols - number of columns
+    /// patch[out] - log likelihoods in row major order
+    /// \throws std::invalid_argument if the variance of the model is 0
+    void beamLogLikelihoods(int i0, int j0, int rows, int cols,
+                            std::vector<float> &patch) const;
+
+    /// \brief Checks for occupied cells
+    /// \returns true if a cell is occupied
+    bool hasObstacles() const;
+
+    /// \brief Size of a cell
+    /// \returns resolution
+    double resolution() const;
 
-    /// \brief Compose a map viewable in rviz
+    /// \brief Converts floating point world coordinates to grid coordinates
+    /// \param x - x position in world
+    /// \param y - y position in world
+    /// \returns the grid coordinates corresponding to a point in the world
+    GridCoordinates world2Grid(double x, double y) const;
+
+    /// \brief Converts grid coordinates to the world coordinates of the cell center
+    /// \param i - row in the grid
+    /// \param j - column in the grid
+    /// \returns center of the cell
+    Vector2D grid2World(int i, int j) const;
+
+    /// \brief Fixed point log odds of the cell containing a point
+    /// \param x - x position in world
+    /// \param y - y position in world
+    /// \returns log odds, 0 if the cell is unknown
+    FixedLogOdds logOdds(double x, double y) const;
+
+    /// \brief Value of a cell in the rviz map
+    /// \param log_odds - fixed point log odds of cell
+    /// \returns -1 unknown, otherwise occupancy in [0 100]
+    int8_t cellValue(FixedLogOdds log_odds) const;
+
+    /// \brief Number of columns of the rviz map, along x
+    /// \returns width
+    unsigned int viewWidth() const;
+
+    /// \brief Number of rows of the rviz map, along y
+    /// \returns height
+    unsigned int viewHeight() const;
+
+    /// \brief Corner of the first cell of the rviz map
+    /// \returns lower x and y bounds of the rviz map in world
+    Vector2D viewOrigin() const;
+
+    /// \brief Walks a ray through the grid cell by cell until it enters an
+    ///        occupied cell
+    /// \param gc - cell the ray starts from the center of
+    /// \param angle - direction of the ray in world
+    /// \param max_range - max length of the ray
+    /// \returns distance to the edge of the first occupied cell, max_range if none is reached
+    double castRay(const GridCoordinates &gc, double angle, double max_range) const;
+
+
+    /// \brief Compose a map viewable in rviz, the window of the grid
+    ///        covering the bounds given to the constructor and every
+    ///        allocated block
     /// map[out] a map in row major order
     void gridMap(std::vector<int8_t> &map) const;
 
+    /// \brief Regions of the rviz map changed by the last call to integrateScan
+    /// regions[out] - changed rectangles
+    void dirtyRegions(std::vector<MapRegion> &regions) const;
+
+    /// \brief Copies a region of the rviz map
+    /// \param region - rectangle in the map
+    /// data[out] - values of the region in row major order
+    /// \throws std::invalid_argument if the region is not in the rviz map
+    void regionData(const MapRegion &region, std::vector<int8_t> &data) const;
+
+    /// \brief Number of cells allocated
+    /// \returns cells
+    std::size_t allocatedCells() const;
+
+    /// \brief ID of the current map, unique across all grid mappers
+    /// \returns map revision
+    unsigned long revision() const;
+
+    /// \brief Revision the last call to integrateScan started from. The
+    ///        dirty regions are the changes between it and revision()
+    /// \returns parent map revision
+    unsigned long parentRevision() const;
+
 
     void printESDF();
 
@@ -149,33 +314,38 @@ namespace bmapping
 
 
     /// \brief Place cells on queue for composing ESDF
+    /// \param i - row in the grid
+    /// \param j - column in the grid
+    /// \param src_i - row of the nearest obstacle
+    /// \param src_j - column of the nearest obstacle
+    /// Q[out] - heap ordered by CompareDistance
+    /// marked[out] - cells that have been enqueued
     void enqueueCell(int i, int j,
 	                    int src_i, int src_j,
-                      std::priority_queue<Cell, std::vector<Cell>, CompareDistance> &Q,
-                      std::vector<int> &marked);
+                      std::vector<EsdfNode> &Q,
+                      BlockGrid<uint8_t> &marked);
 
     /// \brief Compose distance field (ESDF) using fast marching method
     void euclideanSignedDistanceField();
 
 
-    /// \brief updates state of cell and will call updateCellHash
-    ///        to nominally update the hash table
-    /// \param index - cell index in row major order in map
-    /// cell[out] updated cell
-    void updateCellState(Cell &cell, int index);
+    /// \brief Adds to the log odds of a cell and keeps the set of
+    ///        occupied cells and the dirty tiles up to date
+    /// \param gc - grid coordinates of cell
+    /// \param delta - fixed point log odds to add
+    void updateCell(const GridCoordinates &gc, int delta);
 
-    /// \brief updates the hash table for the occupied and free cells
-    /// \param state - occupied or free state
-    ///               -1 unkown, 0 free, 1 occupied
-    /// \param index - cell index in row major order in map
-    void updateCellHash(int state, int index);
+    /// \brief Distance to the nearest obstacle
+    /// \param cell - a cell
+    /// \returns distance in meters
+    double occupiedDistance(const Cell &cell) const;
 
     /// \brief Uses Bresenham's algo to determines the
     ///        grid coordinates of the free cells
     /// \param point - end point of beam in map
     /// \param pose - robots pose in world (Twr)
     /// free_index[out] grid coordinates of the free cells
-    void freeGridIndex(std::vector<int> &free_index,
+    void freeGridIndex(std::vector<GridCoordinates> &free_index,
                        const Vector2D &point,
                        const Transform2D &pose) const;
 
@@ -185,7 +355,7 @@ namespace bmapping
     /// \param x1 - ending x in grid
     /// \param y1 - ending y in grid
     /// free_index[out] grid coordinates of the free cells
-    void lineLow(std::vector<int> &free_index,
+    void lineLow(std::vector<GridCoordinates> &free_index,
                  int x0, int y0, int x1, int y1) const;
 
     /// \brief Part of Bresenham's algo for drawing lines upward
@@ -194,7 +364,7 @@ namespace bmapping
     /// \param x1 - ending x in grid
     /// \param y1 - ending y in grid
     /// free_index[out] grid coordinates of the free cells
-    void lineHigh(std::vector<int> &free_index,
+    void lineHigh(std::vector<GridCoordinates> &free_index,
                   int x0, int y0, int x1, int y1) const;
 
     /// \brief Part of Bresenham's algo for drawing lines at 45 deg
@@ -203,45 +373,45 @@ namespace bmapping
     /// \param x1 - ending x in grid
     /// \param y1 - ending y in grid
     /// free_index[out] grid coordinates of the free cells
-    void lineDiag(std::vector<int> &free_index,
+    void lineDiag(std::vector<GridCoordinates> &free_index,
                  int x0, int y0, int x1, int y1) const;
 
-    /// \brief Converts floating point world coordinates to grid coordinates
-    /// \param x - x position in world
-    /// \param y - y position in world
-    /// \returns the grid coordinates corresponding to a point in the world
-    GridCoordinates world2Grid(double x, double y) const;
-
-    // /// \brief Converts floating point world coordinates to grid coordinates
-    // /// \param x - x position in world
-    // /// \param y - y position in world
-    // /// \returns the grid index in row major order
-    unsigned int world2RowMajor(double x, double y) const;
-
-    /// \brief Converts grid indices to row major oreder index
+    /// \brief Checks if a cell is in the rviz map
     /// \param i - row in the grid
     /// \param j - column in the grid
-    /// \returns the grid index in row major order
-    unsigned int grid2RowMajor(int i, int j) const;
+    /// \returns true if the cell is within the rviz map
+    bool inView(int i, int j) const;
+
+    /// \brief Grows the rviz map to cover every allocated block, the whole
+    ///        map is marked changed if it grew
+    void growView();
 
 
     double prior_, prob_occ_, prob_free_;           // probabilities for cell states
     double log_odds_prior_;                         // log odds prior
     double log_odds_occ_;                           // log odds occupied
     double log_odds_free_;                          // log odds free
+    int occ_update_, free_update_;                  // fixed point log odds added by a hit or a miss
+    FixedLogOdds occ_threshold_, free_threshold_;   // fixed point log odds of the occupied and free states
 
     double resolution_;                             // map resolution
     double max_occ_dist_;                           // max distance to obstacle
     double cell_radius_;                            // max distance to obstacle in grid dim
-    double xmin_, xmax_, ymin_, ymax_;              // map dims
-    int xsize_, ysize_;                             // number of discretization
+    double dist_quantum_;                           // distance of one unit of Cell::occ_dist
+    double xmin_, xmax_, ymin_, ymax_;              // rviz map dims, origin of the grid
+    int view_i_, view_j_;                           // grid coordinates of the first cell of rviz map
+    int xsize_, ysize_;                             // number of discretization of rviz map
 
 
-    std::unordered_set<int> occ_cells_;              // occupied cell indices
-    std::unordered_set<int> free_cells_;             // free cell indices
+    std::unordered_set<int64_t> occ_cells_;          // occupied cell keys
 
     std::vector<std::vector<double>> distances_;      // pre-compose distance to obstacles
-    std::vector<Cell> map_;                         // grid map
+    std::shared_ptr<const std::vector<float>> beam_log_likelihoods_;  // log likelihood of each Cell::occ_dist, shared by copies
+    BlockGrid<Cell> map_;                           // grid map
+
+    DirtyTiles dirty_;                              // tiles of rviz map changed by last scan
+    unsigned long revision_;                        // ID of map contents
+    unsigned long parent_revision_;                 // ID before last scan
 
   };
 
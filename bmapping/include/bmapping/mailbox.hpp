@@ -0,0 +1,100 @@
+#ifndef MAILBOX_GUARD_HPP
+#define MAILBOX_GUARD_HPP
+/// \file
+/// \brief Single slot mailbox for handing data between two threads
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+
+namespace bmapping
+{
+  /// \brief Holds at most one item passed from a producer to a consumer thread.
+  ///        Posting while an item is unread replaces it (drop oldest), so the
+  ///        consumer always gets the most recent item. Posting and taking are
+  ///        a single atomic exchange, the mutex is only used to sleep while
+  ///        the mailbox is empty.
+  template <typename T>
+  class Mailbox
+  {
+  public:
+    /// \brief Empty mailbox
+    Mailbox() : slot(nullptr), dropped(0) {}
+
+    ~Mailbox()
+    {
+      delete slot.exchange(nullptr);
+    }
+
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    /// \brief Puts an item in the mailbox and wakes the consumer
+    /// \param item - item to post
+    /// \return true if an unread item was dropped
+    bool post(std::unique_ptr<T> item)
+    {
+      std::unique_ptr<T> old(slot.exchange(item.release(), std::memory_order_acq_rel));
+      if (old)
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      // make sure a consumer that is about to wait sees the item
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+      }
+      cv.notify_one();
+
+      return static_cast<bool>(old);
+    }
+
+    /// \brief Removes the item without waiting
+    /// \return the item, null if the mailbox is empty
+    std::unique_ptr<T> take()
+    {
+      return std::unique_ptr<T>(slot.exchange(nullptr, std::memory_order_acq_rel));
+    }
+
+    /// \brief Removes the item, waits up to a timeout for one to be posted
+    /// \param timeout - max time to wait
+    /// \return the item, null if none was posted before the timeout
+    template <typename Rep, typename Period>
+    std::unique_ptr<T> waitTake(const std::chrono::duration<Rep, Period> &timeout)
+    {
+      auto item = take();
+      if (item)
+      {
+        return item;
+      }
+
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait_for(lock, timeout, [this]()
+        {
+          return slot.load(std::memory_order_acquire) != nullptr;
+        });
+      }
+
+      return take();
+    }
+
+    /// \brief Number of items replaced before they were read
+    /// \return dropped items
+    unsigned long droppedCount() const
+    {
+      return dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<T *> slot;                    // the item, null if empty
+    std::atomic<unsigned long> dropped;       // number of unread items replaced
+    std::mutex mtx;                           // only used for waiting
+    std::condition_variable cv;               // signals a posted item
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef MAP_FILE_GUARD_HPP
+#define MAP_FILE_GUARD_HPP
+/// \file
+/// \brief Binary occupancy grid files, read through mmap and written in the background
+///
+/// A map file holds the cells of a GridMapper, the log odds and the distance
+/// to the nearest obstacle (ESDF) of every allocated block, so loading it does
+/// not compose the distance field again. The occupied cells are found from
+/// the log odds when loaded. Values are in the native byte order.
+///
+///   MapFileHeader       magic, version, layout, grid metadata, section offsets
+///   MapFileBlock[]      block coordinates and the checksum of its cells
+///   padding             to the next page
+///   Cell[][]            block_cells cells per block in the order of the table
+///
+/// The header, the table, and each block are checksummed. A file is written to a
+/// temporary name, flushed to disk, and renamed, then the directory is flushed,
+/// so a crash or power loss while saving leaves either the last map or the new one.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/mailbox.hpp"
+
+
+namespace bmapping
+{
+
+  /// \brief Identifies a map file
+  constexpr char map_file_magic[4] = {'B', 'M', 'A', 'P'};
+
+  /// \brief Version of the map file layout
+  constexpr std::uint32_t map_file_version = 1;
+
+  /// \brief Alignment of the cells in a map file
+  constexpr std::uint64_t map_file_alignment = 4096;
+
+
+  /// \brief Start of a map file
+  struct MapFileHeader
+  {
+    char magic[4];                    // map_file_magic
+    std::uint32_t version;            // map_file_version
+    std::uint32_t header_bytes;       // size of this header
+    std::uint32_t cell_bytes;         // size of a Cell
+    std::uint32_t block_size;         // cells along the edge of a block
+    std::uint32_t reserved;           // zero
+    double resolution;                // size of a cell
+    double xmin, xmax, ymin, ymax;    // rviz map bounds, the origin of the grid
+    double dist_quantum;              // distance of one unit of Cell::occ_dist
+    double max_occ_dist;              // max distance to an obstacle
+    std::uint64_t num_blocks;         // allocated blocks
+    std::uint64_t num_occupied;       // occupied cells when saved
+    std::uint64_t table_offset;       // offset of the block table
+    std::uint64_t cells_offset;       // offset of the cells, page aligned
+    std::uint64_t file_bytes;         // size of the file
+    std::uint64_t table_checksum;     // checksum of the block table
+    std::uint64_t header_checksum;    // checksum of the bytes before this field
+  };
+
+
+  /// \brief Entry of the block table of a map file
+  struct MapFileBlock
+  {
+    std::int32_t bi, bj;              // block row and column
+    std::uint64_t checksum;           // checksum of the cells of the block
+  };
+
+
+  /// \brief Copy of the contents of a GridMapper to be written to a map file
+  struct MapSnapshot
+  {
+    MapFileHeader header;                           // grid metadata, the rest is set when written
+    std::vector<std::pair<int, int>> blocks;        // block row and column of each block
+    std::vector<Cell> cells;                        // block_cells cells per block in the order of blocks
+  };
+
+
+  /// \brief Checksum of a chunk of a map file, FNV-1a over 64 bit words in
+  ///        four interleaved lanes so the multiplies do not wait on each other
+  /// \param data - first byte
+  /// \param size - number of bytes
+  /// \returns checksum
+  std::uint64_t mapChecksum(const void *data, std::size_t size);
+
+  /// \brief Writes a map file, to a temporary file renamed once it is on disk
+  /// \param filename - file to write
+  /// \param snapshot - contents of the map
+  /// \returns true if the file was written
+  bool writeMapFile(const std::string &filename, const MapSnapshot &snapshot);
+
+
+  /// \brief File mapped read only into memory, pages are read on first access
+  class MappedFile
+  {
+  public:
+    /// \brief Maps a file
+    /// \param filename - file to map
+    explicit MappedFile(const std::string &filename);
+
+    /// \brief Unmaps the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// \brief Checks the file was mapped
+    /// \returns true if the contents can be read
+    bool isOpen() const;
+
+    /// \brief Contents of the file
+    /// \returns first byte, nullptr if not mapped
+    const unsigned char *data() const;
+
+    /// \brief Size of the file
+    /// \returns bytes
+    std::size_t size() const;
+
+  private:
+    const unsigned char *data_;       // mapped contents
+    std::size_t size_;                // bytes mapped
+  };
+
+
+  /// \brief Saves maps on its own thread so the caller never waits on the disk.
+  ///        Only the cells are copied when a map is handed over, the checksums
+  ///        and the file are composed on the writer thread. A map handed over
+  ///        while another is being written replaces any map still waiting.
+  class MapWriter
+  {
+  public:
+    /// \brief Starts the writer
+    /// \param filename - file the maps are written to
+    explicit MapWriter(const std::string &filename);
+
+    /// \brief Writes the map still waiting, then stops the writer
+    ~MapWriter();
+
+    MapWriter(const MapWriter &) = delete;
+    MapWriter &operator=(const MapWriter &) = delete;
+
+    /// \brief Queues a snapshot of a map to be written
+    /// \param grid - the map
+    void save(const GridMapper &grid);
+
+    /// \brief Number of maps written
+    /// \returns maps
+    unsigned long written() const;
+
+    /// \brief Number of maps that could not be written
+    /// \returns maps
+    unsigned long failed() const;
+
+  private:
+    /// \brief Writes the maps handed over until stopped
+    void run();
+
+
+    std::string filename_;                        // file written
+    Mailbox<MapSnapshot> pending_;                // latest map not yet written
+    std::atomic<bool> running_;                   // false once stopping
+    std::atomic<unsigned long> written_;          // maps written
+    std::atomic<unsigned long> failed_;           // maps not written
+    std::thread thread_;                          // writes the maps, last so it starts after the members above
+  };
+
+} // end namespace
+
+#endif
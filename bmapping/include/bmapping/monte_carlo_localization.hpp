@@ -0,0 +1,145 @@
+#ifndef MONTE_CARLO_LOCALIZATION_GUARD_HPP
+#define MONTE_CARLO_LOCALIZATION_GUARD_HPP
+/// \file
+/// \brief Monte Carlo localization on a known occupancy grid with KLD sampling
+///
+/// Every particle is scored against one shared map, with the likelihood field
+/// or the beam model, so an update costs O(particles x beams) rather than
+/// integrating the scan into a map per particle. The number of particles is adapted after each
+/// update with KLD sampling (Fox, Adapting the Sample Size in Particle
+/// Filters Through KLD-Sampling).
+
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include "bmapping/beam_model.hpp"
+#include "bmapping/grid_mapper.hpp"
+
+
+namespace bmapping
+{
+  using Eigen::Vector3d;
+  using Eigen::Matrix3d;
+  using rigid2d::Pose;
+
+
+  /// \brief Localizes a robot on a prebuilt map
+  class MonteCarloLocalization
+  {
+  public:
+    /// \brief Creates the filter
+    /// \param map - the map, shared read only and must outlive the filter
+    /// \param min_particles - lower bound on the number of particles
+    /// \param max_particles - upper bound on the number of particles
+    /// \param kld_error - max KL divergence between the particles and the true posterior
+    /// \param kld_z - upper standard normal quantile of the probability the error bound holds
+    /// \param bin_xy - size of the KLD histogram bins along x and y
+    /// \param bin_theta - size of the KLD histogram bins along theta
+    /// \param srr - rotation noise from rotation
+    /// \param srt - rotation noise from translation
+    /// \param str - translation noise from translation
+    /// \param stt - translation noise from rotation
+    /// \param update_distance - distance the robot moves between updates
+    /// \param update_angle - rotation of the robot between updates
+    /// \param max_beams - max number of beams scored, evenly spaced in the scan
+    /// \throws std::invalid_argument if a bound, bin, error, or max_beams is not positive,
+    ///         or the min particles exceeds the max particles
+    MonteCarloLocalization(const GridMapper &map,
+                           int min_particles,
+                           int max_particles,
+                           double kld_error,
+                           double kld_z,
+                           double bin_xy,
+                           double bin_theta,
+                           double srr,
+                           double srt,
+                           double str,
+                           double stt,
+                           double update_distance,
+                           double update_angle,
+                           int max_beams);
+
+    /// \brief Samples max_particles poses from a normal distribution
+    /// \param pose - mean pose (theta, x, y)
+    /// \param cov - covariance of the pose (theta, x, y)
+    void initialize(const Vector3d &pose, const Matrix3d &cov);
+
+    /// \brief Scores the particles with the beam model rather than the
+    ///        likelihood field
+    /// \param num_angles - number of directions in one revolution of the range table
+    /// \param lambda_short - rate of the exponential distribution of short readings
+    /// \throws std::invalid_argument if the beam model can not be created
+    void useBeamModel(int num_angles, double lambda_short);
+
+    /// \brief Moves the particles by the odometry, weighs them by the scan,
+    ///        and resamples. The first call only weighs and resamples.
+    /// \param scan - range measurements
+    /// \param odom - odometry pose
+    /// \returns false if the robot has not moved far enough since the last update
+    bool update(const std::vector<float> &scan, const Pose &odom);
+
+    /// \brief Weighted mean of the particles
+    /// \returns pose (theta, x, y)
+    Vector3d mean() const;
+
+    /// \brief Weighted covariance of the particles
+    /// \returns covariance (theta, x, y)
+    Matrix3d covariance() const;
+
+    /// \brief Weighted mean of the particles
+    /// \returns Transform from map to robot
+    Transform2D getRobotState() const;
+
+    /// \brief Number of particles
+    /// \returns size
+    std::size_t numParticles() const;
+
+    /// \brief Poses of the particles
+    /// \returns poses (theta, x, y)
+    const std::vector<Vector3d> &poses() const;
+
+    /// \brief Normalized weights of the particles
+    /// \returns weights
+    const std::vector<double> &weights() const;
+
+  private:
+    /// \brief Samples the odometry motion model for every particle
+    /// \param prev_odom - odometry pose at the last update
+    /// \param cur_odom - current odometry pose
+    void sampleMotionModel(const Pose &prev_odom, const Pose &cur_odom);
+
+    /// \brief Multiplies the weights by the likelihood of the scan
+    /// \param scan - range measurements
+    void weighParticles(const std::vector<float> &scan);
+
+    /// \brief Draws particles until the number needed for the KLD bound
+    ///        on the histogram bins they occupy is reached
+    void kldResampling();
+
+    /// \brief Number of particles needed for the KLD bound
+    /// \param k - number of occupied bins
+    /// \returns number of particles
+    int kldSize(int k) const;
+
+
+    const GridMapper &map_;                           // shared map
+    int min_particles_, max_particles_;               // bounds on the number of particles
+    double kld_error_, kld_z_;                        // KLD bound
+    double bin_xy_, bin_theta_;                       // KLD histogram bins
+    double srr_, srt_, str_, stt_;                    // odometry motion model noise
+    double update_distance_, update_angle_;           // motion between updates
+    int max_beams_;                                   // beams scored per scan
+    std::unique_ptr<BeamModel> beam_model_;           // scores with the beam model if set
+
+    std::vector<Vector3d> poses_;                     // particle poses (theta, x, y)
+    std::vector<double> weights_;                     // normalized particle weights
+    Pose last_odom_;                                  // odometry at the last update
+    bool has_odom_;                                   // true after the first update
+  };
+} // end namespace
+
+#endif
@@ -13,7 +13,10 @@
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/diff_drive.hpp>
+#include <rigid2d/utilities.hpp>
 #include "bmapping/cloud_alignment.hpp"
+#include "bmapping/correlative_matcher.hpp"
+#include "bmapping/scan_filter.hpp"
 #include "bmapping/sensor_model.hpp"
 #include "bmapping/grid_mapper.hpp"
 
@@ -24,6 +27,7 @@ namespace bmapping
   using Eigen::VectorXd;
   using Eigen::Vector2d;
   using Eigen::Vector3d;
+  using Eigen::Matrix3d;
   using Eigen::Ref;
 
   using rigid2d::Twist2D;
@@ -34,34 +38,14 @@ namespace bmapping
   using rigid2d::deg2rad;
   using rigid2d::almost_equal;
   using rigid2d::normalize_angle_PI;
-
-  /// \brief Returns a random number engine
-  std::mt19937_64 &getTwister();
-
-  /// \brief samples a standard normal distribution
-  /// \param n - number of samples
-  /// \returns - random sample
-  VectorXd sampleStandardNormal(int n);
-
-  /// \brief samples a multivariate standard normal distribution
-  /// \param cov - covariance matrix
-  /// \returns - random samples
-  VectorXd sampleMultivariateDistribution(const Ref<MatrixXd> cov);
-
-  /// \brief samples a multivariate standard normal distribution
-  /// \param mu - distribution mean
-  /// \param cov - distribution covariance matrix
-  /// \returns - random samples
-  VectorXd sampleMultivariateDistribution(const Ref<VectorXd> mu, const Ref<MatrixXd> cov);
-
-
-
+  using rigid2d::MultivariateNormal;
+  using rigid2d::sampleStandardNormal;
 
   /// \brief Represents a particle
   struct Particle
   {
-    // particles weight
-    double weight;
+    // log of the particles weight, normalized after each update
+    double log_weight;
 
     // the map
     GridMapper grid;
@@ -73,11 +57,11 @@ namespace bmapping
     Vector3d prev_pose;
 
     /// \brief Initialize a particle
-    /// \param w - weight
+    /// \param lw - log of the weight
     /// \mapper - occupancy grid mapper
     /// \ps - particles pose
-    Particle(double w, const GridMapper &mapper, const Vector3d &ps)
-                : weight(w),
+    Particle(double lw, const GridMapper &mapper, const Vector3d &ps)
+                : log_weight(lw),
                   grid(mapper),
                   pose(ps),
                   prev_pose(ps)
@@ -85,7 +69,9 @@ namespace bmapping
   };
 
 
-  /// \brief Particle filter for grid based SLAM
+  /// \brief Particle filter for grid based SLAM. The weights are kept as
+  ///        logs and normalized with log-sum-exp, so the product of many
+  ///        beam likelihoods does not underflow.
   class ParticleFilter
   {
   public:
@@ -102,10 +88,6 @@ namespace bmapping
     /// \param sample_range_theta - sample ICP transform rotation distribution range
     /// \param sample_range_x - sample ICP transform x translation distribution range
     /// \param sample_range_y - sample ICP transform x translation distribution range
-    /// \param scan_likelihood_min - min scan likelihood
-    /// \param scan_likelihood_max - max scan likelihood 
-    /// \param pose_likelihood_min - min pose likelihood
-    /// \param pose_likelihood_max - max pose likelihood
     /// \param scan_matcher - iterative closes point
     /// \param pose - initial pose
     /// \param mapper - occupancy grid mapper and scan likelihood
@@ -121,14 +103,21 @@ namespace bmapping
                    double sample_range_theta,
                    double sample_range_x,
                    double sample_range_y,
-                   double scan_likelihood_min,
-                   double scan_likelihood_max,
-                   double pose_likelihood_min,
-                   double pose_likelihood_max,
                    ScanAlignment &scan_matcher,
                    const Transform2D &pose,
                    const GridMapper &mapper);
 
+    /// \brief Proposes the poses of the particles with a correlative scan
+    ///        matcher rather than ICP and sampling around its mode
+    /// \param matcher - the scan matcher
+    void useCorrelativeMatcher(const CorrelativeScanMatcher &matcher);
+
+    /// \brief Filters each scan once before it is used, the particles and
+    ///        ICP score the decimated beams and the maps integrate every
+    ///        valid return
+    /// \param filter - the scan filter
+    void useScanFilter(const ScanFilter &filter);
+
     /// \brief Updates the particle set and the occupancy grid
     /// \param scan - recent laser scan in the robot frame
     /// \param u - twist from odometry given wheel velocities
@@ -143,6 +132,10 @@ namespace bmapping
     /// map[out] - new map
     void newMap(std::vector<int8_t> &map);
 
+    /// \brief Grid mapper of particle with highest weight
+    /// \returns the map, valid until the next SLAM update
+    const GridMapper &bestMap() const;
+
 
   private:
     /// \brief Initialize the particle set to begin with
@@ -162,15 +155,19 @@ namespace bmapping
     // double poseLikelihoodTwist(const Ref<Vector3d> cur_pose, const Ref<Vector3d> prev_pose, const Twist2D &u);
 
 
-    /// \brief Pose likelihood P(x'|x,u)
+    /// \brief Log of the pose likelihood P(x'|x,u)
     /// \param cur_pose - current pose
     /// \param prev_pose - previous pose
-    /// \returns likelihood of current pose;
-    double poseLikelihoodOdom(const Ref<Vector3d> cur_pose, const Ref<Vector3d> prev_pose,
-                              const Ref<Vector3d> cur_odom, const Ref<Vector3d> prev_odom);
+    /// \param pose_cov - covariance of the current pose (theta, x, y), the
+    ///                   likelihood is integrated over it
+    /// \returns log likelihood of current pose;
+    double logPoseLikelihoodOdom(const Ref<Vector3d> cur_pose, const Ref<Vector3d> prev_pose,
+                                 const Ref<Vector3d> cur_odom, const Ref<Vector3d> prev_odom,
+                                 const Ref<const Matrix3d> pose_cov);
 
 
-    /// \brief Normalize all particle's weights
+    /// \brief Normalize all particle's log weights with log-sum-exp and
+    ///        compose the normalized weights
     void normalizeWeights();
 
     /// \brief Compose the number of effective particles
@@ -196,7 +193,7 @@ namespace bmapping
     /// \param prev_odom - previous odometry pose
     /// \param mu - gaussian proposal mean
     /// \param sigma - gaussian proposal covariance
-    /// \param eta - normalization factor
+    /// \param log_eta - log of the normalization factor
     void gaussianProposal(std::vector<Vector3d> &sampled_poses,
                           Particle &particle,
                           const std::vector<float> &scan,
@@ -204,7 +201,27 @@ namespace bmapping
                           const Ref<Vector3d> prev_odom,
                           Ref<Vector3d> mu,
                           Ref<MatrixXd> sigma,
-                          double &eta);
+                          double &log_eta);
+
+    /// \brief Compose the gaussian proposal from the best match of the scan
+    ///        around the pose predicted by odometry
+    /// \param particle - the current particle to update
+    /// \param scan - recent lidar data
+    /// \param guess - pose of particle moved by the odometry
+    /// \param cur_odom - recent odometry pose
+    /// \param prev_odom - previous odometry pose
+    /// \param mu - gaussian proposal mean
+    /// \param sigma - gaussian proposal covariance
+    /// \param log_eta - log of the normalization factor
+    /// \returns false if the scan does not match the map
+    bool correlativeProposal(Particle &particle,
+                             const std::vector<float> &scan,
+                             const Ref<Vector3d> guess,
+                             const Ref<Vector3d> cur_odom,
+                             const Ref<Vector3d> prev_odom,
+                             Ref<Vector3d> mu,
+                             Ref<MatrixXd> sigma,
+                             double &log_eta);
 
     /// \brief Compose the initial guess for ICP based on odometry
     /// \param cur_odom - recent odometry pose
@@ -220,15 +237,22 @@ namespace bmapping
     double motion_noise_theta_, motion_noise_x_, motion_noise_y_;    // motion model sampling noise
     double sample_range_theta_, sample_range_x_, sample_range_y_;    // sample range for ICP distribution
 
-    double scan_likelihood_min_, scan_likelihood_max_;              // limits on scan likelihood
-    double pose_likelihood_min_, pose_likelihood_max_;              // limits on pose likelihood
-
     double normal_sqrd_sum_;                                        // normalized squared sum of particle weights
+    std::vector<double> weights_;                                   // normalized weight of each particle
+    int best_;                                                      // particle with the highest weight, kept through resampling
+    std::vector<double> likelihoods_;                               // likelihood of each pose around the mode
 
     ScanAlignment scan_matcher_;                                    // ICP
+    CorrelativeScanMatcher correlative_matcher_;                    // searches a window around the odometry
+    bool use_correlative_;                                          // propose with correlative_matcher_ rather than ICP
+    ScanFilter scan_filter_;                                        // removes and decimates beams
+    bool use_scan_filter_;                                          // filter each scan with scan_filter_
+    FilteredScan filtered_;                                         // the latest scan filtered
     std::vector<Particle> particle_set_;                            // set of particles
     MatrixXd motion_noise_;                                         // noise in the motion model
     MatrixXd sample_range_;                                         // range for sampling mode of transform from ICP
+    MultivariateNormal motion_sampler_;                             // samples the motion noise
+    MultivariateNormal mode_sampler_;                               // samples around the mode of the ICP transform
 
   };
 
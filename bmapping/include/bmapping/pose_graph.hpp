@@ -0,0 +1,137 @@
+#ifndef POSE_GRAPH_GUARD_HPP
+#define POSE_GRAPH_GUARD_HPP
+/// \file
+/// \brief Sparse pose graph of submaps and the scans inserted into them
+///
+/// The variables are the poses of the submaps and of the trajectory nodes
+/// (scans) in the map frame. Each constraint is the pose of a node measured
+/// in the frame of a submap, either by inserting the scan into the submap or
+/// by a loop closure. The graph is optimized with Gauss-Newton, each step
+/// solves the sparse normal equations with a Cholesky (LDLT) factorization.
+/// Loop closures use a Huber loss so a wrong match can not pull the whole map.
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <rigid2d/rigid2d.hpp>
+
+
+namespace bmapping
+{
+  using Eigen::Vector3d;
+  using Eigen::Matrix3d;
+  using rigid2d::Transform2D;
+
+
+  /// \brief Convert a transform to a pose
+  /// \param T - transform
+  /// \returns pose (theta, x, y)
+  Vector3d transform2Pose(const Transform2D &T);
+
+  /// \brief Convert a pose to a transform
+  /// \param pose - pose (theta, x, y)
+  /// \returns transform
+  Transform2D pose2Transform(const Vector3d &pose);
+
+
+  /// \brief Pose of a node measured in the frame of a submap
+  struct PoseConstraint
+  {
+    int submap = 0;                                 // index of the submap
+    int node = 0;                                   // index of the node
+    Vector3d relative = Vector3d::Zero();           // pose of the node in the submap (theta, x, y)
+    Matrix3d information = Matrix3d::Identity();    // inverse covariance of relative (theta, x, y)
+    bool loop_closure = false;                      // robust loss applied if true
+  };
+
+
+  /// \brief Poses of the submaps and nodes constrained by relative poses
+  class PoseGraph
+  {
+  public:
+    /// \brief Creates an empty graph
+    /// \param huber_scale - residual, in standard deviations, past which
+    ///                      loop closures are down weighted
+    /// \throws std::invalid_argument if huber_scale is not positive
+    explicit PoseGraph(double huber_scale = 1.0);
+
+    /// \brief Adds a submap, the first submap is fixed
+    /// \param pose - initial pose in map (theta, x, y)
+    /// \returns index of the submap
+    int addSubmap(const Vector3d &pose);
+
+    /// \brief Adds a node
+    /// \param pose - initial pose in map (theta, x, y)
+    /// \returns index of the node
+    int addNode(const Vector3d &pose);
+
+    /// \brief Adds a constraint
+    /// \param constraint - relative pose of a node in a submap
+    /// \throws std::invalid_argument if the submap or node does not exist
+    void addConstraint(const PoseConstraint &constraint);
+
+    /// \brief Moves the poses to minimize the error of the constraints
+    /// \param max_iterations - max number of Gauss-Newton steps
+    /// \returns final weighted squared error
+    double optimize(int max_iterations);
+
+    /// \brief Weighted squared error of the constraints
+    /// \returns error
+    double cost() const;
+
+    /// \brief Pose of a submap
+    /// \param index - index of the submap
+    /// \returns pose (theta, x, y)
+    const Vector3d &submapPose(int index) const;
+
+    /// \brief Pose of a node
+    /// \param index - index of the node
+    /// \returns pose (theta, x, y)
+    const Vector3d &nodePose(int index) const;
+
+    /// \brief Sets the pose of a submap
+    /// \param index - index of the submap
+    /// \param pose - pose (theta, x, y)
+    void setSubmapPose(int index, const Vector3d &pose);
+
+    /// \brief Sets the pose of a node
+    /// \param index - index of the node
+    /// \param pose - pose (theta, x, y)
+    void setNodePose(int index, const Vector3d &pose);
+
+    /// \brief Number of submaps
+    /// \returns submaps
+    int numSubmaps() const;
+
+    /// \brief Number of nodes
+    /// \returns nodes
+    int numNodes() const;
+
+    /// \brief Constraints in the order they were added
+    /// \returns constraints
+    const std::vector<PoseConstraint> &constraints() const;
+
+  private:
+    /// \brief Error of a constraint and its Jacobians
+    /// \param constraint - the constraint
+    /// J_submap[out] - derivative of the error by the submap pose
+    /// J_node[out] - derivative of the error by the node pose
+    /// \returns error (theta, x, y)
+    Vector3d error(const PoseConstraint &constraint, Matrix3d &J_submap, Matrix3d &J_node) const;
+
+    /// \brief Weight of the Huber loss of a constraint
+    /// \param constraint - the constraint
+    /// \param e - error of the constraint
+    /// \returns weight in (0 1]
+    double robustWeight(const PoseConstraint &constraint, const Vector3d &e) const;
+
+
+    double huber_scale_;                            // Huber loss threshold
+    std::vector<Vector3d> submaps_;                 // submap poses
+    std::vector<Vector3d> nodes_;                   // node poses
+    std::vector<PoseConstraint> constraints_;       // relative poses
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SCAN_FILTER_GUARD_HPP
+#define SCAN_FILTER_GUARD_HPP
+/// \file
+/// \brief Preprocesses a scan once before it is scored and inserted into the map
+///
+/// Returns outside the range limits and returns with no neighbouring end point
+/// close to them are removed. The remaining beams are decimated by the spacing
+/// of their end points, so near the robot where consecutive beams land in the
+/// same cell only one is kept, while far away every beam is. A beam is always
+/// kept once the angle since the last kept beam reaches the max gap. If more
+/// beams than the budget are left, evenly spaced ones are scored.
+///
+/// Removed beams are set to NaN rather than erased so each range still lines
+/// up with the angle of its beam, every consumer of a scan skips ranges outside
+/// the limits of the laser.
+
+#include <vector>
+
+#include "bmapping/sensor_model.hpp"
+
+
+namespace bmapping
+{
+
+  /// \brief Scan split into the beams inserted into the map and those scored
+  struct FilteredScan
+  {
+    std::vector<float> integrate;     // valid returns, inserted into the map
+    std::vector<float> score;         // decimated returns, scored for each pose and used by ICP
+    unsigned int num_valid = 0;       // returns in integrate
+    unsigned int num_scored = 0;      // returns in score
+  };
+
+
+  /// \brief Removes invalid and isolated returns and bounds the beams scored
+  class ScanFilter
+  {
+  public:
+    /// \brief Passes every beam on, without a laser the range limits are unknown
+    ScanFilter();
+
+    /// \brief Creates a scan filter
+    /// \param props - beam angles and range limits of the laser
+    /// \param min_spacing - min distance between the end points of the beams scored
+    /// \param max_angle_gap - max angle between the beams scored, 0 for no limit
+    /// \param isolation_distance - a return is removed if no end point of the beams
+    ///                             next to it is this close, 0 keeps every return.
+    ///                             Should exceed the spacing of the beams at max range.
+    /// \param max_beams - max number of beams scored, 0 for no limit
+    /// \throws std::invalid_argument if a distance or angle is negative
+    ScanFilter(const LaserProperties &props,
+               double min_spacing,
+               double max_angle_gap,
+               double isolation_distance,
+               unsigned int max_beams);
+
+    /// \brief Filters a scan
+    /// \param scan - range measurements
+    /// filtered[out] - the beams to insert into the map and to score, both
+    ///                 the size of the scan
+    void filter(const std::vector<float> &scan, FilteredScan &filtered) const;
+
+  private:
+    /// \brief End point of a beam in the frame of the laser
+    /// \param scan - range measurements
+    /// \param beam - index of the beam
+    /// \returns end point
+    Vector2D endPoint(const std::vector<float> &scan, std::size_t beam) const;
+
+    /// \brief Whether a return is within the range limits
+    /// \param range - range measurement
+    /// \returns true if valid
+    bool valid(float range) const;
+
+
+    std::vector<double> scan_angles_;           // angle of each beam
+    PointBatchd beam_dirs_;                     // cosine and sine of each beam angle
+    float range_min_, range_max_;               // range limits of the laser
+    double min_spacing_;                        // min distance between scored end points
+    double max_angle_gap_;                      // max angle between scored beams
+    double isolation_distance_;                 // max distance to a neighbouring end point
+    unsigned int max_beams_;                    // beam budget
+  };
+
+} // end namespace
+
+#endif
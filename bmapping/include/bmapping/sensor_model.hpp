@@ -8,12 +8,14 @@
 #include <vector>
 
 #include <rigid2d/rigid2d.hpp>
+#include <rigid2d/batch_transform.hpp>
 
 
 namespace bmapping
 {
   using rigid2d::Vector2D;
   using rigid2d::Transform2D;
+  using rigid2d::PointBatchd;
 
 
   /// \brief stores laser range finder limits and properties
@@ -98,6 +100,14 @@ namespace bmapping
                          const std::vector<float> &beam_length,
                          const Transform2D &pose) const;
 
+    /// \brief compose cartesian end points of laser beams in map frame
+    /// \param beam_length - range measurements from recent scan
+    /// \param pose - robots pose in world (Twr)
+    /// end_points[out] end points of laser beam as structure of arrays
+    void laserEndPoints(PointBatchd &end_points,
+                        const std::vector<float> &beam_length,
+                        const Transform2D &pose) const;
+
 
     /// \brief Determines the number of range measurements with the
     ///        limits if the laser range finder
@@ -105,6 +115,22 @@ namespace bmapping
     /// \returns number of laser measurements with range limits of sensor
     unsigned int numberValidMeasurements(const std::vector<float> &beam_length) const;
 
+    /// \brief Angle of each beam in the frame of the scanner
+    /// \returns angles in the order of the range measurements
+    const std::vector<double> &scanAngles() const;
+
+    /// \brief Transform from robot to laser scanner
+    /// \returns Trs
+    const Transform2D &scannerTransform() const;
+
+    /// \brief Min range limit for laser
+    /// \returns range
+    float rangeMin() const;
+
+    /// \brief Max range limit for laser
+    /// \returns range
+    float rangeMax() const;
+
 
 
     double z_hit_, z_short_, z_max_, z_rand_;  //must sum to 1
@@ -114,6 +140,8 @@ namespace bmapping
     Transform2D Trs_;                         // robot to laser scanner
     float beam_min_, beam_max_, beam_delta_;  // start, end, increment scan angles
     float range_min_, range_max_;              // min and max range limit for laser
+    std::vector<double> scan_angles_;          // angle of each beam
+    PointBatchd beam_dirs_;                    // cosine and sine of each beam angle
   };
 
 } // end namespace
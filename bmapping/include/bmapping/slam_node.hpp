@@ -0,0 +1,442 @@
+#ifndef SLAM_NODE_GUARD_HPP
+#define SLAM_NODE_GUARD_HPP
+/// \file
+/// \brief Parameters, odometry, transforms, and ground truth shared by the SLAM nodes
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/LaserScan.h>
+#include <tf2/LinearMath/Matrix3x3.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2_ros/transform_broadcaster.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/joint_index.hpp>
+#include <rigid2d/odometry_engine.hpp>
+#include <rigid2d/path_publisher.hpp>
+#include <rigid2d/ros_instrumentation.hpp>
+#include "bmapping/sensor_model.hpp"
+#include "bmapping/mailbox.hpp"
+#include "tsim/PoseError.h"
+
+
+namespace bmapping
+{
+  /// \brief Scan and its time handed to the SLAM worker
+  struct ScanUpdate
+  {
+    std::vector<float> scan;                                    // lidar scan
+    double stamp = 0.0;                                         // time of the odometry at the scan
+  };
+
+
+  /// \brief Parameters read by every SLAM node
+  struct SlamNodeParams
+  {
+    // frame IDs
+    std::string map_frame_id, odom_frame_id, body_frame_id;
+
+    // robots chassis parameters
+    std::string left_wheel_joint, right_wheel_joint;
+    double wheel_base = 0.0, wheel_radius = 0.0;
+
+    // lidar specs, angles in radians
+    double beam_min = 0.0, beam_max = 0.0, beam_delta = 0.0;
+    double range_min = 0.0, range_max = 0.0;
+
+    // scan likelihood parameters
+    double z_hit = 0.0, z_short = 0.0, z_max = 0.0, z_rand = 0.0, sigma_hit = 0.0;
+
+    // occupancy grid parameters
+    double map_min = 0.0, map_max = 0.0, map_resolution = 0.0;
+
+    // rate of pose error and map update publishing
+    double publish_frequency = 10.0;
+
+    // rate of full map publishing
+    double map_publish_frequency = 0.2;
+
+    // odometry poses kept
+    int odometry_history = 2000;
+
+    // trajectory recording
+    int path_capacity = 5000;
+    double path_min_distance = 0.01, path_min_angle = 0.05, path_publish_frequency = 1.0;
+    bool path_delta = false;
+
+    /// \brief Laser scanner properties of the parameters
+    /// \return the properties
+    LaserProperties laserProperties() const
+    {
+      return LaserProperties(beam_min, beam_max, beam_delta, range_min, range_max,
+                             z_hit, z_short, z_max, z_rand, sigma_hit);
+    }
+  };
+
+
+  /// \brief Reads and logs the parameters shared by the SLAM nodes,
+  ///        the beam angles are converted from degrees to radians
+  /// \param nh - private node handle
+  /// \param node_handle - public node handle with the robot parameters
+  /// params[out] - the parameters
+  /// \return true if the parameters are valid
+  inline bool loadSlamNodeParams(ros::NodeHandle &nh, ros::NodeHandle &node_handle, SlamNodeParams &params)
+  {
+    nh.getParam("left_wheel_joint", params.left_wheel_joint);
+    nh.getParam("right_wheel_joint", params.right_wheel_joint);
+
+    nh.getParam("map_frame_id", params.map_frame_id);
+    nh.getParam("odom_frame_id", params.odom_frame_id);
+    nh.getParam("body_frame_id", params.body_frame_id);
+
+    nh.getParam("beam_min", params.beam_min);
+    nh.getParam("beam_max", params.beam_max);
+    nh.getParam("beam_delta", params.beam_delta);
+    nh.getParam("range_min", params.range_min);
+    nh.getParam("range_max", params.range_max);
+
+    nh.getParam("z_hit", params.z_hit);
+    nh.getParam("z_short", params.z_short);
+    nh.getParam("z_max", params.z_max);
+    nh.getParam("z_rand", params.z_rand);
+    nh.getParam("sigma_hit", params.sigma_hit);
+
+    nh.getParam("map_min", params.map_min);
+    nh.getParam("map_max", params.map_max);
+    nh.getParam("map_resolution", params.map_resolution);
+
+    nh.getParam("publish_frequency", params.publish_frequency);
+    nh.getParam("map_publish_frequency", params.map_publish_frequency);
+    nh.getParam("odometry_history", params.odometry_history);
+
+    nh.getParam("path_capacity", params.path_capacity);
+    nh.getParam("path_min_distance", params.path_min_distance);
+    nh.getParam("path_min_angle", params.path_min_angle);
+    nh.getParam("path_publish_frequency", params.path_publish_frequency);
+    nh.getParam("path_delta", params.path_delta);
+
+    node_handle.getParam("/wheel_base", params.wheel_base);
+    node_handle.getParam("/wheel_radius", params.wheel_radius);
+
+    if (params.publish_frequency <= 0.0)
+    {
+      ROS_FATAL("publish_frequency must be positive, got %f", params.publish_frequency);
+      return false;
+    }
+
+    if (params.map_publish_frequency <= 0.0)
+    {
+      ROS_FATAL("map_publish_frequency must be positive, got %f", params.map_publish_frequency);
+      return false;
+    }
+
+    params.beam_min = rigid2d::deg2rad(params.beam_min);
+    params.beam_max = rigid2d::deg2rad(params.beam_max);
+    params.beam_delta = rigid2d::deg2rad(params.beam_delta);
+
+    ROS_INFO("beam_min %f", params.beam_min);
+    ROS_INFO("beam_max %f", params.beam_max);
+    ROS_INFO("beam_delta %f", params.beam_delta);
+    ROS_INFO("range_min %f", params.range_min);
+    ROS_INFO("range_max %f", params.range_max);
+
+    ROS_INFO("z_hit %f", params.z_hit);
+    ROS_INFO("z_short %f", params.z_short);
+    ROS_INFO("z_max %f", params.z_max);
+    ROS_INFO("z_rand %f", params.z_rand);
+    ROS_INFO("sigma_hit %f", params.sigma_hit);
+
+    ROS_INFO("map_min %f", params.map_min);
+    ROS_INFO("map_max %f", params.map_max);
+    ROS_INFO("map_resolution %f", params.map_resolution);
+
+    ROS_INFO("publish_frequency %f", params.publish_frequency);
+    ROS_INFO("map_publish_frequency %f", params.map_publish_frequency);
+    ROS_INFO("odometry_history %d", params.odometry_history);
+
+    ROS_INFO("path_capacity %d", params.path_capacity);
+    ROS_INFO("path_min_distance %f", params.path_min_distance);
+    ROS_INFO("path_min_angle %f", params.path_min_angle);
+    ROS_INFO("path_publish_frequency %f", params.path_publish_frequency);
+    ROS_INFO("path_delta %d", params.path_delta);
+
+    ROS_INFO("map_frame_id %s", params.map_frame_id.c_str());
+    ROS_INFO("odom_frame_id %s", params.odom_frame_id.c_str());
+    ROS_INFO("body_frame_id %s", params.body_frame_id.c_str());
+
+    ROS_INFO("left_wheel_joint %s", params.left_wheel_joint.c_str());
+    ROS_INFO("right_wheel_joint %s", params.right_wheel_joint.c_str());
+
+    ROS_INFO("wheel_base %f", params.wheel_base);
+    ROS_INFO("wheel_radius %f", params.wheel_radius);
+
+    return true;
+  }
+
+
+  /// \brief Wheel odometry, transforms, paths, and pose errors of a SLAM
+  ///        node. The odometry and the map to odom transform are broadcast
+  ///        each time the wheels move, scans are posted to a mailbox for
+  ///        the SLAM worker.
+  class SlamNodeInterface
+  {
+  public:
+    /// \brief Advertise the topics and subscribe to the wheels, scans, and gazebo
+    /// \param nh - private node handle
+    /// \param node_handle - public node handle
+    /// \param params - parameters of the node
+    /// \param diagnostics_name - name of the diagnostic status
+    SlamNodeInterface(ros::NodeHandle &nh, ros::NodeHandle &node_handle,
+                      const SlamNodeParams &params, const std::string &diagnostics_name)
+                      : params(params),
+                        joint_index(params.left_wheel_joint, params.right_wheel_joint),
+                        odom(rigid2d::DiffDrive(rigid2d::Pose(), params.wheel_base, params.wheel_radius),
+                             std::max(params.odometry_history, 1)),
+                        wheel_odom_flag(false),
+                        odom_path(node_handle, "odom_path", params.map_frame_id,
+                                  params.path_capacity, params.path_min_distance, params.path_min_angle,
+                                  params.path_publish_frequency, params.path_delta),
+                        slam_path(node_handle, "slam_path", params.map_frame_id,
+                                  params.path_capacity, params.path_min_distance, params.path_min_angle,
+                                  params.path_publish_frequency, params.path_delta),
+                        gazebo_path(node_handle, "gazebo_path", params.map_frame_id,
+                                    params.path_capacity, params.path_min_distance, params.path_min_angle,
+                                    params.path_publish_frequency, params.path_delta),
+                        diagnostics(node_handle, nh, diagnostics_name)
+    {
+      odom_pub = node_handle.advertise<nav_msgs::Odometry>("odom", 1);
+      odom_error_pub = node_handle.advertise<tsim::PoseError>("odom_error", 1);
+      slam_error_pub = node_handle.advertise<tsim::PoseError>("slam_error", 1);
+
+      scan_sub = node_handle.subscribe("scan", 1, &SlamNodeInterface::scanCallback, this);
+      joint_sub = node_handle.subscribe("joint_states", 1, &SlamNodeInterface::jointStatesCallback, this);
+      model_sub = nh.subscribe("/gazebo/model_states", 1, &SlamNodeInterface::modelCallBack, this);
+    }
+
+    SlamNodeInterface(const SlamNodeInterface &) = delete;
+    SlamNodeInterface &operator=(const SlamNodeInterface &) = delete;
+
+    /// \brief Odometry shared by the odometry publisher and SLAM,
+    ///        safe to look up poses from the SLAM worker
+    /// \return the odometry
+    rigid2d::OdometryEngine &odometry()
+    {
+      return odom;
+    }
+
+    /// \brief Latest scan for the SLAM worker, unprocessed scans are dropped
+    /// \return the mailbox
+    Mailbox<ScanUpdate> &scans()
+    {
+      return scan_mailbox;
+    }
+
+    /// \brief Sets the function called before the transforms are broadcast,
+    ///        it takes the newest SLAM result
+    /// \param update - function setting the transform from map to robot
+    void onJointStates(const std::function<void()> &update)
+    {
+      update_slam_state = update;
+    }
+
+    /// \brief Sets the most recent transform from map to robot
+    /// \param T - transform from map to robot
+    void setMapToRobot(const rigid2d::Transform2D &T)
+    {
+      Tmr = T;
+    }
+
+    /// \brief Records and publishes the paths, diagnostics, and pose errors
+    /// \param now - current time
+    void publish(const ros::Time &now)
+    {
+      // ground truth robot heading
+      tf2::Quaternion gazebo_robot_quat(gazebo_robot_pose.pose.orientation.x,
+                                        gazebo_robot_pose.pose.orientation.y,
+                                        gazebo_robot_pose.pose.orientation.z,
+                                        gazebo_robot_pose.pose.orientation.w);
+
+      tf2::Matrix3x3 mat(gazebo_robot_quat);
+      auto roll = 0.0, pitch = 0.0 , yaw = 0.0;
+      mat.getRPY(roll, pitch, yaw);
+
+      // paths from SLAM, odom, and gazebo
+      // only poses that moved far enough from the previous one are kept
+      const auto pose_map_robot = Tmr.displacement();
+      rigid2d::Pose slam_pose;
+      slam_pose.theta = pose_map_robot.theta;
+      slam_pose.x = pose_map_robot.x;
+      slam_pose.y = pose_map_robot.y;
+
+      rigid2d::Pose gazebo_pose;
+      gazebo_pose.theta = yaw;
+      gazebo_pose.x = gazebo_robot_pose.pose.position.x;
+      gazebo_pose.y = gazebo_robot_pose.pose.position.y;
+
+      slam_path.record(slam_pose, now);
+      odom_path.record(pose, now);
+      gazebo_path.record(gazebo_pose, now);
+
+      slam_path.publish(now);
+      odom_path.publish(now);
+      gazebo_path.publish(now);
+
+      diagnostics.publish(now);
+
+      // odometry error
+      tsim::PoseError odom_error_msg;
+      odom_error_msg.x_error = gazebo_pose.x - pose.x;
+      odom_error_msg.y_error = gazebo_pose.y - pose.y;
+      odom_error_msg.theta_error = rigid2d::normalize_angle_PI(rigid2d::normalize_angle_PI(yaw) -
+                                                               rigid2d::normalize_angle_PI(pose.theta));
+
+      // slam error
+      tsim::PoseError slam_error_msg;
+      slam_error_msg.x_error = gazebo_pose.x - pose_map_robot.x;
+      slam_error_msg.y_error = gazebo_pose.y - pose_map_robot.y;
+      slam_error_msg.theta_error = rigid2d::normalize_angle_PI(rigid2d::normalize_angle_PI(yaw) -
+                                                               rigid2d::normalize_angle_PI(pose_map_robot.theta));
+
+      odom_error_pub.publish(odom_error_msg);
+      slam_error_pub.publish(slam_error_msg);
+    }
+
+  private:
+    /// \brief Broadcast transforms and odometry each time the wheels move
+    /// \param msg - angular wheel positions
+    void jointStatesCallback(const sensor_msgs::JointState::ConstPtr &msg)
+    {
+      unsigned int left_idx = 0, right_idx = 0;
+      joint_index.lookup(msg->name, left_idx, right_idx);
+      wheel_odom_flag = true;
+
+      // most recent odom update
+      odom.addEncoders(msg->header.stamp.toSec(), msg->position.at(left_idx), msg->position.at(right_idx));
+      pose = odom.pose();
+
+      if (update_slam_state)
+      {
+        update_slam_state();
+      }
+
+      // transform from map to odom
+      rigid2d::Transform2D Tor(rigid2d::Vector2D(pose.x, pose.y), pose.theta);
+      const auto pose_map_odom = (Tmr * Tor.inv()).displacement();
+
+      tf2::Quaternion q_mo;
+      q_mo.setRPY(0, 0, pose_map_odom.theta);
+
+      geometry_msgs::TransformStamped tf_mo;
+      tf_mo.header.stamp = ros::Time::now();
+      tf_mo.header.frame_id = params.map_frame_id;
+      tf_mo.child_frame_id = params.odom_frame_id;
+
+      tf_mo.transform.translation.x = pose_map_odom.x;
+      tf_mo.transform.translation.y = pose_map_odom.y;
+      tf_mo.transform.translation.z = 0.0;
+      tf_mo.transform.rotation = tf2::toMsg(q_mo);
+
+      slam_broadcaster.sendTransform(tf_mo);
+
+      // transform from odom to body
+      tf2::Quaternion q;
+      q.setRPY(0, 0, pose.theta);
+      const auto odom_quat = tf2::toMsg(q);
+
+      geometry_msgs::TransformStamped odom_tf;
+      odom_tf.header.stamp = ros::Time::now();
+      odom_tf.header.frame_id = params.odom_frame_id;
+      odom_tf.child_frame_id = params.body_frame_id;
+
+      odom_tf.transform.translation.x = pose.x;
+      odom_tf.transform.translation.y = pose.y;
+      odom_tf.transform.translation.z = 0.0;
+      odom_tf.transform.rotation = odom_quat;
+
+      odom_broadcaster.sendTransform(odom_tf);
+
+      // pose in odom frame, velocity in body frame
+      const auto vb = odom.lastTwist();
+
+      nav_msgs::Odometry odom_msg;
+      odom_msg.header.stamp = ros::Time::now();
+      odom_msg.header.frame_id = params.odom_frame_id;
+      odom_msg.child_frame_id = params.body_frame_id;
+
+      odom_msg.pose.pose.position.x = pose.x;
+      odom_msg.pose.pose.position.y = pose.y;
+      odom_msg.pose.pose.position.z = 0.0;
+      odom_msg.pose.pose.orientation = odom_quat;
+
+      odom_msg.twist.twist.linear.x = vb.vx;
+      odom_msg.twist.twist.linear.y = 0.0;
+      odom_msg.twist.twist.angular.z = vb.w;
+
+      odom_pub.publish(odom_msg);
+    }
+
+    /// \brief Hand the scan to the SLAM worker
+    /// \param msg - lidar scan
+    void scanCallback(const sensor_msgs::LaserScan::ConstPtr &msg)
+    {
+      if (!wheel_odom_flag)
+      {
+        return;
+      }
+
+      // odometry at the time of the scan, or the latest if the wheels lag behind
+      std::unique_ptr<ScanUpdate> update(new ScanUpdate);
+      update->scan = msg->ranges;
+      update->stamp = std::min(msg->header.stamp.toSec(), odom.stamp());
+
+      if (scan_mailbox.post(std::move(update)))
+      {
+        ROS_DEBUG("SLAM busy, dropped scan (%lu total)", scan_mailbox.droppedCount());
+      }
+    }
+
+    /// \brief  Retreive gazebo robot pose
+    /// \param model_data - model states in world
+    void modelCallBack(const gazebo_msgs::ModelStates::ConstPtr &model_data)
+    {
+      const auto &names = model_data->name;
+      const auto it = std::find(names.begin(), names.end(), "diff_drive");
+      const auto robot_index = (it == names.end()) ? 0 : std::distance(names.begin(), it);
+
+      gazebo_robot_pose.header.stamp = ros::Time::now();
+      gazebo_robot_pose.pose = model_data->pose.at(robot_index);
+    }
+
+
+    SlamNodeParams params;                                      // parameters of the node
+    rigid2d::WheelJointIndex joint_index;                       // wheel joints in joint states
+    rigid2d::OdometryEngine odom;                               // wheel odometry
+    rigid2d::Pose pose;                                         // latest odometry pose
+    rigid2d::Transform2D Tmr;                                   // most recent transform from map to robot
+    bool wheel_odom_flag;                                       // true once the wheels have moved
+    geometry_msgs::PoseStamped gazebo_robot_pose;               // gazebo robot pose
+
+    Mailbox<ScanUpdate> scan_mailbox;                           // latest scan for the SLAM worker
+    std::function<void()> update_slam_state;                    // takes the newest SLAM result
+
+    rigid2d::PathPublisher odom_path, slam_path, gazebo_path;   // paths from odometry, SLAM, and gazebo
+    rigid2d::DiagnosticsPublisher diagnostics;                  // timing metrics of the SLAM stages
+
+    ros::Publisher odom_pub, odom_error_pub, slam_error_pub;
+    ros::Subscriber scan_sub, joint_sub, model_sub;
+    tf2_ros::TransformBroadcaster slam_broadcaster, odom_broadcaster;
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef SUBMAP_SLAM_GUARD_HPP
+#define SUBMAP_SLAM_GUARD_HPP
+/// \file
+/// \brief Graph SLAM over small local submaps with background loop closure
+///
+/// Consecutive scans are matched against and inserted into small submaps,
+/// each an occupancy grid in its own frame. Two submaps are active at a
+/// time, a new one starts when the newer has half its scans, so every scan
+/// is in a submap that also holds the scans around it. The pose of each scan
+/// in the submaps it was inserted into is a constraint of a sparse pose graph.
+/// Every scan is also matched against the finished submaps near it on a pool
+/// of worker threads with the branch and bound scan matcher, each match adds
+/// a loop closure constraint. The submaps built around the scan in time are
+/// not searched, their constraints come from the local matches. The graph is
+/// optimized in the background and the poses of the submaps are updated, the
+/// cells of a submap never move within it. The memory grows with the number
+/// of submaps and scans rather than with a map per particle.
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <rigid2d/worker_pool.hpp>
+#include "bmapping/correlative_matcher.hpp"
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/pose_graph.hpp"
+
+
+namespace bmapping
+{
+  using rigid2d::Pose;
+
+
+  /// \brief Occupancy grid built from consecutive scans, in its own frame
+  struct Submap
+  {
+    GridMapper grid;                  // cells in the frame of the submap
+    Transform2D pose;                 // pose of the submap in the map
+    int num_scans;                    // scans inserted
+    int first_node, last_node;        // first and last node inserted, -1 if none
+    bool finished;                    // no more scans are inserted
+    double xmin, xmax, ymin, ymax;    // bounds of the scanner positions in the submap
+
+    /// \brief Creates an empty submap
+    /// \param prototype - empty grid with the resolution and laser properties
+    /// \param pose - pose of the submap in the map
+    Submap(const GridMapper &prototype, const Transform2D &pose)
+                : grid(prototype),
+                  pose(pose),
+                  num_scans(0),
+                  first_node(-1),
+                  last_node(-1),
+                  finished(false),
+                  xmin(0.0), xmax(0.0), ymin(0.0), ymax(0.0)
+                  {}
+  };
+
+
+  /// \brief Scan in the trajectory
+  struct TrajectoryNode
+  {
+    std::vector<float> scan;          // range measurements
+    Transform2D pose;                 // pose of the robot in the map
+    std::vector<int> submaps;         // submaps the scan was inserted into
+  };
+
+
+  /// \brief Submap pose graph SLAM
+  class SubmapSLAM
+  {
+  public:
+    /// \brief Creates the SLAM backend
+    /// \param prototype - empty grid with the resolution, laser properties,
+    ///                    and the window composed by gridMap
+    /// \param scans_per_submap - scans inserted before a submap is finished
+    /// \param node_distance - distance the robot moves before a scan is added
+    /// \param node_angle - rotation of the robot before a scan is added
+    /// \param local_matcher - matches each scan against the active submap
+    /// \param loop_matcher - matches each scan against finished submaps
+    /// \param loop_search_distance - max distance from a submap searched for loop closures
+    /// \param loop_min_gap - min number of nodes between a submap and the
+    ///                       nodes searched against it, the submaps the node
+    ///                       was inserted into are never searched
+    /// \param optimize_every - scans added between optimizations of the graph
+    /// \param huber_scale - residual, in standard deviations, past which
+    ///                      loop closures are down weighted
+    /// \param num_threads - loop closure and optimization threads, 0 runs
+    ///                      them on the caller of addScan
+    /// \throws std::invalid_argument if scans_per_submap is less than 2,
+    ///         loop_min_gap is negative, or optimize_every is not positive
+    SubmapSLAM(const GridMapper &prototype,
+               int scans_per_submap,
+               double node_distance,
+               double node_angle,
+               const CorrelativeScanMatcher &local_matcher,
+               const CorrelativeScanMatcher &loop_matcher,
+               double loop_search_distance,
+               int loop_min_gap,
+               int optimize_every,
+               double huber_scale,
+               unsigned int num_threads);
+
+    /// \brief Stops the workers, queued searches are dropped
+    ~SubmapSLAM();
+
+    SubmapSLAM(const SubmapSLAM &) = delete;
+    SubmapSLAM &operator=(const SubmapSLAM &) = delete;
+
+    /// \brief Matches a scan against the active submap and inserts it if
+    ///        the robot moved far enough since the last scan added
+    /// \param scan - range measurements
+    /// \param odom - odometry pose
+    /// \returns true if the scan was added
+    bool addScan(const std::vector<float> &scan, const Pose &odom);
+
+    /// \brief Waits for the queued loop closure searches and optimizes the graph
+    void finish();
+
+    /// \brief Pose of the robot
+    /// \returns Transform from map to robot
+    Transform2D getRobotState() const;
+
+    /// \brief Compose a map viewable in rviz by adding the log odds of the
+    ///        submaps, the window of the prototype given to the constructor.
+    ///        Called from the thread that calls addScan.
+    /// map[out] a map in row major order
+    void gridMap(std::vector<int8_t> &map) const;
+
+    /// \brief Optimized poses of the scans added
+    /// \returns poses in the order they were added
+    std::vector<Transform2D> trajectory() const;
+
+    /// \brief Number of submaps
+    /// \returns submaps
+    std::size_t numSubmaps() const;
+
+    /// \brief Number of scans added
+    /// \returns nodes
+    std::size_t numNodes() const;
+
+    /// \brief Number of loop closure constraints
+    /// \returns loop closures
+    std::size_t numLoopClosures() const;
+
+  private:
+    /// \brief Adds a submap at a pose, holds mtx_
+    /// \param pose - pose of the submap in the map
+    /// \returns index of the submap
+    int addSubmap(const Transform2D &pose);
+
+    /// \brief Queues the search of the nodes near a finished submap
+    /// \param submap - index of the submap
+    void searchSubmap(int submap);
+
+    /// \brief Queues the search of the finished submaps near a node
+    /// \param node - index of the node
+    void searchNode(int node);
+
+    /// \brief Checks if a node may close a loop with a finished submap, holds mtx_
+    /// \param node - index of the node
+    /// \param submap - index of the submap
+    /// \returns true if the node is within loop_search_distance_ of the
+    ///          submap and far enough from it along the trajectory
+    bool loopCandidate(int node, int submap) const;
+
+    /// \brief Matches the scan of a node against a finished submap and
+    ///        adds a loop closure if it matches
+    /// \param node - index of the node
+    /// \param submap - index of the submap
+    void matchLoopClosure(int node, int submap);
+
+    /// \brief Optimizes a copy of the graph and applies the poses, the
+    ///        submaps and nodes added meanwhile are moved with the last node
+    void optimize();
+
+
+    GridMapper prototype_;                            // empty grid copied by each submap
+    int scans_per_submap_;                            // scans in a finished submap
+    double node_distance_, node_angle_;               // motion between nodes
+    CorrelativeScanMatcher local_matcher_;            // scan to active submap
+    CorrelativeScanMatcher loop_matcher_;             // copied by each loop closure search
+    double loop_search_distance_;                     // max distance searched for loop closures
+    int loop_min_gap_;                                // min nodes between a submap and a node it is matched with
+    int optimize_every_;                              // nodes between optimizations
+
+    // state of the local SLAM, only used by the caller of addScan
+    std::deque<int> active_;                          // active submaps, oldest first
+    Pose last_odom_;                                  // odometry at the last scan
+    Pose node_odom_;                                  // odometry at the last node
+    bool has_odom_;                                   // true after the first scan
+    int nodes_since_optimize_;                        // nodes added since the last optimization
+
+    // state shared with the workers
+    mutable std::mutex mtx_;                          // guards the members below
+    PoseGraph graph_;                                 // submap and node poses and constraints
+    std::vector<std::unique_ptr<Submap>> submaps_;    // submaps, the grids of active submaps
+                                                      // are only used by the caller of addScan
+    std::vector<std::unique_ptr<TrajectoryNode>> nodes_;  // scans added
+    Transform2D pose_;                                // pose of the robot in the map
+    std::size_t num_loop_closures_;                   // loop closure constraints
+
+    std::mutex optimize_mtx_;                         // one optimization at a time
+    rigid2d::WorkerPool pool_;                        // loop closure and optimization, last so
+                                                      // it stops before the members above
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,176 @@
+/// \file
+/// \brief Beam model of a laser range finder with a ray-cast range table
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "bmapping/beam_model.hpp"
+
+
+namespace bmapping
+{
+
+// entry of the range table that has not been cast
+static constexpr uint16_t not_cast = 65535;
+
+// smallest likelihood of a beam, keeps the log finite when a component is disabled
+static constexpr double min_beam_likelihood = 1e-12;
+
+
+BeamModel::BeamModel(const GridMapper &map, int num_angles, double lambda_short)
+  : map_(map),
+    num_angles_(num_angles),
+    lambda_short_(lambda_short),
+    angle_step_(0.0),
+    range_max_(map.rangeMax()),
+    range_quantum_(0.0),
+    var_hit_(map.sigma_hit_ * map.sigma_hit_),
+    hit_norm_(0.0),
+    offsets_(-1),
+    revision_(map.revision())
+{
+  if (num_angles_ <= 0 or lambda_short_ <= 0.0)
+  {
+    throw std::invalid_argument("Beam model angles and short reading rate must be positive");
+  }
+
+  if (rigid2d::almost_equal(var_hit_, 0.0) or range_max_ <= 0.0)
+  {
+    throw std::invalid_argument("Beam model variance and max range must be positive");
+  }
+
+  angle_step_ = 2.0 * rigid2d::PI / num_angles_;
+  range_quantum_ = range_max_ / (not_cast - 1);
+  hit_norm_ = 1.0 / std::sqrt(2.0 * rigid2d::PI * var_hit_);
+}
+
+
+double BeamModel::logLikelihood(const std::vector<float> &scan, const Transform2D &pose,
+                                unsigned int step)
+{
+  checkRevision();
+
+  // every beam starts from the cell of the scanner
+  const auto Tms = pose * map_.scannerTransform();
+  const auto sensor = Tms.displacement();
+  const auto gc = map_.world2Grid(sensor.x, sensor.y);
+
+  const auto &angles = map_.scanAngles();
+  const auto num_beams = std::min(scan.size(), angles.size());
+  const auto range_min = map_.rangeMin();
+  auto *ranges = cellRanges(gc);
+
+  auto log_likelihood = 0.0;
+  for(std::size_t b = 0; b < num_beams; b += std::max(step, 1u))
+  {
+    // readings below the min range carry no information
+    const auto z = scan[b];
+    if (z < range_min)
+    {
+      continue;
+    }
+
+    auto a = static_cast<int>(std::lround((sensor.theta + angles[b]) / angle_step_)) % num_angles_;
+    if (a < 0)
+    {
+      a += num_angles_;
+    }
+
+    // NaN and inf are max range readings
+    const auto z_meas = std::isfinite(z) ? std::min<double>(z, range_max_) : range_max_;
+    log_likelihood += beamLogLikelihood(z_meas, tableRange(gc, ranges, a));
+  }
+
+  return log_likelihood;
+}
+
+
+double BeamModel::expectedRange(const GridCoordinates &gc, double angle)
+{
+  checkRevision();
+
+  auto a = static_cast<int>(std::lround(angle / angle_step_)) % num_angles_;
+  if (a < 0)
+  {
+    a += num_angles_;
+  }
+
+  return tableRange(gc, cellRanges(gc), a);
+}
+
+
+std::size_t BeamModel::cachedCells() const
+{
+  return ranges_.size() / num_angles_;
+}
+
+
+void BeamModel::checkRevision()
+{
+  if (map_.revision() != revision_)
+  {
+    offsets_.clear();
+    ranges_.clear();
+    revision_ = map_.revision();
+  }
+}
+
+
+uint16_t *BeamModel::cellRanges(const GridCoordinates &gc)
+{
+  auto &offset = offsets_.at(gc.i, gc.j);
+  if (offset < 0)
+  {
+    offset = static_cast<int32_t>(ranges_.size());
+    ranges_.resize(ranges_.size() + num_angles_, not_cast);
+  }
+
+  return ranges_.data() + offset;
+}
+
+
+double BeamModel::tableRange(const GridCoordinates &gc, uint16_t *ranges, int a)
+{
+  auto &entry = ranges[a];
+  if (entry == not_cast)
+  {
+    RIGID2D_COUNT("beam_model.rays_cast", 1);
+    const auto range = map_.castRay(gc, a * angle_step_, range_max_);
+    entry = static_cast<uint16_t>(std::min<long>(std::lround(range / range_quantum_), not_cast - 1));
+  }
+
+  return entry * range_quantum_;
+}
+
+
+double BeamModel::beamLogLikelihood(double z, double z_exp) const
+{
+  // measurement noise around the expected range
+  const auto err = z - z_exp;
+  auto p = map_.z_hit_ * hit_norm_ * std::exp(-0.5 * err * err / var_hit_);
+
+  // unexpected objects in front of the expected range
+  if (z < z_exp)
+  {
+    p += map_.z_short_ * lambda_short_ * std::exp(-lambda_short_ * z) /
+         (1.0 - std::exp(-lambda_short_ * z_exp));
+  }
+
+  // failures return the max range, otherwise random readings
+  if (z >= range_max_)
+  {
+    p += map_.z_max_;
+  }
+
+  else
+  {
+    p += map_.z_rand_ / range_max_;
+  }
+
+  return std::log(std::max(p, min_beam_likelihood));
+}
+
+} // end namespace
@@ -5,6 +5,8 @@
 #include <iterator>
 
 #include <eigen3/Eigen/Core>
+#include <rigid2d/logging.hpp>
+#include <rigid2d/instrumentation.hpp>
 // #include <Eigen/Dense>
 // #include <Eigen/Core>
 
@@ -31,6 +33,7 @@ ScanAlignment::ScanAlignment(const LaserProperties &props, const Transform2D &Tr
                                 range_max_(props.range_max),
                                 first_scan_recieved(false)
 {
+  rigid2d::beamDirections(rigid2d::beamAngles(beam_min_, beam_max_, beam_delta_), beam_dirs_);
 }
 
 
@@ -79,81 +82,24 @@ void ScanAlignment::createPointCloud(pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud,
   // TODO: RANSAC, max correspondences
   // TODO: check for inf or nan in raw measurements
 
-
-  // number of raw measurements with limits of range finder
-  unsigned int num_meas = beam_length.size();
-
-  // number of valid measurements
-  unsigned int valid_meas = 0;
-
-
-  // iterate and find number of valid measurements
-  std::vector<float>::const_iterator it;
-  for(it = beam_length.begin(); it != beam_length.end(); ++it)
-  {
-    if (*it >= range_min_ and *it < range_max_)
-      valid_meas++;
-  }
-
-
-  // std::cout << "Valid meas: " << valid_meas << " "
-  //           << "Raw meas: " << num_meas << std::endl;
-
+  // cartesian coordinates of the valid measurements in frame of robot
+  // transform from frame of sensor to frame of robot
+  // pr = Trs * ps
+  PointBatchf points;
+  rigid2d::scanEndPoints(Trs_, beam_length, beam_dirs_, range_min_, range_max_, points);
 
   // allocate memory for cloud using number of valid measurements
-  cloud->width = valid_meas;
+  cloud->width = points.size();
   cloud->height = 1;
   cloud->is_dense = true; // all points are finite, do not contain inf or nan
   cloud->points.resize(cloud->width * cloud->height);
 
-  // end point
-  Vector2D point;
-
-  // convert ranges from polar to cartesian
-  auto range = 0.0;
-  auto beam_angle = beam_min_;
-
-  auto ctr = 0;             // assign valid measurements to pcl
-  for(unsigned int i = 0; i < num_meas; i++)
+  for(unsigned int i = 0; i < points.size(); i++)
   {
-    range = beam_length.at(i);
-
-    if (range >= range_min_ and range < range_max_)
-    {
-      point.x = range * std::cos(beam_angle);
-      point.y = range * std::sin(beam_angle);
-
-      // cartesian coordinates in frame of robot
-      // transform from frame of sensor to frame of robot
-      // pr = Trs * ps
-      point = Trs_(point);
-
-
-      cloud->points[ctr].x = point.x;
-      cloud->points[ctr].y = point.y;
-      cloud->points[ctr].z = 1.0;
-      ctr++;
-    }
-
-
-    // update beam angle
-    beam_angle += beam_delta_;
-
-
-    // max angle is negative
-    if (beam_max_ < 0.0 and beam_angle <= beam_max_)
-    {
-      beam_angle = beam_min_;
-    }
-
-    // max angle is positive
-    else if (beam_max_ >= 0.0 and beam_angle >= beam_max_)
-    {
-      beam_angle = beam_min_;
-    }
-
-  } // end loop
-
+    cloud->points[i].x = points.x[i];
+    cloud->points[i].y = points.y[i];
+    cloud->points[i].z = 1.0;
+  }
 }
 
 
@@ -199,7 +145,8 @@ bool ScanAlignment::pclICP(Transform2D &T, const Transform2D &T_init,
 
   if (!icp.hasConverged())
   {
-    std::cout << "ICP FAILED TO CONVERGED!" << std::endl;
+    RIGID2D_COUNT("icp.not_converged", 1);
+    RIGID2D_LOG_THROTTLE(5.0, rigid2d::LogLevel::Warn, "icp.not_converged");
     return false;
   }
 
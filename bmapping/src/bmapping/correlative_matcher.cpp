@@ -0,0 +1,283 @@
+/// \file
+/// \brief Correlative scan matcher with branch and bound over multi-resolution
+///        likelihood grids
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "bmapping/correlative_matcher.hpp"
+
+
+namespace bmapping
+{
+
+CorrelativeScanMatcher::CorrelativeScanMatcher()
+  : CorrelativeScanMatcher(0.1, 0.1, 3, -1.0)
+{
+}
+
+
+CorrelativeScanMatcher::CorrelativeScanMatcher(double linear_window, double angular_window,
+                                               int depth, double min_score)
+  : linear_window_(linear_window),
+    angular_window_(angular_window),
+    depth_(depth),
+    min_score_(min_score),
+    cols_(0),
+    num_points_(0),
+    window_(0)
+{
+  if (linear_window_ < 0.0 or angular_window_ < 0.0)
+  {
+    throw std::invalid_argument("Scan matcher search window is negative");
+  }
+
+  if (depth_ < 0)
+  {
+    throw std::invalid_argument("Scan matcher depth is negative");
+  }
+}
+
+
+bool CorrelativeScanMatcher::match(const GridMapper &grid, const std::vector<float> &scan,
+                                   const Vector3d &guess, ScanMatch &match)
+{
+  RIGID2D_SCOPED_TIMER("matcher.correlative");
+
+  if (!grid.hasObstacles())
+  {
+    return false;
+  }
+
+  // end points in the robot frame
+  thread_local PointBatchd points;
+  grid.laserEndPoints(points, scan, Transform2D());
+  num_points_ = static_cast<int>(points.size());
+  if (num_points_ == 0)
+  {
+    return false;
+  }
+
+  // rotation step that moves the farthest end point by at most one cell
+  const auto resolution = grid.resolution();
+  auto max_range = 0.0;
+  for(int p = 0; p < num_points_; p++)
+  {
+    max_range = std::max(max_range, std::hypot(points.x[p], points.y[p]));
+  }
+
+  auto angular_step = angular_window_;
+  if (max_range > resolution)
+  {
+    angular_step = std::min(angular_step, std::acos(1.0 - (resolution * resolution) / (2.0 * max_range * max_range)));
+  }
+
+  const auto num_steps = (angular_step > 0.0) ? static_cast<int>(std::ceil(angular_window_ / angular_step)) : 0;
+  const auto num_rotations = 2 * num_steps + 1;
+  window_ = static_cast<int>(std::ceil(linear_window_ / resolution));
+
+  // cells of the end points at each rotation about the guess
+  thread_local std::vector<GridCoordinates> grid_cells;
+  grid_cells.resize(num_rotations * num_points_);
+
+  auto imin = std::numeric_limits<int>::max(), imax = std::numeric_limits<int>::min();
+  auto jmin = std::numeric_limits<int>::max(), jmax = std::numeric_limits<int>::min();
+  for(int k = 0; k < num_rotations; k++)
+  {
+    const auto theta = guess(0) + (k - num_steps) * angular_step;
+    const auto ctheta = std::cos(theta);
+    const auto stheta = std::sin(theta);
+
+    for(int p = 0; p < num_points_; p++)
+    {
+      const auto gc = grid.world2Grid(guess(1) + ctheta * points.x[p] - stheta * points.y[p],
+                                      guess(2) + stheta * points.x[p] + ctheta * points.y[p]);
+      grid_cells[k * num_points_ + p] = gc;
+
+      imin = std::min(imin, gc.i);
+      imax = std::max(imax, gc.i);
+      jmin = std::min(jmin, gc.j);
+      jmax = std::max(jmax, gc.j);
+    }
+  }
+
+  // the grids cover every end point at every offset in the window
+  const auto i0 = imin - window_;
+  const auto j0 = jmin - window_;
+  const auto rows = imax - imin + 2 * window_ + 1;
+  cols_ = jmax - jmin + 2 * window_ + 1;
+
+  cells_.resize(grid_cells.size());
+  for(std::size_t n = 0; n < grid_cells.size(); n++)
+  {
+    cells_[n] = (grid_cells[n].i - i0) * cols_ + (grid_cells[n].j - j0);
+  }
+
+  // each level holds the max of the square of 2^level cells starting at a cell
+  levels_.resize(depth_ + 1);
+  grid.beamLogLikelihoods(i0, j0, rows, cols_, levels_[0]);
+  for(int level = 1; level <= depth_; level++)
+  {
+    const auto &fine = levels_[level - 1];
+    auto &coarse = levels_[level];
+    coarse = fine;
+
+    const auto half = 1 << (level - 1);
+    for(int r = 0; r < rows; r++)
+    {
+      for(int c = 0; c < cols_; c++)
+      {
+        auto &value = coarse[r * cols_ + c];
+        if (r + half < rows)
+        {
+          value = std::max(value, fine[(r + half) * cols_ + c]);
+        }
+
+        if (c + half < cols_)
+        {
+          value = std::max(value, fine[r * cols_ + c + half]);
+        }
+
+        if (r + half < rows and c + half < cols_)
+        {
+          value = std::max(value, fine[(r + half) * cols_ + c + half]);
+        }
+      }
+    }
+  }
+
+  // squares of the coarsest level covering the window
+  const auto size = 1 << depth_;
+  std::vector<Candidate> candidates;
+  for(int k = 0; k < num_rotations; k++)
+  {
+    for(int dx = -window_; dx <= window_; dx += size)
+    {
+      for(int dy = -window_; dy <= window_; dy += size)
+      {
+        Candidate candidate = {k, dx, dy, 0.0f};
+        score(depth_, candidate);
+        candidates.push_back(candidate);
+      }
+    }
+  }
+
+  Candidate best = {0, 0, 0, static_cast<float>(min_score_ * num_points_)};
+  best.k = -1;
+  branchAndBound(depth_, candidates, best);
+
+  if (best.k < 0)
+  {
+    return false;
+  }
+
+  // pose of a point on the lattice
+  auto latticePose = [&](const Candidate &c)
+  {
+    return Vector3d(guess(0) + (c.k - num_steps) * angular_step,
+                    guess(1) + c.dx * resolution,
+                    guess(2) + c.dy * resolution);
+  };
+
+  // covariance from the likelihood of the poses next to the best pose
+  Vector3d mean = Vector3d::Zero();
+  Matrix3d second = Matrix3d::Zero();
+  auto eta = 0.0;
+  for(int k = std::max(best.k - 1, 0); k <= std::min(best.k + 1, num_rotations - 1); k++)
+  {
+    for(int dx = std::max(best.dx - 1, -window_); dx <= std::min(best.dx + 1, window_); dx++)
+    {
+      for(int dy = std::max(best.dy - 1, -window_); dy <= std::min(best.dy + 1, window_); dy++)
+      {
+        Candidate neighbor = {k, dx, dy, 0.0f};
+        score(0, neighbor);
+
+        const auto w = std::exp(static_cast<double>(neighbor.score) - best.score);
+        const Vector3d pose = latticePose(neighbor);
+        mean += w * pose;
+        second += w * pose * pose.transpose();
+        eta += w;
+      }
+    }
+  }
+
+  mean /= eta;
+
+  // the lattice spacing bounds how well the pose is known
+  match.covariance = second / eta - mean * mean.transpose();
+  match.covariance(0,0) += angular_step * angular_step / 12.0;
+  match.covariance(1,1) += resolution * resolution / 12.0;
+  match.covariance(2,2) += resolution * resolution / 12.0;
+
+  match.pose = latticePose(best);
+  match.pose(0) = rigid2d::normalize_angle_PI(match.pose(0));
+  match.score = best.score / num_points_;
+
+  return true;
+}
+
+
+void CorrelativeScanMatcher::score(int level, Candidate &candidate) const
+{
+  const auto *grid = levels_[level].data();
+  const auto *cells = cells_.data() + candidate.k * num_points_;
+  const auto offset = candidate.dx * cols_ + candidate.dy;
+
+  auto sum = 0.0f;
+  for(int p = 0; p < num_points_; p++)
+  {
+    sum += grid[cells[p] + offset];
+  }
+
+  candidate.score = sum;
+}
+
+
+void CorrelativeScanMatcher::branchAndBound(int level, std::vector<Candidate> &candidates, Candidate &best) const
+{
+  RIGID2D_COUNT("matcher.candidates", candidates.size());
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+
+  for(const auto &candidate : candidates)
+  {
+    // the rest are bounded by this score
+    if (candidate.score <= best.score)
+    {
+      return;
+    }
+
+    if (level == 0)
+    {
+      best = candidate;
+      continue;
+    }
+
+    // split into the squares of the next level within the window
+    const auto half = 1 << (level - 1);
+    std::vector<Candidate> children;
+    for(int ox = 0; ox <= half; ox += half)
+    {
+      for(int oy = 0; oy <= half; oy += half)
+      {
+        if (candidate.dx + ox > window_ or candidate.dy + oy > window_)
+        {
+          continue;
+        }
+
+        Candidate child = {candidate.k, candidate.dx + ox, candidate.dy + oy, 0.0f};
+        score(level - 1, child);
+        children.push_back(child);
+      }
+    }
+
+    branchAndBound(level - 1, children, best);
+  }
+}
+
+} // end namespace
@@ -0,0 +1,163 @@
+/// \file
+/// \brief Tracks the changed regions of a 2D map in square tiles
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "bmapping/dirty_tiles.hpp"
+
+
+namespace bmapping
+{
+
+void copyRegion(const std::vector<int8_t> &map, unsigned int width,
+                const MapRegion &region, std::vector<int8_t> &data)
+{
+  if (region.x + region.width > width or (region.y + region.height) * width > map.size())
+  {
+    throw std::invalid_argument("Region NOT in the bounds of the map");
+  }
+
+  data.resize(region.width * region.height);
+
+  for(unsigned int r = 0; r < region.height; r++)
+  {
+    const auto first = map.begin() + (region.y + r) * width + region.x;
+    std::copy(first, first + region.width, data.begin() + r * region.width);
+  }
+}
+
+
+void pasteRegion(std::vector<int8_t> &map, unsigned int width,
+                 const MapRegion &region, const std::vector<int8_t> &data)
+{
+  if (region.x + region.width > width or (region.y + region.height) * width > map.size() or
+      data.size() != region.width * region.height)
+  {
+    throw std::invalid_argument("Region NOT in the bounds of the map");
+  }
+
+  for(unsigned int r = 0; r < region.height; r++)
+  {
+    const auto first = data.begin() + r * region.width;
+    std::copy(first, first + region.width, map.begin() + (region.y + r) * width + region.x);
+  }
+}
+
+
+DirtyTiles::DirtyTiles() : width_(0),
+                           height_(0),
+                           tile_size_(1),
+                           tiles_x_(0),
+                           tiles_y_(0),
+                           count_(0)
+{
+}
+
+
+DirtyTiles::DirtyTiles(unsigned int width, unsigned int height, unsigned int tile_size)
+                        : width_(width),
+                          height_(height),
+                          tile_size_(tile_size),
+                          tiles_x_(0),
+                          tiles_y_(0),
+                          count_(0)
+{
+  if (tile_size_ == 0)
+  {
+    throw std::invalid_argument("Tile size must be at least one cell");
+  }
+
+  tiles_x_ = (width_ + tile_size_ - 1) / tile_size_;
+  tiles_y_ = (height_ + tile_size_ - 1) / tile_size_;
+  tiles_.assign(tiles_x_ * tiles_y_, 0);
+}
+
+
+void DirtyTiles::markRegion(const MapRegion &region)
+{
+  if (region.width == 0 or region.height == 0)
+  {
+    return;
+  }
+
+  const auto tx0 = region.x / tile_size_;
+  const auto ty0 = region.y / tile_size_;
+  const auto tx1 = std::min(region.x + region.width - 1, width_ - 1) / tile_size_;
+  const auto ty1 = std::min(region.y + region.height - 1, height_ - 1) / tile_size_;
+
+  for(auto ty = ty0; ty <= ty1; ty++)
+  {
+    for(auto tx = tx0; tx <= tx1; tx++)
+    {
+      auto &tile = tiles_.at(ty * tiles_x_ + tx);
+      if (!tile)
+      {
+        tile = 1;
+        count_++;
+      }
+    }
+  }
+}
+
+
+void DirtyTiles::markAll()
+{
+  std::fill(tiles_.begin(), tiles_.end(), 1);
+  count_ = tiles_.size();
+}
+
+
+void DirtyTiles::clear()
+{
+  if (count_ != 0)
+  {
+    std::fill(tiles_.begin(), tiles_.end(), 0);
+    count_ = 0;
+  }
+}
+
+
+bool DirtyTiles::empty() const
+{
+  return count_ == 0;
+}
+
+
+void DirtyTiles::regions(std::vector<MapRegion> &regions) const
+{
+  regions.clear();
+  if (count_ == 0)
+  {
+    return;
+  }
+
+  for(unsigned int ty = 0; ty < tiles_y_; ty++)
+  {
+    unsigned int tx = 0;
+    while(tx < tiles_x_)
+    {
+      if (!tiles_[ty * tiles_x_ + tx])
+      {
+        tx++;
+        continue;
+      }
+
+      // run of marked tiles
+      const auto first = tx;
+      while(tx < tiles_x_ and tiles_[ty * tiles_x_ + tx])
+      {
+        tx++;
+      }
+
+      MapRegion region;
+      region.x = first * tile_size_;
+      region.y = ty * tile_size_;
+      region.width = std::min(tx * tile_size_, width_) - region.x;
+      region.height = std::min((ty + 1) * tile_size_, height_) - region.y;
+      regions.push_back(region);
+    }
+  }
+}
+
+} // end namespace
@@ -2,18 +2,82 @@
 /// \brief A motion model for a differential drive robot
 
 #include <iostream>
+#include <cstddef>
+#include <cstring>
 #include <stdexcept>
 #include <functional>
 #include <iterator>
 #include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
 
 // #include <robot_models/probability.hpp>
 #include "bmapping/grid_mapper.hpp"
+#include "bmapping/map_file.hpp"
 
 
 namespace bmapping
 {
 
+// cells along the edge of a dirty tile
+static constexpr unsigned int map_tile_size = 32;
+
+// source of map revisions
+static std::atomic<unsigned long> next_revision(1);
+
+// largest quantized distance to an obstacle
+static constexpr uint16_t max_dist_units = 65535;
+
+
+/// \brief Key of a cell in the set of occupied cells
+/// \param i - row in the grid
+/// \param j - column in the grid
+/// \return key
+static int64_t cellKey(int i, int j)
+{
+  return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(i)) << 32) |
+                               static_cast<uint32_t>(j));
+}
+
+
+/// \brief Grid coordinates of a cell key
+/// \param key - key from cellKey
+/// \return grid coordinates
+static GridCoordinates keyCoordinates(int64_t key)
+{
+  GridCoordinates gc;
+  gc.i = static_cast<int32_t>(static_cast<uint64_t>(key) >> 32);
+  gc.j = static_cast<int32_t>(static_cast<uint32_t>(key));
+  return gc;
+}
+
+
+FixedLogOdds toFixedLogOdds(double l)
+{
+  const auto fixed = std::lround(l * log_odds_scale);
+  return static_cast<FixedLogOdds>(std::clamp<long>(fixed, -log_odds_limit, log_odds_limit));
+}
+
+
+double fixedLogOdds2Prob(FixedLogOdds l)
+{
+  // probability of every fixed point value, shared by all maps
+  static const std::vector<float> table = []()
+  {
+    std::vector<float> probs(2 * log_odds_limit + 1);
+    for(int k = -log_odds_limit; k <= log_odds_limit; k++)
+    {
+      probs[k + log_odds_limit] = static_cast<float>(logOdds2Prob(k / log_odds_scale));
+    }
+    return probs;
+  }();
+
+  return table[l + log_odds_limit];
+}
+
 
 double pdfNormal(double a, double b)
 {
@@ -28,6 +92,42 @@ double pdfNormal(double a, double b)
 }
 
 
+double logPdfNormal(double a, double b)
+{
+  if (rigid2d::almost_equal(b, 0.0))
+  {
+    throw std::invalid_argument("Variance in pdfNormal is 0");
+  }
+
+  return -0.5 * std::log(2.0 * rigid2d::PI * b) - 0.5 * (a * a) / b;
+}
+
+
+double normalizeLogWeights(std::vector<double> &weights)
+{
+  if (weights.empty())
+  {
+    return -std::numeric_limits<double>::infinity();
+  }
+
+  const auto max_log_weight = *std::max_element(weights.begin(), weights.end());
+
+  auto sum = 0.0;
+  for(auto &w : weights)
+  {
+    w = std::exp(w - max_log_weight);
+    sum += w;
+  }
+
+  for(auto &w : weights)
+  {
+    w /= sum;
+  }
+
+  return max_log_weight + std::log(sum);
+}
+
+
 unsigned int mapSize(double lower, double upper, double resolution)
 {
   return static_cast<unsigned int> (std::ceil((upper - lower) / resolution));
@@ -45,20 +145,42 @@ GridMapper::GridMapper(double resolution, double xmin, double xmax,
       log_odds_prior_(prob2LogOdds(prior_)),
       log_odds_occ_(prob2LogOdds(prob_occ_)),
       log_odds_free_(prob2LogOdds(prob_free_)),
+      occ_update_(toFixedLogOdds(log_odds_occ_ - log_odds_prior_)),
+      free_update_(toFixedLogOdds(log_odds_free_ - log_odds_prior_)),
+      occ_threshold_(toFixedLogOdds(log_odds_occ_)),
+      free_threshold_(toFixedLogOdds(log_odds_free_)),
       resolution_(resolution),
       max_occ_dist_(10.0),
       cell_radius_(mapSize(0.0, max_occ_dist_, resolution_)),
+      dist_quantum_(max_occ_dist_ / max_dist_units),
       xmin_(xmin),
       xmax_(xmax),
       ymin_(ymin),
       ymax_(ymax),
+      view_i_(0),
+      view_j_(0),
       xsize_(mapSize(xmin_, xmax_, resolution_)),
       ysize_(mapSize(ymin_, ymax_, resolution_)),
       distances_(cell_radius_, std::vector<double>(cell_radius_)),
-      map_(xsize_ * ysize_, {log_odds_prior_, prior_, max_occ_dist_, -1}) // set occupies distance to max
+      map_(Cell(toFixedLogOdds(log_odds_prior_), max_dist_units)), // set occupies distance to max
+      dirty_(xsize_, ysize_, map_tile_size),
+      revision_(next_revision++),
+      parent_revision_(0)
 {
   // look up table for scan likelihood
   preComposeDistanceField();
+
+  // log likelihood of a beam ending at each quantized distance to an obstacle
+  if (!rigid2d::almost_equal(sigma_hit_, 0.0))
+  {
+    const auto var_hit = sigma_hit_ * sigma_hit_;
+    auto table = std::make_shared<std::vector<float>>(max_dist_units + 1);
+    for(unsigned int d = 0; d <= max_dist_units; d++)
+    {
+      (*table)[d] = static_cast<float>(std::log(z_hit_ * pdfNormal(d * dist_quantum_, var_hit) + z_rand_ / z_max_));
+    }
+    beam_log_likelihoods_ = table;
+  }
   // std::cout << "max_occ_dist_: " << max_occ_dist_ << std::endl;
   // std::cout << "cell_radius_: " << cell_radius_ << std::endl;
 }
@@ -69,9 +191,10 @@ GridMapper::GridMapper(double resolution, double xmin, double xmax,
 double GridMapper::likelihoodFieldModel(const std::vector<float> &beam_length,
                                         const Transform2D &pose) const
 {
+  RIGID2D_SCOPED_TIMER("grid.likelihood_field");
 
   // Ignores beams at max range
-  // Assume all beam end points are on the map
+  // End points in cells not allocated are at the max distance to an obstacle
 
 
   const auto var_hit = sigma_hit_ * sigma_hit_;
@@ -82,8 +205,9 @@ double GridMapper::likelihoodFieldModel(const std::vector<float> &beam_length,
   // End points of each beam in cartesian coordinates
   // in the robots frame relative to the map frame.
   // Ignore range if at max beam length, these are filtered
-  // out in laserEndPoints
-  std::vector<Vector2D> end_points;
+  // out in laserEndPoints. The buffer is reused across calls,
+  // scan matching scores many poses per scan.
+  thread_local PointBatchd end_points;
   laserEndPoints(end_points, beam_length, pose);
 
 
@@ -98,16 +222,16 @@ double GridMapper::likelihoodFieldModel(const std::vector<float> &beam_length,
   }
 
   // iterate over beam end points
-  for(const auto &point: end_points)
+  for(unsigned int i = 0; i < end_points.size(); i++)
   {
 
     auto pz = 0.0;
 
     // cell the current beam end point falls into
-    const auto idx = world2RowMajor(point.x, point.y);
+    const auto gc = world2Grid(end_points.x[i], end_points.y[i]);
 
     // the distances have been pre determined
-    const auto z = map_.at(idx).occ_dist;
+    const auto z = occupiedDistance(map_.get(gc.i, gc.j));
 
     // std::cout<< "d to nearst obstacle " << z << std::endl;
 
@@ -133,6 +257,38 @@ double GridMapper::likelihoodFieldModel(const std::vector<float> &beam_length,
 }
 
 
+double GridMapper::logLikelihoodFieldModel(const std::vector<float> &beam_length,
+                                           const Transform2D &pose) const
+{
+  RIGID2D_SCOPED_TIMER("grid.log_likelihood_field");
+
+  if (!beam_log_likelihoods_)
+  {
+    throw std::invalid_argument("Variance in pdfNormal is 0");
+  }
+
+  // an empty map explains every scan, as in likelihoodFieldModel
+  if (occ_cells_.empty())
+  {
+    return 0.0;
+  }
+
+  thread_local PointBatchd end_points;
+  laserEndPoints(end_points, beam_length, pose);
+
+  // one table look up and add per beam
+  const auto &table = *beam_log_likelihoods_;
+  auto log_p = 0.0;
+  for(unsigned int i = 0; i < end_points.size(); i++)
+  {
+    const auto gc = world2Grid(end_points.x[i], end_points.y[i]);
+    log_p += table[map_.get(gc.i, gc.j).occ_dist];
+  }
+
+  return log_p;
+}
+
+
 
 
 
@@ -140,113 +296,375 @@ double GridMapper::likelihoodFieldModel(const std::vector<float> &beam_length,
 void GridMapper::integrateScan(const std::vector<float> &beam_length,
                                const Transform2D &pose)
 {
-  std::vector<Vector2D> end_points;
+  RIGID2D_SCOPED_TIMER("grid.integrate_scan");
+
+  // scratch space shared by the maps updated on a thread
+  thread_local PointBatchd end_points;                      // beam end points
+  thread_local std::vector<GridCoordinates> free_index;     // cells traversed by all beams
+  thread_local std::vector<GridCoordinates> touched;        // distinct cells updated by this scan
+  thread_local BlockGrid<uint8_t> update;                   // update of each cell, 0 none, 1 free, 2 occupied
+
   // End points of each beam in cartesian coordinates
   // in the robots frame relative to the map frame
   laserEndPoints(end_points, beam_length, pose);
 
-
-  // row major order index of the map to update
-  auto idx = 0;
-
-  // Find empty indices for each laser beam
+  // cast every beam before changing the map
+  free_index.clear();
+  touched.clear();
   for(unsigned int i = 0; i < end_points.size(); i++)
   {
+    freeGridIndex(free_index, Vector2D(end_points.x[i], end_points.y[i]), pose);
+    touched.push_back(world2Grid(end_points.x[i], end_points.y[i]));
+  }
+
+  // track the changes made by this scan
+  dirty_.clear();
+  parent_revision_ = revision_;
+  revision_ = next_revision++;
 
-    std::vector<int> free_index;
-    freeGridIndex(free_index, end_points.at(i), pose);
+  // only the blocks reached by this scan are allocated
+  update.clear();
 
+  // a cell is updated once per scan, occupied wins over free
+  std::size_t num_touched = 0;
+  for(const auto &gc : touched)
+  {
+    auto &u = update.at(gc.i, gc.j);
+    if (u == 0)
+    {
+      touched[num_touched++] = gc;
+    }
+    u = 2;
+  }
+  touched.resize(num_touched);
 
-    // update prob of a cell being free
-    for(unsigned int j = 0; j < free_index.size(); j++)
+  for(const auto &gc : free_index)
+  {
+    auto &u = update.at(gc.i, gc.j);
+    if (u == 0)
     {
-      idx = free_index.at(j);
-      map_.at(idx).log_odds +=  log_odds_free_ - log_odds_prior_;
+      u = 1;
+      touched.push_back(gc);
+    }
+  }
 
-      updateCellState(map_.at(idx), idx);
+  RIGID2D_COUNT("grid.cells_updated", touched.size());
 
+  for(const auto &gc : touched)
+  {
+    updateCell(gc, (update.get(gc.i, gc.j) == 2) ? occ_update_ : free_update_);
+  }
 
-    } // end inner loop
+  // cells outside the rviz map were reached
+  growView();
 
+  // update ESDF
+  euclideanSignedDistanceField();
+}
 
-    // update prob of a cell being occupied
-    idx = world2RowMajor(end_points.at(i).x, end_points.at(i).y);
-    map_.at(idx).log_odds += log_odds_occ_ - log_odds_prior_;
 
-    updateCellState(map_.at(idx), idx);
+void GridMapper::loadMap(const std::vector<int8_t> &map)
+{
+  if (map.size() != static_cast<std::size_t>(xsize_ * ysize_))
+  {
+    throw std::invalid_argument("Map size does not match the grid");
+  }
 
-  } // end outer loop
+  map_.clear();
+  occ_cells_.clear();
+
+  // rows of the rviz map are along the y-axis
+  for(int j = 0; j < ysize_; j++)
+  {
+    for(int i = 0; i < xsize_; i++)
+    {
+      const auto value = map[j * xsize_ + i];
+      if (value < 0)
+      {
+        continue;
+      }
+
+      FixedLogOdds log_odds = 0;
+      if (value >= 100)
+      {
+        log_odds = occ_threshold_;
+      }
+
+      else if (value == 0)
+      {
+        log_odds = free_threshold_;
+      }
+
+      else
+      {
+        log_odds = toFixedLogOdds(prob2LogOdds(value / 100.0));
+      }
+
+      map_.at(view_i_ + i, view_j_ + j).log_odds = log_odds;
+      if (log_odds >= occ_threshold_)
+      {
+        occ_cells_.insert(cellKey(view_i_ + i, view_j_ + j));
+      }
+    }
+  }
+
+  // the whole map changed
+  growView();
+  dirty_.markAll();
+  parent_revision_ = revision_;
+  revision_ = next_revision++;
 
-  // update ESDF
   euclideanSignedDistanceField();
 }
 
 
-void GridMapper::gridMap(std::vector<int8_t> &map) const
+bool GridMapper::saveMapFile(const std::string &filename) const
 {
-  // IMPORTANT
-  // Transpose map
-  // convert log odds to probability
-  map.resize(map_.size(), 0);
+  RIGID2D_SCOPED_TIMER("grid.save_map");
+  MapSnapshot snap;
+  snapshot(snap);
+  return writeMapFile(filename, snap);
+}
+
+
+void GridMapper::snapshot(MapSnapshot &snapshot) const
+{
+  map_.blocks(snapshot.blocks);
+  const auto *cells = map_.cellData();
+  snapshot.cells.assign(cells, cells + snapshot.blocks.size() * BlockGrid<Cell>::block_cells);
+
+  auto &header = snapshot.header;
+  std::memset(&header, 0, sizeof(header));
+  header.resolution = resolution_;
+  header.xmin = xmin_;
+  header.xmax = xmax_;
+  header.ymin = ymin_;
+  header.ymax = ymax_;
+  header.dist_quantum = dist_quantum_;
+  header.max_occ_dist = max_occ_dist_;
+  header.num_occupied = occ_cells_.size();
+}
+
+
+bool GridMapper::loadMapFile(const std::string &filename)
+{
+  RIGID2D_SCOPED_TIMER("grid.load_map");
+
+  MappedFile file(filename);
+  if (!file.isOpen())
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.open_failed " + filename);
+    return false;
+  }
 
-  for(unsigned int i = 0; i < map_.size(); i++)
+  MapFileHeader header;
+  if (file.size() < sizeof(header))
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.not_a_map " + filename);
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (!std::equal(map_file_magic, map_file_magic + sizeof(map_file_magic), header.magic) or
+      header.version != map_file_version or
+      header.header_bytes != sizeof(MapFileHeader) or
+      header.cell_bytes != sizeof(Cell) or
+      header.block_size != static_cast<std::uint32_t>(BlockGrid<Cell>::block_size) or
+      header.header_checksum != mapChecksum(&header, offsetof(MapFileHeader, header_checksum)))
   {
-    // transpose for rviz
-    auto row = i / xsize_;
-    auto col = i % xsize_;
-    auto idx = col * xsize_ + row;
-    // auto idx = row * xsize_ + col;
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.not_a_map " + filename);
+    return false;
+  }
 
+  // the cells must line up with the cells of this grid
+  if (!rigid2d::almost_equal(header.resolution, resolution_) or
+      !rigid2d::almost_equal(header.xmin, xmin_) or !rigid2d::almost_equal(header.ymin, ymin_))
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.grid_mismatch " + filename);
+    return false;
+  }
 
-    auto prob = map_.at(i).prob;
+  constexpr auto block_bytes = BlockGrid<Cell>::block_cells * sizeof(Cell);
+  const auto table_bytes = header.num_blocks * sizeof(MapFileBlock);
+  if (header.file_bytes != file.size() or
+      header.table_offset < sizeof(MapFileHeader) or
+      header.num_blocks > file.size() / block_bytes or
+      header.table_offset + table_bytes > header.cells_offset or
+      header.cells_offset % map_file_alignment != 0 or
+      header.cells_offset + header.num_blocks * block_bytes != header.file_bytes)
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.truncated " + filename);
+    return false;
+  }
 
+  const auto *table_data = file.data() + header.table_offset;
+  const auto *cells = file.data() + header.cells_offset;
+  if (mapChecksum(table_data, table_bytes) != header.table_checksum)
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.corrupt " + filename);
+    return false;
+  }
 
-    if (prob == prior_)
+  std::vector<std::pair<int, int>> blocks(header.num_blocks);
+  for(std::size_t s = 0; s < blocks.size(); s++)
+  {
+    MapFileBlock entry;
+    std::memcpy(&entry, table_data + s * sizeof(MapFileBlock), sizeof(entry));
+    if (mapChecksum(cells + s * block_bytes, block_bytes) != entry.checksum)
     {
-      map.at(idx) = -1;
+      RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.corrupt " + filename, {{"block", static_cast<double>(s)}});
+      return false;
     }
+    blocks[s] = {entry.bi, entry.bj};
+  }
+
+  // the file is valid, replace the map
+  map_.assign(blocks, reinterpret_cast<const Cell *>(cells));
 
-    else if (prob >= prob_occ_)
+  // occupied by the threshold of this grid
+  constexpr auto block_size = BlockGrid<Cell>::block_size;
+  const auto *loaded = map_.cellData();
+  occ_cells_.clear();
+  occ_cells_.reserve(header.num_occupied);
+  for(std::size_t s = 0; s < blocks.size(); s++)
+  {
+    for(int k = 0; k < BlockGrid<Cell>::block_cells; k++)
     {
-      map.at(idx) = 100;
+      if (loaded[s * BlockGrid<Cell>::block_cells + k].log_odds >= occ_threshold_)
+      {
+        occ_cells_.insert(cellKey(blocks[s].first * block_size + k / block_size,
+                                  blocks[s].second * block_size + k % block_size));
+      }
     }
+  }
+
+  // distances saved in other units are composed again
+  if (!rigid2d::almost_equal(header.dist_quantum, dist_quantum_) or
+      !rigid2d::almost_equal(header.max_occ_dist, max_occ_dist_))
+  {
+    euclideanSignedDistanceField();
+  }
+
+  // the whole map changed
+  growView();
+  dirty_.markAll();
+  parent_revision_ = revision_;
+  revision_ = next_revision++;
+
+  RIGID2D_COUNT("grid.map_file_bytes", header.file_bytes);
+  return true;
+}
+
+
+float GridMapper::beamLogLikelihood(double x, double y) const
+{
+  if (!beam_log_likelihoods_)
+  {
+    throw std::invalid_argument("Variance in pdfNormal is 0");
+  }
 
-    else if (prob <= prob_free_)
+  const auto gc = world2Grid(x, y);
+  return (*beam_log_likelihoods_)[map_.get(gc.i, gc.j).occ_dist];
+}
+
+
+void GridMapper::beamLogLikelihoods(int i0, int j0, int rows, int cols,
+                                    std::vector<float> &patch) const
+{
+  if (!beam_log_likelihoods_)
+  {
+    throw std::invalid_argument("Variance in pdfNormal is 0");
+  }
+
+  const auto &table = *beam_log_likelihoods_;
+  patch.resize(rows * cols);
+
+  for(int r = 0; r < rows; r++)
+  {
+    for(int c = 0; c < cols; c++)
     {
-      map.at(idx) = 0;
+      patch[r * cols + c] = table[map_.get(i0 + r, j0 + c).occ_dist];
     }
+  }
+}
 
-    else
+
+bool GridMapper::hasObstacles() const
+{
+  return !occ_cells_.empty();
+}
+
+
+double GridMapper::resolution() const
+{
+  return resolution_;
+}
+
+
+void GridMapper::gridMap(std::vector<int8_t> &map) const
+{
+  MapRegion region;
+  region.width = xsize_;
+  region.height = ysize_;
+  regionData(region, map);
+}
+
+
+void GridMapper::dirtyRegions(std::vector<MapRegion> &regions) const
+{
+  dirty_.regions(regions);
+}
+
+
+void GridMapper::regionData(const MapRegion &region, std::vector<int8_t> &data) const
+{
+  if (region.x + region.width > static_cast<unsigned int>(xsize_) or
+      region.y + region.height > static_cast<unsigned int>(ysize_))
+  {
+    throw std::invalid_argument("Region NOT in the bounds of the map");
+  }
+
+  data.resize(region.width * region.height);
+
+  // transpose for rviz, rows are along the y-axis
+  for(unsigned int r = 0; r < region.height; r++)
+  {
+    for(unsigned int c = 0; c < region.width; c++)
     {
-      map.at(idx) = prob * 100;
+      data[r * region.width + c] = cellValue(map_.get(view_i_ + region.x + c, view_j_ + region.y + r).log_odds);
     }
+  }
+}
 
-  } // end loop
 
+std::size_t GridMapper::allocatedCells() const
+{
+  return map_.numBlocks() * BlockGrid<Cell>::block_cells;
 }
 
 
-void GridMapper::printESDF()
+unsigned long GridMapper::revision() const
 {
-  for(unsigned int i = 0; i < map_.size(); i++)
-  {
-    int row = i / xsize_;
-    int col = i % xsize_;
-    int idx = row * xsize_ + col;
-    // int idx = col * xsize_ + row;
+  return revision_;
+}
 
 
-    // std::cout << idx << ": " << map_.at(idx).occ_dist << " | ";
-    printf("%d : %f |", idx, map_.at(idx).occ_dist);
-    // std::cout << "row: " << row << std::endl;
-    // std::cout << "col: " << col << std::endl;
+unsigned long GridMapper::parentRevision() const
+{
+  return parent_revision_;
+}
 
 
-    if (col == xsize_-1)
+void GridMapper::printESDF()
+{
+  for(int row = 0; row < xsize_; row++)
+  {
+    for(int col = 0; col < ysize_; col++)
     {
-      std::cout << std::endl;
+      printf("%d : %f |", row * ysize_ + col, occupiedDistance(map_.get(row, col)));
     }
 
+    std::cout << std::endl;
   }
 
 }
@@ -271,18 +689,23 @@ void GridMapper::preComposeDistanceField()
 
 void GridMapper::enqueueCell(int i, int j,
                               int src_i, int src_j,
-                              std::priority_queue<Cell, std::vector<Cell>, CompareDistance> &Q,
-                              std::vector<int> &marked)
+                              std::vector<EsdfNode> &Q,
+                              BlockGrid<uint8_t> &marked)
 {
 
   // TODO: if distance to obstacle is greater than max_occ_dist_
   //       set cell distance to max dist?
 
-  // index of cell of interest in map
-  auto idx = grid2RowMajor(i, j);
+  // the wavefront stays within the allocated blocks
+  auto cell = map_.find(i, j);
+  if (!cell)
+  {
+    return;
+  }
 
   // check if visited
-  if (marked.at(idx))
+  auto &mark = marked.at(i, j);
+  if (mark)
   {
     return;
   }
@@ -314,50 +737,51 @@ void GridMapper::enqueueCell(int i, int j,
   }
 
 
-  // update cell
-  map_.at(idx).occ_dist = dist * resolution_;
-  map_.at(idx).i = i;
-  map_.at(idx).j = j;
-  map_.at(idx).src_i = src_i;
-  map_.at(idx).src_j = src_j;
+  // update cell, rounded to the nearest distance quantum
+  const auto occ_dist = dist * resolution_;
+  cell->occ_dist = static_cast<uint16_t>(std::min<long>(std::lround(occ_dist / dist_quantum_),
+                                                                 max_dist_units));
 
   // add to queue
-  Q.push(map_.at(idx));
+  Q.push_back({occ_dist, i, j, src_i, src_j});
+  std::push_heap(Q.begin(), Q.end(), CompareDistance());
 
   // label as marked
-  marked.at(idx) = 1;
+  mark = 1;
 }
 
 
 
 void GridMapper::euclideanSignedDistanceField()
 {
+  RIGID2D_SCOPED_TIMER("grid.esdf");
+
   if (occ_cells_.empty())
   {
     return;
   }
 
 
+  // scratch space shared by the maps composed on a thread,
+  // the nearest obstacle of a cell is only kept on the queue
+
   // record cells that have been marked
-  std::vector<int> marked(xsize_ * ysize_);
+  thread_local BlockGrid<uint8_t> marked;
+  marked.clear();
 
-  // use queue in FMM
-  std::priority_queue<Cell, std::vector<Cell>, CompareDistance> Q;
+  // use queue in FMM, a heap ordered by CompareDistance
+  thread_local std::vector<EsdfNode> Q;
+  Q.clear();
 
   // enqueue all obstacle cells
   for(auto key: occ_cells_)
   {
-    map_.at(key).occ_dist = 0.0;
+    const auto gc = keyCoordinates(key);
+    map_.at(gc.i, gc.j).occ_dist = 0;
 
-    // auto i = key / xsize_;
-    // auto j = key % xsize_;
-
-    map_.at(key).i = map_.at(key).src_i = key / xsize_;
-    map_.at(key).j = map_.at(key).src_j = key % xsize_;
-
-
-    marked.at(key) = 1;
-    Q.push(map_.at(key));
+    marked.at(gc.i, gc.j) = 1;
+    Q.push_back({0.0, gc.i, gc.j, gc.i, gc.j});
+    std::push_heap(Q.begin(), Q.end(), CompareDistance());
   }
 
   // std::cout << "here" << std::endl;
@@ -398,155 +822,86 @@ void GridMapper::euclideanSignedDistanceField()
 
   while(!Q.empty())
   {
-    Cell current_cell = Q.top();
+    const EsdfNode current_cell = Q.front();
 
-    if (current_cell.i > 0)
-    {
-      enqueueCell(current_cell.i - 1, current_cell.j,
-                  current_cell.src_i, current_cell.src_j,
-                  Q, marked);
-    }
+    enqueueCell(current_cell.i - 1, current_cell.j,
+                current_cell.src_i, current_cell.src_j,
+                Q, marked);
 
-    if (current_cell.j > 0)
-    {
-      enqueueCell(current_cell.i, current_cell.j - 1,
-                  current_cell.src_i, current_cell.src_j,
-                  Q, marked);
-    }
+    enqueueCell(current_cell.i, current_cell.j - 1,
+                current_cell.src_i, current_cell.src_j,
+                Q, marked);
 
-    if (current_cell.i < xsize_ - 1)
-    {
-      enqueueCell(current_cell.i + 1, current_cell.j,
-                  current_cell.src_i, current_cell.src_j,
-                  Q, marked);
-    }
+    enqueueCell(current_cell.i + 1, current_cell.j,
+                current_cell.src_i, current_cell.src_j,
+                Q, marked);
 
-    if (current_cell.j < ysize_ - 1)
-    {
-      enqueueCell(current_cell.i, current_cell.j + 1,
-                  current_cell.src_i, current_cell.src_j,
-                  Q, marked);
-    }
+    enqueueCell(current_cell.i, current_cell.j + 1,
+                current_cell.src_i, current_cell.src_j,
+                Q, marked);
 
-    Q.pop();
+    std::pop_heap(Q.begin(), Q.end(), CompareDistance());
+    Q.pop_back();
 
   }
 
 }
 
 
-void GridMapper::updateCellState(Cell &cell, int index)
+void GridMapper::updateCell(const GridCoordinates &gc, int delta)
 {
-  auto prob = logOdds2Prob(cell.log_odds);
-
-  if (prob == prior_)
+  auto &cell = map_.at(gc.i, gc.j);
+  const auto was_occupied = cell.log_odds >= occ_threshold_;
+  const auto value = cellValue(cell.log_odds);
+  cell.log_odds = static_cast<FixedLogOdds>(std::clamp(cell.log_odds + delta, -log_odds_limit, log_odds_limit));
+
+  // the occupied cells only change when a cell enters or leaves the occupied state
+  const auto occupied = cell.log_odds >= occ_threshold_;
+  if (occupied and !was_occupied)
   {
-    cell.state = -1;
-    cell.prob = prior_;
-
-    // may need to remove a cell from a hash table
-    updateCellHash(-1, index);
+    occ_cells_.insert(cellKey(gc.i, gc.j));
   }
 
-  else if (prob >= prob_occ_)
+  else if (!occupied and was_occupied)
   {
-    cell.state = 1;
-    cell.prob = 1;      // 100%
-
-    // nominally update occupied hash table
-    updateCellHash(1, index);
+    occ_cells_.erase(cellKey(gc.i, gc.j));
   }
 
-  else if (prob <= prob_free_)
+  if (inView(gc.i, gc.j) and cellValue(cell.log_odds) != value)
   {
-    cell.state = 0;
-    cell.prob = 0;      // 0%
-
-    // nominally update the free hash table
-    // updateCellHash(0, index);
-  }
-
-  else
-  {
-    cell.state = -1;    // assume it is still unkown
-    cell.prob = prob;
-
-    // may need to remove a cell from a hash table
-    updateCellHash(-1, index);
+    dirty_.mark(gc.i - view_i_, gc.j - view_j_);
   }
 }
 
 
-void GridMapper::updateCellHash(int state, int index)
+int8_t GridMapper::cellValue(FixedLogOdds log_odds) const
 {
-  // occupied hash
-  if (state == 1)
+  if (log_odds == 0)
   {
-    // key not in table
-    auto search_occ = occ_cells_.find(index);
-    if (search_occ == occ_cells_.end())
-    {
-      occ_cells_.insert(index);
-    }
+    return -1;
   }
 
-  // free hash
-  // else if (state == 0)
-  // {
-  //   auto search_free = free_cells_.find(index);
-  //   if (search_free == free_cells_.end())
-  //   {
-  //     free_cells_.insert(index);
-  //   }
-  // }
-
-  // in unkown state
-  // might need to take off the
-  // occupied or free hash table
-  // if previously added
-  else
+  else if (log_odds >= occ_threshold_)
   {
-    auto search_occ = occ_cells_.find(index);
-    // auto search_free = free_cells_.find(index);
-
-
-    // exists in occupied
-    if (search_occ != occ_cells_.end())
-    {
-      occ_cells_.erase(index);
-      // std::cout<< "Removed from occupied cells" << std::endl;
-    }
+    return 100;
+  }
 
-    // exists in free
-    // else if (search_free != free_cells_.end())
-    // {
-    //   free_cells_.erase(index);
-    //   // std::cout<< "Removed from free cells" << std::endl;
-    // }
+  else if (log_odds <= free_threshold_)
+  {
+    return 0;
   }
 
+  return fixedLogOdds2Prob(log_odds) * 100;
+}
 
-  // std::cout<< "occupied cells size " << occ_cells_.size() <<std::endl;
-  // std::cout<< "free cells size " << free_cells_.size() <<std::endl;
-  //
-  // std::cout<< "-----------------" << std::endl;
-  // std::cout<< "Occupied cells" << std::endl;
-  //
-  // std::copy(occ_cells_.begin(), occ_cells_.end(),
-  //                     std::ostream_iterator<int>(std::cout, " "));
-  //                     std::cout<<"\n";
-  //
-  // std::cout<< "Free cells" << std::endl;
-  //
-  // std::copy(free_cells_.begin(), free_cells_.end(),
-  //                     std::ostream_iterator<int>(std::cout, " "));
-  //                     std::cout<<"\n";
-  //
-  // std::cout<< "-----------------" << std::endl;
+
+double GridMapper::occupiedDistance(const Cell &cell) const
+{
+  return cell.occ_dist * dist_quantum_;
 }
 
 
-void GridMapper::freeGridIndex(std::vector<int> &free_index,
+void GridMapper::freeGridIndex(std::vector<GridCoordinates> &free_index,
                                const Vector2D &point,
                                const Transform2D &pose) const
 {
@@ -584,7 +939,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
     {
       for(auto y = y0; y > y1; y--)
       {
-        free_index.push_back(grid2RowMajor(x0, y));
+        free_index.push_back(GridCoordinates{x0, y});
       }
     }
 
@@ -593,7 +948,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
     {
       for(auto y = y0; y < y1; y++)
       {
-        free_index.push_back(grid2RowMajor(x0, y));
+        free_index.push_back(GridCoordinates{x0, y});
       }
     }
 
@@ -610,7 +965,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
     {
       for(auto x = x0; x > x1; x--)
       {
-        free_index.push_back(grid2RowMajor(x, y0));
+        free_index.push_back(GridCoordinates{x, y0});
       }
     }
 
@@ -619,7 +974,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
     {
       for(auto x = x0; x < x1; x++)
       {
-        free_index.push_back(grid2RowMajor(x, y0));
+        free_index.push_back(GridCoordinates{x, y0});
       }
     }
   }
@@ -636,7 +991,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
       // std::cout << "dx < 0" << std::endl;
 
       // add starting cell
-      free_index.push_back(grid2RowMajor(x0, y0));
+      free_index.push_back(GridCoordinates{x0, y0});
 
       // find middle cells
       lineLow(free_index, x1, y1, x0, y0);
@@ -648,7 +1003,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
       // std::cout << "dx > 0" << std::endl;
 
       // add starting cell
-      free_index.push_back(grid2RowMajor(x0, y0));
+      free_index.push_back(GridCoordinates{x0, y0});
 
       // find middle cells
       lineLow(free_index, x0, y0, x1, y1);
@@ -668,7 +1023,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
       // std::cout << "dy < 0" << std::endl;
 
       // // add starting cell
-      free_index.push_back(grid2RowMajor(x0, y0));
+      free_index.push_back(GridCoordinates{x0, y0});
 
       // find middle cells
       lineHigh(free_index, x1, y1, x0, y0);
@@ -680,7 +1035,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
       // std::cout << "dy > 0" << std::endl;
 
       // // add starting cell
-      free_index.push_back(grid2RowMajor(x0, y0));
+      free_index.push_back(GridCoordinates{x0, y0});
 
       // find middle cells
       lineHigh(free_index, x0, y0, x1, y1);
@@ -704,7 +1059,7 @@ void GridMapper::freeGridIndex(std::vector<int> &free_index,
 }
 
 
-void GridMapper::lineLow(std::vector<int> &free_index,
+void GridMapper::lineLow(std::vector<GridCoordinates> &free_index,
                             int x0, int y0, int x1, int y1) const
 {
   auto dx = x1 - x0;
@@ -729,7 +1084,7 @@ void GridMapper::lineLow(std::vector<int> &free_index,
     // prevents adding the end point in the case dx < 0
     if (ctr != 0)
     {
-      free_index.push_back(grid2RowMajor(x, y));
+      free_index.push_back(GridCoordinates{x, y});
     }
 
     if ( D > 0)
@@ -744,7 +1099,7 @@ void GridMapper::lineLow(std::vector<int> &free_index,
 }
 
 
-void GridMapper::lineHigh(std::vector<int> &free_index,
+void GridMapper::lineHigh(std::vector<GridCoordinates> &free_index,
                              int x0, int y0, int x1, int y1) const
 {
   auto dx = x1 - x0;
@@ -769,7 +1124,7 @@ void GridMapper::lineHigh(std::vector<int> &free_index,
     // prevents adding the end point in the case dy < 0
     if (ctr != 0)
     {
-      free_index.push_back(grid2RowMajor(x, y));
+      free_index.push_back(GridCoordinates{x, y});
     }
 
     if (D > 0)
@@ -784,7 +1139,7 @@ void GridMapper::lineHigh(std::vector<int> &free_index,
 }
 
 
-void GridMapper::lineDiag(std::vector<int> &free_index,
+void GridMapper::lineDiag(std::vector<GridCoordinates> &free_index,
                              int x0, int y0, int x1, int y1) const
 {
   const auto dx = x1 - x0;
@@ -798,7 +1153,7 @@ void GridMapper::lineDiag(std::vector<int> &free_index,
 
   while (x != x1 and y != y1)
   {
-    free_index.push_back(grid2RowMajor(x, y));
+    free_index.push_back(GridCoordinates{x, y});
 
     x += xi;
     y += yi;
@@ -811,90 +1166,129 @@ GridCoordinates GridMapper::world2Grid(double x, double y) const
 {
   GridCoordinates grid;
 
-  // std::cout << "X size: " << xsize_
-  //           << " Y size: " << ysize_ << "\n";
-
-  if (!(x >= xmin_ and x <= xmax_))
-  {
-    throw std::invalid_argument("X position Not in the bounds of the world");
-  }
-
-  if (!(y >= ymin_ and y <= ymax_))
-  {
-    throw std::invalid_argument("Y position Not in the bounds of the world");
-  }
-
   // round down to the nearest cell
   // do not want to over estimate the index
   grid.i = std::floor((x - xmin_) / resolution_);
-  // Case: x query == 0 and xmin < 0
-  //        (0 - (-3)) / 1 = 3 == xsize
-  //     or x query == xsize and xmin == 0
-  //        (3 - 0) / 1 = 3 == xsize
-  if (grid.i == xsize_)
-  {
-    grid.i--;
-  }
-
-
   grid.j = std::floor((y - ymin_) / resolution_);
-  // Case: y query == 0 and ymin < 0
-  //     or y query == ysize and ymin == 0
-  if (grid.j == ysize_)
-  {
-    grid.j--;
-  }
 
   return grid;
 }
 
 
-unsigned int GridMapper::world2RowMajor(double x, double y) const
+Vector2D GridMapper::grid2World(int i, int j) const
 {
-  if (!(x >= xmin_ and x <= xmax_))
-  {
-    throw std::invalid_argument("X position NOT in the bounds of the world");
-  }
+  return Vector2D(xmin_ + (i + 0.5) * resolution_, ymin_ + (j + 0.5) * resolution_);
+}
 
-  if (!(y >= ymin_ and y <= ymax_))
-  {
-    throw std::invalid_argument("Y position NOT in the bounds of the world");
-  }
 
-  // round down to the nearest cell
-  // do not want to over estimate the index
-  auto i = std::floor((x - xmin_) / resolution_);
-  // Case: x query == 0 and xmin < 0
-  //        (0 - (-3)) / 1 = 3 == xsize
-  //     or x query == xsize and xmin == 0
-  //        (3 - 0) / 1 = 3 == xsize
-  if (i == xsize_)
-  {
-    i--;
-  }
+FixedLogOdds GridMapper::logOdds(double x, double y) const
+{
+  const auto gc = world2Grid(x, y);
+  return map_.get(gc.i, gc.j).log_odds;
+}
+
+
+unsigned int GridMapper::viewWidth() const
+{
+  return xsize_;
+}
+
+
+unsigned int GridMapper::viewHeight() const
+{
+  return ysize_;
+}
+
+
+Vector2D GridMapper::viewOrigin() const
+{
+  return Vector2D(xmin_ + view_i_ * resolution_, ymin_ + view_j_ * resolution_);
+}
 
 
-  auto j = std::floor((y - ymin_) / resolution_);
-  // Case: y query == 0 and ymin < 0
-  //     or y query == ysize and ymin == 0
-  if (j == ysize_)
+double GridMapper::castRay(const GridCoordinates &gc, double angle, double max_range) const
+{
+  // Amanatides and Woo, A Fast Voxel Traversal Algorithm for Ray Tracing,
+  // distances are in cells until the end
+  const auto dx = std::cos(angle);
+  const auto dy = std::sin(angle);
+  const auto step_i = (dx < 0.0) ? -1 : 1;
+  const auto step_j = (dy < 0.0) ? -1 : 1;
+
+  // distance along the ray between crossings of the cell edges
+  const auto inf = std::numeric_limits<double>::infinity();
+  const auto delta_i = (dx == 0.0) ? inf : 1.0 / std::fabs(dx);
+  const auto delta_j = (dy == 0.0) ? inf : 1.0 / std::fabs(dy);
+
+  // the ray starts in the center of the cell
+  auto next_i = 0.5 * delta_i;
+  auto next_j = 0.5 * delta_j;
+
+  const auto max_cells = max_range / resolution_;
+  auto i = gc.i, j = gc.j;
+  while(true)
   {
-    j--;
+    auto t = 0.0;
+    if (next_i < next_j)
+    {
+      t = next_i;
+      next_i += delta_i;
+      i += step_i;
+    }
+
+    else
+    {
+      t = next_j;
+      next_j += delta_j;
+      j += step_j;
+    }
+
+    if (t >= max_cells)
+    {
+      return max_range;
+    }
+
+    if (map_.get(i, j).log_odds >= occ_threshold_)
+    {
+      return t * resolution_;
+    }
   }
+}
+
 
-  auto index = grid2RowMajor(i, j);
-  return index;
+bool GridMapper::inView(int i, int j) const
+{
+  return i >= view_i_ and i < view_i_ + xsize_ and j >= view_j_ and j < view_j_ + ysize_;
 }
 
 
-unsigned int GridMapper::grid2RowMajor(int i, int j) const
+void GridMapper::growView()
 {
-  // std::cout << "[" << i << " " << j <<"]" << std::endl;
+  const auto &bounds = map_.blockBounds();
+  if (bounds.empty())
+  {
+    return;
+  }
+
+  // the window only grows so cells already published keep their place
+  constexpr auto block_size = BlockGrid<Cell>::block_size;
+  const auto i0 = std::min(view_i_, bounds.bi_min * block_size);
+  const auto j0 = std::min(view_j_, bounds.bj_min * block_size);
+  const auto i1 = std::max(view_i_ + xsize_, (bounds.bi_max + 1) * block_size);
+  const auto j1 = std::max(view_j_ + ysize_, (bounds.bj_max + 1) * block_size);
+  if (i0 == view_i_ and j0 == view_j_ and i1 == view_i_ + xsize_ and j1 == view_j_ + ysize_)
+  {
+    return;
+  }
+
+  view_i_ = i0;
+  view_j_ = j0;
+  xsize_ = i1 - i0;
+  ysize_ = j1 - j0;
 
-  // IMPORTANT: swap i and j because rviz uses rows for y-axis
-  //            and col for x-axis
-  return i * xsize_ + j;
-  // return j * xsize_ + i;  // rviz wants this
+  // every cell moved in the rviz map
+  dirty_ = DirtyTiles(xsize_, ysize_, map_tile_size);
+  dirty_.markAll();
 }
 
 
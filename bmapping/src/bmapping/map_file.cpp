@@ -0,0 +1,315 @@
+/// \file
+/// \brief Binary occupancy grid files, read through mmap and written in the background
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
+
+#include "bmapping/map_file.hpp"
+
+
+namespace bmapping
+{
+
+// 64 bit FNV-1a
+static constexpr std::uint64_t fnv_offset = 14695981039346656037ULL;
+static constexpr std::uint64_t fnv_prime = 1099511628211ULL;
+
+
+/// \brief Writes all bytes to a file, retrying short writes
+/// \param fd - file descriptor
+/// \param data - first byte
+/// \param size - number of bytes
+/// \returns true if every byte was written
+static bool writeAll(int fd, const void *data, std::size_t size)
+{
+  const auto *bytes = static_cast<const char *>(data);
+  while (size > 0)
+  {
+    const auto n = ::write(fd, bytes, size);
+    if (n < 0 and errno == EINTR)
+    {
+      continue;
+    }
+
+    else if (n <= 0)
+    {
+      return false;
+    }
+
+    bytes += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+
+/// \brief Flushes the directory holding a file so a rename in it is on disk
+/// \param filename - file in the directory
+/// \returns true if the directory was flushed
+static bool syncParentDirectory(const std::string &filename)
+{
+  const auto slash = filename.find_last_of('/');
+  const std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : filename.substr(0, slash));
+
+  const auto fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  const auto synced = (::fsync(fd) == 0);
+  ::close(fd);
+  return synced;
+}
+
+
+std::uint64_t mapChecksum(const void *data, std::size_t size)
+{
+  const auto *bytes = static_cast<const unsigned char *>(data);
+
+  // independent lanes over 32 byte strides
+  std::uint64_t lanes[4] = {fnv_offset, fnv_offset ^ 1, fnv_offset ^ 2, fnv_offset ^ 3};
+  std::size_t i = 0;
+  for(; i + 32 <= size; i += 32)
+  {
+    for(int k = 0; k < 4; k++)
+    {
+      std::uint64_t word = 0;
+      std::memcpy(&word, bytes + i + 8 * k, sizeof(word));
+      lanes[k] = (lanes[k] ^ word) * fnv_prime;
+    }
+  }
+
+  auto hash = fnv_offset;
+  for(const auto lane : lanes)
+  {
+    hash = (hash ^ lane) * fnv_prime;
+  }
+
+  for(; i < size; i++)
+  {
+    hash = (hash ^ bytes[i]) * fnv_prime;
+  }
+
+  return (hash ^ size) * fnv_prime;
+}
+
+
+bool writeMapFile(const std::string &filename, const MapSnapshot &snapshot)
+{
+  RIGID2D_SCOPED_TIMER("map_file.write");
+
+  constexpr auto block_bytes = BlockGrid<Cell>::block_cells * sizeof(Cell);
+  const auto &blocks = snapshot.blocks;
+  const auto *cells = reinterpret_cast<const unsigned char *>(snapshot.cells.data());
+
+  std::vector<MapFileBlock> table(blocks.size());
+  for(std::size_t s = 0; s < blocks.size(); s++)
+  {
+    table[s].bi = blocks[s].first;
+    table[s].bj = blocks[s].second;
+    table[s].checksum = mapChecksum(cells + s * block_bytes, block_bytes);
+  }
+
+  auto header = snapshot.header;
+  std::copy(map_file_magic, map_file_magic + sizeof(map_file_magic), header.magic);
+  header.version = map_file_version;
+  header.header_bytes = sizeof(MapFileHeader);
+  header.cell_bytes = sizeof(Cell);
+  header.block_size = BlockGrid<Cell>::block_size;
+  header.reserved = 0;
+  header.num_blocks = table.size();
+  header.table_offset = sizeof(MapFileHeader);
+
+  const auto end_table = header.table_offset + table.size() * sizeof(MapFileBlock);
+  header.cells_offset = (end_table + map_file_alignment - 1) / map_file_alignment * map_file_alignment;
+  header.file_bytes = header.cells_offset + table.size() * block_bytes;
+  header.table_checksum = mapChecksum(table.data(), table.size() * sizeof(MapFileBlock));
+  header.header_checksum = mapChecksum(&header, offsetof(MapFileHeader, header_checksum));
+
+  // the last map is only replaced once the new one is on disk
+  const auto tmp_filename = filename + ".tmp";
+  const auto fd = ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.open_failed " + tmp_filename);
+    return false;
+  }
+
+  const std::vector<char> padding(header.cells_offset - end_table, 0);
+  const auto written = writeAll(fd, &header, sizeof(header)) and
+                       writeAll(fd, table.data(), table.size() * sizeof(MapFileBlock)) and
+                       writeAll(fd, padding.data(), padding.size()) and
+                       writeAll(fd, cells, table.size() * block_bytes) and
+                       ::fsync(fd) == 0;
+
+  if (::close(fd) != 0 or !written)
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.write_failed " + tmp_filename);
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+
+  if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.replace_failed " + filename);
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+
+  // the rename is only durable once the directory entry is on disk
+  if (!syncParentDirectory(filename))
+  {
+    RIGID2D_LOG(rigid2d::LogLevel::Error, "map_file.sync_failed " + filename);
+    return false;
+  }
+
+  RIGID2D_COUNT("map_file.bytes", header.file_bytes);
+  return true;
+}
+
+
+
+// Class MappedFile
+
+
+MappedFile::MappedFile(const std::string &filename)
+  : data_(nullptr),
+    size_(0)
+{
+  const auto fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  struct stat info;
+  if (::fstat(fd, &info) == 0 and info.st_size > 0)
+  {
+    void *addr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      // the whole file is checked right away
+      ::madvise(addr, info.st_size, MADV_WILLNEED);
+      data_ = static_cast<const unsigned char *>(addr);
+      size_ = info.st_size;
+    }
+  }
+
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+}
+
+
+MappedFile::~MappedFile()
+{
+  if (data_)
+  {
+    ::munmap(const_cast<unsigned char *>(data_), size_);
+  }
+}
+
+
+bool MappedFile::isOpen() const
+{
+  return data_ != nullptr;
+}
+
+
+const unsigned char *MappedFile::data() const
+{
+  return data_;
+}
+
+
+std::size_t MappedFile::size() const
+{
+  return size_;
+}
+
+
+
+// Class MapWriter
+
+
+MapWriter::MapWriter(const std::string &filename)
+  : filename_(filename),
+    running_(true),
+    written_(0),
+    failed_(0),
+    thread_(&MapWriter::run, this)
+{
+}
+
+
+MapWriter::~MapWriter()
+{
+  running_ = false;
+  thread_.join();
+}
+
+
+void MapWriter::save(const GridMapper &grid)
+{
+  RIGID2D_SCOPED_TIMER("map_writer.copy");
+  std::unique_ptr<MapSnapshot> snapshot(new MapSnapshot);
+  grid.snapshot(*snapshot);
+  if (pending_.post(std::move(snapshot)))
+  {
+    RIGID2D_COUNT("map_writer.replaced", 1);
+  }
+}
+
+
+unsigned long MapWriter::written() const
+{
+  return written_.load();
+}
+
+
+unsigned long MapWriter::failed() const
+{
+  return failed_.load();
+}
+
+
+void MapWriter::run()
+{
+  while (true)
+  {
+    // the map waiting when stopped is still written
+    const auto stopping = !running_;
+    std::unique_ptr<MapSnapshot> snapshot = pending_.waitTake(std::chrono::milliseconds(100));
+    if (snapshot)
+    {
+      if (writeMapFile(filename_, *snapshot))
+      {
+        written_++;
+      }
+
+      else
+      {
+        failed_++;
+      }
+    }
+
+    else if (stopping)
+    {
+      break;
+    }
+  }
+}
+
+} // end namespace
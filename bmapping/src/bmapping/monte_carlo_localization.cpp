@@ -0,0 +1,324 @@
+/// \file
+/// \brief Monte Carlo localization on a known occupancy grid with KLD sampling
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/sampling.hpp>
+
+#include "bmapping/monte_carlo_localization.hpp"
+
+
+namespace bmapping
+{
+
+MonteCarloLocalization::MonteCarloLocalization(const GridMapper &map,
+                                               int min_particles,
+                                               int max_particles,
+                                               double kld_error,
+                                               double kld_z,
+                                               double bin_xy,
+                                               double bin_theta,
+                                               double srr,
+                                               double srt,
+                                               double str,
+                                               double stt,
+                                               double update_distance,
+                                               double update_angle,
+                                               int max_beams)
+  : map_(map),
+    min_particles_(min_particles),
+    max_particles_(max_particles),
+    kld_error_(kld_error),
+    kld_z_(kld_z),
+    bin_xy_(bin_xy),
+    bin_theta_(bin_theta),
+    srr_(srr),
+    srt_(srt),
+    str_(str),
+    stt_(stt),
+    update_distance_(update_distance),
+    update_angle_(update_angle),
+    max_beams_(max_beams),
+    has_odom_(false)
+{
+  if (min_particles_ <= 0 or max_particles_ < min_particles_)
+  {
+    throw std::invalid_argument("Particle bounds must be positive with min <= max");
+  }
+
+  if (kld_error_ <= 0.0 or bin_xy_ <= 0.0 or bin_theta_ <= 0.0)
+  {
+    throw std::invalid_argument("KLD error and bin sizes must be positive");
+  }
+
+  if (max_beams_ <= 0)
+  {
+    throw std::invalid_argument("Max beams must be positive");
+  }
+}
+
+
+void MonteCarloLocalization::initialize(const Vector3d &pose, const Matrix3d &cov)
+{
+  const rigid2d::MultivariateNormal noise(cov);
+  auto &gen = rigid2d::threadGenerator();
+
+  poses_.resize(max_particles_);
+  weights_.assign(max_particles_, 1.0 / max_particles_);
+  for(auto &p : poses_)
+  {
+    p = pose + noise.sample(gen);
+    p(0) = rigid2d::normalize_angle_PI(p(0));
+  }
+
+  has_odom_ = false;
+}
+
+
+void MonteCarloLocalization::useBeamModel(int num_angles, double lambda_short)
+{
+  beam_model_ = std::make_unique<BeamModel>(map_, num_angles, lambda_short);
+}
+
+
+bool MonteCarloLocalization::update(const std::vector<float> &scan, const Pose &odom)
+{
+  if (poses_.empty())
+  {
+    throw std::invalid_argument("Localization is not initialized");
+  }
+
+  if (has_odom_)
+  {
+    // wait for the robot to move
+    const auto dist = std::hypot(odom.x - last_odom_.x, odom.y - last_odom_.y);
+    const auto angle = std::fabs(rigid2d::normalize_angle_PI(odom.theta - last_odom_.theta));
+    if (dist < update_distance_ and angle < update_angle_)
+    {
+      return false;
+    }
+
+    RIGID2D_SCOPED_TIMER("mcl.update");
+    sampleMotionModel(last_odom_, odom);
+    weighParticles(scan);
+    kldResampling();
+  }
+
+  else
+  {
+    RIGID2D_SCOPED_TIMER("mcl.update");
+    weighParticles(scan);
+    kldResampling();
+    has_odom_ = true;
+  }
+
+  last_odom_ = odom;
+  RIGID2D_RECORD("mcl.particles", poses_.size());
+
+  return true;
+}
+
+
+Vector3d MonteCarloLocalization::mean() const
+{
+  // circular mean of the heading
+  auto x = 0.0, y = 0.0, c = 0.0, s = 0.0;
+  for(std::size_t n = 0; n < poses_.size(); n++)
+  {
+    x += weights_[n] * poses_[n](1);
+    y += weights_[n] * poses_[n](2);
+    c += weights_[n] * std::cos(poses_[n](0));
+    s += weights_[n] * std::sin(poses_[n](0));
+  }
+
+  return Vector3d(std::atan2(s, c), x, y);
+}
+
+
+Matrix3d MonteCarloLocalization::covariance() const
+{
+  const auto mu = mean();
+
+  Matrix3d cov = Matrix3d::Zero();
+  for(std::size_t n = 0; n < poses_.size(); n++)
+  {
+    Vector3d d = poses_[n] - mu;
+    d(0) = rigid2d::normalize_angle_PI(d(0));
+    cov += weights_[n] * d * d.transpose();
+  }
+
+  return cov;
+}
+
+
+Transform2D MonteCarloLocalization::getRobotState() const
+{
+  const auto mu = mean();
+  return Transform2D(Vector2D(mu(1), mu(2)), mu(0));
+}
+
+
+std::size_t MonteCarloLocalization::numParticles() const
+{
+  return poses_.size();
+}
+
+
+const std::vector<Vector3d> &MonteCarloLocalization::poses() const
+{
+  return poses_;
+}
+
+
+const std::vector<double> &MonteCarloLocalization::weights() const
+{
+  return weights_;
+}
+
+
+void MonteCarloLocalization::sampleMotionModel(const Pose &prev_odom, const Pose &cur_odom)
+{
+  // Table 5.6 Probabilistic Robotics
+  const auto dx = cur_odom.x - prev_odom.x;
+  const auto dy = cur_odom.y - prev_odom.y;
+  const auto trans = std::hypot(dx, dy);
+
+  // the direction of a short translation is noise
+  const auto rot1 = (trans < 0.01) ? 0.0 : rigid2d::normalize_angle_PI(std::atan2(dy, dx) - prev_odom.theta);
+  const auto rot2 = rigid2d::normalize_angle_PI(cur_odom.theta - prev_odom.theta - rot1);
+
+  const auto sd_rot1 = std::sqrt(srr_ * rot1 * rot1 + srt_ * trans * trans);
+  const auto sd_trans = std::sqrt(str_ * trans * trans + stt_ * (rot1 * rot1 + rot2 * rot2));
+  const auto sd_rot2 = std::sqrt(srr_ * rot2 * rot2 + srt_ * trans * trans);
+
+  // noise of every particle drawn at once
+  thread_local std::vector<double> noise;
+  noise.resize(3 * poses_.size());
+  rigid2d::fillStandardNormal(rigid2d::threadGenerator(), noise.data(), noise.size());
+
+  for(std::size_t n = 0; n < poses_.size(); n++)
+  {
+    const auto rot1_hat = rot1 + sd_rot1 * noise[3*n];
+    const auto trans_hat = trans + sd_trans * noise[3*n+1];
+    const auto rot2_hat = rot2 + sd_rot2 * noise[3*n+2];
+
+    auto &p = poses_[n];
+    p(1) += trans_hat * std::cos(p(0) + rot1_hat);
+    p(2) += trans_hat * std::sin(p(0) + rot1_hat);
+    p(0) = rigid2d::normalize_angle_PI(p(0) + rot1_hat + rot2_hat);
+  }
+}
+
+
+void MonteCarloLocalization::weighParticles(const std::vector<float> &scan)
+{
+  // scan log likelihood of each particle
+  if (beam_model_)
+  {
+    // every beam is scored, including max range readings
+    const auto step = std::max<std::size_t>(1, (scan.size() + max_beams_ - 1) / max_beams_);
+    RIGID2D_COUNT("mcl.beams", (scan.size() + step - 1) / step * poses_.size());
+
+    for(std::size_t n = 0; n < poses_.size(); n++)
+    {
+      const auto &p = poses_[n];
+      const auto log_likelihood = beam_model_->logLikelihood(scan, Transform2D(Vector2D(p(1), p(2)), p(0)),
+                                                             static_cast<unsigned int>(step));
+
+      weights_[n] = std::log(weights_[n]) + log_likelihood;
+    }
+  }
+
+  else
+  {
+    // end points in the robot frame, evenly spaced to at most max_beams_
+    thread_local PointBatchd points;
+    map_.laserEndPoints(points, scan, Transform2D());
+
+    const auto step = std::max<std::size_t>(1, (points.size() + max_beams_ - 1) / max_beams_);
+    RIGID2D_COUNT("mcl.beams", (points.size() + step - 1) / step * poses_.size());
+
+    for(std::size_t n = 0; n < poses_.size(); n++)
+    {
+      const auto &p = poses_[n];
+      const auto c = std::cos(p(0));
+      const auto s = std::sin(p(0));
+
+      auto log_likelihood = 0.0;
+      for(std::size_t b = 0; b < points.size(); b += step)
+      {
+        log_likelihood += map_.beamLogLikelihood(p(1) + c * points.x[b] - s * points.y[b],
+                                                 p(2) + s * points.x[b] + c * points.y[b]);
+      }
+
+      weights_[n] = std::log(weights_[n]) + log_likelihood;
+    }
+  }
+
+  normalizeLogWeights(weights_);
+}
+
+
+void MonteCarloLocalization::kldResampling()
+{
+  // cumulative weights for drawing particles
+  thread_local std::vector<double> cdf;
+  cdf.resize(weights_.size());
+  auto total = 0.0;
+  for(std::size_t n = 0; n < weights_.size(); n++)
+  {
+    total += weights_[n];
+    cdf[n] = total;
+  }
+
+  thread_local std::unordered_set<int64_t> bins;
+  thread_local std::vector<Vector3d> resampled;
+  bins.clear();
+  resampled.clear();
+
+  auto &gen = rigid2d::threadGenerator();
+  auto required = min_particles_;
+  while(static_cast<int>(resampled.size()) < std::min(required, max_particles_))
+  {
+    const auto u = gen.uniform() * total;
+    const auto idx = std::min<std::size_t>(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin(),
+                                           cdf.size() - 1);
+    const auto &p = poses_[idx];
+    resampled.push_back(p);
+
+    // the histogram bin of the particle, 21 bits per dimension
+    const auto bx = static_cast<int64_t>(std::floor(p(1) / bin_xy_)) & 0x1FFFFF;
+    const auto by = static_cast<int64_t>(std::floor(p(2) / bin_xy_)) & 0x1FFFFF;
+    const auto bt = static_cast<int64_t>(std::floor(p(0) / bin_theta_)) & 0x1FFFFF;
+    if (bins.insert((bx << 42) | (by << 21) | bt).second)
+    {
+      required = std::max(min_particles_, kldSize(static_cast<int>(bins.size())));
+    }
+  }
+
+  poses_.swap(resampled);
+  weights_.assign(poses_.size(), 1.0 / poses_.size());
+}
+
+
+int MonteCarloLocalization::kldSize(int k) const
+{
+  if (k <= 1)
+  {
+    return min_particles_;
+  }
+
+  // Wilson-Hilferty approximation of the chi-square quantile
+  const auto a = 2.0 / (9.0 * (k - 1));
+  const auto b = 1.0 - a + std::sqrt(a) * kld_z_;
+  const auto n = std::ceil((k - 1) / (2.0 * kld_error_) * b * b * b);
+
+  return static_cast<int>(std::min<double>(n, std::numeric_limits<int>::max()));
+}
+
+} // end namespace
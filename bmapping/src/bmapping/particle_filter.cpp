@@ -3,9 +3,13 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <iomanip>
 
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
+
 #include "bmapping/particle_filter.hpp"
 
 
@@ -14,54 +18,6 @@ namespace bmapping
 {
 
 
-std::mt19937_64 &getTwister()
-{
-  static std::random_device rd;
-  static std::mt19937_64 gen(rd());
-  return gen;
-}
-
-
-VectorXd sampleStandardNormal(int n)
-{
-  VectorXd rand_vec = VectorXd::Zero(n);
-  for(auto i = 0; i < n; i++)
-  {
-    std::normal_distribution<double> dis(0, 1);
-    rand_vec(i) = dis(getTwister());
-  }
-  return rand_vec;
-}
-
-
-VectorXd sampleMultivariateDistribution(const Ref<MatrixXd> cov)
-{
-  // must be square
-  int dim = cov.cols();
-  VectorXd rand_vec = sampleStandardNormal(dim);
-
-  // cholesky decomposition
-  MatrixXd L( cov.llt().matrixL() );
-
-  return L * rand_vec;
-}
-
-
-VectorXd sampleMultivariateDistribution(const Ref<VectorXd> mu, const Ref<MatrixXd> cov)
-{
-  // must be square
-  int dim = cov.cols();
-  VectorXd rand_vec = sampleStandardNormal(dim);
-
-  // cholesky decomposition
-  MatrixXd L( cov.llt().matrixL() );
-
-  return (mu + L * rand_vec);
-}
-
-
-
-
 // public
 
 ParticleFilter::ParticleFilter(int num_particles,
@@ -76,10 +32,6 @@ ParticleFilter::ParticleFilter(int num_particles,
                                double sample_range_theta,
                                double sample_range_x,
                                double sample_range_y,
-                               double scan_likelihood_min,
-                               double scan_likelihood_max,
-                               double pose_likelihood_min,
-                               double pose_likelihood_max,
                                ScanAlignment &scan_matcher,
                                const Transform2D &pose,
                                const GridMapper &mapper)
@@ -95,12 +47,11 @@ ParticleFilter::ParticleFilter(int num_particles,
                                    sample_range_theta_(sample_range_theta),
                                    sample_range_x_(sample_range_x),
                                    sample_range_y_(sample_range_y),
-                                   scan_likelihood_min_(scan_likelihood_min),
-                                   scan_likelihood_max_(scan_likelihood_max),
-                                   pose_likelihood_min_(pose_likelihood_min),
-                                   pose_likelihood_max_(pose_likelihood_max),
                                    normal_sqrd_sum_(0.0),
-                                   scan_matcher_(scan_matcher)
+                                   best_(0),
+                                   scan_matcher_(scan_matcher),
+                                   use_correlative_(false),
+                                   use_scan_filter_(false)
 {
   // initialize set of particles
   initParticleSet(mapper, pose);
@@ -116,6 +67,25 @@ ParticleFilter::ParticleFilter(int num_particles,
   sample_range_(0,0) = sample_range_theta_;  // theta var
   sample_range_(1,1) = sample_range_x_;   // x var
   sample_range_(2,2) = sample_range_y_;   // y var
+
+  // factorize the constant covariances once
+  motion_sampler_.setCovariance(motion_noise_);
+  mode_sampler_.setCovariance(sample_range_);
+}
+
+
+
+void ParticleFilter::useCorrelativeMatcher(const CorrelativeScanMatcher &matcher)
+{
+  correlative_matcher_ = matcher;
+  use_correlative_ = true;
+}
+
+
+void ParticleFilter::useScanFilter(const ScanFilter &filter)
+{
+  scan_filter_ = filter;
+  use_scan_filter_ = true;
 }
 
 
@@ -124,7 +94,8 @@ ParticleFilter::ParticleFilter(int num_particles,
 
 void ParticleFilter::initParticleSet(const GridMapper &mapper, const Transform2D &pose)
 {
-  const auto weight = 1.0 / num_particles_;
+  const auto log_weight = -std::log(static_cast<double>(num_particles_));
+  weights_.assign(num_particles_, 1.0 / num_particles_);
 
   particle_set_.reserve(num_particles_);
   for(auto i = 0; i < num_particles_; i++)
@@ -132,7 +103,7 @@ void ParticleFilter::initParticleSet(const GridMapper &mapper, const Transform2D
     TransformData2D T2d = pose.displacement();
     Vector3d ps(T2d.theta, T2d.x, T2d.y);
 
-    Particle particle(weight, mapper, ps);
+    Particle particle(log_weight, mapper, ps);
     particle_set_.push_back(particle);
   }
 }
@@ -141,6 +112,7 @@ void ParticleFilter::initParticleSet(const GridMapper &mapper, const Transform2D
 void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
                           const Pose &cur_odom, const Pose &prev_odom)
 {
+  RIGID2D_SCOPED_TIMER("pf.slam");
 
   // find transform between scans
   Transform2D Ticp;
@@ -149,14 +121,71 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
   Vector3d prev_od(prev_odom.theta, prev_odom.x, prev_odom.y);
   Transform2D Tinit = icpInitGuess(cur_od, prev_od);
 
-  // ICP
-  bool matcher_success = scan_matcher_.pclICPWrapper(Ticp, Tinit, scan);
+  // motion since the previous scan in the frame of the robot, moves each
+  // particle to the center of its correlative search window
+  const Transform2D Tprev_odom(Vector2D(prev_odom.x, prev_odom.y), prev_odom.theta);
+  const Transform2D Tcur_odom(Vector2D(cur_odom.x, cur_odom.y), cur_odom.theta);
+  const Transform2D Todom = Tprev_odom.inv() * Tcur_odom;
+
+  // filtered once, shared by ICP and every particle
+  if (use_scan_filter_)
+  {
+    scan_filter_.filter(scan, filtered_);
+  }
+  const auto &score_scan = use_scan_filter_ ? filtered_.score : scan;
+  const auto &map_scan = use_scan_filter_ ? filtered_.integrate : scan;
+
+  // ICP, the correlative matcher runs for each particle instead
+  bool matcher_success = false;
+  if (!use_correlative_)
+  {
+    RIGID2D_SCOPED_TIMER("pf.icp");
+    matcher_success = scan_matcher_.pclICPWrapper(Ticp, Tinit, score_scan);
+
+    if (!matcher_success)
+    {
+      RIGID2D_COUNT("pf.icp_failures", 1);
+    }
+  }
   // scan_matcher_.pclICPWrapper(Ticp, Tinit, scan);
   // bool matcher_success = false;
 
 
   for(auto &particle: particle_set_)
   {
+    // propose from the best match around the pose predicted by odometry
+    if (use_correlative_)
+    {
+      Vector2D vec(particle.pose(1), particle.pose(2));
+      const TransformData2D T_guess = (Transform2D(vec, particle.pose(0)) * Todom).displacement();
+      Vector3d guess(T_guess.theta, T_guess.x, T_guess.y);
+
+      Vector3d mu(0.0, 0.0, 0.0);
+      MatrixXd sigma = MatrixXd::Zero(3,3);
+      auto log_eta = 0.0;
+
+      bool matched = false;
+      {
+        RIGID2D_SCOPED_TIMER("pf.proposal");
+        matched = correlativeProposal(particle, score_scan, guess, cur_od, prev_od, mu, sigma, log_eta);
+      }
+
+      if (matched)
+      {
+        particle.prev_pose = particle.pose;
+        particle.pose = MultivariateNormal(mu, sigma).sample();
+        particle.pose(0) = normalize_angle_PI(particle.pose(0));
+        particle.log_weight += log_eta;
+      }
+
+      else
+      {
+        RIGID2D_COUNT("pf.match_failures", 1);
+      }
+
+      matcher_success = matched;
+    }
+
     // scan matcher fails
     if (!matcher_success)
     {
@@ -171,11 +200,10 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
       Transform2D T_pose(p_vec, particle.pose(0));
 
       // update weight for each particle
-      const auto scan_likelihood = particle.grid.likelihoodFieldModel(scan, T_pose);
-      particle.weight *= scan_likelihood;
+      particle.log_weight += particle.grid.logLikelihoodFieldModel(score_scan, T_pose);
     }
 
-    else
+    else if (!use_correlative_)
     {
       // particles estimated pose based on ICP
       Vector2D vec(particle.pose(1), particle.pose(2));
@@ -193,15 +221,18 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
       Vector3d mu(0.0, 0.0, 0.0);
       // covariance
       MatrixXd sigma = MatrixXd::Zero(3,3);
-      // normalization factor
-      auto eta = 0.0;
+      // log of the normalization factor
+      auto log_eta = 0.0;
 
 
 
       // Vector3d cur_od(cur_odom.theta, cur_odom.x, cur_odom.y);
       // Vector3d prev_od(prev_odom.theta, prev_odom.x, prev_odom.y);
 
-      gaussianProposal(sampled_poses, particle, scan, cur_od, prev_od, mu, sigma, eta);
+      {
+        RIGID2D_SCOPED_TIMER("pf.proposal");
+        gaussianProposal(sampled_poses, particle, score_scan, cur_od, prev_od, mu, sigma, log_eta);
+      }
 
       // std::cout << "sample mu" << std::endl;
       // std::cout << mu << std::endl;
@@ -211,7 +242,7 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
 
 
       // sample particles new pose
-      Vector3d new_pose = sampleMultivariateDistribution(mu, sigma);
+      Vector3d new_pose = MultivariateNormal(mu, sigma).sample();
       // std::cout << "new pose" << std::endl;
       // std::cout << new_pose << std::endl;
 
@@ -227,8 +258,7 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
 
 
       // update weights
-      // TODO: should I multply here?
-      particle.weight *= eta;
+      particle.log_weight += log_eta;
 
     }
 
@@ -236,7 +266,7 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
     // TODO: update map here
     Vector2D v(particle.pose(1), particle.pose(2));
     Transform2D Particle_pose(v, particle.pose(0));
-    particle.grid.integrateScan(scan, Particle_pose);
+    particle.grid.integrateScan(map_scan, Particle_pose);
 
   } // end loop
 
@@ -244,7 +274,8 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
   normalizeWeights();
   if(effectiveParticles())
   {
-    std::cout << "Resampling" << std::endl;
+    RIGID2D_SCOPED_TIMER("pf.resample");
+    RIGID2D_COUNT("pf.resamples", 1);
     lowVarianceResampling();
   }
 
@@ -254,18 +285,7 @@ void ParticleFilter::SLAM(const std::vector<float> &scan, const Twist2D &u,
 
 Transform2D ParticleFilter::getRobotState()
 {
-  auto weight = 0.0;
-  auto idx = 0;
-
-  for(auto i = 0; i < num_particles_; i++)
-  {
-    if (particle_set_.at(i).weight > weight)
-    {
-      weight = particle_set_.at(i).weight;
-      idx = i;
-    }
-  }
-  Vector3d pose = particle_set_.at(idx).pose;
+  Vector3d pose = particle_set_.at(best_).pose;
 
   Vector2D vec(pose(1), pose(2));
   Transform2D T_pose(vec, pose(0));
@@ -276,18 +296,13 @@ Transform2D ParticleFilter::getRobotState()
 
 void ParticleFilter::newMap(std::vector<int8_t> &map)
 {
-  auto weight = 0.0;
-  auto idx = 0;
+  bestMap().gridMap(map);
+}
 
-  for(auto i = 0; i < num_particles_; i++)
-  {
-    if (particle_set_.at(i).weight > weight)
-    {
-      weight = particle_set_.at(i).weight;
-      idx = i;
-    }
-  }
-  particle_set_.at(idx).grid.gridMap(map);
+
+const GridMapper &ParticleFilter::bestMap() const
+{
+  return particle_set_.at(best_).grid;
 }
 
 
@@ -295,7 +310,7 @@ void ParticleFilter::newMap(std::vector<int8_t> &map)
 void ParticleFilter::sampleMotionModel(const Twist2D &u, Ref<Vector3d> pose)
 {
   // sample noise
-  VectorXd w = sampleMultivariateDistribution(motion_noise_);
+  const VectorXd w = motion_sampler_.sample();
 
   // update robot pose based on odometry
   if (almost_equal(u.w, 0.0))
@@ -380,8 +395,9 @@ void ParticleFilter::sampleMotionModel(const Twist2D &u, Ref<Vector3d> pose)
 
 
 
-double ParticleFilter::poseLikelihoodOdom(const Ref<Vector3d> cur_pose, const Ref<Vector3d> prev_pose,
-                                          const Ref<Vector3d> cur_odom, const Ref<Vector3d> prev_odom)
+double ParticleFilter::logPoseLikelihoodOdom(const Ref<Vector3d> cur_pose, const Ref<Vector3d> prev_pose,
+                                             const Ref<Vector3d> cur_odom, const Ref<Vector3d> prev_odom,
+                                             const Ref<const Matrix3d> pose_cov)
 {
   // Table 5.5 Probabilistic Robotics
 
@@ -425,15 +441,24 @@ double ParticleFilter::poseLikelihoodOdom(const Ref<Vector3d> cur_pose, const Re
 
   const auto temp3 = a1_*rot2_hat*rot2_hat + a2_*trans_hat*trans_hat;
 
+  // uncertainty of the current pose adds to the motion noise, the direction
+  // of a short move is uncertain by the position variance over its length
+  const auto position_var = 0.5 * (pose_cov(1,1) + pose_cov(2,2));
+  const auto bearing_var = (position_var > 0.0) ?
+                           position_var / std::max(trans_hat * trans_hat, position_var) : 0.0;
+  const auto heading_var = pose_cov(0,0) + bearing_var;
+
 
-  // compose probabilities
-  const auto p1 = pdfNormal(normalize_angle_PI(normalize_angle_PI(rot1) - normalize_angle_PI(rot1_hat)), temp1);
+  // compose log probabilities
+  const auto p1 = logPdfNormal(normalize_angle_PI(normalize_angle_PI(rot1) - normalize_angle_PI(rot1_hat)),
+                               temp1 + bearing_var);
 
-  const auto p2 = pdfNormal(trans - trans_hat, temp2);
+  const auto p2 = logPdfNormal(trans - trans_hat, temp2 + position_var);
 
-  const auto p3 = pdfNormal(normalize_angle_PI(normalize_angle_PI(rot2) - normalize_angle_PI(rot2_hat)), temp3);
+  const auto p3 = logPdfNormal(normalize_angle_PI(normalize_angle_PI(rot2) - normalize_angle_PI(rot2_hat)),
+                               temp3 + heading_var);
 
-  return p1 * p2 *p3;
+  return p1 + p2 + p3;
 }
 
 
@@ -441,26 +466,32 @@ double ParticleFilter::poseLikelihoodOdom(const Ref<Vector3d> cur_pose, const Re
 
 void ParticleFilter::normalizeWeights()
 {
-  // TODO: check if sum > 0
-
-  auto sum = 0.0;
-  for(const auto &particle: particle_set_)
+  weights_.resize(particle_set_.size());
+  for(std::size_t i = 0; i < particle_set_.size(); i++)
   {
-    sum += particle.weight;
+    weights_[i] = particle_set_[i].log_weight;
   }
 
+  const auto log_sum = normalizeLogWeights(weights_);
+
   normal_sqrd_sum_ = 0.0;
-  for(auto &particle: particle_set_)
+  for(std::size_t i = 0; i < particle_set_.size(); i++)
   {
-    particle.weight /= sum;
-    normal_sqrd_sum_ += std::pow(particle.weight, 2);
+    particle_set_[i].log_weight -= log_sum;
+    normal_sqrd_sum_ += weights_[i] * weights_[i];
   }
+
+  best_ = static_cast<int>(std::max_element(weights_.begin(), weights_.end()) - weights_.begin());
 }
 
 
 bool ParticleFilter::effectiveParticles()
 {
-  std::cout << "Neff: " << static_cast<int> (1.0 / normal_sqrd_sum_) << std::endl;
+  const auto neff = static_cast<int> (1.0 / normal_sqrd_sum_);
+  RIGID2D_RECORD("pf.neff", neff);
+  RIGID2D_LOG_THROTTLE(1.0, rigid2d::LogLevel::Debug, "pf.neff", {{"neff", static_cast<double>(neff)},
+                                                                  {"particles", static_cast<double>(num_particles_)}});
+
   return (static_cast<int> (1.0 / normal_sqrd_sum_) < (num_particles_ / 2)) ? true : false;
 }
 
@@ -475,7 +506,10 @@ void ParticleFilter::lowVarianceResampling()
   const auto r =  (v(0) / static_cast<double> (num_particles_));
 
   // start with weight of first particle
-  auto c = particle_set_.at(0).weight;
+  auto c = weights_.at(0);
+
+  // first copy of the best particle
+  auto best = -1;
 
   auto i = 0;
   for(auto m = 0; m < num_particles_; m++)
@@ -490,13 +524,26 @@ void ParticleFilter::lowVarianceResampling()
          i = num_particles_ - 1;
          break;
        }
-       c += particle_set_.at(i).weight;
+       c += weights_.at(i);
+     }
+     if (i == best_ and best < 0)
+     {
+       best = m;
      }
      temp_particle_set.push_back(particle_set_.at(i));
   }
 
   particle_set_.clear();
   particle_set_ = temp_particle_set;
+
+  // the copies share the weight of the particle drawn
+  const auto log_weight = -std::log(static_cast<double>(num_particles_));
+  for(auto &particle: particle_set_)
+  {
+    particle.log_weight = log_weight;
+  }
+  weights_.assign(num_particles_, 1.0 / num_particles_);
+  best_ = std::max(best, 0);
 }
 
 
@@ -508,7 +555,7 @@ void ParticleFilter::sampleMode(const Transform2D &T, std::vector<Vector3d> &sam
 
   for(auto i = 0; i < k_; i++)
   {
-    Vector3d sample = sampleMultivariateDistribution(mu, sample_range_);
+    Vector3d sample = mu + mode_sampler_.sample();
     sample(0) = normalize_angle_PI(sample(0));
     sampled_poses.push_back(sample);
 
@@ -526,76 +573,65 @@ void ParticleFilter::gaussianProposal(std::vector<Vector3d> &sampled_poses,
                                         const Ref<Vector3d> prev_odom,
                                         Ref<Vector3d> mu,
                                         Ref<MatrixXd> sigma,
-                                        double &eta)
+                                        double &log_eta)
 {
-
-  std::vector<double> likelihoods(k_);
-
+  likelihoods_.resize(k_);
   for(auto i = 0; i < k_; i++)
   {
     Vector3d xj = sampled_poses.at(i);
     Vector2D vec(xj(1), xj(2));
     Transform2D Txj(vec, xj(0));
 
+    const auto log_p_scan = particle.grid.logLikelihoodFieldModel(scan, Txj);
+    const auto log_p_pose = logPoseLikelihoodOdom(xj, particle.prev_pose, cur_odom, prev_odom, Matrix3d::Zero());
 
-    auto p_scan = particle.grid.likelihoodFieldModel(scan, Txj);
-    auto p_pose = poseLikelihoodOdom(xj, particle.prev_pose, cur_odom, prev_odom);
-    // auto p_pose = poseLikelihoodTwist(xj, particle.prev_pose, u);
-
-
-    // std::cout << "p_scan" << std::endl;
-    // std::cout << p_scan << std::endl;
-    //
-    // std::cout << "p_pose" << std::endl;
-    // std::cout << p_pose << std::endl;
-
-    p_scan = std::clamp(p_scan, scan_likelihood_min_, scan_likelihood_max_);
-    p_pose = std::clamp(p_pose, pose_likelihood_min_, pose_likelihood_max_);
-
-
-
-    const auto p = p_scan * p_pose;
-    // const auto p = p_pose;
-
-    // std::cout << "p_scan" << std::endl;
-    // std::cout << p_scan << std::endl;
-    //
-    // std::cout << "p_pose" << std::endl;
-    // std::cout << p_pose << std::endl;
-    // //
-    // std::cout << "p" << std::endl;
-    // std::cout << p << std::endl;
-
-
-    likelihoods.at(i) = p;
-
-    mu += xj * p;
-    eta += p;
+    likelihoods_[i] = log_p_scan + log_p_pose;
   }
 
+  // the mean and covariance only depend on the normalized likelihoods
+  log_eta = normalizeLogWeights(likelihoods_);
 
-  if (almost_equal(eta, 0.0))
+  for(auto i = 0; i < k_; i++)
   {
-    throw std::invalid_argument("eta is 0");
+    mu += sampled_poses.at(i) * likelihoods_[i];
   }
-
-
-  // scale mu
-  mu /= eta;
   mu(0) = normalize_angle_PI(mu(0));
 
 
   for(auto i = 0; i < k_; i++)
   {
-    Vector3d xj = sampled_poses.at(i);
-    Vector2D vec(xj(1), xj(2));
-    Transform2D Txj(vec, xj(0));
+    const Vector3d xj = sampled_poses.at(i);
+    sigma += (xj - mu) * (xj - mu).transpose() * likelihoods_[i];
+  }
+}
+
 
-    sigma += (xj - mu) * (xj - mu).transpose() * likelihoods.at(i);
+bool ParticleFilter::correlativeProposal(Particle &particle,
+                                         const std::vector<float> &scan,
+                                         const Ref<Vector3d> guess,
+                                         const Ref<Vector3d> cur_odom,
+                                         const Ref<Vector3d> prev_odom,
+                                         Ref<Vector3d> mu,
+                                         Ref<MatrixXd> sigma,
+                                         double &log_eta)
+{
+  ScanMatch match;
+  if (!correlative_matcher_.match(particle.grid, scan, guess, match))
+  {
+    return false;
   }
 
-  // scale sigma
-  sigma /= eta;
+  mu = match.pose;
+  sigma = match.covariance;
+
+  // weight of the particle at the mode, the pose likelihood is
+  // integrated over the covariance of the match
+  Vector2D vec(mu(1), mu(2));
+  Transform2D Tmu(vec, mu(0));
+
+  log_eta = particle.grid.logLikelihoodFieldModel(scan, Tmu) +
+            logPoseLikelihoodOdom(mu, particle.prev_pose, cur_odom, prev_odom, sigma);
+  return true;
 }
 
 
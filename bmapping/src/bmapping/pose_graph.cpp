@@ -0,0 +1,273 @@
+/// \file
+/// \brief Sparse pose graph of submaps and the scans inserted into them
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "bmapping/pose_graph.hpp"
+
+
+namespace bmapping
+{
+
+// added to the diagonal of the normal equations so nodes without constraints stay solvable
+static constexpr double diagonal_damping = 1e-9;
+
+// Gauss-Newton stops when no pose moves by more than this
+static constexpr double min_step = 1e-6;
+
+
+Vector3d transform2Pose(const Transform2D &T)
+{
+  const auto d = T.displacement();
+  return Vector3d(d.theta, d.x, d.y);
+}
+
+
+Transform2D pose2Transform(const Vector3d &pose)
+{
+  return Transform2D(rigid2d::Vector2D(pose(1), pose(2)), pose(0));
+}
+
+
+PoseGraph::PoseGraph(double huber_scale)
+  : huber_scale_(huber_scale)
+{
+  if (huber_scale_ <= 0.0)
+  {
+    throw std::invalid_argument("Huber scale must be positive");
+  }
+}
+
+
+int PoseGraph::addSubmap(const Vector3d &pose)
+{
+  submaps_.push_back(pose);
+  return static_cast<int>(submaps_.size()) - 1;
+}
+
+
+int PoseGraph::addNode(const Vector3d &pose)
+{
+  nodes_.push_back(pose);
+  return static_cast<int>(nodes_.size()) - 1;
+}
+
+
+void PoseGraph::addConstraint(const PoseConstraint &constraint)
+{
+  if (constraint.submap < 0 or constraint.submap >= numSubmaps() or
+      constraint.node < 0 or constraint.node >= numNodes())
+  {
+    throw std::invalid_argument("Constraint between a submap or node not in the graph");
+  }
+
+  constraints_.push_back(constraint);
+}
+
+
+double PoseGraph::optimize(int max_iterations)
+{
+  RIGID2D_SCOPED_TIMER("pose_graph.optimize");
+
+  // the first submap is fixed, the rest are followed by the nodes
+  const auto num_vars = 3 * (std::max(numSubmaps() - 1, 0) + numNodes());
+  if (num_vars == 0 or constraints_.empty())
+  {
+    return cost();
+  }
+
+  auto submapVar = [](int s) { return 3 * (s - 1); };
+  auto nodeVar = [this](int n) { return 3 * (std::max(numSubmaps() - 1, 0) + n); };
+
+  std::vector<Eigen::Triplet<double>> triplets;
+  Eigen::SparseMatrix<double> H(num_vars, num_vars);
+  Eigen::VectorXd b(num_vars);
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver;
+
+  // adds a 3x3 block to the normal equations
+  auto addBlock = [&triplets](int row, int col, const Matrix3d &block)
+  {
+    for(int r = 0; r < 3; r++)
+    {
+      for(int c = 0; c < 3; c++)
+      {
+        triplets.emplace_back(row + r, col + c, block(r, c));
+      }
+    }
+  };
+
+  for(int iter = 0; iter < max_iterations; iter++)
+  {
+    triplets.clear();
+    triplets.reserve(36 * constraints_.size() + num_vars);
+    b.setZero();
+
+    for(const auto &constraint : constraints_)
+    {
+      Matrix3d J_submap, J_node;
+      const Vector3d e = error(constraint, J_submap, J_node);
+      const Matrix3d omega = robustWeight(constraint, e) * constraint.information;
+
+      const auto fixed = constraint.submap == 0;
+      const auto s = submapVar(constraint.submap);
+      const auto n = nodeVar(constraint.node);
+
+      const Matrix3d omega_node = omega * J_node;
+      addBlock(n, n, J_node.transpose() * omega_node);
+      b.segment<3>(n) += J_node.transpose() * omega * e;
+
+      if (!fixed)
+      {
+        const Matrix3d omega_submap = omega * J_submap;
+        addBlock(s, s, J_submap.transpose() * omega_submap);
+        addBlock(s, n, J_submap.transpose() * omega_node);
+        addBlock(n, s, J_node.transpose() * omega_submap);
+        b.segment<3>(s) += J_submap.transpose() * omega * e;
+      }
+    }
+
+    for(int k = 0; k < num_vars; k++)
+    {
+      triplets.emplace_back(k, k, diagonal_damping);
+    }
+
+    H.setFromTriplets(triplets.begin(), triplets.end());
+    solver.compute(H);
+    if (solver.info() != Eigen::Success)
+    {
+      break;
+    }
+
+    const Eigen::VectorXd dx = solver.solve(-b);
+    if (solver.info() != Eigen::Success)
+    {
+      break;
+    }
+
+    for(int k = 1; k < numSubmaps(); k++)
+    {
+      submaps_[k] += dx.segment<3>(submapVar(k));
+      submaps_[k](0) = rigid2d::normalize_angle_PI(submaps_[k](0));
+    }
+
+    for(int k = 0; k < numNodes(); k++)
+    {
+      nodes_[k] += dx.segment<3>(nodeVar(k));
+      nodes_[k](0) = rigid2d::normalize_angle_PI(nodes_[k](0));
+    }
+
+    RIGID2D_COUNT("pose_graph.iterations", 1);
+    if (dx.lpNorm<Eigen::Infinity>() < min_step)
+    {
+      break;
+    }
+  }
+
+  return cost();
+}
+
+
+double PoseGraph::cost() const
+{
+  auto sum = 0.0;
+  for(const auto &constraint : constraints_)
+  {
+    Matrix3d J_submap, J_node;
+    const Vector3d e = error(constraint, J_submap, J_node);
+    sum += robustWeight(constraint, e) * e.dot(constraint.information * e);
+  }
+
+  return sum;
+}
+
+
+const Vector3d &PoseGraph::submapPose(int index) const
+{
+  return submaps_.at(index);
+}
+
+
+const Vector3d &PoseGraph::nodePose(int index) const
+{
+  return nodes_.at(index);
+}
+
+
+void PoseGraph::setSubmapPose(int index, const Vector3d &pose)
+{
+  submaps_.at(index) = pose;
+}
+
+
+void PoseGraph::setNodePose(int index, const Vector3d &pose)
+{
+  nodes_.at(index) = pose;
+}
+
+
+int PoseGraph::numSubmaps() const
+{
+  return static_cast<int>(submaps_.size());
+}
+
+
+int PoseGraph::numNodes() const
+{
+  return static_cast<int>(nodes_.size());
+}
+
+
+const std::vector<PoseConstraint> &PoseGraph::constraints() const
+{
+  return constraints_;
+}
+
+
+Vector3d PoseGraph::error(const PoseConstraint &constraint, Matrix3d &J_submap, Matrix3d &J_node) const
+{
+  const auto &ps = submaps_[constraint.submap];
+  const auto &pn = nodes_[constraint.node];
+
+  const auto c = std::cos(ps(0));
+  const auto s = std::sin(ps(0));
+  const auto dx = pn(1) - ps(1);
+  const auto dy = pn(2) - ps(2);
+
+  // pose of the node in the frame of the submap minus the measurement
+  Vector3d e;
+  e(0) = rigid2d::normalize_angle_PI(pn(0) - ps(0) - constraint.relative(0));
+  e(1) = c * dx + s * dy - constraint.relative(1);
+  e(2) = -s * dx + c * dy - constraint.relative(2);
+
+  J_submap << -1.0, 0.0, 0.0,
+              -s * dx + c * dy, -c, -s,
+              -c * dx - s * dy, s, -c;
+
+  J_node << 1.0, 0.0, 0.0,
+            0.0, c, s,
+            0.0, -s, c;
+
+  return e;
+}
+
+
+double PoseGraph::robustWeight(const PoseConstraint &constraint, const Vector3d &e) const
+{
+  if (!constraint.loop_closure)
+  {
+    return 1.0;
+  }
+
+  // residual in standard deviations
+  const auto r = std::sqrt(e.dot(constraint.information * e));
+  return (r <= huber_scale_) ? 1.0 : huber_scale_ / r;
+}
+
+} // end namespace
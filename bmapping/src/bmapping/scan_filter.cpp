@@ -0,0 +1,157 @@
+/// \file
+/// \brief Preprocesses a scan once before it is scored and inserted into the map
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "bmapping/scan_filter.hpp"
+
+
+namespace bmapping
+{
+
+ScanFilter::ScanFilter()
+  : range_min_(0.0),
+    range_max_(0.0),
+    min_spacing_(0.0),
+    max_angle_gap_(0.0),
+    isolation_distance_(0.0),
+    max_beams_(0)
+{
+}
+
+
+ScanFilter::ScanFilter(const LaserProperties &props,
+                       double min_spacing,
+                       double max_angle_gap,
+                       double isolation_distance,
+                       unsigned int max_beams)
+  : scan_angles_(rigid2d::beamAngles(props.beam_min, props.beam_max, props.beam_delta)),
+    range_min_(props.range_min),
+    range_max_(props.range_max),
+    min_spacing_(min_spacing),
+    max_angle_gap_(max_angle_gap),
+    isolation_distance_(isolation_distance),
+    max_beams_(max_beams)
+{
+  if (min_spacing_ < 0.0 or max_angle_gap_ < 0.0 or isolation_distance_ < 0.0)
+  {
+    throw std::invalid_argument("Scan filter distances and angles must not be negative");
+  }
+
+  rigid2d::beamDirections(scan_angles_, beam_dirs_);
+}
+
+
+void ScanFilter::filter(const std::vector<float> &scan, FilteredScan &filtered) const
+{
+  RIGID2D_SCOPED_TIMER("scan_filter.filter");
+
+  // without a laser every beam is passed on
+  if (scan_angles_.empty())
+  {
+    filtered.integrate = scan;
+    filtered.score = scan;
+    filtered.num_valid = filtered.num_scored = static_cast<unsigned int>(scan.size());
+    return;
+  }
+
+  const auto n = scan.size();
+  const auto nan = std::numeric_limits<float>::quiet_NaN();
+  filtered.integrate.assign(n, nan);
+  filtered.score.assign(n, nan);
+  filtered.num_valid = 0;
+  filtered.num_scored = 0;
+
+  // valid returns with an end point of a neighbouring beam close to them,
+  // a lone return is a mixed pixel or noise and not a surface
+  for(std::size_t i = 0; i < n; i++)
+  {
+    if (!valid(scan[i]))
+    {
+      continue;
+    }
+
+    if (isolation_distance_ > 0.0)
+    {
+      const auto p = endPoint(scan, i);
+      auto isolated = true;
+      for(const auto k : {i - 1, i + 1})
+      {
+        // i - 1 wraps past n for the first beam
+        if (k < n and valid(scan[k]))
+        {
+          const auto q = endPoint(scan, k);
+          isolated = isolated and std::hypot(p.x - q.x, p.y - q.y) > isolation_distance_;
+        }
+      }
+
+      if (isolated)
+      {
+        continue;
+      }
+    }
+
+    filtered.integrate[i] = scan[i];
+    filtered.num_valid++;
+  }
+
+  // decimate by the spacing of the end points, the spacing of consecutive
+  // beams grows with range so close returns are thinned the most
+  thread_local std::vector<std::size_t> kept;
+  kept.clear();
+
+  Vector2D last;
+  auto last_angle = 0.0;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    if (!valid(filtered.integrate[i]))
+    {
+      continue;
+    }
+
+    const auto p = endPoint(scan, i);
+    const auto angle = scan_angles_[i % scan_angles_.size()];
+    if (kept.empty() or
+        std::hypot(p.x - last.x, p.y - last.y) >= min_spacing_ or
+        (max_angle_gap_ > 0.0 and std::fabs(rigid2d::normalize_angle_PI(angle - last_angle)) >= max_angle_gap_))
+    {
+      kept.push_back(i);
+      last = p;
+      last_angle = angle;
+    }
+  }
+
+  // evenly spaced beams within the budget
+  const auto num_scored = (max_beams_ > 0) ? std::min<std::size_t>(kept.size(), max_beams_) : kept.size();
+  for(std::size_t k = 0; k < num_scored; k++)
+  {
+    const auto i = kept[k * kept.size() / num_scored];
+    filtered.score[i] = scan[i];
+  }
+  filtered.num_scored = static_cast<unsigned int>(num_scored);
+
+  RIGID2D_COUNT("scan_filter.beams", n);
+  RIGID2D_COUNT("scan_filter.valid", filtered.num_valid);
+  RIGID2D_COUNT("scan_filter.scored", filtered.num_scored);
+}
+
+
+Vector2D ScanFilter::endPoint(const std::vector<float> &scan, std::size_t beam) const
+{
+  const auto d = beam % beam_dirs_.size();
+  return Vector2D(scan[beam] * beam_dirs_.x[d], scan[beam] * beam_dirs_.y[d]);
+}
+
+
+bool ScanFilter::valid(float range) const
+{
+  // false for NaN
+  return range >= range_min_ and range < range_max_;
+}
+
+} // end namespace
@@ -32,9 +32,11 @@ LaserScanner::LaserScanner(const LaserProperties &props, const Transform2D &Trs)
                             beam_max_(props.beam_max),
                             beam_delta_(props.beam_delta),
                             range_min_(props.range_min),
-                            range_max_(props.range_max)
+                            range_max_(props.range_max),
+                            scan_angles_(rigid2d::beamAngles(beam_min_, beam_max_, beam_delta_))
 
 {
+  rigid2d::beamDirections(scan_angles_, beam_dirs_);
 }
 
 
@@ -44,71 +46,33 @@ void LaserScanner::laserEndPoints(std::vector<Vector2D> &end_points,
                                   const std::vector<float> &beam_length,
                                   const Transform2D &pose) const
 {
+  PointBatchd points;
+  laserEndPoints(points, beam_length, pose);
 
+  end_points.reserve(end_points.size() + points.size());
+  for(unsigned int i = 0; i < points.size(); i++)
+  {
+    end_points.emplace_back(points.x[i], points.y[i]);
+  }
+}
+
+
+void LaserScanner::laserEndPoints(PointBatchd &end_points,
+                                  const std::vector<float> &beam_length,
+                                  const Transform2D &pose) const
+{
   // TODO: Implementation assumes map is aligned with world
   //       This may cause a bug because laser end points are suppose to
   //        be in frame of map
 
-  // TODO: not sure if checking for valid measurements
-  //       to reserve memory for vector reduces latency
-
-
-  // number of measurements within specified range limits
-  unsigned int num_meas = numberValidMeasurements(beam_length);
-
-  // store end points
-  end_points.reserve(num_meas);
-
-  // end point
-  Vector2D point;
-
   // TODO: Tmr = Twm^-1 * Twr then pm = Tmr * Trs * p
   // transform from map to sensor
   // Tms = Twr * Trs
   Transform2D Tms = pose * Trs_;
 
-
-  // start beam angle at 0 and then transoform into coordinates
-  // of robot and the to world
-  double beam_angle = beam_min_;
-
-  // range measurement
-  double range = 0.0;
-  for(unsigned int i = 0; i < beam_length.size(); i++)
-  {
-    range = beam_length.at(i);
-
-    if (range >= range_min_ and range < range_max_)
-    {
-      // std::cout << range_min_ << " <= " << range << " < " << range_max_ << std::endl;
-      // cartesian coordinates in frame of sensor
-      point = range2Cartesian(range, beam_angle);
-
-      // cartesian coordinates in frame of map
-      // pm = Tms * p
-      point = Tms(point);
-
-      end_points.push_back(point);
-    }
-
-
-    // update beam angle
-    beam_angle += beam_delta_;
-
-    // max angle is negative
-    if (beam_max_ < 0.0 and beam_angle <= beam_max_)
-    {
-      beam_angle = beam_min_;
-    }
-
-    // max angle is positive
-    else if (beam_max_ >= 0.0 and beam_angle >= beam_max_)
-    {
-      beam_angle = beam_min_;
-    }
-
-  } // end loop
-
+  // beams within the range limits in cartesian coordinates
+  // of the sensor transformed to the map, pm = Tms * p
+  rigid2d::scanEndPoints(Tms, beam_length, beam_dirs_, range_min_, range_max_, end_points);
 }
 
 
@@ -129,4 +93,28 @@ unsigned int LaserScanner::numberValidMeasurements(const std::vector<float> &bea
 
   return valid_meas;
 }
+
+
+const std::vector<double> &LaserScanner::scanAngles() const
+{
+  return scan_angles_;
+}
+
+
+const Transform2D &LaserScanner::scannerTransform() const
+{
+  return Trs_;
+}
+
+
+float LaserScanner::rangeMin() const
+{
+  return range_min_;
+}
+
+
+float LaserScanner::rangeMax() const
+{
+  return range_max_;
+}
 } // end namespace
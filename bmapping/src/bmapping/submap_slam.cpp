@@ -0,0 +1,494 @@
+/// \file
+/// \brief Graph SLAM over small local submaps with background loop closure
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "bmapping/submap_slam.hpp"
+
+
+namespace bmapping
+{
+
+// Gauss-Newton steps per optimization
+static constexpr int optimize_iterations = 10;
+
+// standard deviation of a scan inserted without a match (theta, x, y)
+static const Vector3d unmatched_stddev(0.05, 0.05, 0.05);
+
+
+SubmapSLAM::SubmapSLAM(const GridMapper &prototype,
+                       int scans_per_submap,
+                       double node_distance,
+                       double node_angle,
+                       const CorrelativeScanMatcher &local_matcher,
+                       const CorrelativeScanMatcher &loop_matcher,
+                       double loop_search_distance,
+                       int loop_min_gap,
+                       int optimize_every,
+                       double huber_scale,
+                       unsigned int num_threads)
+  : prototype_(prototype),
+    scans_per_submap_(scans_per_submap),
+    node_distance_(node_distance),
+    node_angle_(node_angle),
+    local_matcher_(local_matcher),
+    loop_matcher_(loop_matcher),
+    loop_search_distance_(loop_search_distance),
+    loop_min_gap_(loop_min_gap),
+    optimize_every_(optimize_every),
+    has_odom_(false),
+    nodes_since_optimize_(0),
+    graph_(huber_scale),
+    num_loop_closures_(0),
+    pool_(num_threads)
+{
+  if (scans_per_submap_ < 2)
+  {
+    throw std::invalid_argument("A submap needs at least 2 scans");
+  }
+
+  if (loop_min_gap_ < 0)
+  {
+    throw std::invalid_argument("Nodes between a submap and a loop closure must not be negative");
+  }
+
+  if (optimize_every_ <= 0)
+  {
+    throw std::invalid_argument("Scans between optimizations must be positive");
+  }
+}
+
+
+SubmapSLAM::~SubmapSLAM()
+{
+  pool_.stop();
+}
+
+
+bool SubmapSLAM::addScan(const std::vector<float> &scan, const Pose &odom)
+{
+  RIGID2D_SCOPED_TIMER("submap.add_scan");
+
+  // pose predicted by the odometry
+  const Transform2D T_odom(Vector2D(odom.x, odom.y), odom.theta);
+  Transform2D predicted;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (has_odom_)
+    {
+      const Transform2D T_last(Vector2D(last_odom_.x, last_odom_.y), last_odom_.theta);
+      pose_ = pose_ * (T_last.inv() * T_odom);
+    }
+    predicted = pose_;
+  }
+  last_odom_ = odom;
+
+  // wait for the robot to move
+  if (has_odom_)
+  {
+    const auto dist = std::hypot(odom.x - node_odom_.x, odom.y - node_odom_.y);
+    const auto angle = std::fabs(rigid2d::normalize_angle_PI(odom.theta - node_odom_.theta));
+    if (dist < node_distance_ and angle < node_angle_)
+    {
+      return false;
+    }
+  }
+  has_odom_ = true;
+  node_odom_ = odom;
+
+  // match against the oldest active submap, it holds the most scans
+  auto matched = false;
+  ScanMatch match;
+  if (!active_.empty())
+  {
+    Submap *submap = nullptr;
+    Transform2D T_submap;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      submap = submaps_[active_.front()].get();
+      T_submap = submap->pose;
+    }
+
+    matched = local_matcher_.match(submap->grid, scan, transform2Pose(T_submap.inv() * predicted), match);
+    if (!matched and submap->grid.hasObstacles())
+    {
+      RIGID2D_COUNT("submap.match_failures", 1);
+    }
+  }
+
+  Matrix3d information = unmatched_stddev.cwiseProduct(unmatched_stddev).cwiseInverse().asDiagonal();
+  if (matched)
+  {
+    information = match.covariance.inverse();
+  }
+
+  // poses of the scan in the submaps it is inserted into
+  std::vector<std::pair<Submap *, Transform2D>> inserts;
+  int node = 0;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // the match is relative to the submap, which an optimization may have moved
+    if (matched)
+    {
+      pose_ = submaps_[active_.front()]->pose * pose2Transform(match.pose);
+    }
+
+    // a new submap starts when the newest has half its scans
+    if (active_.empty() or submaps_[active_.back()]->num_scans >= scans_per_submap_ / 2)
+    {
+      active_.push_back(addSubmap(pose_));
+    }
+
+    node = graph_.addNode(transform2Pose(pose_));
+    std::unique_ptr<TrajectoryNode> trajectory_node(new TrajectoryNode);
+    trajectory_node->scan = scan;
+    trajectory_node->pose = pose_;
+
+    for(const auto s : active_)
+    {
+      const auto T_local = submaps_[s]->pose.inv() * pose_;
+      inserts.emplace_back(submaps_[s].get(), T_local);
+      trajectory_node->submaps.push_back(s);
+
+      if (submaps_[s]->first_node < 0)
+      {
+        submaps_[s]->first_node = node;
+      }
+      submaps_[s]->last_node = node;
+
+      PoseConstraint constraint;
+      constraint.submap = s;
+      constraint.node = node;
+      constraint.relative = transform2Pose(T_local);
+      constraint.information = information;
+      graph_.addConstraint(constraint);
+    }
+
+    nodes_.push_back(std::move(trajectory_node));
+  }
+
+  // the active grids are only used on this thread
+  for(auto &insert : inserts)
+  {
+    auto &submap = *insert.first;
+    submap.grid.integrateScan(scan, insert.second);
+
+    const auto d = (insert.second * prototype_.scannerTransform()).displacement();
+    submap.xmin = std::min(submap.xmin, d.x);
+    submap.xmax = std::max(submap.xmax, d.x);
+    submap.ymin = std::min(submap.ymin, d.y);
+    submap.ymax = std::max(submap.ymax, d.y);
+    submap.num_scans++;
+  }
+
+  // the oldest submap is finished once full
+  if (submaps_[active_.front()]->num_scans >= scans_per_submap_)
+  {
+    const auto finished = active_.front();
+    active_.pop_front();
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      submaps_[finished]->finished = true;
+    }
+
+    searchSubmap(finished);
+  }
+
+  searchNode(node);
+
+  if (++nodes_since_optimize_ >= optimize_every_)
+  {
+    nodes_since_optimize_ = 0;
+    pool_.post([this]() { optimize(); });
+  }
+
+  return true;
+}
+
+
+void SubmapSLAM::finish()
+{
+  while (!pool_.waitIdle(std::chrono::milliseconds(100)))
+  {
+  }
+
+  optimize();
+}
+
+
+Transform2D SubmapSLAM::getRobotState() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return pose_;
+}
+
+
+void SubmapSLAM::gridMap(std::vector<int8_t> &map) const
+{
+  RIGID2D_SCOPED_TIMER("submap.grid_map");
+
+  const auto width = static_cast<int>(prototype_.viewWidth());
+  const auto height = static_cast<int>(prototype_.viewHeight());
+  const auto resolution = prototype_.resolution();
+  const auto margin = prototype_.rangeMax();
+
+  // the submaps are not removed and the grids are not written by the workers
+  std::vector<std::pair<const Submap *, Transform2D>> submaps;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for(const auto &submap : submaps_)
+    {
+      submaps.emplace_back(submap.get(), submap->pose);
+    }
+  }
+
+  // sum of the log odds of every submap over each cell of the window
+  thread_local std::vector<int> log_odds;
+  log_odds.assign(width * height, 0);
+
+  const auto origin = prototype_.grid2World(0, 0);
+  for(const auto &entry : submaps)
+  {
+    const auto &submap = *entry.first;
+    const auto &T_map_submap = entry.second;
+    const auto T_submap_map = T_map_submap.inv();
+
+    // cells of the window within the bounds of the submap
+    auto xmin = std::numeric_limits<double>::max(), xmax = std::numeric_limits<double>::lowest();
+    auto ymin = std::numeric_limits<double>::max(), ymax = std::numeric_limits<double>::lowest();
+    for(const auto x : {submap.xmin - margin, submap.xmax + margin})
+    {
+      for(const auto y : {submap.ymin - margin, submap.ymax + margin})
+      {
+        const auto corner = T_map_submap(Vector2D(x, y));
+        xmin = std::min(xmin, corner.x);
+        xmax = std::max(xmax, corner.x);
+        ymin = std::min(ymin, corner.y);
+        ymax = std::max(ymax, corner.y);
+      }
+    }
+
+    const auto i0 = std::max(0, static_cast<int>(std::floor((xmin - origin.x) / resolution)));
+    const auto i1 = std::min(width - 1, static_cast<int>(std::ceil((xmax - origin.x) / resolution)));
+    const auto j0 = std::max(0, static_cast<int>(std::floor((ymin - origin.y) / resolution)));
+    const auto j1 = std::min(height - 1, static_cast<int>(std::ceil((ymax - origin.y) / resolution)));
+
+    for(int j = j0; j <= j1; j++)
+    {
+      for(int i = i0; i <= i1; i++)
+      {
+        const auto p = T_submap_map(prototype_.grid2World(i, j));
+        log_odds[j * width + i] += submap.grid.logOdds(p.x, p.y);
+      }
+    }
+  }
+
+  map.resize(width * height);
+  for(int k = 0; k < width * height; k++)
+  {
+    map[k] = prototype_.cellValue(static_cast<FixedLogOdds>(std::clamp(log_odds[k], -log_odds_limit,
+                                                                       log_odds_limit)));
+  }
+}
+
+
+std::vector<Transform2D> SubmapSLAM::trajectory() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  std::vector<Transform2D> poses;
+  poses.reserve(nodes_.size());
+  for(const auto &node : nodes_)
+  {
+    poses.push_back(node->pose);
+  }
+
+  return poses;
+}
+
+
+std::size_t SubmapSLAM::numSubmaps() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return submaps_.size();
+}
+
+
+std::size_t SubmapSLAM::numNodes() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return nodes_.size();
+}
+
+
+std::size_t SubmapSLAM::numLoopClosures() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return num_loop_closures_;
+}
+
+
+int SubmapSLAM::addSubmap(const Transform2D &pose)
+{
+  submaps_.emplace_back(new Submap(prototype_, pose));
+  return graph_.addSubmap(transform2Pose(pose));
+}
+
+
+void SubmapSLAM::searchSubmap(int submap)
+{
+  std::vector<int> candidates;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for(std::size_t n = 0; n < nodes_.size(); n++)
+    {
+      if (loopCandidate(static_cast<int>(n), submap))
+      {
+        candidates.push_back(static_cast<int>(n));
+      }
+    }
+  }
+
+  for(const auto node : candidates)
+  {
+    pool_.post([this, node, submap]() { matchLoopClosure(node, submap); });
+  }
+}
+
+
+void SubmapSLAM::searchNode(int node)
+{
+  std::vector<int> candidates;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for(std::size_t s = 0; s < submaps_.size(); s++)
+    {
+      if (submaps_[s]->finished and loopCandidate(node, static_cast<int>(s)))
+      {
+        candidates.push_back(static_cast<int>(s));
+      }
+    }
+  }
+
+  for(const auto submap : candidates)
+  {
+    pool_.post([this, node, submap]() { matchLoopClosure(node, submap); });
+  }
+}
+
+
+bool SubmapSLAM::loopCandidate(int node, int submap) const
+{
+  const auto &target = *submaps_[submap];
+
+  // the submaps built around the node in time are matched by the local
+  // matcher, matching them again is not a loop closure
+  if (node >= target.first_node - loop_min_gap_ and node <= target.last_node + loop_min_gap_)
+  {
+    return false;
+  }
+
+  // distance from the node to the scanner positions of the submap
+  const auto d = (target.pose.inv() * nodes_[node]->pose).displacement();
+  const auto dx = std::max({target.xmin - d.x, d.x - target.xmax, 0.0});
+  const auto dy = std::max({target.ymin - d.y, d.y - target.ymax, 0.0});
+  return std::hypot(dx, dy) <= loop_search_distance_;
+}
+
+
+void SubmapSLAM::matchLoopClosure(int node, int submap)
+{
+  const Submap *target = nullptr;
+  const std::vector<float> *scan = nullptr;
+  Transform2D T_local;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // an optimization may have moved them apart since the search was queued
+    if (!loopCandidate(node, submap))
+    {
+      return;
+    }
+
+    target = submaps_[submap].get();
+    scan = &nodes_[node]->scan;
+    T_local = target->pose.inv() * nodes_[node]->pose;
+  }
+
+  RIGID2D_COUNT("submap.loop_searches", 1);
+
+  // the matcher keeps buffers between matches so each search has its own
+  CorrelativeScanMatcher matcher(loop_matcher_);
+  ScanMatch match;
+  if (!matcher.match(target->grid, *scan, transform2Pose(T_local), match))
+  {
+    return;
+  }
+
+  PoseConstraint constraint;
+  constraint.submap = submap;
+  constraint.node = node;
+  constraint.relative = match.pose;
+  constraint.information = match.covariance.inverse();
+  constraint.loop_closure = true;
+
+  RIGID2D_COUNT("submap.loop_closures", 1);
+  std::lock_guard<std::mutex> lock(mtx_);
+  graph_.addConstraint(constraint);
+  num_loop_closures_++;
+}
+
+
+void SubmapSLAM::optimize()
+{
+  std::lock_guard<std::mutex> serial(optimize_mtx_);
+
+  PoseGraph graph;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    graph = graph_;
+  }
+
+  if (graph.numNodes() == 0)
+  {
+    return;
+  }
+
+  graph.optimize(optimize_iterations);
+
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  // the robot moves with the latest node
+  const auto T_latest = nodes_.back()->pose;
+
+  // moves the submaps and nodes added during the optimization with the last node optimized
+  const auto last = graph.numNodes() - 1;
+  const auto correction = pose2Transform(graph.nodePose(last)) * pose2Transform(graph_.nodePose(last)).inv();
+
+  for(int s = 0; s < graph_.numSubmaps(); s++)
+  {
+    const auto pose = (s < graph.numSubmaps()) ? graph.submapPose(s) :
+                                                 transform2Pose(correction * submaps_[s]->pose);
+    graph_.setSubmapPose(s, pose);
+    submaps_[s]->pose = pose2Transform(pose);
+  }
+
+  for(int n = 0; n < graph_.numNodes(); n++)
+  {
+    const auto pose = (n < graph.numNodes()) ? graph.nodePose(n) :
+                                               transform2Pose(correction * nodes_[n]->pose);
+    graph_.setNodePose(n, pose);
+    nodes_[n]->pose = pose2Transform(pose);
+  }
+
+  pose_ = nodes_.back()->pose * (T_latest.inv() * pose_);
+}
+
+} // end namespace
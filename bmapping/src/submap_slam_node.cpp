@@ -0,0 +1,347 @@
+/// \file
+/// \brief Submap pose graph SLAM
+///
+/// PARAMETERS:
+///   map_frame_id - map frame
+///   odom_frame_id - odometry frame
+///   body_frame_id - base link frame
+///   left_wheel_joint - name of left wheel joint
+///   right_wheel_joint - name of right wheel joint
+///   match_linear_window - distance searched along x and y when matching a scan to the active submap (m)
+///   match_angular_window - rotation searched when matching a scan to the active submap (rad)
+///   match_depth - number of coarser grids in the local scan matcher
+///   match_min_score - lowest mean log likelihood of a beam accepted by the local scan matcher
+///   submap_scans - scans inserted into a submap before it is finished
+///   submap_node_distance - distance the robot moves before a scan is added (m)
+///   submap_node_angle - rotation of the robot before a scan is added (rad)
+///   loop_linear_window - distance searched along x and y for a loop closure (m)
+///   loop_angular_window - rotation searched for a loop closure (rad)
+///   loop_depth - number of coarser grids in the loop closure scan matcher
+///   loop_min_score - lowest mean log likelihood of a beam accepted as a loop closure
+///   loop_search_distance - max distance between a scan and the submaps searched for loop closures (m)
+///   loop_min_gap - min number of scans between a submap and the scans searched against it
+///   optimize_every - scans added between optimizations of the pose graph
+///   huber_scale - residual of a loop closure, in standard deviations, past which it is down weighted
+///   num_threads - loop closure and optimization threads, 0 runs them on the SLAM thread
+///   z_hit - probability laser hits obstacle
+///   z_short - probability laser end short of obstacle
+///   z_max - probability laser is at its max range
+///   z_rand - probability laser hit is random
+///   sigma_hit - varinace of the distance between nearest obstacle in occupancy grid and laser end point
+///   map_min - lower bound of the published map, the submaps grow beyond it
+///   map_max - upper bound of the published map
+///   map_resolution - map resolution
+///   beam_min - starting angle of lidar (degrees)
+///   beam_max - ending angle of lidar (degrees)
+///   beam_delta - change in angle between laser measurements
+///   range_min - min range of lidar
+///   range_max - max range of lidar
+///   publish_frequency - rate pose errors are published and a new map is checked for
+///   map_publish_frequency - rate the full map is republished
+///   odometry_history - number of odometry poses kept to look up the pose at a scan
+///   path_capacity - max number of poses kept in each path
+///   path_min_distance - min distance between poses in a path
+///   path_min_angle - min change in heading between poses in a path
+///   path_publish_frequency - rate the paths are published
+///   path_delta - publish the poses added to each path on <path>_delta
+///   diagnostics_frequency - rate the timing metrics are published
+///   trace_file - writes a Chrome trace of the hot paths on shutdown if set
+/// PUBLISHES:
+///   slam_path (nav_msgs/Path): trajectory from submap slam
+///   odom_path (nav_msgs/Path): trajectory from odometry
+///   gazebo_path (nav_msgs/Path): trajectory from gazebo
+///   slam_path_delta, odom_path_delta, gazebo_path_delta (nav_msgs/Path): poses added to each path
+///   map (nav_msgs/OccupancyGrid): 2D occupancy grid map, always the full map since
+///                                 an optimization of the graph moves every submap
+///   odom (nav_msgs/Odometry): pose and twist from odometry
+///   odom_error (tsim/PoseError): pose error between gazebo and odometry
+///   slam_error (tsim/PoseError): pose error between gazebo and submap slam
+///   /diagnostics (diagnostic_msgs/DiagnosticArray): latency of the SLAM stages
+/// SUBSCRIBES:
+///   scan (sensor_msgs/LaserScan): Lidar scan
+///   /gazebo/model_states (gazebo_msgs/ModelStates): model states from grazebo
+///   joint_states (sensor_msgs/JointState): angular wheel positions
+///
+
+
+#include <ros/ros.h>
+#include <ros/console.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include <rigid2d/rigid2d.hpp>
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/correlative_matcher.hpp"
+#include "bmapping/submap_slam.hpp"
+#include "bmapping/mailbox.hpp"
+#include "bmapping/slam_node.hpp"
+
+
+using rigid2d::Transform2D;
+
+
+using bmapping::LaserProperties;
+using bmapping::CorrelativeScanMatcher;
+using bmapping::SubmapSLAM;
+using bmapping::GridMapper;
+using bmapping::Mailbox;
+using bmapping::ScanUpdate;
+using bmapping::SlamNodeParams;
+using bmapping::SlamNodeInterface;
+
+
+/// \brief Result of the SLAM worker
+struct SlamUpdate
+{
+  Transform2D Tmr;                                              // transform from map to robot
+  bool full_map = false;                                        // true if map is set
+  std::vector<int8_t> map;                                      // map composed from the submaps
+};
+
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "submap_slam");
+  ros::NodeHandle nh("~");
+  ros::NodeHandle node_handle;
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  ros::Publisher map_pub = node_handle.advertise<nav_msgs::OccupancyGrid>("map", 10, true);
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  // frame IDs, robot, lidar, map, and publishing parameters
+  SlamNodeParams params;
+
+  // local scan matcher parameters
+  double match_linear_window = 0.1, match_angular_window = 0.1, match_min_score = -1.0;
+  int match_depth = 3;
+
+  // submap parameters
+  int submap_scans = 20;
+  double submap_node_distance = 0.02, submap_node_angle = 0.05;
+
+  // loop closure parameters
+  double loop_linear_window = 0.5, loop_angular_window = 0.3, loop_min_score = -0.3;
+  int loop_depth = 4;
+  double loop_search_distance = 1.0;
+  int loop_min_gap = 40;
+
+  // pose graph parameters
+  int optimize_every = 20;
+  double huber_scale = 1.0;
+  int num_threads = 2;
+
+
+  if (!bmapping::loadSlamNodeParams(nh, node_handle, params))
+  {
+    return 1;
+  }
+
+  nh.getParam("match_linear_window", match_linear_window);
+  nh.getParam("match_angular_window", match_angular_window);
+  nh.getParam("match_depth", match_depth);
+  nh.getParam("match_min_score", match_min_score);
+
+  nh.getParam("submap_scans", submap_scans);
+  nh.getParam("submap_node_distance", submap_node_distance);
+  nh.getParam("submap_node_angle", submap_node_angle);
+
+  nh.getParam("loop_linear_window", loop_linear_window);
+  nh.getParam("loop_angular_window", loop_angular_window);
+  nh.getParam("loop_depth", loop_depth);
+  nh.getParam("loop_min_score", loop_min_score);
+  nh.getParam("loop_search_distance", loop_search_distance);
+  nh.getParam("loop_min_gap", loop_min_gap);
+
+  nh.getParam("optimize_every", optimize_every);
+  nh.getParam("huber_scale", huber_scale);
+  nh.getParam("num_threads", num_threads);
+
+  ROS_INFO("match_linear_window %f", match_linear_window);
+  ROS_INFO("match_angular_window %f", match_angular_window);
+  ROS_INFO("match_depth %d", match_depth);
+  ROS_INFO("match_min_score %f", match_min_score);
+
+  ROS_INFO("submap_scans %d", submap_scans);
+  ROS_INFO("submap_node_distance %f", submap_node_distance);
+  ROS_INFO("submap_node_angle %f", submap_node_angle);
+
+  ROS_INFO("loop_linear_window %f", loop_linear_window);
+  ROS_INFO("loop_angular_window %f", loop_angular_window);
+  ROS_INFO("loop_depth %d", loop_depth);
+  ROS_INFO("loop_min_score %f", loop_min_score);
+  ROS_INFO("loop_search_distance %f", loop_search_distance);
+  ROS_INFO("loop_min_gap %d", loop_min_gap);
+
+  ROS_INFO("optimize_every %d", optimize_every);
+  ROS_INFO("huber_scale %f", huber_scale);
+  ROS_INFO("num_threads %d", num_threads);
+
+  ROS_INFO("Successfully launched submap SLAM node");
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  // odometry, transforms, paths, and pose errors
+  SlamNodeInterface node(nh, node_handle, params, "submap_slam");
+  rigid2d::OdometryEngine &odometry = node.odometry();
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  // transform robot to lidar
+  Transform2D Trs;
+
+  // lidar properties
+  LaserProperties props = params.laserProperties();
+
+  // empty submap, its window is the published map
+  GridMapper grid(params.map_resolution, params.map_min, params.map_max,
+                  params.map_min, params.map_max, props, Trs);
+
+  // submap pose graph
+  SubmapSLAM slam(grid, submap_scans, submap_node_distance, submap_node_angle,
+                  CorrelativeScanMatcher(match_linear_window, match_angular_window,
+                                         match_depth, match_min_score),
+                  CorrelativeScanMatcher(loop_linear_window, loop_angular_window,
+                                         loop_depth, loop_min_score),
+                  loop_search_distance, loop_min_gap, optimize_every, huber_scale,
+                  static_cast<unsigned int>(std::max(num_threads, 0)));
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  const auto origin = grid.viewOrigin();
+
+  nav_msgs::OccupancyGrid map_msg;
+  map_msg.header.frame_id = params.map_frame_id;
+  map_msg.info.resolution = params.map_resolution;
+  map_msg.info.width = grid.viewWidth();
+  map_msg.info.height = grid.viewHeight();
+
+  map_msg.info.origin.position.x = origin.x;
+  map_msg.info.origin.position.y = origin.y;
+  map_msg.info.origin.orientation.w = 1.0;
+
+  // publish the map on the next update
+  bool map_reset = false;
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  // latest scan for the SLAM worker, unprocessed scans are dropped
+  Mailbox<ScanUpdate> &scan_mailbox = node.scans();
+
+  // latest SLAM result for publishing
+  Mailbox<SlamUpdate> slam_mailbox;
+
+  // scan matching and submap insertion run on their own thread so the
+  // odometry and transforms are not delayed, loop closure runs on the
+  // workers of the SLAM backend
+  std::thread slam_worker([&]()
+  {
+    while(ros::ok())
+    {
+      std::unique_ptr<ScanUpdate> update = scan_mailbox.waitTake(std::chrono::milliseconds(100));
+      if (!update)
+      {
+        continue;
+      }
+
+      // odometry is looked up here, the history covers the time
+      // the scan waited in the mailbox
+      const auto added = slam.addScan(update->scan, odometry.poseAt(update->stamp));
+
+      std::unique_ptr<SlamUpdate> result(new SlamUpdate);
+      result->Tmr = slam.getRobotState();
+
+      // the map only changes when a scan is inserted, the background
+      // optimization moves the submaps of the next composed map
+      if (added)
+      {
+        result->full_map = true;
+        slam.gridMap(result->map);
+      }
+
+      // a map the ROS thread has not read is still the latest map
+      std::unique_ptr<SlamUpdate> unread = slam_mailbox.take();
+      if (unread and unread->full_map and !result->full_map)
+      {
+        result->full_map = true;
+        result->map = std::move(unread->map);
+      }
+
+      slam_mailbox.post(std::move(result));
+    }
+  });
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  // takes the newest SLAM result if there is one
+  auto updateSlamState = [&]()
+  {
+    std::unique_ptr<SlamUpdate> result = slam_mailbox.take();
+    if (result)
+    {
+      node.setMapToRobot(result->Tmr);
+
+      if (result->full_map)
+      {
+        map_msg.header.stamp = ros::Time::now();
+        map_msg.info.map_load_time = ros::Time::now();
+        map_msg.data = std::move(result->map);
+        map_reset = true;
+      }
+    }
+  };
+
+  // the transforms are broadcast from the newest result
+  node.onJointStates(updateSlamState);
+
+
+  // publish the full map
+  auto publishMap = [&]()
+  {
+    if (map_msg.data.empty())
+    {
+      return;
+    }
+
+    map_msg.header.stamp = ros::Time::now();
+    map_pub.publish(map_msg);
+
+    map_reset = false;
+  };
+
+
+  // publish paths, map, and pose errors at a fixed rate
+  auto publishCallback = [&](const ros::TimerEvent &)
+  {
+    updateSlamState();
+    node.publish(ros::Time::now());
+
+    // publish the map if a scan was inserted since it was last published
+    if (map_reset)
+    {
+      publishMap();
+    }
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  ros::Timer publish_timer = node_handle.createTimer(ros::Duration(1.0 / params.publish_frequency), publishCallback);
+
+  // the full map for late subscribers
+  ros::Timer map_timer = node_handle.createTimer(ros::Duration(1.0 / params.map_publish_frequency),
+                                                 [&](const ros::TimerEvent &) { publishMap(); });
+
+  // callbacks only run when a message or timer event arrives
+  ros::spin();
+
+  slam_worker.join();
+
+  return 0;
+}
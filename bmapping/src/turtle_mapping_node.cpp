@@ -22,32 +22,54 @@
 ///   sample_range_theta - sample ICP transform rotation distribution range
 ///   sample_range_x - sample ICP transform x translation distribution range
 ///   sample_range_y - sample ICP transform x translation distribution range
-///   scan_likelihood_min - min scan likelihood
-///   scan_likelihood_max - max scan likelihood
-///   pose_likelihood_min - min pose likelihood
-///   pose_likelihood_max - max pose likelihood
+///   correlative_matcher - propose poses with the correlative scan matcher rather than ICP
+///   match_linear_window - distance searched by the correlative matcher along x and y (m)
+///   match_angular_window - rotation searched by the correlative matcher (rad)
+///   match_depth - number of coarser grids in the correlative matcher
+///   match_min_score - lowest mean log likelihood of a beam accepted by the correlative matcher
+///   scan_filter - score a decimated subset of each scan and integrate every valid return
+///   filter_min_spacing - min distance between the end points of the beams scored (m)
+///   filter_max_angle_gap - max angle between the beams scored, 0 for no limit (rad)
+///   filter_isolation_distance - returns with no neighbouring end point this close are removed, 0 keeps all (m)
+///   filter_max_beams - max number of beams scored, 0 for no limit
 ///   z_hit - probability laser hits obstacle
 ///   z_short - probability laser end short of obstacle
 ///   z_max - probability laser is at its max range
 ///   z_rand - probability laser hit is random
 ///   sigma_hit - varinace of the distance between nearest obstacle in occupancy grid and laser end point
-///   map_min - lower map bound
-///   map_max - upper map bound
+///   map_min - lower bound of the published map, the map grows to cover every cell mapped
+///   map_max - upper bound of the published map
 ///   map_resolution - map resolution
+///   load_map_file - map file every particle starts from if set, must have the same resolution and map_min
+///   save_map_file - map file the best map is written to in the background if set
+///   save_map_period - time between saves of the best map, 0 only saves on shutdown (s)
 ///   beam_min - starting angle of lidar (degrees)
 ///   beam_max - ending angle of lidar (degrees)
 ///   beam_delta - change in angle between laser measurements
 ///   range_min - min range of lidar
 ///   range_max - max range of lidar
+///   publish_frequency - rate map updates and pose errors are published
+///   map_publish_frequency - rate the full map is published
+///   odometry_history - number of odometry poses kept to look up the pose at a scan
+///   path_capacity - max number of poses kept in each path
+///   path_min_distance - min distance between poses in a path
+///   path_min_angle - min change in heading between poses in a path
+///   path_publish_frequency - rate the paths are published
+///   path_delta - publish the poses added to each path on <path>_delta
+///   diagnostics_frequency - rate the timing metrics are published
+///   trace_file - writes a Chrome trace of the hot paths on shutdown if set
 /// PUBLISHES:
 ///   odom (nav_msgs/Odometry): Pose of robot in odom frame and twist in body frame
 ///   slam_path (nav_msgs/Path): trajectory from RBPG slam
 ///   odom_path (nav_msgs/Path): trajectory from odometry
 ///   gazebo_path (nav_msgs/Path): trajectory from gazebo
+///   slam_path_delta, odom_path_delta, gazebo_path_delta (nav_msgs/Path): poses added to each path
 ///   map (nav_msgs/OccupancyGrid): 2D occupancy grid map
+///   map_updates (map_msgs/OccupancyGridUpdate): regions of the map that changed
 ///   odom (nav_msgs/Odometry): pose and twist from odometry
 ///   odom_error (tsim/PoseError): pose error between gazebo and odometry
 ///   slam_error (tsim/PoseError): pose error between gazebo and RBPF slam
+///   /diagnostics (diagnostic_msgs/DiagnosticArray): latency of the SLAM stages
 /// SUBSCRIBES:
 ///   scan (sensor_msgs/LaserScan): Lidar scan
 ///   /gazebo/model_states (gazebo_msgs/ModelStates): model states from grazebo
@@ -58,145 +80,101 @@
 #include <ros/ros.h>
 #include <ros/console.h>
 #include <nav_msgs/OccupancyGrid.h>
-#include <nav_msgs/Odometry.h>
-#include <geometry_msgs/Pose.h>
-#include <geometry_msgs/PoseStamped.h>
-#include <gazebo_msgs/ModelStates.h>
-#include <sensor_msgs/JointState.h>
-#include <sensor_msgs/LaserScan.h>
-#include <tf2/LinearMath/Matrix3x3.h>
-#include <tf2/LinearMath/Quaternion.h>
-#include <tf2_ros/transform_broadcaster.h>
-#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
-#include <geometry_msgs/TransformStamped.h>
-#include <geometry_msgs/Point32.h>
-#include <sensor_msgs/PointCloud.h>
-#include <nav_msgs/Odometry.h>
-#include <nav_msgs/Path.h>
+#include <map_msgs/OccupancyGridUpdate.h>
 
 #include <iostream>
+#include <algorithm>
 #include <memory>
 #include <cstdlib>
 #include <vector>
-#include <time.h>
-#include <cmath>
-#include <Eigen/Core>
+#include <chrono>
+#include <thread>
 
 #include <rigid2d/rigid2d.hpp>
-#include <rigid2d/diff_drive.hpp>
 #include "bmapping/cloud_alignment.hpp"
 #include "bmapping/sensor_model.hpp"
 #include "bmapping/grid_mapper.hpp"
+#include "bmapping/map_file.hpp"
 #include "bmapping/particle_filter.hpp"
-#include "tsim/PoseError.h"
+#include "bmapping/scan_filter.hpp"
+#include "bmapping/mailbox.hpp"
+#include "bmapping/dirty_tiles.hpp"
+#include "bmapping/slam_node.hpp"
 
 
-using Eigen::MatrixXd;
-using Eigen::VectorXd;
-using Eigen::Vector2d;
-using Eigen::Vector3d;
-
-using rigid2d::Twist2D;
 using rigid2d::Vector2D;
-using rigid2d::Pose;
 using rigid2d::Transform2D;
-using rigid2d::TransformData2D;
-using rigid2d::deg2rad;
-using rigid2d::normalize_angle_PI;
 
 
 using bmapping::LaserProperties;
-using bmapping::LaserScanner;
 using bmapping::ScanAlignment;
+using bmapping::CorrelativeScanMatcher;
+using bmapping::ScanFilter;
 using bmapping::ParticleFilter;
 using bmapping::GridMapper;
+using bmapping::MapWriter;
+using bmapping::Mailbox;
+using bmapping::MapRegion;
+using bmapping::DirtyTiles;
+using bmapping::ScanUpdate;
+using bmapping::SlamNodeParams;
+using bmapping::SlamNodeInterface;
 
 
-static std::string left_wheel_joint, right_wheel_joint;         // joint names
-static double left, right;                                      // wheel angular positions for odometry
-static double pf_left, pf_right;                                // wheel angular positions for SLAM
-static bool wheel_odom_flag;                                    // odometry update
-
-static std::vector<float> scan;                                 // lidar scan
-static bool scan_update;                                        // scan update flag
-
-static geometry_msgs::PoseStamped gazebo_robot_pose;            // gazebo robot pose
-
-
-/// \brief Update the scan
-/// \param msg -lidar scan
-void scanCallback(const sensor_msgs::LaserScan::ConstPtr &msg)
+/// \brief Changed region of the map
+struct MapPatch
 {
-  scan = msg->ranges;
-  scan_update = true;
-}
+  MapRegion region;                                             // rectangle in the map
+  std::vector<int8_t> data;                                     // values in the region
+};
 
 
-/// \brief updates the wheel encoder angles
-/// \param msg - contains the encoder readings and joint names
-void jointStatesCallback(const sensor_msgs::JointState::ConstPtr &msg)
+/// \brief Result of the SLAM worker
+struct SlamUpdate
 {
-  std::vector<std::string> names = msg->name;
-  std::vector<std::string>::iterator iter;
-  int left_idx, right_idx;
-
-  iter = std::find(names.begin(), names.end(), left_wheel_joint);
-  left_idx = std::distance(names.begin(), iter);
-
-  iter = std::find(names.begin(), names.end(), right_wheel_joint);
-  right_idx = std::distance(names.begin(), iter);
-
-  if (left_idx > 1)
+  Transform2D Tmr;                                              // transform from map to robot
+  bool full_map = false;                                        // true if map is set
+  std::vector<int8_t> map;                                      // map of best particle
+  unsigned int width = 0, height = 0;                           // size of map
+  Vector2D origin;                                              // corner of the first cell of map
+  std::vector<MapPatch> patches;                                // changes since the previous result
+};
+
+
+/// \brief Combines a result the ROS thread has not read with a newer one
+/// \param older - the unread result
+/// newer[out] - the newer result, holds both on return
+void mergeSlamUpdates(SlamUpdate &older, SlamUpdate &newer)
+{
+  // the newer map replaces everything
+  if (newer.full_map)
   {
-    throw std::invalid_argument("Left wheel index not found in Odometer.");
+    return;
   }
 
-  if (right_idx > 1)
+  if (older.full_map)
   {
-    throw std::invalid_argument("Right wheel index not found in Odometer.");
-  }
-
-
-  // ROS_INFO("left index: %d", left_idx);
-  // ROS_INFO("right index: %d", right_idx);
-
-
-  left = msg->position.at(left_idx);
-  right = msg->position.at(right_idx);
-
-
-  wheel_odom_flag = true;
-}
-
-
-/// \brief  Retreive gazebo robot pose
-/// \param model_data - model states in world
-void modelCallBack(const gazebo_msgs::ModelStates::ConstPtr& model_data)
-{
-  // store names of all items in gazebo
-  std::vector<std::string> names = model_data->name;
-
-  // index of robot
-  int robot_index = 0;
-
-  // find diff_drive robot
-  int ctr = 0;
-  for(const auto &item : names)
-  {
-    // check for robot
-    if (item == "diff_drive")
+    for(const auto &patch : newer.patches)
     {
-      robot_index = ctr;
+      bmapping::pasteRegion(older.map, older.width, patch.region, patch.data);
     }
 
-    ctr++;
-  } // end loop
-
+    newer.full_map = true;
+    newer.map = std::move(older.map);
+    newer.width = older.width;
+    newer.height = older.height;
+    newer.origin = older.origin;
+    newer.patches.clear();
+  }
 
-  // pose of robot
-  gazebo_robot_pose.header.stamp = ros::Time::now();
-  gazebo_robot_pose.pose.position = model_data->pose[robot_index].position;
-  gazebo_robot_pose.pose.orientation = model_data->pose[robot_index].orientation;
+  else
+  {
+    // older patches are applied first
+    older.patches.insert(older.patches.end(),
+                         std::make_move_iterator(newer.patches.begin()),
+                         std::make_move_iterator(newer.patches.end()));
+    newer.patches = std::move(older.patches);
+  }
 }
 
 
@@ -208,32 +186,13 @@ int main(int argc, char** argv)
 
   /////////////////////////////////////////////////////////////////////////////
 
-  ros::Subscriber scan_sub = node_handle.subscribe("scan", 1, scanCallback);
-  ros::Subscriber joint_sub = node_handle.subscribe("joint_states", 1, jointStatesCallback);
-  ros::Subscriber model_sub = nh.subscribe("/gazebo/model_states", 1, modelCallBack);
-
-  ros::Publisher slam_path_pub = node_handle.advertise<nav_msgs::Path>("slam_path", 10);
-  ros::Publisher odom_path_pub = node_handle.advertise<nav_msgs::Path>("odom_path", 10);
-  ros::Publisher gazebo_path_pub = node_handle.advertise<nav_msgs::Path>("gazebo_path", 10);
-  ros::Publisher map_pub = node_handle.advertise<nav_msgs::OccupancyGrid>("map", 10);
-  ros::Publisher odom_pub = node_handle.advertise<nav_msgs::Odometry>("odom", 1);
-
-  ros::Publisher odom_error_pub = node_handle.advertise<tsim::PoseError>("odom_error", 1);
-  ros::Publisher slam_error_pub = node_handle.advertise<tsim::PoseError>("slam_error", 1);
+  ros::Publisher map_pub = node_handle.advertise<nav_msgs::OccupancyGrid>("map", 10, true);
+  ros::Publisher map_update_pub = node_handle.advertise<map_msgs::OccupancyGridUpdate>("map_updates", 10);
 
   /////////////////////////////////////////////////////////////////////////////
 
-  // frame IDs
-  // robots chassis parameters
-  std::string map_frame_id, odom_frame_id, body_frame_id;
-  double wheel_base = 0.0, wheel_radius = 0.0;
-
-  // lidar specs
-  double beam_min = 0.0, beam_max = 0.0, beam_delta = 0.0;
-  double range_min = 0.0, range_max = 0.0;
-
-  // scan likelihood parameters
-  double z_hit = 0.0, z_short = 0.0, z_max = 0.0, z_rand = 0.0, sigma_hit = 0.0;
+  // frame IDs, robot, lidar, map, and publishing parameters
+  SlamNodeParams params;
 
   // particle filter parameters
   int num_particles = 0, num_samples_mode = 0;
@@ -241,31 +200,26 @@ int main(int argc, char** argv)
   double srr = 0.0, srt = 0.0, str = 0.0, stt = 0.0;
   double motion_noise_theta = 0.0, motion_noise_x = 0.0, motion_noise_y = 0.0;
   double sample_range_theta = 0.0, sample_range_x = 0.0, sample_range_y = 0.0;
-  double scan_likelihood_min = 0.0, scan_likelihood_max = 0.0;
-  double pose_likelihood_min = 0.0, pose_likelihood_max = 0.0;
-
-  // occupancy grid parameters
-  double map_min = 0.0, map_max = 0.0, map_resolution = 0.0;
 
+  // correlative scan matcher parameters
+  bool correlative_matcher = false;
+  double match_linear_window = 0.1, match_angular_window = 0.1, match_min_score = -1.0;
+  int match_depth = 3;
 
-  nh.getParam("left_wheel_joint", left_wheel_joint);
-  nh.getParam("right_wheel_joint", right_wheel_joint);
+  // scan preprocessing parameters
+  bool scan_filter = false;
+  double filter_min_spacing = 0.05, filter_max_angle_gap = 0.05, filter_isolation_distance = 0.15;
+  int filter_max_beams = 120;
 
-  nh.getParam("map_frame_id", map_frame_id);
-  nh.getParam("odom_frame_id", odom_frame_id);
-  nh.getParam("body_frame_id", body_frame_id);
+  // map persistence
+  std::string load_map_file, save_map_file;
+  double save_map_period = 60.0;
 
-  nh.getParam("beam_min", beam_min);
-  nh.getParam("beam_max", beam_max);
-  nh.getParam("beam_delta", beam_delta);
-  nh.getParam("range_min", range_min);
-  nh.getParam("range_max", range_max);
 
-  nh.getParam("z_hit", z_hit);
-  nh.getParam("z_short", z_short);
-  nh.getParam("z_max", z_max);
-  nh.getParam("z_rand", z_rand);
-  nh.getParam("sigma_hit", sigma_hit);
+  if (!bmapping::loadSlamNodeParams(nh, node_handle, params))
+  {
+    return 1;
+  }
 
   nh.getParam("num_particles", num_particles);
   nh.getParam("num_samples_mode", num_samples_mode);
@@ -283,35 +237,21 @@ int main(int argc, char** argv)
   nh.getParam("sample_range_x", sample_range_x);
   nh.getParam("sample_range_y", sample_range_y);
 
-  nh.getParam("scan_likelihood_min", scan_likelihood_min);
-  nh.getParam("scan_likelihood_max", scan_likelihood_max);
+  nh.getParam("correlative_matcher", correlative_matcher);
+  nh.getParam("match_linear_window", match_linear_window);
+  nh.getParam("match_angular_window", match_angular_window);
+  nh.getParam("match_depth", match_depth);
+  nh.getParam("match_min_score", match_min_score);
 
-  nh.getParam("pose_likelihood_min", pose_likelihood_min);
-  nh.getParam("pose_likelihood_max", pose_likelihood_max);
+  nh.getParam("scan_filter", scan_filter);
+  nh.getParam("filter_min_spacing", filter_min_spacing);
+  nh.getParam("filter_max_angle_gap", filter_max_angle_gap);
+  nh.getParam("filter_isolation_distance", filter_isolation_distance);
+  nh.getParam("filter_max_beams", filter_max_beams);
 
-  nh.getParam("map_min", map_min);
-  nh.getParam("map_max", map_max);
-  nh.getParam("map_resolution", map_resolution);
-
-
-  node_handle.getParam("/wheel_base", wheel_base);
-  node_handle.getParam("/wheel_radius", wheel_radius);
-
-  beam_min = deg2rad(beam_min);
-  beam_max = deg2rad(beam_max);
-  beam_delta = deg2rad(beam_delta);
-
-  ROS_INFO("beam_min %f", beam_min);
-  ROS_INFO("beam_max %f", beam_max);
-  ROS_INFO("beam_delta %f", beam_delta);
-  ROS_INFO("range_min %f", range_min);
-  ROS_INFO("range_max %f", range_max);
-
-  ROS_INFO("z_hit %f", z_hit);
-  ROS_INFO("z_short %f", z_short);
-  ROS_INFO("z_max %f", z_max);
-  ROS_INFO("z_rand %f", z_rand);
-  ROS_INFO("sigma_hit %f", sigma_hit);
+  nh.getParam("load_map_file", load_map_file);
+  nh.getParam("save_map_file", save_map_file);
+  nh.getParam("save_map_period", save_map_period);
 
   ROS_INFO("num_particles %d", num_particles);
   ROS_INFO("num_samples_mode %d", num_samples_mode);
@@ -329,72 +269,60 @@ int main(int argc, char** argv)
   ROS_INFO("sample_range_x %.15f", sample_range_x);
   ROS_INFO("sample_range_y %.15f", sample_range_y);
 
-  ROS_INFO("scan_likelihood_min %f", scan_likelihood_min);
-  ROS_INFO("scan_likelihood_max %f", scan_likelihood_max);
+  ROS_INFO("correlative_matcher %d", correlative_matcher);
+  ROS_INFO("match_linear_window %f", match_linear_window);
+  ROS_INFO("match_angular_window %f", match_angular_window);
+  ROS_INFO("match_depth %d", match_depth);
+  ROS_INFO("match_min_score %f", match_min_score);
 
-  ROS_INFO("pose_likelihood_min %f", pose_likelihood_min);
-  ROS_INFO("pose_likelihood_max %f", pose_likelihood_max);
+  ROS_INFO("scan_filter %d", scan_filter);
+  ROS_INFO("filter_min_spacing %f", filter_min_spacing);
+  ROS_INFO("filter_max_angle_gap %f", filter_max_angle_gap);
+  ROS_INFO("filter_isolation_distance %f", filter_isolation_distance);
+  ROS_INFO("filter_max_beams %d", filter_max_beams);
 
-  ROS_INFO("map_min %f", map_min);
-  ROS_INFO("map_max %f", map_max);
-  ROS_INFO("map_resolution %f", map_resolution);
-
-  ROS_INFO("map_frame_id %s", map_frame_id.c_str());
-  ROS_INFO("odom_frame_id %s", odom_frame_id.c_str());
-  ROS_INFO("body_frame_id %s", body_frame_id.c_str());
-
-  ROS_INFO("left_wheel_joint %s", left_wheel_joint.c_str());
-  ROS_INFO("right_wheel_joint %s", right_wheel_joint.c_str());
-
-  ROS_INFO("wheel_base %f", wheel_base);
-  ROS_INFO("wheel_radius %f", wheel_radius);
+  ROS_INFO("load_map_file %s", load_map_file.c_str());
+  ROS_INFO("save_map_file %s", save_map_file.c_str());
+  ROS_INFO("save_map_period %f", save_map_period);
 
   ROS_INFO("Successfully launched RBPF SLAM node");
 
   /////////////////////////////////////////////////////////////////////////////
 
-  tf2_ros::TransformBroadcaster slam_broadcaster;
-  tf2_ros::TransformBroadcaster odom_broadcaster;
-
-  wheel_odom_flag = false;
-  scan_update = false;
-
-
-  // Assume pose starts at (0,0,0)
-  // for odometry
-  rigid2d::Pose pose;
-  pose.theta = 0;
-  pose.x = 0;
-  pose.y = 0;
-
-  // odometry poses for SLAM pose likelihood
-  rigid2d::Pose cur_odom;
-  rigid2d::Pose prev_odom;
-  cur_odom = prev_odom = pose;
+  // odometry, transforms, paths, and pose errors
+  SlamNodeInterface node(nh, node_handle, params, "slam");
+  rigid2d::OdometryEngine &odometry = node.odometry();
 
   // Assume pose starts at (0,0,0)
   // SLAM
   Transform2D robot_pose;
 
-
-  // diff drive model for odometry
-  rigid2d::DiffDrive drive(pose, wheel_base, wheel_radius);
-  // diff drive model for SLAM
-  rigid2d::DiffDrive pf_drive(pose, wheel_base, wheel_radius);
-
-
   /////////////////////////////////////////////////////////////////////////////
 
   // transform robot to lidar
   Transform2D Trs;
 
   // lidar properties
-  LaserProperties props(beam_min, beam_max, beam_delta, range_min, range_max,
-                              z_hit, z_short, z_max, z_rand, sigma_hit);
+  LaserProperties props = params.laserProperties();
 
   // grid mapping
   // set map as square
-  GridMapper grid(map_resolution, map_min, map_max, map_min, map_max, props, Trs);
+  GridMapper grid(params.map_resolution, params.map_min, params.map_max,
+                  params.map_min, params.map_max, props, Trs);
+
+  // warm start, every particle copies the saved map
+  if (!load_map_file.empty())
+  {
+    if (grid.loadMapFile(load_map_file))
+    {
+      ROS_INFO("Loaded map from %s", load_map_file.c_str());
+    }
+
+    else
+    {
+      ROS_WARN("Starting from an empty map, could not load %s", load_map_file.c_str());
+    }
+  }
 
   // pcl ICP
   ScanAlignment aligner(props, Trs);
@@ -405,264 +333,268 @@ int main(int argc, char** argv)
                     srr, srt, str, stt,
                     motion_noise_theta, motion_noise_x, motion_noise_y,
                     sample_range_theta, sample_range_x, sample_range_y,
-                    scan_likelihood_min, scan_likelihood_max,
-                    pose_likelihood_min, pose_likelihood_max,
                     aligner, robot_pose, grid);
 
+  // correlative scan matcher
+  if (correlative_matcher)
+  {
+    pf.useCorrelativeMatcher(CorrelativeScanMatcher(match_linear_window, match_angular_window,
+                                                    match_depth, match_min_score));
+  }
 
-  // path from odometry
-  nav_msgs::Path odom_path;
-
-  // path from SLAM
-  nav_msgs::Path pf_path;
-
-  // path from gazebo
-  nav_msgs::Path gazebo_path;
+  // scan preprocessing shared by ICP and the particles
+  if (scan_filter)
+  {
+    pf.useScanFilter(ScanFilter(props, filter_min_spacing, filter_max_angle_gap,
+                                filter_isolation_distance,
+                                static_cast<unsigned int>(std::max(filter_max_beams, 0))));
+  }
 
-  // error in pose
-  tsim::PoseError odom_error_msg;
-  tsim::PoseError slam_error_msg;
 
   /////////////////////////////////////////////////////////////////////////////
 
-  // the map
-  std::vector<int8_t> map;
+  const auto origin = grid.viewOrigin();
 
-  geometry_msgs::Pose map_pose;
-  map_pose.position.x = map_min;
-  map_pose.position.y = map_min;
-  map_pose.position.z = 0;
-  map_pose.orientation.x = 0;
-  map_pose.orientation.y = 0;
-  map_pose.orientation.z = 0;
-  map_pose.orientation.w = 1;
+  nav_msgs::OccupancyGrid map_msg;
+  map_msg.header.frame_id = params.map_frame_id;
+  map_msg.info.resolution = params.map_resolution;
+  map_msg.info.width = grid.viewWidth();
+  map_msg.info.height = grid.viewHeight();
 
+  map_msg.info.origin.position.x = origin.x;
+  map_msg.info.origin.position.y = origin.y;
+  map_msg.info.origin.orientation.w = 1.0;
 
-  nav_msgs::OccupancyGrid map_msg;
-  map_msg.header.frame_id = map_frame_id;
-  map_msg.info.resolution = map_resolution;
-  map_msg.info.width = static_cast<int> ((map_max - map_min) / map_resolution);
-  map_msg.info.height = static_cast<int> ((map_max - map_min) / map_resolution);;
+  // tiles changed since the map or its updates were last published
+  DirtyTiles map_dirty(map_msg.info.width, map_msg.info.height, 32);
 
-  map_msg.info.origin = map_pose;
+  // publish the full map on the next update
+  bool map_reset = false;
 
   /////////////////////////////////////////////////////////////////////////////
 
-  while(node_handle.ok())
+  // writes the best map without holding up SLAM, outlives the worker
+  std::unique_ptr<MapWriter> map_writer;
+  if (!save_map_file.empty())
   {
-    ros::spinOnce();
+    map_writer.reset(new MapWriter(save_map_file));
+  }
 
-    /////////////////////////////////////////////////////////////////////////////
-    if (wheel_odom_flag)
-    {
-      // most recent odom update
-      drive.updateOdometry(left, right);
-      pose = drive.pose();
+  /////////////////////////////////////////////////////////////////////////////
 
-      pf_left = left;
-      pf_right = right;
+  // latest scan for the SLAM worker, unprocessed scans are dropped
+  Mailbox<ScanUpdate> &scan_mailbox = node.scans();
 
-      // update ekf with odometry and sensor measurements
-      if (scan_update)
-      {
-        // do the slam
-        pf_drive.updateOdometry(pf_left, pf_right);
-        cur_odom = pf_drive.pose();
-        rigid2d::WheelVelocities vel = pf_drive.wheelVelocities();
-        rigid2d::Twist2D vb = pf_drive.wheelsToTwist(vel);
+  // latest SLAM result for publishing
+  Mailbox<SlamUpdate> slam_mailbox;
 
-        pf.SLAM(scan, vb, cur_odom, prev_odom);
+  // the particle filter runs on its own thread so the
+  // odometry and transforms are not delayed by the update
+  std::thread slam_worker([&]()
+  {
+    // odometry at the last processed scan
+    rigid2d::Pose prev_odom = odometry.pose();
+    auto prev_stamp = 0.0;
 
-        map_msg.header.stamp = ros::Time::now();
-        map_msg.info.map_load_time = ros::Time::now();
-        map_msg.data = map;
-        pf.newMap(map);
+    // revision and window of the map handed to the ROS thread
+    unsigned long map_revision = 0;
+    unsigned int map_width = 0, map_height = 0;
+    Vector2D map_origin;
+    std::vector<MapRegion> regions;
 
-        prev_odom = cur_odom;
+    // time the best map was last handed to the writer
+    auto saved_stamp = std::chrono::steady_clock::now();
 
-        scan_update = false;
+    while(ros::ok())
+    {
+      std::unique_ptr<ScanUpdate> update = scan_mailbox.waitTake(std::chrono::milliseconds(100));
+      if (!update)
+      {
+        continue;
       }
 
-      wheel_odom_flag = false;
-    }
-
-    /////////////////////////////////////////////////////////////////////////////
-
-    // braodcast transform from map to odom
-    // transform from map to robot
-    // Transform2D Tmr = robot_pose;
-    Transform2D Tmr = pf.getRobotState();;
-
-
-    // transform from odom to robot
-    Vector2D vor(pose.x, pose.y);
-    Transform2D Tor(vor, pose.theta);
-
-    // transform from robot to odom
-    Transform2D Tro = Tor.inv();
-
-    // now we can get transform from map to odom
-    Transform2D Tmo = Tmr *  Tro;
-    TransformData2D pose_map_odom = Tmo.displacement();
-
-
-    tf2::Quaternion q_mo;
-    q_mo.setRPY(0, 0, pose_map_odom.theta);
-    geometry_msgs::Quaternion quat_mo;
-    quat_mo = tf2::toMsg(q_mo);
-
-
-    // broadcast transform between map and odom
-    geometry_msgs::TransformStamped tf_mo;
-    tf_mo.header.stamp = ros::Time::now();
-    tf_mo.header.frame_id = map_frame_id;
-    tf_mo.child_frame_id = odom_frame_id;
-
-    tf_mo.transform.translation.x = pose_map_odom.x;
-    tf_mo.transform.translation.y = pose_map_odom.y;
-    tf_mo.transform.translation.z = 0.0;
-    tf_mo.transform.rotation = quat_mo;
-
-    slam_broadcaster.sendTransform(tf_mo);
-
-    /////////////////////////////////////////////////////////////////////////////
-
-    // broadcast transform from odom to base_link
-    // publish twist in odom message
-    rigid2d::WheelVelocities vel = drive.wheelVelocities();
-    rigid2d::Twist2D vb = drive.wheelsToTwist(vel);
-
-
-    // convert yaw to Quaternion
-    tf2::Quaternion q;
-    q.setRPY(0, 0, pose.theta);
-    geometry_msgs::Quaternion odom_quat;
-    odom_quat = tf2::toMsg(q);
-
-
-    // broadcast transform between odom and body
-    geometry_msgs::TransformStamped odom_tf;
-    odom_tf.header.stamp = ros::Time::now();
-    odom_tf.header.frame_id = odom_frame_id;
-    odom_tf.child_frame_id = body_frame_id;
-
-    odom_tf.transform.translation.x = pose.x;
-    odom_tf.transform.translation.y = pose.y;
-    odom_tf.transform.translation.z = 0.0;
-    odom_tf.transform.rotation = odom_quat;
-
-    odom_broadcaster.sendTransform(odom_tf);
-
-
-    // publish odom message over ros
-    nav_msgs::Odometry odom;
-    odom.header.stamp = ros::Time::now();
-    odom.header.frame_id = odom_frame_id;
-    odom.child_frame_id = body_frame_id;
-
-
-    // pose in odom frame
-    odom.pose.pose.position.x = pose.x;
-    odom.pose.pose.position.y = pose.y;
-    odom.pose.pose.position.z = 0.0;
-    odom.pose.pose.orientation = odom_quat;
-
-    // velocity in body frame
-    odom.twist.twist.linear.x = vb.vx;
-    odom.twist.twist.linear.y = 0.0;
-    odom.twist.twist.angular.z = vb.w;
-
-    odom_pub.publish(odom);
+      // odometry is looked up here, measured from the last processed
+      // scan so the motion of the scans dropped in between is not lost
+      const auto u = odometry.twistBetween(prev_stamp, update->stamp);
+      const auto odom = odometry.poseAt(update->stamp);
+
+      pf.SLAM(update->scan, u, odom, prev_odom);
+      prev_odom = odom;
+      prev_stamp = update->stamp;
+
+      std::unique_ptr<SlamUpdate> result(new SlamUpdate);
+      result->Tmr = pf.getRobotState();
+
+      // only send the cells that changed if the best map was built from
+      // the one already sent, resampling may switch to another lineage.
+      // The window grows when the robot maps beyond it.
+      const GridMapper &best = pf.bestMap();
+      const auto origin = best.viewOrigin();
+      const auto resized = best.viewWidth() != map_width or best.viewHeight() != map_height or
+                           !rigid2d::almost_equal(origin.x, map_origin.x) or
+                           !rigid2d::almost_equal(origin.y, map_origin.y);
+      if (!resized and best.parentRevision() == map_revision)
+      {
+        best.dirtyRegions(regions);
+        for(const auto &region : regions)
+        {
+          MapPatch patch;
+          patch.region = region;
+          best.regionData(region, patch.data);
+          result->patches.push_back(std::move(patch));
+        }
+      }
 
+      else if (resized or best.revision() != map_revision)
+      {
+        result->full_map = true;
+        best.gridMap(result->map);
+        result->width = map_width = best.viewWidth();
+        result->height = map_height = best.viewHeight();
+        result->origin = map_origin = origin;
+      }
+      map_revision = best.revision();
 
-    /////////////////////////////////////////////////////////////////////////////
+      // the patches are relative to the previous result so
+      // an unread result has to be merged and not dropped
+      std::unique_ptr<SlamUpdate> unread = slam_mailbox.take();
+      if (unread)
+      {
+        mergeSlamUpdates(*unread, *result);
+      }
 
-    // path from SLAM
-    geometry_msgs::PoseStamped slam_pose;
-    TransformData2D pose_map_robot = Tmr.displacement();
+      slam_mailbox.post(std::move(result));
 
-    tf2::Quaternion q_mr;
-    q_mr.setRPY(0, 0, pose_map_robot.theta);
-    geometry_msgs::Quaternion quat_mr;
-    quat_mr = tf2::toMsg(q_mr);
+      if (map_writer and save_map_period > 0.0 and
+          std::chrono::steady_clock::now() - saved_stamp > std::chrono::duration<double>(save_map_period))
+      {
+        map_writer->save(best);
+        saved_stamp = std::chrono::steady_clock::now();
+      }
+    }
 
-    slam_pose.header.stamp = ros::Time::now();
-    slam_pose.pose.position.x = pose_map_robot.x;
-    slam_pose.pose.position.y = pose_map_robot.y;
-    slam_pose.pose.orientation = quat_mr;
+    // written before the writer stops
+    if (map_writer)
+    {
+      map_writer->save(pf.bestMap());
+    }
+  });
 
-    pf_path.header.stamp = ros::Time::now();
-    pf_path.header.frame_id = map_frame_id;
-    pf_path.poses.push_back(slam_pose);
+  /////////////////////////////////////////////////////////////////////////////
 
-    slam_path_pub.publish(pf_path);
+  // takes the newest SLAM result if there is one
+  auto updateSlamState = [&]()
+  {
+    std::unique_ptr<SlamUpdate> result = slam_mailbox.take();
+    if (result)
+    {
+      node.setMapToRobot(result->Tmr);
 
-    /////////////////////////////////////////////////////////////////////////////
+      if (result->full_map)
+      {
+        map_msg.header.stamp = ros::Time::now();
+        map_msg.info.map_load_time = ros::Time::now();
+        map_msg.data = std::move(result->map);
+        map_reset = true;
+
+        if (map_msg.info.width != result->width or map_msg.info.height != result->height)
+        {
+          map_msg.info.width = result->width;
+          map_msg.info.height = result->height;
+          map_dirty = DirtyTiles(result->width, result->height, 32);
+        }
+        map_msg.info.origin.position.x = result->origin.x;
+        map_msg.info.origin.position.y = result->origin.y;
+      }
 
-    // path from odom
-    geometry_msgs::PoseStamped odom_pose;
+      // patches only arrive after a full map
+      for(const auto &patch : result->patches)
+      {
+        bmapping::pasteRegion(map_msg.data, map_msg.info.width, patch.region, patch.data);
+        map_dirty.markRegion(patch.region);
+      }
+    }
+  };
 
-    tf2::Quaternion q_or;
-    q_or.setRPY(0, 0, pose.theta);
-    geometry_msgs::Quaternion quat_or;
-    quat_or = tf2::toMsg(q_or);
+  // the transforms are broadcast from the newest result
+  node.onJointStates(updateSlamState);
 
-    odom_pose.header.stamp = ros::Time::now();
-    odom_pose.pose.position.x = pose.x;
-    odom_pose.pose.position.y = pose.y;
-    odom_pose.pose.orientation = quat_or;
 
-    odom_path.header.stamp = ros::Time::now();
-    odom_path.header.frame_id = map_frame_id;
-    odom_path.poses.push_back(odom_pose);
+  // publish the full map
+  auto publishMap = [&]()
+  {
+    if (map_msg.data.empty())
+    {
+      return;
+    }
 
-    odom_path_pub.publish(odom_path);
+    map_msg.header.stamp = ros::Time::now();
+    map_pub.publish(map_msg);
 
-    /////////////////////////////////////////////////////////////////////////////
+    map_dirty.clear();
+    map_reset = false;
+  };
 
-    // path from gazebo
-    gazebo_path.header.stamp = ros::Time::now();
-    gazebo_path.header.frame_id = map_frame_id;
-    gazebo_path.poses.push_back(gazebo_robot_pose);
 
-    gazebo_path_pub.publish(gazebo_path);
+  // publish the regions of the map that changed
+  auto publishMapUpdates = [&]()
+  {
+    std::vector<MapRegion> regions;
+    map_dirty.regions(regions);
 
-    /////////////////////////////////////////////////////////////////////////////
+    for(const auto &region : regions)
+    {
+      map_msgs::OccupancyGridUpdate update_msg;
+      update_msg.header.stamp = ros::Time::now();
+      update_msg.header.frame_id = params.map_frame_id;
+      update_msg.x = region.x;
+      update_msg.y = region.y;
+      update_msg.width = region.width;
+      update_msg.height = region.height;
+      bmapping::copyRegion(map_msg.data, map_msg.info.width, region, update_msg.data);
+
+      map_update_pub.publish(update_msg);
+    }
 
-    // publish the map
-    map_pub.publish(map_msg);
+    map_dirty.clear();
+  };
 
-    /////////////////////////////////////////////////////////////////////////////
 
-    // ground truth robot heading
-    tf2::Quaternion gazebo_robot_quat(gazebo_robot_pose.pose.orientation.x,
-                               gazebo_robot_pose.pose.orientation.y,
-                               gazebo_robot_pose.pose.orientation.z,
-                               gazebo_robot_pose.pose.orientation.w);
+  // publish paths, map, and pose errors at a fixed rate
+  auto publishCallback = [&](const ros::TimerEvent &)
+  {
+    updateSlamState();
+    node.publish(ros::Time::now());
 
-    tf2::Matrix3x3 mat(gazebo_robot_quat);
-    auto roll = 0.0, pitch = 0.0 , yaw = 0.0;
-    mat.getRPY(roll, pitch, yaw);
+    // publish the map, only the changes unless the best particle's map was replaced
+    if (map_reset)
+    {
+      publishMap();
+    }
 
+    else
+    {
+      publishMapUpdates();
+    }
+  };
 
-    // odometry error
-    odom_error_msg.x_error = gazebo_robot_pose.pose.position.x - pose.x;
-    odom_error_msg.y_error = gazebo_robot_pose.pose.position.y - pose.y;
+  /////////////////////////////////////////////////////////////////////////////
 
-    odom_error_msg.theta_error = normalize_angle_PI(normalize_angle_PI(yaw) - \
-                                                     normalize_angle_PI(pose.theta));
+  ros::Timer publish_timer = node_handle.createTimer(ros::Duration(1.0 / params.publish_frequency), publishCallback);
 
-    // slam error
-    TransformData2D Trd_mr = Tmr.displacement();
+  // the full map for subscribers that missed the updates
+  ros::Timer map_timer = node_handle.createTimer(ros::Duration(1.0 / params.map_publish_frequency),
+                                                 [&](const ros::TimerEvent &) { publishMap(); });
 
-    slam_error_msg.x_error = gazebo_robot_pose.pose.position.x - Trd_mr.x;
-    slam_error_msg.y_error = gazebo_robot_pose.pose.position.y - Trd_mr.y;
+  // callbacks only run when a message or timer event arrives
+  ros::spin();
 
-    slam_error_msg.theta_error = normalize_angle_PI(normalize_angle_PI(yaw) - \
-                                                     normalize_angle_PI(Trd_mr.theta));
+  slam_worker.join();
 
-    odom_error_pub.publish(odom_error_msg);
-    slam_error_pub.publish(slam_error_msg);
+  // the destructor writes the final map
+  if (map_writer)
+  {
+    map_writer.reset();
   }
 
   return 0;
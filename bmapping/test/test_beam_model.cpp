@@ -0,0 +1,182 @@
+/// \file
+/// \brief unit tests for the beam model
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <rigid2d/batch_transform.hpp>
+#include "bmapping/beam_model.hpp"
+#include "bmapping/grid_mapper.hpp"
+
+using bmapping::BeamModel;
+using bmapping::GridMapper;
+using bmapping::LaserProperties;
+using rigid2d::Transform2D;
+using rigid2d::Vector2D;
+using Eigen::Vector3d;
+
+
+/// \brief Room with walls around the border and two boxes so no two poses
+///        see the same scan
+/// \return the grid
+static GridMapper roomGrid()
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.8, 0.1, 0.05, 0.05, 0.1);
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+
+  const auto w = grid.viewWidth();
+  const auto h = grid.viewHeight();
+  std::vector<int8_t> map(w * h, 0);
+  for(unsigned int j = 0; j < h; j++)
+  {
+    for(unsigned int i = 0; i < w; i++)
+    {
+      const auto border = i < 2 or j < 2 or i >= w - 2 or j >= h - 2;
+      const auto box = i >= 50 and i < 60 and j >= 10 and j < 30;
+      const auto post = i >= 15 and i < 19 and j >= 55 and j < 59;
+      if (border or box or post)
+      {
+        map.at(j * w + i) = 100;
+      }
+    }
+  }
+
+  grid.loadMap(map);
+  return grid;
+}
+
+
+/// \brief Ray casts a scan in the grid
+/// \param grid - map and laser properties
+/// \param pose - pose of the scanner (theta, x, y), at the center of a cell
+/// \return ranges
+static std::vector<float> castScan(const GridMapper &grid, const Vector3d &pose)
+{
+  const auto angles = rigid2d::beamAngles(0.0, 6.28, 0.0174);
+  const auto gc = grid.world2Grid(pose(1), pose(2));
+
+  std::vector<float> scan;
+  for(const auto angle : angles)
+  {
+    scan.push_back(static_cast<float>(grid.castRay(gc, pose(0) + angle, grid.rangeMax())));
+  }
+
+  return scan;
+}
+
+
+/// \brief Tests the range table matches casting the rays and is reused
+TEST(BeamModelTest, RangeTable)
+{
+  const auto grid = roomGrid();
+  BeamModel model(grid, 360, 0.1);
+  ASSERT_EQ(model.cachedCells(), 0u);
+
+  const auto gc = grid.world2Grid(0.1, -0.3);
+  const auto step = 2.0 * rigid2d::PI / 360;
+  for(int a = 0; a < 360; a++)
+  {
+    ASSERT_NEAR(model.expectedRange(gc, a * step), grid.castRay(gc, a * step, grid.rangeMax()), 1e-3);
+  }
+  ASSERT_EQ(model.cachedCells(), 1u);
+
+  // the directions wrap around
+  ASSERT_DOUBLE_EQ(model.expectedRange(gc, -step), model.expectedRange(gc, 359 * step));
+  ASSERT_EQ(model.cachedCells(), 1u);
+
+  ASSERT_NEAR(model.expectedRange(grid.world2Grid(-1.0, 1.0), 0.0),
+              grid.castRay(grid.world2Grid(-1.0, 1.0), 0.0, grid.rangeMax()), 1e-3);
+  ASSERT_EQ(model.cachedCells(), 2u);
+}
+
+
+/// \brief Tests the range table is refilled when the map changes
+TEST(BeamModelTest, MapRevision)
+{
+  auto grid = roomGrid();
+  BeamModel model(grid, 360, 0.1);
+
+  // the wall at x = 1.9 is in front of the scanner
+  const auto gc = grid.world2Grid(0.0, 0.0);
+  const auto before = model.expectedRange(gc, 0.0);
+  ASSERT_NEAR(before, 1.9, 0.1);
+
+  std::vector<int8_t> map;
+  grid.gridMap(map);
+  const auto w = grid.viewWidth();
+  const auto wall = grid.world2Grid(1.0, 0.0);
+  map.at(wall.j * w + wall.i) = 100;
+  grid.loadMap(map);
+
+  const auto after = model.expectedRange(gc, 0.0);
+  ASSERT_NEAR(after, 1.0, 0.1);
+  ASSERT_EQ(model.cachedCells(), 1u);
+}
+
+
+/// \brief Tests the scan is most likely from the pose it was taken at
+TEST(BeamModelTest, LikelihoodPeak)
+{
+  const auto grid = roomGrid();
+  BeamModel model(grid, 360, 0.1);
+
+  const auto center = grid.grid2World(45, 38);
+  const auto scan = castScan(grid, Vector3d(0.0, center.x, center.y));
+  const auto best = model.logLikelihood(scan, Transform2D(center, 0.0));
+
+  ASSERT_LT(model.logLikelihood(scan, Transform2D(center + Vector2D(0.1, 0.0), 0.0)), best);
+  ASSERT_LT(model.logLikelihood(scan, Transform2D(center + Vector2D(0.0, -0.1), 0.0)), best);
+  ASSERT_LT(model.logLikelihood(scan, Transform2D(center, 0.1)), best);
+
+  // every step-th beam is scored
+  const auto half = model.logLikelihood(scan, Transform2D(center, 0.0), 2);
+  ASSERT_NEAR(half, 0.5 * best, 0.1 * std::fabs(best));
+}
+
+
+/// \brief Tests max range and missing readings score the max range component
+TEST(BeamModelTest, MaxRange)
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.8, 0.1, 0.05, 0.05, 0.1);
+  const GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  BeamModel model(grid, 360, 0.1);
+
+  // nothing is hit in an empty map
+  const auto max_range = model.logLikelihood(std::vector<float>(361, 3.5), Transform2D());
+  const auto beyond = model.logLikelihood(std::vector<float>(361, 10.0), Transform2D());
+  const auto inf = model.logLikelihood(std::vector<float>(361, std::numeric_limits<float>::infinity()),
+                                       Transform2D());
+  const auto nan = model.logLikelihood(std::vector<float>(361, std::numeric_limits<float>::quiet_NaN()),
+                                       Transform2D());
+  ASSERT_DOUBLE_EQ(beyond, max_range);
+  ASSERT_DOUBLE_EQ(inf, max_range);
+  ASSERT_DOUBLE_EQ(nan, max_range);
+
+  // a reading short of the max range is only random
+  const auto random = model.logLikelihood(std::vector<float>(361, 1.0), Transform2D());
+  ASSERT_LT(random, max_range);
+  ASSERT_TRUE(std::isfinite(random));
+
+  // readings below the min range carry no information
+  ASSERT_DOUBLE_EQ(model.logLikelihood(std::vector<float>(361, 0.05), Transform2D()), 0.0);
+}
+
+
+/// \brief Tests invalid parameters throw
+TEST(BeamModelTest, InvalidArguments)
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.8, 0.1, 0.05, 0.05, 0.1);
+  const GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  ASSERT_THROW(BeamModel(grid, 0, 0.1), std::invalid_argument);
+  ASSERT_THROW(BeamModel(grid, 360, 0.0), std::invalid_argument);
+
+  LaserProperties exact(0.0, 6.28, 0.0174, 0.12, 3.5, 0.8, 0.1, 0.05, 0.05, 0.0);
+  const GridMapper exact_grid(0.05, -2.0, 2.0, -2.0, 2.0, exact, Transform2D());
+  ASSERT_THROW(BeamModel(exact_grid, 360, 0.1), std::invalid_argument);
+}
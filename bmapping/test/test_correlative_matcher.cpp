@@ -0,0 +1,126 @@
+/// \file
+/// \brief unit tests for the correlative scan matcher
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <rigid2d/batch_transform.hpp>
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/correlative_matcher.hpp"
+
+using bmapping::CorrelativeScanMatcher;
+using bmapping::GridMapper;
+using bmapping::LaserProperties;
+using bmapping::ScanMatch;
+using rigid2d::Transform2D;
+using rigid2d::Vector2D;
+using Eigen::Vector3d;
+
+
+/// \brief Room with walls around the border and two boxes so no two poses
+///        see the same scan
+/// \return the grid
+static GridMapper roomGrid()
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.1);
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+
+  const auto w = grid.viewWidth();
+  const auto h = grid.viewHeight();
+  std::vector<int8_t> map(w * h, 0);
+  for(unsigned int j = 0; j < h; j++)
+  {
+    for(unsigned int i = 0; i < w; i++)
+    {
+      const auto border = i < 2 or j < 2 or i >= w - 2 or j >= h - 2;
+      const auto box = i >= 50 and i < 60 and j >= 10 and j < 30;
+      const auto post = i >= 15 and i < 19 and j >= 55 and j < 59;
+      if (border or box or post)
+      {
+        map.at(j * w + i) = 100;
+      }
+    }
+  }
+
+  grid.loadMap(map);
+  return grid;
+}
+
+
+/// \brief Ray casts a scan in the grid
+/// \param grid - map and laser properties
+/// \param pose - pose of the scanner (theta, x, y), at the center of a cell
+/// \return ranges
+static std::vector<float> castScan(const GridMapper &grid, const Vector3d &pose)
+{
+  const auto angles = rigid2d::beamAngles(0.0, 6.28, 0.0174);
+  const auto gc = grid.world2Grid(pose(1), pose(2));
+
+  std::vector<float> scan;
+  for(const auto angle : angles)
+  {
+    scan.push_back(static_cast<float>(grid.castRay(gc, pose(0) + angle, grid.rangeMax())));
+  }
+
+  return scan;
+}
+
+
+/// \brief Tests the pose of a scan is found from a guess off by a few cells
+TEST(CorrelativeMatcherTest, RecoversOffset)
+{
+  const auto grid = roomGrid();
+
+  // center of a cell
+  const auto center = grid.grid2World(45, 38);
+  const Vector3d truth(0.3, center.x, center.y);
+  const auto scan = castScan(grid, truth);
+
+  CorrelativeScanMatcher matcher(0.2, 0.2, 3, -3.0);
+  const Vector3d guess = truth + Vector3d(-0.08, 0.12, -0.09);
+
+  ScanMatch match;
+  ASSERT_TRUE(matcher.match(grid, scan, guess, match));
+  ASSERT_NEAR(match.pose(0), truth(0), 0.02);
+  ASSERT_NEAR(match.pose(1), truth(1), grid.resolution());
+  ASSERT_NEAR(match.pose(2), truth(2), grid.resolution());
+
+  // the covariance is positive definite
+  const Eigen::LLT<Eigen::Matrix3d> llt(match.covariance);
+  ASSERT_EQ(llt.info(), Eigen::Success);
+}
+
+
+/// \brief Tests a pose outside the window is not reached
+TEST(CorrelativeMatcherTest, WindowLimitsSearch)
+{
+  const auto grid = roomGrid();
+
+  const auto center = grid.grid2World(45, 38);
+  const Vector3d truth(0.3, center.x, center.y);
+  const auto scan = castScan(grid, truth);
+
+  CorrelativeScanMatcher matcher(0.1, 0.1, 3, -100.0);
+  const Vector3d guess = truth + Vector3d(0.0, 0.3, 0.0);
+
+  ScanMatch match;
+  ASSERT_TRUE(matcher.match(grid, scan, guess, match));
+  ASSERT_LE(std::fabs(match.pose(1) - guess(1)), 0.1 + 1e-9);
+  ASSERT_LE(std::fabs(match.pose(2) - guess(2)), 0.1 + 1e-9);
+}
+
+
+/// \brief Tests an empty map gives no match
+TEST(CorrelativeMatcherTest, EmptyMap)
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.1);
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+
+  CorrelativeScanMatcher matcher;
+  const std::vector<float> scan(361, 1.0);
+
+  ScanMatch match;
+  ASSERT_FALSE(matcher.match(grid, scan, Vector3d::Zero(), match));
+}
@@ -0,0 +1,92 @@
+/// \file
+/// \brief unit tests for the occupancy grid
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bmapping/grid_mapper.hpp"
+
+using bmapping::GridMapper;
+using bmapping::LaserProperties;
+using bmapping::MapRegion;
+using rigid2d::Transform2D;
+using rigid2d::Vector2D;
+
+
+/// \brief Tests the rviz map grows to cover cells mapped beyond its bounds
+TEST(GridMapperTest, ViewGrows)
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.5);
+  GridMapper grid(0.05, -1.0, 1.0, -1.0, 1.0, props, Transform2D());
+  ASSERT_EQ(grid.viewWidth(), 40u);
+  ASSERT_EQ(grid.viewHeight(), 40u);
+
+  // a circular wall 3 m away, outside the bounds
+  const std::vector<float> scan(361, 3.0);
+  grid.integrateScan(scan, Transform2D());
+
+  const auto origin = grid.viewOrigin();
+  const auto width = grid.viewWidth();
+  const auto height = grid.viewHeight();
+  ASSERT_LT(origin.x, -3.0);
+  ASSERT_LT(origin.y, -3.0);
+  ASSERT_GT(origin.x + width * grid.resolution(), 3.0);
+  ASSERT_GT(origin.y + height * grid.resolution(), 3.0);
+
+  std::vector<int8_t> map;
+  grid.gridMap(map);
+  ASSERT_EQ(map.size(), width * height);
+
+  // the wall is in the rviz map where the window puts it
+  const auto gc = grid.world2Grid(3.02, 0.0);
+  const auto view = grid.world2Grid(origin.x + 0.5 * grid.resolution(), origin.y + 0.5 * grid.resolution());
+  ASSERT_EQ(map.at((gc.j - view.j) * width + (gc.i - view.i)), 100);
+
+  // the whole map is changed when the window moves
+  std::vector<MapRegion> regions;
+  grid.dirtyRegions(regions);
+  unsigned int cells = 0;
+  for(const auto &region : regions)
+  {
+    cells += region.width * region.height;
+  }
+  ASSERT_EQ(cells, width * height);
+
+  // the window stays once it covers the mapped cells
+  grid.integrateScan(scan, Transform2D(Vector2D(0.1, 0.0)));
+  ASSERT_EQ(grid.viewWidth(), width);
+  ASSERT_EQ(grid.viewHeight(), height);
+}
+
+
+/// \brief Tests log weights too small to exponentiate are normalized
+TEST(GridMapperTest, NormalizeLogWeights)
+{
+  // the weights underflow if exponentiated directly
+  std::vector<double> weights = {-1e4, -1e4 - 1.0, -1e4 - 2.0, -1e4 - 50.0};
+  ASSERT_EQ(std::exp(weights.at(0)), 0.0);
+
+  const auto log_sum = bmapping::normalizeLogWeights(weights);
+  const auto sum_rel = 1.0 + std::exp(-1.0) + std::exp(-2.0) + std::exp(-50.0);
+  ASSERT_NEAR(log_sum, -1e4 + std::log(sum_rel), 1e-9);
+
+  auto sum = 0.0;
+  for(const auto w : weights)
+  {
+    ASSERT_FALSE(std::isnan(w));
+    ASSERT_GE(w, 0.0);
+    sum += w;
+  }
+  ASSERT_NEAR(sum, 1.0, 1e-12);
+
+  // the ratios of the weights are kept
+  ASSERT_NEAR(weights.at(0), 1.0 / sum_rel, 1e-12);
+  ASSERT_NEAR(weights.at(0) / weights.at(1), std::exp(1.0), 1e-9);
+  ASSERT_GT(weights.at(3), 0.0);
+
+  std::vector<double> empty;
+  ASSERT_EQ(bmapping::normalizeLogWeights(empty), -std::numeric_limits<double>::infinity());
+}
@@ -0,0 +1,181 @@
+/// \file
+/// \brief unit tests for map files
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <rigid2d/logging.hpp>
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/map_file.hpp"
+
+using bmapping::GridMapper;
+using bmapping::LaserProperties;
+using bmapping::MapFileHeader;
+using rigid2d::Transform2D;
+
+
+static const std::string map_filename = "/tmp/bmapping_test_map_file.bmap";
+
+
+/// \brief Grid with walls every 20 cells
+/// \return the grid
+static GridMapper wallGrid()
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.5);
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+
+  const auto w = grid.viewWidth();
+  const auto h = grid.viewHeight();
+  std::vector<int8_t> map(w * h, 0);
+  for(unsigned int j = 0; j < h; j++)
+  {
+    for(unsigned int i = 0; i < w; i++)
+    {
+      if (i % 20 == 0 or j % 20 == 0)
+      {
+        map.at(j * w + i) = 100;
+      }
+    }
+  }
+
+  grid.loadMap(map);
+  return grid;
+}
+
+
+/// \brief Reads a whole file
+/// \param filename - file to read
+/// \return contents
+static std::vector<char> readFile(const std::string &filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+/// \brief Replaces a file
+/// \param filename - file to write
+/// \param bytes - contents
+static void writeFile(const std::string &filename, const std::vector<char> &bytes)
+{
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), bytes.size());
+}
+
+
+/// \brief Loads a map file into an empty grid and checks it fails
+///        without changing the grid
+/// \param event - error logged
+static void expectLoadFails(const std::string &event)
+{
+  std::vector<std::string> messages;
+  rigid2d::setLogSink([&messages](rigid2d::LogLevel, const std::string &msg)
+  {
+    messages.push_back(msg);
+  });
+
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.5);
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  std::vector<int8_t> before, after;
+  grid.gridMap(before);
+
+  const auto loaded = grid.loadMapFile(map_filename);
+  rigid2d::setLogSink(rigid2d::LogSink());
+
+  ASSERT_FALSE(loaded);
+  grid.gridMap(after);
+  ASSERT_EQ(after, before);
+
+  ASSERT_EQ(messages.size(), 1u);
+  ASSERT_EQ(messages.at(0).find(event), 0u);
+}
+
+
+/// \brief Tests a saved map loads with the same cells and distance field
+TEST(MapFileTest, RoundTrip)
+{
+  const auto grid = wallGrid();
+  ASSERT_TRUE(grid.saveMapFile(map_filename));
+
+  // the temporary file was renamed
+  ASSERT_FALSE(std::ifstream(map_filename + ".tmp").good());
+
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.5);
+  GridMapper loaded(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  ASSERT_TRUE(loaded.loadMapFile(map_filename));
+
+  std::vector<int8_t> expected, actual;
+  grid.gridMap(expected);
+  loaded.gridMap(actual);
+  ASSERT_EQ(actual, expected);
+
+  for(auto y = -1.97; y < 2.0; y += 0.37)
+  {
+    for(auto x = -1.99; x < 2.0; x += 0.41)
+    {
+      ASSERT_EQ(loaded.beamLogLikelihood(x, y), grid.beamLogLikelihood(x, y));
+    }
+  }
+
+  std::remove(map_filename.c_str());
+}
+
+
+/// \brief Tests a changed cell is found by the block checksum
+TEST(MapFileTest, ChecksumMismatch)
+{
+  ASSERT_TRUE(wallGrid().saveMapFile(map_filename));
+
+  auto bytes = readFile(map_filename);
+  bytes.at(bytes.size() - 100) ^= 0x10;
+  writeFile(map_filename, bytes);
+
+  expectLoadFails("map_file.corrupt");
+  std::remove(map_filename.c_str());
+}
+
+
+/// \brief Tests a file cut short is rejected
+TEST(MapFileTest, Truncated)
+{
+  ASSERT_TRUE(wallGrid().saveMapFile(map_filename));
+
+  auto bytes = readFile(map_filename);
+  bytes.resize(bytes.size() - 4096);
+  writeFile(map_filename, bytes);
+
+  expectLoadFails("map_file.truncated");
+
+  // shorter than the header
+  bytes.resize(sizeof(MapFileHeader) / 2);
+  writeFile(map_filename, bytes);
+
+  expectLoadFails("map_file.not_a_map");
+  std::remove(map_filename.c_str());
+}
+
+
+/// \brief Tests a file of another version is rejected even with a valid checksum
+TEST(MapFileTest, BadVersion)
+{
+  ASSERT_TRUE(wallGrid().saveMapFile(map_filename));
+
+  auto bytes = readFile(map_filename);
+  MapFileHeader header;
+  std::copy(bytes.begin(), bytes.begin() + sizeof(header), reinterpret_cast<char *>(&header));
+  header.version = bmapping::map_file_version + 1;
+  header.header_checksum = bmapping::mapChecksum(&header, offsetof(MapFileHeader, header_checksum));
+  std::copy(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header) + sizeof(header),
+            bytes.begin());
+  writeFile(map_filename, bytes);
+
+  expectLoadFails("map_file.not_a_map");
+  std::remove(map_filename.c_str());
+}
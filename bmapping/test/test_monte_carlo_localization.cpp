@@ -0,0 +1,198 @@
+/// \file
+/// \brief unit tests for Monte Carlo localization
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <rigid2d/batch_transform.hpp>
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/monte_carlo_localization.hpp"
+
+using bmapping::GridMapper;
+using bmapping::LaserProperties;
+using bmapping::MonteCarloLocalization;
+using rigid2d::Pose;
+using rigid2d::Transform2D;
+using Eigen::Matrix3d;
+using Eigen::Vector3d;
+
+
+/// \brief Room with walls around the border and two boxes so no two poses
+///        see the same scan
+/// \return the grid
+static GridMapper roomGrid()
+{
+  LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.1);
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+
+  const auto w = grid.viewWidth();
+  const auto h = grid.viewHeight();
+  std::vector<int8_t> map(w * h, 0);
+  for(unsigned int j = 0; j < h; j++)
+  {
+    for(unsigned int i = 0; i < w; i++)
+    {
+      const auto border = i < 2 or j < 2 or i >= w - 2 or j >= h - 2;
+      const auto box = i >= 50 and i < 60 and j >= 10 and j < 30;
+      const auto post = i >= 15 and i < 19 and j >= 55 and j < 59;
+      if (border or box or post)
+      {
+        map.at(j * w + i) = 100;
+      }
+    }
+  }
+
+  grid.loadMap(map);
+  return grid;
+}
+
+
+/// \brief Ray casts a scan in the grid
+/// \param grid - map and laser properties
+/// \param pose - pose of the scanner (theta, x, y), at the center of a cell
+/// \return ranges
+static std::vector<float> castScan(const GridMapper &grid, const Vector3d &pose)
+{
+  const auto angles = rigid2d::beamAngles(0.0, 6.28, 0.0174);
+  const auto gc = grid.world2Grid(pose(1), pose(2));
+
+  std::vector<float> scan;
+  for(const auto angle : angles)
+  {
+    scan.push_back(static_cast<float>(grid.castRay(gc, pose(0) + angle, grid.rangeMax())));
+  }
+
+  return scan;
+}
+
+
+/// \brief Drives the robot along a row of cells and updates the filter at each cell
+/// \param grid - map
+/// \param mcl - filter initialized near the start
+/// \param sizes[out] - number of particles after each update
+/// \return the last true pose (theta, x, y)
+static Vector3d driveRow(const GridMapper &grid, MonteCarloLocalization &mcl, std::vector<std::size_t> &sizes)
+{
+  Vector3d truth = Vector3d::Zero();
+  for(unsigned int i = 25; i <= 45; i += 2)
+  {
+    const auto center = grid.grid2World(i, 40);
+    truth << 0.0, center.x, center.y;
+
+    // odometry is exact, the filter adds its own noise
+    Pose odom;
+    odom.x = center.x;
+    odom.y = center.y;
+
+    EXPECT_TRUE(mcl.update(castScan(grid, truth), odom));
+    sizes.push_back(mcl.numParticles());
+  }
+
+  return truth;
+}
+
+
+/// \brief Tests the filter converges from a start known to within a few cells
+TEST(MonteCarloLocalizationTest, Converges)
+{
+  const auto grid = roomGrid();
+  MonteCarloLocalization mcl(grid, 100, 2000, 0.01, 2.326, 0.1, 0.1745,
+                             0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60);
+
+  const auto start = grid.grid2World(25, 40);
+  const Matrix3d cov = 0.01 * Matrix3d::Identity();
+  mcl.initialize(Vector3d(0.1, start.x + 0.1, start.y - 0.1), cov);
+  ASSERT_EQ(mcl.numParticles(), 2000u);
+
+  std::vector<std::size_t> sizes;
+  const auto truth = driveRow(grid, mcl, sizes);
+
+  const auto mu = mcl.mean();
+  ASSERT_NEAR(mu(0), truth(0), 0.1);
+  ASSERT_NEAR(mu(1), truth(1), 0.1);
+  ASSERT_NEAR(mu(2), truth(2), 0.1);
+
+  // the weights are normalized
+  auto sum = 0.0;
+  for(const auto w : mcl.weights())
+  {
+    sum += w;
+  }
+  ASSERT_NEAR(sum, 1.0, 1e-9);
+
+  // the particles stay within the bounds and the KLD bound
+  // needs fewer of them once the cloud is small
+  for(const auto n : sizes)
+  {
+    ASSERT_GE(n, 100u);
+    ASSERT_LE(n, 2000u);
+  }
+  ASSERT_LT(sizes.back(), 2000u);
+}
+
+
+/// \brief Tests the filter is not updated until the robot moves
+TEST(MonteCarloLocalizationTest, WaitsForMotion)
+{
+  const auto grid = roomGrid();
+  MonteCarloLocalization mcl(grid, 100, 500, 0.01, 2.326, 0.1, 0.1745,
+                             0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60);
+
+  const auto start = grid.grid2World(25, 40);
+  mcl.initialize(Vector3d(0.0, start.x, start.y), 0.01 * Matrix3d::Identity());
+
+  const auto scan = castScan(grid, Vector3d(0.0, start.x, start.y));
+  Pose odom;
+  odom.x = start.x;
+  odom.y = start.y;
+
+  // the first scan is always used
+  ASSERT_TRUE(mcl.update(scan, odom));
+
+  odom.x += 0.02;
+  ASSERT_FALSE(mcl.update(scan, odom));
+}
+
+
+/// \brief Tests the number of particles is fixed when the bounds are equal
+TEST(MonteCarloLocalizationTest, FixedBounds)
+{
+  const auto grid = roomGrid();
+  MonteCarloLocalization mcl(grid, 300, 300, 0.01, 2.326, 0.1, 0.1745,
+                             0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60);
+
+  const auto start = grid.grid2World(25, 40);
+  mcl.initialize(Vector3d(0.0, start.x, start.y), 0.01 * Matrix3d::Identity());
+
+  std::vector<std::size_t> sizes;
+  driveRow(grid, mcl, sizes);
+  for(const auto n : sizes)
+  {
+    ASSERT_EQ(n, 300u);
+  }
+}
+
+
+/// \brief Tests an uninitialized filter and bad bounds throw
+TEST(MonteCarloLocalizationTest, InvalidArguments)
+{
+  const auto grid = roomGrid();
+
+  MonteCarloLocalization mcl(grid, 100, 500, 0.01, 2.326, 0.1, 0.1745,
+                             0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60);
+  ASSERT_THROW(mcl.update(std::vector<float>(361, 1.0), Pose()), std::invalid_argument);
+
+  ASSERT_THROW(MonteCarloLocalization(grid, 0, 500, 0.01, 2.326, 0.1, 0.1745,
+                                      0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60), std::invalid_argument);
+  ASSERT_THROW(MonteCarloLocalization(grid, 600, 500, 0.01, 2.326, 0.1, 0.1745,
+                                      0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60), std::invalid_argument);
+  ASSERT_THROW(MonteCarloLocalization(grid, 100, 500, 0.0, 2.326, 0.1, 0.1745,
+                                      0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60), std::invalid_argument);
+  ASSERT_THROW(MonteCarloLocalization(grid, 100, 500, 0.01, 2.326, 0.0, 0.1745,
+                                      0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 60), std::invalid_argument);
+  ASSERT_THROW(MonteCarloLocalization(grid, 100, 500, 0.01, 2.326, 0.1, 0.1745,
+                                      0.05, 0.05, 0.05, 0.05, 0.05, 0.1, 0), std::invalid_argument);
+}
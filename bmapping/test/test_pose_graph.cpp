@@ -0,0 +1,189 @@
+/// \file
+/// \brief unit tests for the pose graph
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "bmapping/pose_graph.hpp"
+
+using bmapping::PoseConstraint;
+using bmapping::PoseGraph;
+using bmapping::pose2Transform;
+using bmapping::transform2Pose;
+using rigid2d::Transform2D;
+using rigid2d::Vector2D;
+using Eigen::Matrix3d;
+using Eigen::Vector3d;
+
+
+/// \brief Square loop of 2 m sides, a submap at each corner and two nodes
+///        along each side, constrained to the submaps they were inserted
+///        into to within a centimeter and closed by a loop closure of the
+///        last node in the first submap to within 10 cm
+struct SquareLoop
+{
+  std::vector<Vector3d> submaps;      // true submap poses
+  std::vector<Vector3d> nodes;        // true node poses
+  PoseGraph graph;                    // started from poses that drift
+
+  /// \brief Builds the graph
+  /// \param huber_scale - Huber loss threshold of the graph
+  explicit SquareLoop(double huber_scale)
+    : graph(huber_scale)
+  {
+    const std::vector<Vector2D> corners = {Vector2D(0.0, 0.0), Vector2D(2.0, 0.0),
+                                           Vector2D(2.0, 2.0), Vector2D(0.0, 2.0)};
+    for(int s = 0; s < 4; s++)
+    {
+      const auto theta = rigid2d::normalize_angle_PI(s * 0.5 * rigid2d::PI);
+      submaps.emplace_back(theta, corners[s].x, corners[s].y);
+      for(int t = 0; t < 2; t++)
+      {
+        nodes.emplace_back(theta, corners[s].x + t * std::cos(theta), corners[s].y + t * std::sin(theta));
+      }
+    }
+
+    // odometry drifts along the loop
+    for(int s = 0; s < 4; s++)
+    {
+      graph.addSubmap(submaps[s] + s * Vector3d(0.05, 0.1, -0.1));
+    }
+
+    for(int n = 0; n < 8; n++)
+    {
+      graph.addNode(nodes[n] + n * Vector3d(0.025, 0.05, -0.05));
+    }
+
+    for(int n = 0; n < 8; n++)
+    {
+      graph.addConstraint(constraint(n / 2, n, false));
+
+      // the first node of a side is also in the previous submap
+      if (n > 0 and n % 2 == 0)
+      {
+        graph.addConstraint(constraint(n / 2 - 1, n, false));
+      }
+    }
+
+    graph.addConstraint(constraint(0, 7, true));
+  }
+
+  /// \brief Measurement of a node in a submap from the true poses
+  /// \param submap - index of the submap
+  /// \param node - index of the node
+  /// \param loop_closure - true for a loop closure, which is less certain
+  /// \returns the constraint
+  PoseConstraint constraint(int submap, int node, bool loop_closure) const
+  {
+    PoseConstraint c;
+    c.submap = submap;
+    c.node = node;
+    c.relative = transform2Pose(pose2Transform(submaps[submap]).inv() * pose2Transform(nodes[node]));
+    c.information = (loop_closure ? 100.0 : 1e4) * Matrix3d::Identity();
+    c.loop_closure = loop_closure;
+    return c;
+  }
+
+  /// \brief Largest distance of an optimized pose from the truth
+  /// \returns error in meters or radians
+  double maxError() const
+  {
+    auto err = 0.0;
+    for(int s = 0; s < graph.numSubmaps(); s++)
+    {
+      Vector3d d = graph.submapPose(s) - submaps[s];
+      d(0) = rigid2d::normalize_angle_PI(d(0));
+      err = std::max(err, d.lpNorm<Eigen::Infinity>());
+    }
+
+    for(int n = 0; n < graph.numNodes(); n++)
+    {
+      Vector3d d = graph.nodePose(n) - nodes[n];
+      d(0) = rigid2d::normalize_angle_PI(d(0));
+      err = std::max(err, d.lpNorm<Eigen::Infinity>());
+    }
+
+    return err;
+  }
+};
+
+
+/// \brief Tests a pose converts to a transform and back
+TEST(PoseGraphTest, PoseTransform)
+{
+  const Vector3d pose(2.5, -1.0, 0.3);
+  const auto T = pose2Transform(pose);
+  ASSERT_NEAR(T.displacement().theta, 2.5, 1e-12);
+  ASSERT_NEAR(T.displacement().x, -1.0, 1e-12);
+  ASSERT_NEAR(T.displacement().y, 0.3, 1e-12);
+  ASSERT_TRUE(transform2Pose(T).isApprox(pose, 1e-12));
+}
+
+
+/// \brief Tests the loop converges to the true poses in a few Gauss-Newton
+///        steps, which needs the Jacobians to match the error
+TEST(PoseGraphTest, LoopConverges)
+{
+  SquareLoop loop(1.0);
+  ASSERT_GT(loop.graph.cost(), 1.0);
+  ASSERT_GT(loop.maxError(), 0.1);
+
+  const auto cost = loop.graph.optimize(6);
+  ASSERT_LT(cost, 1e-12);
+  ASSERT_LT(loop.maxError(), 1e-6);
+
+  // the first submap is fixed
+  ASSERT_TRUE(loop.graph.submapPose(0).isApprox(loop.submaps[0]));
+}
+
+
+/// \brief Tests the Huber loss keeps a wrong loop closure from pulling the map
+TEST(PoseGraphTest, HuberOutlier)
+{
+  // a match of the far corner one meter off
+  auto addOutlier = [](SquareLoop &loop)
+  {
+    auto wrong = loop.constraint(0, 4, true);
+    wrong.relative(2) += 1.0;
+    loop.graph.addConstraint(wrong);
+  };
+
+  SquareLoop robust(1.0);
+  addOutlier(robust);
+  robust.graph.optimize(50);
+
+  SquareLoop plain(1e6);
+  addOutlier(plain);
+  plain.graph.optimize(50);
+
+  ASSERT_LT(robust.maxError(), 0.02);
+  ASSERT_GT(plain.maxError(), 2.0 * robust.maxError());
+
+  // the loss grows linearly past the threshold
+  ASSERT_LT(robust.graph.cost(), plain.graph.cost());
+}
+
+
+/// \brief Tests invalid constraints and parameters throw
+TEST(PoseGraphTest, InvalidArguments)
+{
+  ASSERT_THROW(PoseGraph(0.0), std::invalid_argument);
+
+  PoseGraph graph;
+  graph.addSubmap(Vector3d::Zero());
+  graph.addNode(Vector3d::Zero());
+
+  PoseConstraint c;
+  c.submap = 1;
+  ASSERT_THROW(graph.addConstraint(c), std::invalid_argument);
+
+  c.submap = 0;
+  c.node = -1;
+  ASSERT_THROW(graph.addConstraint(c), std::invalid_argument);
+
+  // nothing to optimize without constraints
+  ASSERT_DOUBLE_EQ(graph.optimize(10), 0.0);
+}
@@ -0,0 +1,197 @@
+/// \file
+/// \brief unit tests for the scan filter
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <rigid2d/batch_transform.hpp>
+#include "bmapping/scan_filter.hpp"
+
+using bmapping::FilteredScan;
+using bmapping::LaserProperties;
+using bmapping::ScanFilter;
+
+
+static const LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.1);
+static const auto angles = rigid2d::beamAngles(0.0, 6.28, 0.0174);
+
+
+/// \brief Indices of the beams kept
+/// \param ranges - filtered ranges, removed beams are NaN
+/// \return indices
+static std::vector<std::size_t> keptBeams(const std::vector<float> &ranges)
+{
+  std::vector<std::size_t> kept;
+  for(std::size_t i = 0; i < ranges.size(); i++)
+  {
+    if (!std::isnan(ranges[i]))
+    {
+      kept.push_back(i);
+    }
+  }
+
+  return kept;
+}
+
+
+/// \brief Distance between the end points of two beams of a circular wall
+/// \param radius - range of every beam
+/// \param a - index of the first beam
+/// \param b - index of the second beam
+/// \return distance
+static double endPointDistance(double radius, std::size_t a, std::size_t b)
+{
+  return std::hypot(radius * (std::cos(angles[a]) - std::cos(angles[b])),
+                    radius * (std::sin(angles[a]) - std::sin(angles[b])));
+}
+
+
+/// \brief Tests every beam is passed on without a laser
+TEST(ScanFilterTest, PassThrough)
+{
+  const ScanFilter filter;
+  const std::vector<float> scan = {0.0, 1.0, std::numeric_limits<float>::quiet_NaN(), 10.0};
+
+  FilteredScan filtered;
+  filter.filter(scan, filtered);
+  ASSERT_EQ(filtered.num_valid, 4u);
+  ASSERT_EQ(filtered.num_scored, 4u);
+  ASSERT_EQ(filtered.integrate.size(), 4u);
+  ASSERT_EQ(filtered.score.size(), 4u);
+  ASSERT_EQ(filtered.integrate.at(3), 10.0f);
+}
+
+
+/// \brief Tests returns outside the range limits are removed in place
+TEST(ScanFilterTest, RangeLimits)
+{
+  const ScanFilter filter(props, 0.0, 0.0, 0.0, 0);
+
+  std::vector<float> scan(angles.size(), 1.0);
+  scan.at(10) = std::numeric_limits<float>::quiet_NaN();
+  scan.at(20) = std::numeric_limits<float>::infinity();
+  scan.at(30) = 0.05;
+  scan.at(40) = 3.5;
+
+  FilteredScan filtered;
+  filter.filter(scan, filtered);
+  ASSERT_EQ(filtered.integrate.size(), scan.size());
+  ASSERT_EQ(filtered.num_valid, scan.size() - 4);
+  ASSERT_EQ(filtered.num_scored, scan.size() - 4);
+
+  for(const auto i : {10, 20, 30, 40})
+  {
+    ASSERT_TRUE(std::isnan(filtered.integrate.at(i)));
+    ASSERT_TRUE(std::isnan(filtered.score.at(i)));
+  }
+  ASSERT_EQ(filtered.integrate.at(11), 1.0f);
+}
+
+
+/// \brief Tests a return far from the end points of its neighbours is removed
+TEST(ScanFilterTest, IsolatedReturns)
+{
+  const ScanFilter filter(props, 0.0, 0.0, 0.1, 0);
+
+  std::vector<float> scan(angles.size(), 1.0);
+  scan.at(50) = 3.0;
+
+  // the neighbour of a return next to a gap is still close
+  scan.at(100) = std::numeric_limits<float>::quiet_NaN();
+
+  FilteredScan filtered;
+  filter.filter(scan, filtered);
+  ASSERT_TRUE(std::isnan(filtered.integrate.at(50)));
+  ASSERT_EQ(filtered.integrate.at(49), 1.0f);
+  ASSERT_EQ(filtered.integrate.at(51), 1.0f);
+  ASSERT_EQ(filtered.integrate.at(101), 1.0f);
+  ASSERT_EQ(filtered.num_valid, scan.size() - 2);
+
+  // a return with no valid neighbours is isolated
+  std::vector<float> lone(angles.size(), std::numeric_limits<float>::quiet_NaN());
+  lone.at(5) = 1.0;
+  filter.filter(lone, filtered);
+  ASSERT_EQ(filtered.num_valid, 0u);
+}
+
+
+/// \brief Tests the end points scored are at least the min spacing apart,
+///        so close returns are thinned and far returns are kept
+TEST(ScanFilterTest, Spacing)
+{
+  const ScanFilter filter(props, 0.05, 0.0, 0.0, 0);
+  FilteredScan filtered;
+
+  // consecutive end points 1.7 cm apart
+  filter.filter(std::vector<float>(angles.size(), 1.0), filtered);
+  auto kept = keptBeams(filtered.score);
+  ASSERT_EQ(kept.size(), filtered.num_scored);
+  ASSERT_EQ(filtered.num_valid, angles.size());
+  ASSERT_LT(filtered.num_scored, angles.size() / 2);
+  for(std::size_t k = 1; k < kept.size(); k++)
+  {
+    ASSERT_GE(endPointDistance(1.0, kept[k-1], kept[k]), 0.05);
+
+    // no beam between two kept beams was far enough to be kept
+    ASSERT_LT(endPointDistance(1.0, kept[k-1], kept[k] - 1), 0.05);
+  }
+
+  // consecutive end points 5.2 cm apart
+  filter.filter(std::vector<float>(angles.size(), 3.0), filtered);
+  ASSERT_EQ(filtered.num_scored, angles.size());
+}
+
+
+/// \brief Tests a beam is kept once the angle since the last one reaches the max gap
+TEST(ScanFilterTest, MaxAngleGap)
+{
+  const ScanFilter filter(props, 1.0, 0.2, 0.0, 0);
+  FilteredScan filtered;
+
+  filter.filter(std::vector<float>(angles.size(), 0.5), filtered);
+  const auto kept = keptBeams(filtered.score);
+  ASSERT_GT(kept.size(), 1u);
+  for(std::size_t k = 1; k < kept.size(); k++)
+  {
+    ASSERT_LE(angles[kept[k]] - angles[kept[k-1]], 0.2 + 0.0174);
+  }
+}
+
+
+/// \brief Tests at most the budget of beams is scored, evenly spaced,
+///        while every valid return is still inserted
+TEST(ScanFilterTest, BeamBudget)
+{
+  const ScanFilter filter(props, 0.0, 0.0, 0.0, 60);
+  FilteredScan filtered;
+
+  filter.filter(std::vector<float>(angles.size(), 1.0), filtered);
+  ASSERT_EQ(filtered.num_valid, angles.size());
+  ASSERT_EQ(filtered.num_scored, 60u);
+
+  const auto kept = keptBeams(filtered.score);
+  ASSERT_EQ(kept.size(), 60u);
+  for(std::size_t k = 1; k < kept.size(); k++)
+  {
+    const auto gap = kept[k] - kept[k-1];
+    ASSERT_GE(gap, angles.size() / 60);
+    ASSERT_LE(gap, angles.size() / 60 + 1);
+  }
+
+  // a budget above the beams left changes nothing
+  const ScanFilter loose(props, 0.0, 0.0, 0.0, 1000);
+  loose.filter(std::vector<float>(angles.size(), 1.0), filtered);
+  ASSERT_EQ(filtered.num_scored, angles.size());
+}
+
+
+/// \brief Tests negative distances and angles throw
+TEST(ScanFilterTest, InvalidArguments)
+{
+  ASSERT_THROW(ScanFilter(props, -0.1, 0.0, 0.0, 0), std::invalid_argument);
+  ASSERT_THROW(ScanFilter(props, 0.0, -0.1, 0.0, 0), std::invalid_argument);
+  ASSERT_THROW(ScanFilter(props, 0.0, 0.0, -0.1, 0), std::invalid_argument);
+}
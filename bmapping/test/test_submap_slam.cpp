@@ -0,0 +1,220 @@
+/// \file
+/// \brief unit tests for submap SLAM
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <rigid2d/batch_transform.hpp>
+#include "bmapping/correlative_matcher.hpp"
+#include "bmapping/grid_mapper.hpp"
+#include "bmapping/submap_slam.hpp"
+
+using bmapping::CorrelativeScanMatcher;
+using bmapping::GridMapper;
+using bmapping::LaserProperties;
+using bmapping::SubmapSLAM;
+using rigid2d::Pose;
+using rigid2d::Transform2D;
+using Eigen::Vector3d;
+
+
+static const LaserProperties props(0.0, 6.28, 0.0174, 0.12, 3.5, 0.95, 0.0, 0.04, 0.01, 0.1);
+
+
+/// \brief Room with walls around the border and two boxes so no two poses
+///        see the same scan
+/// \return the grid
+static GridMapper roomGrid()
+{
+  GridMapper grid(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+
+  const auto w = grid.viewWidth();
+  const auto h = grid.viewHeight();
+  std::vector<int8_t> map(w * h, 0);
+  for(unsigned int j = 0; j < h; j++)
+  {
+    for(unsigned int i = 0; i < w; i++)
+    {
+      const auto border = i < 2 or j < 2 or i >= w - 2 or j >= h - 2;
+      const auto box = i >= 50 and i < 60 and j >= 10 and j < 30;
+      const auto post = i >= 15 and i < 19 and j >= 55 and j < 59;
+      if (border or box or post)
+      {
+        map.at(j * w + i) = 100;
+      }
+    }
+  }
+
+  grid.loadMap(map);
+  return grid;
+}
+
+
+/// \brief Ray casts a scan in the grid
+/// \param grid - map and laser properties
+/// \param pose - pose of the scanner (theta, x, y), at the center of a cell
+/// \return ranges
+static std::vector<float> castScan(const GridMapper &grid, const Vector3d &pose)
+{
+  const auto angles = rigid2d::beamAngles(0.0, 6.28, 0.0174);
+  const auto gc = grid.world2Grid(pose(1), pose(2));
+
+  std::vector<float> scan;
+  for(const auto angle : angles)
+  {
+    scan.push_back(static_cast<float>(grid.castRay(gc, pose(0) + angle, grid.rangeMax())));
+  }
+
+  return scan;
+}
+
+
+/// \brief SLAM with small submaps in an empty copy of the room
+/// \param loop_min_gap - min nodes between a submap and the nodes searched against it
+/// \param num_threads - loop closure threads
+/// \return the SLAM backend
+static std::unique_ptr<SubmapSLAM> makeSlam(int loop_min_gap, unsigned int num_threads)
+{
+  const GridMapper prototype(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  return std::make_unique<SubmapSLAM>(prototype, 6, 0.02, 0.05,
+                                      CorrelativeScanMatcher(0.1, 0.1, 3, -1.0),
+                                      CorrelativeScanMatcher(0.3, 0.2, 3, -1.0),
+                                      1.0, loop_min_gap, 10, 1.0, num_threads);
+}
+
+
+/// \brief Drives the robot along row 40 of the room, the robot starts at
+///        the origin of the map so the poses are relative to the first cell
+/// \param room - the world
+/// \param slam - SLAM backend
+/// \param cells - columns visited in order
+/// \return the last true pose relative to the start (theta, x, y)
+static Vector3d driveRow(const GridMapper &room, SubmapSLAM &slam, const std::vector<unsigned int> &cells)
+{
+  const auto start = room.grid2World(cells.front(), 40);
+
+  Vector3d truth = Vector3d::Zero();
+  for(const auto i : cells)
+  {
+    const auto center = room.grid2World(i, 40);
+
+    Pose odom;
+    odom.x = center.x - start.x;
+    odom.y = center.y - start.y;
+    truth << 0.0, odom.x, odom.y;
+
+    EXPECT_TRUE(slam.addScan(castScan(room, Vector3d(0.0, center.x, center.y)), odom));
+  }
+
+  return truth;
+}
+
+
+/// \brief Tests the trajectory follows a straight drive without loop closures
+TEST(SubmapSLAMTest, StraightDrive)
+{
+  const auto room = roomGrid();
+  auto slam = makeSlam(40, 0);
+
+  std::vector<unsigned int> cells;
+  for(unsigned int i = 25; i <= 45; i++)
+  {
+    cells.push_back(i);
+  }
+
+  const auto truth = driveRow(room, *slam, cells);
+  slam->finish();
+
+  ASSERT_EQ(slam->numNodes(), cells.size());
+  ASSERT_GE(slam->numSubmaps(), 3u);
+  ASSERT_EQ(slam->numLoopClosures(), 0u);
+
+  const auto trajectory = slam->trajectory();
+  ASSERT_EQ(trajectory.size(), cells.size());
+  const auto last = trajectory.back().displacement();
+  ASSERT_NEAR(last.x, truth(1), 0.05);
+  ASSERT_NEAR(last.y, truth(2), 0.05);
+  ASSERT_NEAR(last.theta, truth(0), 0.05);
+
+  const auto pose = slam->getRobotState().displacement();
+  ASSERT_NEAR(pose.x, truth(1), 0.05);
+  ASSERT_NEAR(pose.y, truth(2), 0.05);
+
+  // the face of the wall behind the start, at x = -1.9 in the room, is in the map
+  std::vector<int8_t> map;
+  slam->gridMap(map);
+  const GridMapper prototype(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  ASSERT_EQ(map.size(), prototype.viewWidth() * prototype.viewHeight());
+
+  const auto start = room.grid2World(25, 40);
+  const auto wall = prototype.world2Grid(-1.9 - start.x + 0.01, 0.0);
+  ASSERT_GT(map.at(wall.j * prototype.viewWidth() + wall.i), 50);
+}
+
+
+/// \brief Tests driving back over the start closes loops with the first submaps
+TEST(SubmapSLAMTest, ReturnClosesLoop)
+{
+  const auto room = roomGrid();
+  auto slam = makeSlam(10, 2);
+
+  std::vector<unsigned int> cells;
+  for(unsigned int i = 25; i <= 45; i++)
+  {
+    cells.push_back(i);
+  }
+
+  for(unsigned int i = 44; i >= 25; i--)
+  {
+    cells.push_back(i);
+  }
+
+  const auto truth = driveRow(room, *slam, cells);
+  slam->finish();
+
+  ASSERT_EQ(slam->numNodes(), cells.size());
+  ASSERT_GT(slam->numLoopClosures(), 0u);
+
+  const auto pose = slam->getRobotState().displacement();
+  ASSERT_NEAR(pose.x, truth(1), 0.05);
+  ASSERT_NEAR(pose.y, truth(2), 0.05);
+}
+
+
+/// \brief Tests the robot must move before a scan is added
+TEST(SubmapSLAMTest, WaitsForMotion)
+{
+  const auto room = roomGrid();
+  auto slam = makeSlam(40, 0);
+
+  const auto center = room.grid2World(25, 40);
+  const auto scan = castScan(room, Vector3d(0.0, center.x, center.y));
+
+  Pose odom;
+  ASSERT_TRUE(slam->addScan(scan, odom));
+
+  odom.x = 0.01;
+  ASSERT_FALSE(slam->addScan(scan, odom));
+  ASSERT_EQ(slam->numNodes(), 1u);
+}
+
+
+/// \brief Tests invalid parameters throw
+TEST(SubmapSLAMTest, InvalidArguments)
+{
+  const GridMapper prototype(0.05, -2.0, 2.0, -2.0, 2.0, props, Transform2D());
+  const CorrelativeScanMatcher matcher;
+
+  ASSERT_THROW(SubmapSLAM(prototype, 1, 0.02, 0.05, matcher, matcher, 1.0, 40, 10, 1.0, 0),
+               std::invalid_argument);
+  ASSERT_THROW(SubmapSLAM(prototype, 6, 0.02, 0.05, matcher, matcher, 1.0, -1, 10, 1.0, 0),
+               std::invalid_argument);
+  ASSERT_THROW(SubmapSLAM(prototype, 6, 0.02, 0.05, matcher, matcher, 1.0, 40, 0, 1.0, 0),
+               std::invalid_argument);
+}
@@ -7,6 +7,8 @@
 #include <functional>
 #include "controller/mppi.hpp"
 #include "rigid2d/utilities.hpp"
+#include "rigid2d/sampling.hpp"
+#include "rigid2d/instrumentation.hpp"
 
 
 namespace controller
@@ -71,6 +73,8 @@ void MPPI::setWaypoint(const Pose &wpt)
 
 WheelVelocities MPPI::newControls(const Pose &ps)
 {
+  RIGID2D_SCOPED_TIMER("mppi.new_controls");
+
   // I.C.
   VectorXd x0(3);
   x0 << ps.x, ps.y, ps.theta;
@@ -176,10 +180,14 @@ void MPPI::pertubations(Ref<MatrixXd> pert)
   const auto ul_sig = std::sqrt(ul_var);
   const auto ur_sig = std::sqrt(ur_var);
 
+  auto &gen = rigid2d::threadGenerator();
   for(int i = 0; i < steps; i++)
   {
-    pert(0,i) = rigid2d::sampleNormalDistribution(0.0, ul_sig);
-    pert(1,i) = rigid2d::sampleNormalDistribution(0.0, ur_sig);
+    // one Box-Muller pair per column
+    double z[2];
+    rigid2d::fillStandardNormal(gen, z, 2);
+    pert(0,i) = ul_sig * z[0];
+    pert(1,i) = ur_sig * z[1];
   }
 }
 
@@ -26,7 +26,7 @@ namespace nuslam
   using rigid2d::almost_equal;
   using rigid2d::normalize_angle_PI;
   using rigid2d::Transform2D;
-  using rigid2d::sampleMultivariateDistribution;
+  using rigid2d::MultivariateNormal;
 
 
   /// \brief Compose distance from 1.0 to the next largest double-precision number
@@ -147,6 +147,9 @@ namespace nuslam
     MatrixXd measurement_noise;    // noise in measurement model
     MatrixXd process_noise;        // process noise matrix
 
+    MultivariateNormal motion_sampler;         // samples the motion noise
+    MultivariateNormal measurement_sampler;    // samples the measurement noise
+
     // landmark j in state
     std::vector<int> lm_j;
 
@@ -9,6 +9,7 @@
 
 
 #include <rigid2d/rigid2d.hpp>
+#include <rigid2d/batch_transform.hpp>
 
 namespace nuslam
 {
@@ -138,6 +139,7 @@ namespace nuslam
     double angle_std;                         // standard deviation of angles
     double mu_min, mux_max;                   // min and max mean angles of circle
     unsigned int num_points;                  // min points per circle
+    rigid2d::PointBatchd beam_dirs;           // cosine and sine of each beam angle
   };
 }
 
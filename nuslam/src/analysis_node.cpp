@@ -30,6 +30,7 @@
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/utilities.hpp>
+#include <rigid2d/node_runtime.hpp>
 #include "nuslam/landmarks.hpp"
 #include "nuslam/TurtleMap.h"
 
@@ -225,10 +226,10 @@ int main(int argc, char** argv)
   // int frequency = 5;
   // ros::Rate loop_rate(frequency);
 
-  while(node_handle.ok())
+  // sleeps until the model states arrive
+  rigid2d::NodeRuntime runtime(node_handle);
+  runtime.spin([&]()
   {
-    ros::spinOnce();
-
     if (model_update)
     {
       map.header.frame_id = frame_id;
@@ -241,7 +242,7 @@ int main(int argc, char** argv)
     }
     // loop_rate.sleep();
 
-  }
+  });
 
 return 0;
 }
@@ -18,6 +18,7 @@
 #include <string>
 #include <iostream>
 
+#include <rigid2d/node_runtime.hpp>
 #include "nuslam/TurtleMap.h"
 
 static bool map_update;               // map update flag
@@ -56,10 +57,10 @@ int main(int argc, char** argv)
   ROS_INFO("Successfully launched draw_map node");
 
 
-  while(node_handle.ok())
+  // sleeps until a map arrives
+  rigid2d::NodeRuntime runtime(node_handle);
+  runtime.spin([&]()
   {
-    ros::spinOnce();
-
     if (map_update)
     {
       visualization_msgs::MarkerArray marker_array;
@@ -99,7 +100,7 @@ int main(int argc, char** argv)
       map_update = false;
     }
 
-  }
+  });
   return 0;
 }
 
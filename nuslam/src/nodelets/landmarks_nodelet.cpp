@@ -0,0 +1,97 @@
+/// \file
+/// \brief Detects and extracts circular features in laser scan
+///
+/// PARAMETERS:
+///   frame_id - frame the circles are in
+/// PUBLISHES:
+///   landmarks (nuslam::TurtleMap): center and radius of all circles detected
+/// SUBSCRIBES:
+///   scan (sensor_msgs/LaserScan): Lidar scan
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <boost/make_shared.hpp>
+
+#include <memory>
+#include <string>
+
+#include <rigid2d/rigid2d.hpp>
+#include "nuslam/TurtleMap.h"
+#include "nuslam/landmarks.hpp"
+
+
+namespace nuslam
+{
+  using rigid2d::deg2rad;
+
+
+  /// \brief Landmark detection as a nodelet. The map of each scan is
+  ///        published as a shared pointer, a SLAM nodelet in the same
+  ///        manager receives it without serialization.
+  class LandmarksNodelet : public nodelet::Nodelet
+  {
+  private:
+    /// \brief Reads the parameters and connects the topics
+    void onInit() override
+    {
+      ros::NodeHandle &node_handle = getNodeHandle();
+      ros::NodeHandle &nh = getPrivateNodeHandle();
+
+      nh.getParam("frame_id", frame_id);
+
+      NODELET_INFO("frame_id %s", frame_id.c_str());
+
+      // lidar properties
+      double beam_min = 0.0, beam_max = deg2rad(360.0);
+      double beam_delta = deg2rad(1.0);
+      double range_min = 0.12, range_max = 3.5;
+      LaserProperties props(beam_min, beam_max, beam_delta, range_min, range_max);
+
+      // landmark classifier
+      double epsilon = 0.075;
+      landmarks = std::make_unique<Landmarks>(props, epsilon);
+
+      circle_pub = node_handle.advertise<TurtleMap>("landmarks", 1);
+      scan_sub = node_handle.subscribe("scan", 1, &LandmarksNodelet::scanCallback, this);
+
+      NODELET_INFO("Successfully launched landmarks nodelet");
+    }
+
+    /// \brief Finds the features in a scan and publishes them
+    /// \param msg - lidar scan
+    void scanCallback(const sensor_msgs::LaserScan::ConstPtr &msg)
+    {
+      // find features in new scan
+      landmarks->featureDetection(msg->ranges);
+
+      // new map, ownership passes to the subscribers
+      TurtleMap::Ptr map = boost::make_shared<TurtleMap>();
+      map->header.frame_id = frame_id;
+      map->header.stamp = msg->header.stamp;
+
+      const auto num_lm = landmarks->lm.size();
+      map->cx.reserve(num_lm);
+      map->cy.reserve(num_lm);
+      map->r.reserve(num_lm);
+
+      for(const auto &lm : landmarks->lm)
+      {
+        map->cx.push_back(lm.x_hat);
+        map->cy.push_back(lm.y_hat);
+        map->r.push_back(lm.radius);
+      }
+
+      circle_pub.publish(map);
+    }
+
+
+    std::string frame_id;                     // frame the circles are in
+    std::unique_ptr<Landmarks> landmarks;     // landmark classifier
+    ros::Publisher circle_pub;                // detected circles
+    ros::Subscriber scan_sub;                 // lidar scan
+  };
+} // end namespace
+
+PLUGINLIB_EXPORT_CLASS(nuslam::LandmarksNodelet, nodelet::Nodelet)
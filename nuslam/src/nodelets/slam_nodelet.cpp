@@ -0,0 +1,432 @@
+/// \file
+/// \brief EKF SLAM
+///
+/// PARAMETERS:
+///   map_frame_id - map frame
+///   odom_frame_id - odometry frame
+///   body_frame_id - base link frame
+///   left_wheel_joint - name of left wheel joint
+///   right_wheel_joint - name of right wheel joint
+///   wheel_base - distance between wheels
+///   wheel_radius - radius of wheels
+///   known_data_association - EKF runs with or without know data association
+///   publish_frequency - rate the paths, landmarks, and errors are published
+///   odometry_history - number of odometry poses kept to look up the pose at a scan
+///   path_capacity - max number of poses kept in each path
+///   path_min_distance - min distance between poses in a path
+///   path_min_angle - min change in heading between poses in a path
+///   path_publish_frequency - rate the paths are published
+///   path_delta - publish the poses added to each path on <path>_delta
+///   diagnostics_frequency - rate the timing metrics are published
+///   trace_file - writes a Chrome trace of the hot paths on shutdown if set
+/// PUBLISHES:
+///   slam_path (nav_msgs/Path): trajectory from EKF slam
+///   odom_path (nav_msgs/Path): trajectory from odometry
+///   gazebo_path (nav_msgs/Path): trajectory from gazebo
+///   slam_path_delta, odom_path_delta, gazebo_path_delta (nav_msgs/Path): poses added to each path
+///   map (visualization_msgs::MarkerArray): landmarks states from EKF represented as cylinders
+///   odom_error (tsim/PoseError): pose error between gazebo and odometry
+///   slam_error (tsim/PoseError): pose error between gazebo and EKF slam
+///   /diagnostics (diagnostic_msgs/DiagnosticArray): latency of the EKF stages
+/// SUBSCRIBES:
+///   joint_states (sensor_msgs/JointState): angular wheel positions
+///   landmarks (nuslam::TurtleMap): center and radius of all circles detected
+///   /gazebo/model_states (gazebo_msgs/ModelStates): model states from grazebo
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <sensor_msgs/JointState.h>
+#include <visualization_msgs/MarkerArray.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Matrix3x3.h>
+#include <tf2_ros/transform_broadcaster.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <boost/make_shared.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <rigid2d/odometry_engine.hpp>
+#include <rigid2d/joint_index.hpp>
+#include <rigid2d/path_publisher.hpp>
+#include <rigid2d/ros_instrumentation.hpp>
+#include "nuslam/ekf_filter.hpp"
+#include "nuslam/TurtleMap.h"
+#include "tsim/PoseError.h"
+
+
+namespace nuslam
+{
+  using rigid2d::Vector2D;
+  using rigid2d::Pose;
+  using rigid2d::Transform2D;
+  using rigid2d::TransformData2D;
+  using rigid2d::normalize_angle_PI;
+
+
+  /// \brief EKF SLAM as a nodelet. The estimate and the map to odom
+  ///        transform are updated in the joint states callback, the
+  ///        paths, landmarks, and errors are published on a timer.
+  ///        All callbacks run on the nodelet's single threaded queue.
+  class SlamNodelet : public nodelet::Nodelet
+  {
+  public:
+    SlamNodelet() : known_data_association(false),
+                    map_flag(false),
+                    meas_stamp(0.0),
+                    ekf_stamp(0.0)
+    {
+    }
+
+  private:
+    /// \brief Reads the parameters and connects the topics
+    void onInit() override
+    {
+      ros::NodeHandle &node_handle = getNodeHandle();
+      ros::NodeHandle &nh = getPrivateNodeHandle();
+
+      std::string left_wheel_joint, right_wheel_joint;
+      auto wheel_base = 0.0, wheel_radius = 0.0;
+      auto publish_frequency = 10.0;
+      auto odometry_history = 2000;
+
+      // trajectory recording
+      auto path_capacity = 5000;
+      auto path_min_distance = 0.01, path_min_angle = 0.05, path_publish_frequency = 1.0;
+      auto path_delta = false;
+
+      nh.getParam("left_wheel_joint", left_wheel_joint);
+      nh.getParam("right_wheel_joint", right_wheel_joint);
+
+      nh.getParam("map_frame_id", map_frame_id);
+      nh.getParam("odom_frame_id", odom_frame_id);
+      nh.getParam("marker_frame_id", marker_frame_id);
+
+      nh.getParam("known_data_association", known_data_association);
+      nh.getParam("publish_frequency", publish_frequency);
+      nh.getParam("odometry_history", odometry_history);
+
+      nh.getParam("path_capacity", path_capacity);
+      nh.getParam("path_min_distance", path_min_distance);
+      nh.getParam("path_min_angle", path_min_angle);
+      nh.getParam("path_publish_frequency", path_publish_frequency);
+      nh.getParam("path_delta", path_delta);
+
+      node_handle.getParam("/wheel_base", wheel_base);
+      node_handle.getParam("/wheel_radius", wheel_radius);
+
+
+      NODELET_INFO("map_frame_id %s", map_frame_id.c_str());
+      NODELET_INFO("odom_frame_id %s", odom_frame_id.c_str());
+      NODELET_INFO("marker_frame_id %s", marker_frame_id.c_str());
+
+      NODELET_INFO("left_wheel_joint %s", left_wheel_joint.c_str());
+      NODELET_INFO("right_wheel_joint %s", right_wheel_joint.c_str());
+
+      NODELET_INFO("wheel_base %f", wheel_base);
+      NODELET_INFO("wheel_radius %f", wheel_radius);
+
+      NODELET_INFO("known_data_association %d", known_data_association);
+      NODELET_INFO("publish_frequency %f", publish_frequency);
+      NODELET_INFO("odometry_history %d", odometry_history);
+
+      NODELET_INFO("path_capacity %d", path_capacity);
+      NODELET_INFO("path_min_distance %f", path_min_distance);
+      NODELET_INFO("path_min_angle %f", path_min_angle);
+      NODELET_INFO("path_publish_frequency %f", path_publish_frequency);
+      NODELET_INFO("path_delta %d", path_delta);
+
+      if (publish_frequency <= 0.0)
+      {
+        throw std::invalid_argument("publish_frequency must be positive");
+      }
+
+      if (odometry_history <= 0)
+      {
+        throw std::invalid_argument("odometry_history must be positive");
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+
+      joint_index = std::make_unique<rigid2d::WheelJointIndex>(left_wheel_joint, right_wheel_joint);
+
+      // Assume pose starts at (0,0,0)
+      pose.theta = 0;
+      pose.x = 0;
+      pose.y = 0;
+
+      // odometry shared by the odometry path and the EKF
+      odometry = std::make_unique<rigid2d::OdometryEngine>(rigid2d::DiffDrive(pose, wheel_base, wheel_radius),
+                                                           odometry_history);
+
+      // number of landmarks in model
+      int n = 25;
+      double md_max = 1e7;//0.30;
+      double md_min = 20000.0;//0.05;
+      ekf = std::make_unique<EKF>(n, md_max, md_min);
+
+      odom_path = std::make_unique<rigid2d::PathPublisher>(node_handle, "odom_path", map_frame_id,
+                                                          path_capacity, path_min_distance, path_min_angle,
+                                                          path_publish_frequency, path_delta);
+
+      ekf_path = std::make_unique<rigid2d::PathPublisher>(node_handle, "slam_path", map_frame_id,
+                                                         path_capacity, path_min_distance, path_min_angle,
+                                                         path_publish_frequency, path_delta);
+
+      gazebo_path = std::make_unique<rigid2d::PathPublisher>(node_handle, "gazebo_path", map_frame_id,
+                                                            path_capacity, path_min_distance, path_min_angle,
+                                                            path_publish_frequency, path_delta);
+
+      diagnostics = std::make_unique<rigid2d::DiagnosticsPublisher>(node_handle, nh, "slam");
+
+      /////////////////////////////////////////////////////////////////////////
+
+      marker_pub = node_handle.advertise<visualization_msgs::MarkerArray>("slam_map", 10);
+      odom_error_pub = node_handle.advertise<tsim::PoseError>("odom_error", 1);
+      slam_error_pub = node_handle.advertise<tsim::PoseError>("slam_error", 1);
+
+      joint_sub = node_handle.subscribe("joint_states", 1, &SlamNodelet::jointStatesCallback, this);
+      map_sub = node_handle.subscribe("landmarks", 1, &SlamNodelet::mapCallBack, this);
+      model_sub = nh.subscribe("/gazebo/model_states", 1, &SlamNodelet::modelCallBack, this);
+
+      publish_timer = node_handle.createTimer(ros::Duration(1.0 / publish_frequency),
+                                              &SlamNodelet::publishCallback, this);
+
+      NODELET_INFO("Successfully launched slam nodelet");
+    }
+
+    /// \brief Retreive gazebo robot pose
+    /// \param model_data - model states in world
+    void modelCallBack(const gazebo_msgs::ModelStates::ConstPtr &model_data)
+    {
+      // index of robot
+      unsigned int robot_index = 0;
+
+      // find diff_drive robot
+      for(unsigned int i = 0; i < model_data->name.size(); i++)
+      {
+        if (model_data->name[i] == "diff_drive")
+        {
+          robot_index = i;
+        }
+      }
+
+      // pose of robot
+      gazebo_robot_pose.header.stamp = ros::Time::now();
+      gazebo_robot_pose.pose.position = model_data->pose[robot_index].position;
+      gazebo_robot_pose.pose.orientation = model_data->pose[robot_index].orientation;
+    }
+
+    /// \brief Update the map
+    /// \param map_msg - recent map
+    void mapCallBack(const TurtleMap::ConstPtr &map_msg)
+    {
+      // the buffer keeps its capacity between scans
+      meas.clear();
+      meas.reserve(map_msg->r.size());
+      for(unsigned int i = 0; i < map_msg->r.size(); i++)
+      {
+        meas.emplace_back(map_msg->cx[i], map_msg->cy[i]);
+      }
+
+      meas_stamp = map_msg->header.stamp.toSec();
+      map_flag = true;
+    }
+
+    /// \brief Updates odometry and the EKF and broadcasts the map to odom transform
+    /// \param msg - contains the encoder readings and joint names
+    void jointStatesCallback(const sensor_msgs::JointState::ConstPtr &msg)
+    {
+      unsigned int left_idx = 0, right_idx = 0;
+      joint_index->lookup(msg->name, left_idx, right_idx);
+
+      const auto left = msg->position.at(left_idx);
+      const auto right = msg->position.at(right_idx);
+
+      // most recent odom update
+      odometry->addEncoders(msg->header.stamp.toSec(), left, right);
+      pose = odometry->pose();
+
+      // update ekf with odometry and sensor measurements once the
+      // odometry reaches the time of the scan
+      if (map_flag && odometry->stamp() >= meas_stamp)
+      {
+        // motion between the previous scan and this one, at the scan times
+        const auto vb = odometry->twistBetween(ekf_stamp, meas_stamp);
+        ekf_stamp = meas_stamp;
+
+        if (known_data_association)
+        {
+          ekf->knownCorrespondenceSLAM(meas, vb);
+        }
+
+        else
+        {
+          ekf->SLAM(meas, vb);
+        }
+
+        map_flag = false;
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+
+      // transform from map to robot
+      Transform2D Tmr = ekf->getRobotState();
+
+      // transform from odom to robot
+      Vector2D vor(pose.x, pose.y);
+      Transform2D Tor(vor, pose.theta);
+
+      // now we can get transform from map to odom
+      Transform2D Tmo = Tmr * Tor.inv();
+      TransformData2D pose_map_odom = Tmo.displacement();
+
+      tf2::Quaternion q_mo;
+      q_mo.setRPY(0, 0, pose_map_odom.theta);
+
+      // broadcast transform between map and odom
+      geometry_msgs::TransformStamped tf_mo;
+      tf_mo.header.stamp = msg->header.stamp;
+      tf_mo.header.frame_id = map_frame_id;
+      tf_mo.child_frame_id = odom_frame_id;
+
+      tf_mo.transform.translation.x = pose_map_odom.x;
+      tf_mo.transform.translation.y = pose_map_odom.y;
+      tf_mo.transform.translation.z = 0.0;
+      tf_mo.transform.rotation = tf2::toMsg(q_mo);
+
+      map_odom_broadcaster.sendTransform(tf_mo);
+    }
+
+    /// \brief Publishes the paths, landmarks, errors, and diagnostics
+    /// \param event - timer event
+    void publishCallback(const ros::TimerEvent &event)
+    {
+      const auto now = event.current_real;
+
+      // transform from map to robot
+      Transform2D Tmr = ekf->getRobotState();
+
+      // ground truth robot heading
+      tf2::Quaternion gazebo_robot_quat(gazebo_robot_pose.pose.orientation.x,
+                                        gazebo_robot_pose.pose.orientation.y,
+                                        gazebo_robot_pose.pose.orientation.z,
+                                        gazebo_robot_pose.pose.orientation.w);
+
+      tf2::Matrix3x3 mat(gazebo_robot_quat);
+      auto roll = 0.0, pitch = 0.0 , yaw = 0.0;
+      mat.getRPY(roll, pitch, yaw);
+
+      /////////////////////////////////////////////////////////////////////////
+
+      // paths from SLAM, odom, and gazebo
+      // only poses that moved far enough from the previous one are kept
+      TransformData2D pose_map_robot = Tmr.displacement();
+      Pose slam_pose;
+      slam_pose.theta = pose_map_robot.theta;
+      slam_pose.x = pose_map_robot.x;
+      slam_pose.y = pose_map_robot.y;
+
+      Pose gazebo_pose;
+      gazebo_pose.theta = yaw;
+      gazebo_pose.x = gazebo_robot_pose.pose.position.x;
+      gazebo_pose.y = gazebo_robot_pose.pose.position.y;
+
+      ekf_path->record(slam_pose, now);
+      odom_path->record(pose, now);
+      gazebo_path->record(gazebo_pose, now);
+
+      ekf_path->publish(now);
+      odom_path->publish(now);
+      gazebo_path->publish(now);
+
+      diagnostics->publish(now);
+
+      /////////////////////////////////////////////////////////////////////////
+
+      // marker array of landmark estimates from the ekf filter
+      std::vector<Vector2D> map;
+      ekf->getMap(map);
+
+      visualization_msgs::MarkerArray::Ptr marker_array = boost::make_shared<visualization_msgs::MarkerArray>();
+      marker_array->markers.resize(map.size());
+
+      for(unsigned int i = 0; i < map.size(); i++)
+      {
+        visualization_msgs::Marker &marker = marker_array->markers[i];
+        marker.header.frame_id = marker_frame_id;
+        marker.header.stamp = now;
+        marker.lifetime = ros::Duration(1.0/ 5.0); // 1/5th sec
+        marker.ns = "marker";
+        marker.id = i;
+
+        marker.type = visualization_msgs::Marker::CYLINDER;
+        marker.action = visualization_msgs::Marker::ADD;
+
+        marker.pose.position.x = map[i].x;
+        marker.pose.position.y = map[i].y;
+        marker.pose.position.z = 0.15;
+        marker.pose.orientation.w = 1.0;
+
+        marker.scale.x = 2.0 * 0.05;
+        marker.scale.y = 2.0 * 0.05;
+        marker.scale.z = 0.1;
+
+        marker.color.b = 1.0f;
+        marker.color.a = 1.0f;
+      }
+      marker_pub.publish(marker_array);
+
+      /////////////////////////////////////////////////////////////////////////
+
+      // odometry error
+      tsim::PoseError odom_error_msg;
+      odom_error_msg.x_error = gazebo_robot_pose.pose.position.x - pose.x;
+      odom_error_msg.y_error = gazebo_robot_pose.pose.position.y - pose.y;
+      odom_error_msg.theta_error = normalize_angle_PI(normalize_angle_PI(yaw) - \
+                                                       normalize_angle_PI(pose.theta));
+
+      // slam error
+      tsim::PoseError slam_error_msg;
+      slam_error_msg.x_error = gazebo_robot_pose.pose.position.x - pose_map_robot.x;
+      slam_error_msg.y_error = gazebo_robot_pose.pose.position.y - pose_map_robot.y;
+      slam_error_msg.theta_error = normalize_angle_PI(normalize_angle_PI(yaw) - \
+                                                       normalize_angle_PI(pose_map_robot.theta));
+
+      odom_error_pub.publish(odom_error_msg);
+      slam_error_pub.publish(slam_error_msg);
+    }
+
+
+    std::string map_frame_id, odom_frame_id, marker_frame_id;  // frames
+    bool known_data_association;                               // EKF runs with or without know data association
+
+    std::unique_ptr<rigid2d::WheelJointIndex> joint_index;     // wheel joints in joint states
+    std::unique_ptr<rigid2d::OdometryEngine> odometry;         // odometry from the wheel encoders
+    Pose pose;                                                 // pose from odometry
+    std::unique_ptr<EKF> ekf;                                  // EKF SLAM
+
+    std::vector<Vector2D> meas;                                // x/y locations of cylinders relative to robot
+    bool map_flag;                                             // map update flag
+    double meas_stamp;                                         // time of the scan the landmarks were found in
+    double ekf_stamp;                                          // time of the scan of the last EKF update
+    geometry_msgs::PoseStamped gazebo_robot_pose;              // pose of robot in gazebo
+
+    std::unique_ptr<rigid2d::PathPublisher> odom_path;         // path from odometry
+    std::unique_ptr<rigid2d::PathPublisher> ekf_path;          // path from SLAM
+    std::unique_ptr<rigid2d::PathPublisher> gazebo_path;       // path from gazebo
+    std::unique_ptr<rigid2d::DiagnosticsPublisher> diagnostics; // timing metrics of the EKF stages
+
+    tf2_ros::TransformBroadcaster map_odom_broadcaster;
+    ros::Publisher marker_pub, odom_error_pub, slam_error_pub;
+    ros::Subscriber joint_sub, map_sub, model_sub;
+    ros::Timer publish_timer;
+  };
+} // end namespace
+
+PLUGINLIB_EXPORT_CLASS(nuslam::SlamNodelet, nodelet::Nodelet)
@@ -7,6 +7,10 @@
 #include <stdexcept>
 #include <iomanip>
 
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
+#include <rigid2d/batch_transform.hpp>
+
 #include "nuslam/ekf_filter.hpp"
 
 
@@ -40,7 +44,8 @@ bool isSPD(const Ref<MatrixXd> A)
     return true;
   }
 
-  std::cout << "Matrix is NOT SPD" << std::endl;
+  RIGID2D_COUNT("ekf.not_spd", 1);
+  RIGID2D_LOG_THROTTLE(1.0, rigid2d::LogLevel::Debug, "ekf.not_spd");
   return false;
 }
 
@@ -111,14 +116,19 @@ EKF::EKF(int num_lm, double md_max, double md_min)
 /// \param u - twist from odometry given wheel velocities
 void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
 {
-  // 1) motion model
+  RIGID2D_SCOPED_TIMER("ekf.slam");
+
   VectorXd state_bar = VectorXd::Zero(state_size);
-  motionUpdate(u, state_bar);
+  MatrixXd sigma_bar = MatrixXd::Zero(state_size, state_size);
+  {
+    RIGID2D_SCOPED_TIMER("ekf.predict");
 
+    // 1) motion model
+    motionUpdate(u, state_bar);
 
-  // 2) propagate uncertainty
-  MatrixXd sigma_bar = MatrixXd::Zero(state_size, state_size);
-  uncertaintyUpdate(u, sigma_bar);
+    // 2) propagate uncertainty
+    uncertaintyUpdate(u, sigma_bar);
+  }
 
   // 3) update state based on observations
   // measurements come in as (x,y) in robot frame
@@ -127,9 +137,6 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
   std::vector<LM> lm_meas(meas.size());
   measRobotToMap(meas, lm_meas);
 
-  std::cout << "--------------------------------------" << std::endl;
-
-
   // for(unsigned int i = 0; i < n; i++)
   for(unsigned int i = 0; i < lm_meas.size(); i++)
   {
@@ -142,9 +149,6 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
       continue;
     }
 
-    std::cout << "Current Number of landmarks: " << N << std::endl;
-
-
     // logic for adding first arguement
     std::vector<double> distances;
     if (N == 0)
@@ -160,52 +164,55 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
 
     // 4) compose mahalanobis distance to all landmarks
     // compute mahalanobis distance to each landmark
-    for(int k = 0; k < N; k++)
     {
+      RIGID2D_SCOPED_TIMER("ekf.associate");
+      for(int k = 0; k < N; k++)
+      {
 
-      // predicted measurement z_hat (r,b)
-      Vector2d z_hat = predictedMeasurement(k, state_bar);
+        // predicted measurement z_hat (r,b)
+        Vector2d z_hat = predictedMeasurement(k, state_bar);
 
-      // measurement jacobian
-      MatrixXd H = MatrixXd::Zero(2, state_size);
-      measurementJacobian(k, state_bar, H);
+        // measurement jacobian
+        MatrixXd H = MatrixXd::Zero(2, state_size);
+        measurementJacobian(k, state_bar, H);
 
-      // Psi
-      MatrixXd Psi = H * sigma_bar * H.transpose() + measurement_noise;
+        // Psi
+        MatrixXd Psi = H * sigma_bar * H.transpose() + measurement_noise;
 
 
-      // difference in measurements delta_z (r,b)
-      Vector2d delta_z;
-      delta_z(0) = m.r - z_hat(0);
-      delta_z(1) = normalize_angle_PI(normalize_angle_PI(m.b) - normalize_angle_PI(z_hat(1)));
+        // difference in measurements delta_z (r,b)
+        Vector2d delta_z;
+        delta_z(0) = m.r - z_hat(0);
+        delta_z(1) = normalize_angle_PI(normalize_angle_PI(m.b) - normalize_angle_PI(z_hat(1)));
 
 
-      // mahalanobis distance
-      double d = delta_z.transpose() * Psi.inverse() * delta_z;
-      distances.push_back(d);
+        // mahalanobis distance
+        double d = delta_z.transpose() * Psi.inverse() * delta_z;
+        distances.push_back(d);
 
 
 
-      if (d < 0)
-      {
-        throw std::invalid_argument("WARNING mahalanobis distance is negative");
-      }
+        if (d < 0)
+        {
+          throw std::invalid_argument("WARNING mahalanobis distance is negative");
+        }
 
-      /////////////////////////////////////////////////////////////////////////
-      // euclidean distance alternative
+        /////////////////////////////////////////////////////////////////////////
+        // euclidean distance alternative
 
-      // const auto est_x = state_bar(2*k + 3);
-      // const auto est_y = state_bar(2*k + 4);
-      // // const auto est_x = state(2*k + 3);
-      // // const auto est_y = state(2*k + 4);
-      // const auto dx = est_x - m.x;
-      // const auto dy = est_y - m.y;
-      // double d = std::sqrt(dx*dx + dy*dy);
-      // distances.push_back(d);
+        // const auto est_x = state_bar(2*k + 3);
+        // const auto est_y = state_bar(2*k + 4);
+        // // const auto est_x = state(2*k + 3);
+        // // const auto est_y = state(2*k + 4);
+        // const auto dx = est_x - m.x;
+        // const auto dy = est_y - m.y;
+        // double d = std::sqrt(dx*dx + dy*dy);
+        // distances.push_back(d);
 
-      /////////////////////////////////////////////////////////////////////////
+        /////////////////////////////////////////////////////////////////////////
 
-    } // end inner for loop
+      } // end inner for loop
+    }
 
     // 5) min mahalanobis distance
     // find index of d* (min mahalanobis distance)
@@ -219,7 +226,7 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
       // d* is bellow d*_min update existing landmark
       if (dstar <= dmin)
       {
-        std::cout << "Updating existing landmark: " << j << std::endl;
+        RIGID2D_COUNT("ekf.landmark_updates", 1);
       }
 
       // d* is above d*_max add new landmark
@@ -233,7 +240,9 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
           // because we index from 0
           j = N;
 
-          std::cout << "Adding new landmark ID: " << j << std::endl;
+          RIGID2D_COUNT("ekf.landmarks_added", 1);
+          RIGID2D_LOG(rigid2d::LogLevel::Debug, "ekf.new_landmark", {{"id", static_cast<double>(j)},
+                                                                     {"landmarks", static_cast<double>(N + 1)}});
           newLandmark(m, j, state_bar);
           lm_j.push_back(j);
 
@@ -247,6 +256,7 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
       // check if landmark has been added to state before update occurs
       if (std::find(lm_j.begin(), lm_j.end(), j) != lm_j.end())
       {
+        RIGID2D_SCOPED_TIMER("ekf.update");
 
         // update based on index d* (j)
         // 6) predicted measurement z_hat (r,b)
@@ -289,14 +299,14 @@ void EKF::SLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
 
   //  Update covariance
   state_cov = sigma_bar;
-
-  std::cout << "--------------------------------------" << std::endl;
 }
 
 
 
 void EKF::knownCorrespondenceSLAM(const std::vector<Vector2D> &meas, const Twist2D &u)
 {
+  RIGID2D_SCOPED_TIMER("ekf.slam");
+
   if(!isSPD(state_cov))
   {
     MatrixXd fixed_cov = MatrixXd::Zero(state_size, state_size);
@@ -305,14 +315,17 @@ void EKF::knownCorrespondenceSLAM(const std::vector<Vector2D> &meas, const Twist
   }
 
 
-  // 1) motion model
   VectorXd state_bar = VectorXd::Zero(state_size);
-  motionUpdate(u, state_bar);
+  MatrixXd sigma_bar = MatrixXd::Zero(state_size, state_size);
+  {
+    RIGID2D_SCOPED_TIMER("ekf.predict");
 
+    // 1) motion model
+    motionUpdate(u, state_bar);
 
-  // 2) propagate uncertainty
-  MatrixXd sigma_bar = MatrixXd::Zero(state_size, state_size);
-  uncertaintyUpdate(u, sigma_bar);
+    // 2) propagate uncertainty
+    uncertaintyUpdate(u, sigma_bar);
+  }
 
   // 3) update state based on observations
   // measurements come in as (x,y) in robot frame
@@ -321,8 +334,6 @@ void EKF::knownCorrespondenceSLAM(const std::vector<Vector2D> &meas, const Twist
   std::vector<LM> lm_meas(meas.size());
   measRobotToMap(meas, lm_meas);
 
-  std::cout << "--------------------------------------" << std::endl;
-
   // for(const auto &m : lm_meas)
   for(unsigned int i = 0; i < lm_meas.size(); i++)
   // LM m = lm_meas.at(0);
@@ -360,6 +371,8 @@ void EKF::knownCorrespondenceSLAM(const std::vector<Vector2D> &meas, const Twist
     }
 
 
+    RIGID2D_SCOPED_TIMER("ekf.update");
+
     // 4) predicted measurement z_hat (r,b)
     Vector2d z_hat = predictedMeasurement(j, state_bar);
 
@@ -406,8 +419,6 @@ void EKF::knownCorrespondenceSLAM(const std::vector<Vector2D> &meas, const Twist
 
   // 9) Update covariance
   state_cov = sigma_bar;
-
-  std::cout << "--------------------------------------" << std::endl;
 }
 
 
@@ -486,6 +497,10 @@ void EKF::initFilter()
   measurement_noise(1,1) = 1e-8;   // b var
   // std::cout << measurement_noise << std::endl;
 
+  // factorize the constant noise covariances once
+  motion_sampler.setCovariance(motion_noise);
+  measurement_sampler.setCovariance(measurement_noise);
+
   ////////////////////////////////////////////
 
   // init process noise
@@ -503,7 +518,7 @@ void EKF::motionUpdate(const Twist2D &u, Ref<VectorXd> state_bar) const
   state_bar = state;
 
   // sample noise
-  VectorXd w = sampleMultivariateDistribution(motion_noise);
+  const VectorXd w = motion_sampler.sample();
 
 
   // update robot pose based on odometry
@@ -609,7 +624,7 @@ Vector2d EKF::predictedMeasurement(const int j, const Ref<VectorXd> state_bar) c
   const auto delta_y = state_bar(jy) - state_bar(2);
 
   // measurement noise
-  VectorXd v = sampleMultivariateDistribution(measurement_noise);
+  const VectorXd v = measurement_sampler.sample();
 
   Vector2d z_hat;
 
@@ -626,24 +641,29 @@ Vector2d EKF::predictedMeasurement(const int j, const Ref<VectorXd> state_bar) c
 
 void EKF::measRobotToMap(const std::vector<Vector2D> &meas, std::vector<LM> &lm_meas) const
 {
+  // frame: robot -> map
+  rigid2d::PointBatchd points;
+  points.reserve(meas.size());
+  for(const auto &m : meas)
+  {
+    points.push_back(m.x, m.y);
+  }
+
+  const Transform2D Tmr(Vector2D(state(1), state(2)), state(0));
+  rigid2d::transformPoints(Tmr, points, points);
+
   for(unsigned int i = 0; i < meas.size(); i++)
   {
     const auto mx = meas.at(i).x;
     const auto my = meas.at(i).y;
 
     // to polar coordinates
-    const auto r = std::sqrt(mx * mx + my *my);
-
     // TODO: check this bearing
-    const auto b = std::atan2(my, mx);
-
-    lm_meas.at(i).r = r;
-    lm_meas.at(i).b = b;
-
-    // // frame: robot -> map
-    lm_meas.at(i).x = state(1) + r * std::cos(b + state(0));
-    lm_meas.at(i).y = state(2) + r * std::sin(b + state(0));
+    lm_meas.at(i).r = std::sqrt(mx * mx + my *my);
+    lm_meas.at(i).b = std::atan2(my, mx);
 
+    lm_meas.at(i).x = points.x[i];
+    lm_meas.at(i).y = points.y[i];
   }
 }
 
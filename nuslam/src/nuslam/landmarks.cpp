@@ -252,6 +252,8 @@ Landmarks::Landmarks(const LaserProperties &props, double epsilon)
                             mux_max(135.0),
                             num_points(4)
 {
+  // angles of one revolution, a beam at beam_max is part of the scan
+  rigid2d::beamDirections(rigid2d::beamAngles(beam_min, beam_max, beam_delta, true), beam_dirs);
 }
 
 
@@ -314,39 +316,16 @@ void Landmarks::featureDetection(const std::vector<float> &beam_length)
 void Landmarks::laserEndPoints(std::vector<Vector2D> &end_points,
                                   const std::vector<float> &beam_length) const
 {
+  // beams within the range limits in the frame of the scanner
+  rigid2d::PointBatchd points;
+  rigid2d::scanEndPoints(rigid2d::Transform2D(), beam_length, beam_dirs,
+                         range_min, range_max, points);
 
-  auto beam_angle = beam_min;
-  auto range = 0.0;
-
-
-  for(unsigned int i = 0; i < beam_length.size(); i++)
+  end_points.reserve(end_points.size() + points.size());
+  for(unsigned int i = 0; i < points.size(); i++)
   {
-    range = beam_length.at(i);
-
-    if (range >= range_min and range < range_max)
-    {
-      Vector2D point = range2Cartesian(range, beam_angle);
-      end_points.push_back(point);
-    }
-
-
-    // update beam angle
-    beam_angle += beam_delta;
-
-    // max angle is negative
-    if (beam_max < 0 and beam_angle < beam_max)
-    {
-      beam_angle = beam_min;
-    }
-
-    // max angle is positive
-    else if (beam_max >= 0 and beam_angle > beam_max)
-    {
-      beam_angle = beam_min;
-    }
-
-  } // end loop
-
+    end_points.emplace_back(points.x[i], points.y[i]);
+  }
 }
 
 
@@ -4,9 +4,14 @@
 /// \author Boston Cleek
 /// \date 6/3/20
 ///
+/// PARAMETERS:
+///   cmd_frequency - rate the twist is published
+///   diagnostics_frequency - rate the MPPI latency is published
+///   trace_file - writes a Chrome trace of the controller on shutdown if set
 /// PUBLISHES:
 ///   cmd_vel (geometry_msgs/Twist): twist in body frame
 ///   odom_path (nav_msgs/Path): path executed by robot
+///   /diagnostics (diagnostic_msgs/DiagnosticArray): MPPI latency
 /// SUBSCRIBES:
 ///   odom (nav_msgs/Odometry): Pose of robot in odom frame
 /// SEERVICES:
@@ -35,11 +40,16 @@
 #include <chrono>
 #include <cmath>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include <eigen3/Eigen/Dense>
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/utilities.hpp>
 #include <rigid2d/diff_drive.hpp>
+#include <rigid2d/ros_instrumentation.hpp>
+#include <rigid2d/node_runtime.hpp>
+#include <rigid2d/compute_stage.hpp>
 #include <controller/rk4.hpp>
 #include <controller/mppi.hpp>
 #include <rigid2d/set_pose.h>
@@ -49,8 +59,8 @@
 static rigid2d::Pose pose;                  // current pose of robot
 static int wpt_id;                          // waypoint number
 static bool odom_msg;                       // odometry message
-static bool start_call;                     // call to start motion activated
-static bool stop_call;                      // call to stop motion activated
+static std::atomic<bool> start_call;        // call to start motion activated
+static std::atomic<bool> stop_call;         // call to stop motion activated
 
 
 
@@ -125,6 +135,7 @@ int main(int argc, char** argv)
 
   // threshold to goal
   auto goal_thresh = 0.0;
+  auto cmd_frequency = 60.0;           // rate the twist is published
 
   // frame of trajectory
   std::string frame_id;
@@ -151,6 +162,7 @@ int main(int argc, char** argv)
   nh.getParam("R", R);
   nh.getParam("P1", P1);
   nh.getParam("goal_thresh", goal_thresh);
+  nh.getParam("cmd_frequency", cmd_frequency);
   nh.getParam("odom_frame_id", frame_id);
   nh.getParam("x_component", waypoint_x);
   nh.getParam("y_component", waypoint_y);
@@ -219,90 +231,95 @@ int main(int argc, char** argv)
   // nav_msgs::Path odom_path;
   // odom_path.header.frame_id = frame_id;
 
+  // MPPI latency
+  rigid2d::DiagnosticsPublisher diagnostics(node_handle, nh, "mppi");
+
   auto cnt = 0;
+  std::atomic<bool> cycle_complete(false);
+
+  // latest pose handed to the controller and the twist it produced
+  std::mutex control_mtx;
+  rigid2d::Pose control_pose;
   geometry_msgs::Twist twist_msg;
-  bool cycle_complete = false;
 
-  while(node_handle.ok())
+  // MPPI runs on its own thread so odometry and service callbacks are
+  // never blocked by the rollouts, odometry that arrives while it runs
+  // is merged into a single update with the latest pose
+  rigid2d::ComputeStage control_stage([&]()
   {
-    ros::spinOnce();
+    rigid2d::Pose ps;
+    {
+      std::lock_guard<std::mutex> lock(control_mtx);
+      ps = control_pose;
+    }
 
-    // update constrols
-    if (odom_msg and start_call)
+    // distance to goal
+    const auto d2g = rigid2d::euclideanDistance(wpt.x, wpt.y, ps.x, ps.y);
+    if (d2g < goal_thresh)
     {
-      // distance to goal
-      const auto d2g = rigid2d::euclideanDistance(wpt.x, wpt.y, pose.x, pose.y);
-      // std::cout << "Distance to goal: " << d2g << std::endl;
-      if (d2g < goal_thresh)
+      ROS_INFO("Reached Waypoint %d", wpt_id);
+
+      wpt_id++;
+      cnt++;
+      if (wpt_id % waypoint_x.size() == 0)
       {
-        ROS_INFO("Reached Waypoint %d", wpt_id);
-
-        wpt_id++;
-        cnt++;
-        if (wpt_id % waypoint_x.size() == 0)
-        {
-          wpt_id = 0;
-        }
-
-        if (cnt == static_cast<int>(waypoint_x.size()+1))
-        {
-          cycle_complete = true;
-          ROS_INFO("One cycle complete");
-        }
-
-        wpt.x = waypoint_x.at(wpt_id);
-        wpt.y = waypoint_y.at(wpt_id);
-        wpt.theta = waypoint_theta.at(wpt_id);
-
-        mppi.setWaypoint(wpt);
+        wpt_id = 0;
       }
 
-      // ////////////////////////////////////////////////////////////////////////////
-      // // START TIMR
-      // const auto start = std::chrono::high_resolution_clock::now();
-      // ////////////////////////////////////////////////////////////////////////////
-
-      rigid2d::WheelVelocities wheel_vel = mppi.newControls(pose);
+      if (cnt == static_cast<int>(waypoint_x.size()+1))
+      {
+        cycle_complete = true;
+        ROS_INFO("One cycle complete");
+      }
 
-      // ////////////////////////////////////////////////////////////////////////////
-      // // STOP TIMER
-      // const auto stop = std::chrono::high_resolution_clock::now();
-      // const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
-      // std::cout.precision(5);
-      // std::cout << "Freq: " << (double)(1.0/(duration.count()/1000.0)) << " (Hz)" << std::endl;
-      // //////////////////////////////////////////////////////////////////////////
+      wpt.x = waypoint_x.at(wpt_id);
+      wpt.y = waypoint_y.at(wpt_id);
+      wpt.theta = waypoint_theta.at(wpt_id);
 
+      mppi.setWaypoint(wpt);
+    }
 
-      rigid2d::Twist2D cmd = diff_drive.wheelsToTwist(wheel_vel);
+    // latency is published as mppi.new_controls on /diagnostics
+    rigid2d::WheelVelocities wheel_vel = mppi.newControls(ps);
+    rigid2d::Twist2D cmd = diff_drive.wheelsToTwist(wheel_vel);
 
-      twist_msg.linear.x = cmd.vx;
-      twist_msg.angular.z = cmd.w;
+    std::lock_guard<std::mutex> lock(control_mtx);
+    twist_msg.linear.x = cmd.vx;
+    twist_msg.angular.z = cmd.w;
+  });
 
-      odom_msg = false;
-    }
 
-    // publish twist and markers if robot started
+  // the twist is published at a fixed rate, the controller only
+  // updates it when new odometry arrives
+  rigid2d::NodeRuntime runtime(node_handle);
+  runtime.every(cmd_frequency, [&](const ros::Time &now)
+  {
+    // publish twist if robot started
     if (!stop_call and !cycle_complete)
     {
+      std::lock_guard<std::mutex> lock(control_mtx);
       cmd_pub.publish(twist_msg);
     }
 
+    diagnostics.publish(now);
+  });
 
-    // tf2::Quaternion q_or;
-    // q_or.setRPY(0, 0, pose.theta);
-    // geometry_msgs::Quaternion quat_or;
-    // quat_or = tf2::toMsg(q_or);
-    //
-    // geometry_msgs::PoseStamped odom_pose;
-    // odom_pose.header.stamp = ros::Time::now();
-    // odom_pose.pose.position.x = pose.x;
-    // odom_pose.pose.position.y = pose.y;
-    // odom_pose.pose.orientation = quat_or;
-    //
-    // // odom_path.poses.emplace_back(odom_pose);
-    //
-    // odom_path_pub.publish(odom_path);
-  }
+  runtime.spin([&]()
+  {
+    // update constrols
+    if (odom_msg and start_call)
+    {
+      {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        control_pose = pose;
+      }
+      control_stage.trigger();
+
+      odom_msg = false;
+    }
+  });
+
+  control_stage.stop();
 
   return 0;
 }
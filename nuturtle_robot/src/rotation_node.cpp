@@ -23,6 +23,7 @@
 #include "nuturtle_robot/start.h"
 #include "rigid2d/set_pose.h"
 #include "rigid2d/rigid2d.hpp"
+#include "rigid2d/node_runtime.hpp"
 
 
 // global variable
@@ -215,11 +216,10 @@ int main(int argc, char** argv)
   ROS_INFO("Timer calls per translate %d\n", one_trans);
   ROS_INFO("Timer calls per 1/10 translate %d\n", one_ten_trans);
 
-  while(node_handle.ok())
+  // runs after each timer tick or start request
+  rigid2d::NodeRuntime runtime(node_handle);
+  runtime.spin([&]()
   {
-    ros::spinOnce();
-
-
     // start service as set direction
     if (rotation_srv_flag)
     {
@@ -345,7 +345,7 @@ int main(int argc, char** argv)
     // ROS_INFO("rot %f", rot);
 
 
-  }
+  });
 
 
   return 0;
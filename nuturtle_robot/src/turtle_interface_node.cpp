@@ -26,6 +26,7 @@
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/diff_drive.hpp>
+#include <rigid2d/node_runtime.hpp>
 #include <nuturtlebot/WheelCommands.h>
 #include <nuturtlebot/SensorData.h>
 
@@ -125,9 +126,10 @@ int main(int argc, char** argv)
 
 
 
-  while(node_handle.ok())
+  // sleeps until a command or sensor reading arrives
+  rigid2d::NodeRuntime runtime(node_handle);
+  runtime.spin([&]()
   {
-    ros::spinOnce();
     current_time = ros::Time::now();
     last_time = current_time;
 
@@ -205,7 +207,7 @@ int main(int argc, char** argv)
       joint_pub.publish(joint_state);
     }
 
-  }
+  });
 
   return 0;
 }
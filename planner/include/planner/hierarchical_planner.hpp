@@ -0,0 +1,237 @@
+#ifndef HIERARCHICAL_PLANNER_GUARD_HPP
+#define HIERARCHICAL_PLANNER_GUARD_HPP
+// \file
+/// \brief Jump Point Search and HPA* on a static 2D grid
+
+#include <iosfwd>
+#include <utility>
+#include <vector>
+#include <queue>
+
+#include <rigid2d/rigid2d.hpp>
+#include "planner/grid_map.hpp"
+
+
+namespace planner
+{
+  using rigid2d::Vector2D;
+
+
+  /// \brief Inclusive bounds of the cells a search may visit
+  struct GridBox
+  {
+    int imin = 0;     // min row
+    int imax = -1;    // max row
+    int jmin = 0;     // min column
+    int jmax = -1;    // max column
+  };
+
+
+  /// \brief Grid planner for static maps using 8-connected moves,
+  ///        diagonal moves may not cut the corner of an occupied cell.
+  ///
+  /// planJPS() runs Jump Point Search over the full grid. planHPA() searches
+  /// an abstract graph of the entrances between square sectors of the grid
+  /// and only refines the abstract path with JPS inside the sectors it passes
+  /// through. The abstract graph is built once in the constructor.
+  class HierarchicalPlanner
+  {
+  public:
+    /// \brief Construct the planner and the abstract graph
+    /// \param gridmap - 2D grid, the cells must be labeled
+    /// \param sector_size - number of cells along the edge of a sector
+    HierarchicalPlanner(const GridMap &gridmap, unsigned int sector_size);
+
+    /// \brief Plans a path with Jump Point Search
+    /// \param start - start configuration
+    /// \param goal - goal configuration
+    /// \return true if path is found
+    bool planJPS(const Vector2D &start, const Vector2D &goal);
+
+    /// \brief Plans a path on the sector abstraction and refines it
+    /// \param start - start configuration
+    /// \param goal - goal configuration
+    /// \return true if path is found
+    bool planHPA(const Vector2D &start, const Vector2D &goal);
+
+    /// \brief Retreive the shortest path
+    /// path[out] - (x/y) locations of each cell in the path
+    void getPath(std::vector<Vector2D> &path) const;
+
+    /// \brief Retreive the cells expanded by the last query, usefull for debugging
+    /// cells[out] - (x/y) locations of the cells
+    void getVisited(std::vector<Vector2D> &cells) const;
+
+    /// \brief Length of the last path
+    /// \return path length in world units
+    double pathLength() const;
+
+    /// \brief Number of nodes in the abstract graph
+    /// \return number of entrance nodes
+    unsigned int numAbstractNodes() const;
+
+  private:
+    /// \brief Edge in the abstract graph
+    struct AbstractEdge
+    {
+      int id = -1;            // ID of abstract node
+      double d = 0.0;         // cost in cells
+    };
+
+    /// \brief Node in the abstract graph
+    struct AbstractNode
+    {
+      int cell = -1;                      // cell ID in grid
+      int sector = -1;                    // sector containing the cell
+      std::vector<AbstractEdge> edges;    // adjacent abstract nodes
+    };
+
+    /// \brief Entry in the open list
+    struct OpenEntry
+    {
+      double f = 0.0;         // total cost
+      double g = 0.0;         // true cost when pushed
+      int id = -1;            // cell or abstract node ID
+    };
+
+    /// \brief Orders the open list as a min heap
+    struct SortCost
+    {
+      /// \param a - entry to compare
+      /// \param b - entry to compare
+      /// \return true if cost of a is larger than b
+      bool operator()(const OpenEntry &a, const OpenEntry &b) const
+      {
+        return a.f > b.f;
+      }
+    };
+
+    typedef std::priority_queue<OpenEntry, std::vector<OpenEntry>, SortCost> open_queue;
+
+    /// \brief Builds the entrances and intra-sector edges of the abstraction
+    void buildAbstraction();
+
+    /// \brief Adds the entrances along the border of two sectors
+    /// \param i0 - row of the first cell on the border
+    /// \param j0 - column of the first cell on the border
+    /// \param di - row step along the border
+    /// \param dj - column step along the border
+    /// \param oi - row offset to the cell across the border
+    /// \param oj - column offset to the cell across the border
+    /// \param len - number of cells along the border
+    void addEntrances(int i0, int j0, int di, int dj, int oi, int oj, int len);
+
+    /// \brief Abstract node at a cell, created if there is none
+    /// \param cell - cell ID
+    /// \return ID of abstract node
+    int abstractNode(int cell);
+
+    /// \brief Connects an abstract node to the other nodes in its sector
+    /// \param id - ID of abstract node
+    void connectInSector(int id);
+
+    /// \brief Removes the start/goal nodes added for a query
+    /// \param num_nodes - number of abstract nodes before the query
+    void removeQueryNodes(unsigned int num_nodes);
+
+    /// \brief Search the abstract graph
+    /// \param start - ID of start abstract node
+    /// \param goal - ID of goal abstract node
+    /// nodes[out] - IDs of abstract nodes in the path
+    /// \return true if path is found
+    bool searchAbstract(int start, int goal, std::vector<int> &nodes);
+
+    /// \brief A* or Dijkstra with unit moves
+    /// \param start - start cell ID
+    /// \param goal - goal cell ID, -1 expands all reachable cells in the box
+    /// \param box - cells the search may visit
+    /// \return true if the goal is found
+    bool searchGrid(int start, int goal, const GridBox &box);
+
+    /// \brief Jump Point Search
+    /// \param start - start cell ID
+    /// \param goal - goal cell ID
+    /// \param box - cells the search may visit
+    /// \return true if the goal is found
+    bool searchJPS(int start, int goal, const GridBox &box);
+
+    /// \brief Scans from a cell in one direction for the next jump point
+    /// \param i - row of first cell
+    /// \param j - column of first cell
+    /// \param di - row direction
+    /// \param dj - column direction
+    /// \param goal - goal cell ID
+    /// \param box - cells the search may visit
+    /// \return cell ID of the jump point, -1 if there is none
+    int jump(int i, int j, int di, int dj, int goal, const GridBox &box) const;
+
+    /// \brief Directions to search from a jump point given its parent
+    /// \param id - cell ID of jump point
+    /// \param parent_id - cell ID of parent, -1 at the start
+    /// \param box - cells the search may visit
+    /// dirs[out] - row/column directions
+    void prunedDirections(int id, int parent_id, const GridBox &box,
+                          std::vector<std::pair<int, int>> &dirs) const;
+
+    /// \brief Appends the cells from the search goal back to the start
+    /// \param goal - goal cell ID of the search
+    /// cells[out] - cells in order from start to goal, the start is left out
+    void appendCells(int goal, std::vector<int> &cells) const;
+
+    /// \brief Clears the state left by the previous search
+    void resetSearch();
+
+    /// \brief Checks if a cell is free and inside the box
+    /// \param i - row in the grid
+    /// \param j - column in the grid
+    /// \param box - cells the search may visit
+    /// \return true if the cell can be traversed
+    bool freeCell(int i, int j, const GridBox &box) const;
+
+    /// \brief Cells of the sector containing a cell
+    /// \param cell - cell ID
+    /// \return bounds of the sector
+    GridBox sectorBox(int cell) const;
+
+    /// \brief Sector containing a cell
+    /// \param cell - cell ID
+    /// \return sector ID
+    int sectorID(int cell) const;
+
+    /// \brief Octile distance between cells
+    /// \param id1 - ID of first cell
+    /// \param id2 - ID of second cell
+    /// \return cost in cells
+    double octile(int id1, int id2) const;
+
+    /// \brief Converts a world position to a cell ID
+    /// \param p - position
+    /// \return cell ID, -1 if the cell is not free
+    int worldCell(const Vector2D &p) const;
+
+
+    const GridMap &gridmap;                   // 2D grid
+    int xsize, ysize;                         // number of rows and columns
+    int sector_size;                          // cells along the edge of a sector
+    int sectors_i, sectors_j;                 // number of sectors along rows and columns
+    GridBox full_box;                         // all cells in the grid
+    std::vector<char> blocked;                // true if a cell can not be traversed
+
+    // abstract graph
+    std::vector<AbstractNode> abs_nodes;      // entrances
+    std::vector<std::vector<int>> sector_nodes; // abstract node IDs in each sector
+    std::vector<int> cell_node;               // abstract node ID of each cell, -1 if none
+
+    // dense per search state indexed by cell ID
+    std::vector<double> g;                    // true cost from start to cell
+    std::vector<int> parent;                  // ID of parent cell
+    std::vector<bool> closed;                 // closed set as a bitset
+    std::vector<int> touched;                 // IDs of cells with non default state
+    open_queue open_list;                     // cells currently being considered
+
+    std::vector<int> path;                    // cell IDs in the path
+    std::vector<int> visited;                 // cell IDs expanded by the last query
+  };
+} // end namespace
+
+#endif
@@ -5,6 +5,8 @@
 
 #include <cmath>
 #include <vector>
+#include <thread>
+#include <algorithm>
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/utilities.hpp>
@@ -68,6 +70,54 @@ namespace planner
                               const Vector2D &p2,
                               const Vector2D &p3);
 
+  /// \brief Number of worker threads to use when none are specified
+  /// \returns - number of hardware threads, at least 1
+  inline unsigned int defaultNumThreads()
+  {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  /// \brief Splits [begin, end) into contiguous chunks and runs each
+  ///        chunk on its own thread. The chunks are assigned in order so
+  ///        chunk t always covers lower indices than chunk t+1.
+  /// \param begin - first index
+  /// \param end - one past the last index
+  /// \param num_threads - number of threads to split the range across
+  /// \param func - callable as func(thread_id, lo, hi)
+  template <typename Func>
+  void parallelFor(unsigned int begin, unsigned int end,
+                   unsigned int num_threads, Func func)
+  {
+    if (end <= begin)
+    {
+      return;
+    }
+
+    const auto count = end - begin;
+    num_threads = std::max(1u, std::min(num_threads, count));
+    const auto chunk = (count + num_threads - 1) / num_threads;
+
+    // no need to spawn a thread for a single chunk
+    if (num_threads == 1)
+    {
+      func(0u, begin, end);
+      return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(num_threads);
+    for(unsigned int t = 0; t < num_threads; t++)
+    {
+      const auto lo = std::min(end, begin + t * chunk);
+      const auto hi = std::min(end, lo + chunk);
+      workers.emplace_back(func, t, lo, hi);
+    }
+
+    for(auto &worker : workers)
+    {
+      worker.join();
+    }
+  }
 
 
 
@@ -60,21 +60,90 @@ namespace planner
     /// path[out] - (x/y) locations of each node
     void getPath(std::vector<Vector2D> &path) const;
 
+    /// \brief Precomputes the signed distance and repulsive gradient on a grid.
+    ///        Afterwards the repulsive gradient inside the bounds is a
+    ///        bilinear lookup instead of a search over all obstacle edges.
+    /// \param xmin - min x coordinate of the field
+    /// \param xmax - max x coordinate of the field
+    /// \param ymin - min y coordinate of the field
+    /// \param ymax - max y coordinate of the field
+    /// \param resolution - spacing of the grid samples
+    /// \param num_threads - threads used to build the field (0 uses all cores)
+    void buildField(double xmin, double xmax,
+                    double ymin, double ymax,
+                    double resolution,
+                    unsigned int num_threads = 0);
+
+    /// \brief Signed distance to the closest obstacle
+    /// \param p - query position
+    /// \return distance, negative inside an obstacle
+    double signedDistance(const Vector2D &p) const;
+
+    /// \brief Gradient of the signed distance, points away from the closest obstacle
+    /// \param p - query position
+    /// \return gradient 2D (dd/dx, dd/dy), zero if the field is not built
+    Vector2D distanceGradient(const Vector2D &p) const;
+
+    /// \brief Gradient descent from many starts to the same goal.
+    ///        Does not modify the planner's own path.
+    /// \param starts - starting positions
+    /// \param goal - goal position
+    /// \param max_iter - max gradient descent steps per start
+    /// \param num_threads - threads used for the descents (0 uses all cores)
+    /// paths[out] - path for each start
+    /// reached[out] - true if the path for each start reached the goal
+    /// \return number of paths that reached the goal
+    unsigned int planPaths(const std::vector<Vector2D> &starts,
+                           const Vector2D &goal,
+                           unsigned int max_iter,
+                           std::vector<std::vector<Vector2D>> &paths,
+                           std::vector<bool> &reached,
+                           unsigned int num_threads = 0) const;
+
   private:
     /// \brief Compose the accumulative repulsive gradient
-    ///        from closes point on each obstacle to current position
+    ///        from closes point on each obstacle to a position
+    /// \param p - position
+    /// \return cummulative gradient 2D (du/dx, du/dy)
+    Vector2D accumulateRepulsiveGradient(const Vector2D &p) const;
+
+    /// \brief Repulsive gradient from the field if it covers the position
+    ///        otherwise from the obstacles
+    /// \param p - position
     /// \return cummulative gradient 2D (du/dx, du/dy)
-    Vector2D accumulateRepulsiveGradient() const;
+    Vector2D repulsiveGradientAt(const Vector2D &p) const;
 
-    /// \brief Compose repulsive gradient from a single obstacle to current position
+    /// \brief Compose repulsive gradient from a single obstacle to a position
+    /// \param p - position
     /// \param q0 - closes point on an obstacle
-    /// \param d - euclidean distance from  current position (q) to closest point (q0)
+    /// \param d - euclidean distance from position (p) to closest point (q0)
     /// \return repulsive gradient 2D (du/dx, du/dy)
-    Vector2D repulsiveGradient(const Vector2D &q0, double d) const;
+    Vector2D repulsiveGradient(const Vector2D &p, const Vector2D &q0, double d) const;
 
     /// \brief Compose attractive gradient to goal
+    /// \param p - position
+    /// \param goal - goal position
     /// \return attractive gradient 2D (du/dx, du/dy)
-    Vector2D attractiveGradient() const;
+    Vector2D attractiveGradient(const Vector2D &p, const Vector2D &goal) const;
+
+    /// \brief Compose the signed distance to the closest obstacle edge
+    /// \param p - position
+    /// \return distance, negative inside an obstacle
+    double exactSignedDistance(const Vector2D &p) const;
+
+    /// \brief Bilinear interpolation weights of a position in the field
+    /// \param p - position
+    /// idx[out] - index of the lower left sample
+    /// tx[out] - fraction along x from the lower left sample
+    /// ty[out] - fraction along y from the lower left sample
+    /// \return true if the position is inside the field
+    bool fieldCell(const Vector2D &p, unsigned int &idx, double &tx, double &ty) const;
+
+    /// \brief One step of gradient descent from a position
+    /// \param p - position
+    /// \param goal - goal position
+    /// \return next position
+    Vector2D descentStep(const Vector2D &p, const Vector2D &goal) const;
 
     /// \brief Within tolerance of goal
     /// \returns true if within tolerance
@@ -94,6 +163,14 @@ namespace planner
     double w_att, w_rep;                // weight the attractive and repulsive gradient
     bool goal_reached;                  // path complete
 
+    // precomputed field, samples stored row major
+    bool use_field;                     // true once the field is built
+    double field_xmin, field_ymin;      // position of the first sample
+    double field_res;                   // spacing of the samples
+    unsigned int field_cols, field_rows;// number of samples along x and y
+    std::vector<double> sdf;            // signed distance to closest obstacle
+    std::vector<Vector2D> rep_field;    // accumulated repulsive gradient
+
   };
 } // end namespace
 
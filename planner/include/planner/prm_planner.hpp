@@ -6,8 +6,6 @@
 #include <vector>
 #include <iosfwd>
 #include <queue>
-#include <unordered_set>
-#include <set>
 
 #include "planner/planner_utilities.hpp"
 #include "planner/road_map.hpp"
@@ -18,52 +16,62 @@ namespace planner
   using rigid2d::euclideanDistance;
 
 
-  /// \brief Sort based on the total cost
-  struct SortCost
+  /// \brief Entry in the open list, entries are never updated in place.
+  ///        A cheaper path to a node pushes a new entry and the stale one
+  ///        is skipped when it is popped (lazy deletion).
+  struct OpenEntry
   {
-    /// \brief Sorts nodes
-    /// \param a - node to compare
-    /// \param b - node to compare
-    /// \return true if cost of a is smaller than b
-    bool operator()(const Node &a, const Node &b) const
-    {
-      return a.f < b.f;
-    }
+    double f = 0.0;                 // total cost = true cost + heuristic cost
+    double g = 0.0;                 // true cost from start to node when pushed
+    int id = -1;                    // node ID
   };
 
-  /// \brief Finds a node in base its ID
-  struct MatchesID
+  /// \brief Sort based on the total cost
+  struct SortCost
   {
-    int id; // cell ID
-
-    /// param id - the ID of a cell
-    MatchesID(int id): id(id) {}
-
-    /// \param a - node to look for
-    bool operator()(const Node &n) const
+    /// \brief Orders the open list as a min heap
+    /// \param a - entry to compare
+    /// \param b - entry to compare
+    /// \return true if cost of a is larger than b
+    bool operator()(const OpenEntry &a, const OpenEntry &b) const
     {
-        return n.id == id;
+      return a.f > b.f;
     }
   };
 
 
   /// \brief Theta* shortest path planner
+  ///
+  /// The planner only references the road map and keeps all per query
+  /// state itself. Several planners may search the same road map at once
+  /// from different threads as long as the road map is not modified.
+  /// Lazily validated edges are checked through RoadMap::edgeFree which
+  /// is safe to call concurrently.
   class PRMPlanner
   {
   public:
     /// \brief Construct a global path planner
-    /// \param prm - a probabilisitc road map
-    PRMPlanner(RoadMap &prm);
+    /// \param prm - a probabilisitc road map, must outlive the planner
+    PRMPlanner(const RoadMap &prm);
 
-    /// \brief Plans a path from start to goal on the PRM
+    /// \brief Plans a path from the start to the goal added to the PRM
     /// \return true if path is founc
     bool planPath();
 
+    /// \brief Plans a path between two nodes on the PRM
+    /// \param start - ID of start node
+    /// \param goal - ID of goal node
+    /// \return true if path is founc
+    bool planPath(int start, int goal);
+
     /// \brief Coordinates of nodes in path
     /// path[out] - (x/y) locations of each node
-    void getPath(std::vector<Vector2D> &path);
+    void getPath(std::vector<Vector2D> &path) const;
 
   private:
+    /// \brief Clears the state left by the previous query
+    void resetQuery();
+
     /// \brief Add/examines the neighboring cells of the current min node
     void exploreNeighbors();
 
@@ -74,19 +82,20 @@ namespace planner
     /// \brief Compose the heuristic cost of a node
     /// \param id - the node ID
     /// \return - heuristic cost of node
-    double heuristic(const int id);
-
-
-    RoadMap prm;                              // probabilisitc road map
-    std::vector<Node> roadmap;                // graph structure of road map
-    std::vector<Node> open_list;              // open list, nodes currently being considered
-    std::unordered_set<int> closed_set;       // closed set, nodes that were once on the open list
-    int start_id, goal_id, curr_id;           // ID of start/goal/current node in roadmap
-
+    double heuristic(const int id) const;
 
 
+    const RoadMap &prm;                       // probabilisitc road map
 
+    // dense per query state indexed by node ID
+    std::vector<double> g;                    // true cost from start to node
+    std::vector<int> parent;                  // ID of parents node
+    std::vector<bool> closed;                 // closed set as a bitset
+    std::vector<int> touched;                 // IDs of nodes with non default state
 
+    // open list, nodes currently being considered
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, SortCost> open_list;
+    int start_id, goal_id, curr_id;           // ID of start/goal/current node in roadmap
   };
 } // end namespace
 
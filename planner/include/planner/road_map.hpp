@@ -6,7 +6,11 @@
 
 #include <vector>
 #include <iosfwd>
-#include <unordered_set>
+#include <random>
+#include <utility>
+#include <string>
+#include <atomic>
+#include <cstdint>
 
 
 #include <rigid2d/rigid2d.hpp>
@@ -29,29 +33,33 @@ namespace planner
   };
 
 
-  /// \brief Node in the road map
+  /// \brief Node in the road map, planning state such as costs and
+  ///        parents is kept per query by the planner
   struct Node
   {
-    // used for road map construction
     int id = -1;                            // nodes id, index in nodes
     Vector2D point;                         // (x,y) location in world
-    std::vector<Edge> edges;                // edges to other nodes
-    std::unordered_set<int> id_set;         // id of adjacent nodes
-
-    // used for planning
-    int parent_id = -1;                     // ID of parents node
-    double f = 0.0;                         // total cost = true cost + heuristic cost
-    double g = 0.0;                         // true cost from start to node
-
-
-    /// \brief Checks if edge exists in the id_map
-    /// \param id - id of node connected to
-    /// \return true if node is connected to id
-    bool edgeExists(int id)
-    {
-      const auto search = id_set.find(id);
-      return (search == id_set.end()) ? false : true;
-    }
+  };
+
+
+  /// \brief View of the edges leaving a node, points into
+  ///        the compressed sparse row (CSR) adjacency array
+  struct EdgeRange
+  {
+    const Edge *first = nullptr;            // first edge
+    const Edge *last = nullptr;             // one past the last edge
+
+    /// \brief Iterator to first edge
+    const Edge *begin() const { return first; }
+
+    /// \brief Iterator to one past the last edge
+    const Edge *end() const { return last; }
+
+    /// \brief Number of edges
+    std::size_t size() const { return static_cast<std::size_t>(last - first); }
+
+    /// \brief True if there are no edges
+    bool empty() const { return first == last; }
   };
 
 
@@ -76,24 +84,81 @@ namespace planner
     /// \param bnd_rad - bounding radius around robot
     /// \param neighbors - number of closest neighbors examine for each configuration
     /// \param num_nodes - number of nodes to put in road map
+    /// \param obs_map - coordinates of all polygons in Cspace
+    /// \param num_threads - threads used to build the road map,
+    ///                      0 uses all hardware threads
+    /// \param lazy_edges - when true edges are only collision checked
+    ///                     the first time a search uses them
     RoadMap(double xmin, double xmax,
             double ymin, double ymax,
             double bnd_rad,
             unsigned int neighbors, unsigned int num_nodes,
-            obstacle_map obs_map);
+            obstacle_map obs_map,
+            unsigned int num_threads = 0,
+            bool lazy_edges = false);
 
     /// \brief Retreive the graph
     /// roadmap[out] - the graph
     void getRoadMap(std::vector<Node> &roadmap) const;
 
+    /// \brief Number of nodes in the road map
+    /// \return number of nodes including start and goal when attached
+    unsigned int numNodes() const;
+
+    /// \brief Location of a node
+    /// \param id - node ID
+    /// \return (x, y) location of the node in the world
+    const Vector2D &nodePoint(int id) const;
+
+    /// \brief Edges leaving a node
+    /// \param id - node ID
+    /// \return view of the node's edges in the adjacency array
+    EdgeRange adjacentEdges(int id) const;
+
     /// \brief Print road map
     void printRoadMap() const;
 
-    /// \brief Construct the roadmap
+    /// \brief Construct the roadmap once for the map, start and goal
+    ///        are attached per query with attachStartGoal
+    void constructRoadMap();
+
+    /// \brief Construct the roadmap if it has not been built yet and
+    ///        attach the start and goal to it
     /// \param start - start configuration
     /// \param goal - goal configuration
     void constructRoadMap(const Vector2D &start, const Vector2D &goal);
 
+    /// \brief Temporarily adds the start and goal nodes, they are connected
+    ///        to their K nearest neighbors and stay attached until
+    ///        detachStartGoal is called or another pair is attached.
+    ///        Must not be called while a search is running on the road map.
+    /// \param start - start configuration
+    /// \param goal - goal configuration
+    /// \return - true if start/goal nodes are connected to prm
+    bool attachStartGoal(const Vector2D &start, const Vector2D &goal);
+
+    /// \brief Removes the start and goal nodes and their edges
+    void detachStartGoal();
+
+    /// \brief Check whether an edge is collision free. With lazy edge
+    ///        validation the first call checks the edge and caches the
+    ///        result, otherwise all edges are already known to be free.
+    /// \param edge - an edge from the range returned by adjacentEdges
+    /// \param id - ID of the node the edge leaves
+    /// \return - true if the edge is collision free
+    bool edgeFree(int id, const Edge &edge) const;
+
+    /// \brief Save the road map without start/goal in a compact binary format
+    /// \param filename - file to write
+    /// \return - true if the file was written
+    bool saveRoadMap(const std::string &filename) const;
+
+    /// \brief Load a road map saved by saveRoadMap, the map bounds,
+    ///        bounding radius, number of neighbors, and obstacle map must match
+    /// \param filename - file to read
+    /// \return - true if the road map was loaded, the road map is unchanged otherwise
+    bool loadRoadMap(const std::string &filename);
+
     /// \brief Check whether an edge between two nodes is feasible
     /// \param p1 - first bound of edge
     /// \param p1 - second bound of edge
@@ -101,16 +166,39 @@ namespace planner
     bool stlnPathCollision(const Vector2D &p1, const Vector2D &p2) const;
 
   private:
-    /// \brief Adds the start and goal nodes
-    /// \param start - start configuration
-    /// \param goal - goal configuration
-    /// \return - true if start/goal nodes are connected to prm
-    bool addStartGoalConfig(const Vector2D &start, const Vector2D &goal);
+    /// \brief Rejection samples n free configurations, each thread
+    ///        fills its own slice of the nodes with its own generator
+    /// \param seed - seed shared by the per-thread generators
+    void sampleNodes(unsigned long seed);
+
+    /// \brief Connects every node to its K nearest neighbors, checks the
+    ///        candidate edges for collisions in parallel, and merges the
+    ///        per-thread edge buffers into the CSR adjacency array
+    void connectNodes();
+
+    /// \brief Lays out the CSR adjacency from the node degrees, leaves
+    ///        spare slots on every node for edges to start and goal
+    /// \param degree - number of edges of each node in the road map
+    void allocateAdjacency(const std::vector<unsigned int> &degree);
+
+    /// \brief Connects start or goal to its K nearest road map nodes,
+    ///        the edge between start and goal is left out
+    /// \param id - ID of the start or goal node
+    void attachNode(int id);
+
+    /// \brief Appends an edge to a node's adjacency
+    /// \param id - ID of the node
+    /// \param edge - edge to add
+    /// \param state - collision state of the edge
+    void appendEdge(int id, const Edge &edge, std::uint8_t state);
 
     /// \brief Finds K nearest neighbors in roadmap
-    /// \param query - query node
-    /// neighbors[out] - index on neighbors
-    void nearestNeighbors(const Node &query, std::vector<int> &neighbors) const;
+    /// \param query_id - ID of the query node
+    /// \param candidates - scratch buffer of (distance, ID) pairs
+    /// neighbors[out] - index on neighbors, closest first
+    void nearestNeighbors(int query_id,
+                          std::vector<std::pair<double, int>> &candidates,
+                          std::vector<int> &neighbors) const;
 
     /// \brief Check if node collides with boundaries of map
     /// \param q - the (x, y) location of a node
@@ -138,29 +226,34 @@ namespace planner
                             const Vector2D &p1,
                             const Vector2D &p2) const;
 
-    /// \brief Insert a node into roadmap
-    /// \param q - the (x, y) location of a node
-    /// \return - node ID
-    int addNode(const Vector2D &q);
-
-    /// \brief Add edge between two nodes
-    /// \param id1 - key of first node
-    /// \param id2 - key of second node
-    void addEdge(int id1, int id2);
-
     /// \brief Generate random point in world
-    Vector2D randomPoint() const;
+    /// \param gen - random number engine owned by the calling thread
+    Vector2D randomPoint(rigid2d::Xoshiro256 &gen) const;
 
 
     double xmin, xmax, ymin, ymax;      // bounds of the world
     double bnd_rad;                     // distance threshold between nodes/path from obstacles
     unsigned int k, n;                  // number of closest neighbors, number of nodes
     obstacle_map obs_map;               // collection of all the polygons
+    unsigned int num_threads;           // threads used to build the road map
+    bool lazy_edges;                    // check edges when they are first used
+    bool attached;                      // start and goal are attached
 
     // graph representation of road map
-    // start node is at position n-2
-    // goal node is at position n-1
+    // when attached start node is at position n-2
+    // and goal node is at position n-1
     std::vector<Node> nodes;
+
+    // CSR adjacency, the edges of node i are
+    // edges[edge_offsets[i], edge_offsets[i] + edge_count[i]) and
+    // the remaining slots up to edge_offsets[i+1] are spare
+    std::vector<unsigned int> edge_offsets;
+    std::vector<unsigned int> edge_count;
+    std::vector<Edge> edges;
+
+    // collision state of each edge slot, written by lazy validation
+    // during searches so it is atomic
+    mutable std::vector<std::atomic<std::uint8_t>> edge_state;
   };
 
 } // end namespace
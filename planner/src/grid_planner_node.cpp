@@ -10,6 +10,8 @@
 /// bounding_radius - padding around obstacles
 /// grid_resolution - resolution of a grid cell
 /// viz_rad - visibility threshold for simulating map updates
+/// planner_type - "dstar" (D* Lite), "jps" (Jump Point Search), or "hpa" (hierarchical JPS)
+/// sector_size - cells along the edge of a sector for "hpa"
 /// start_x - start x position in map coordinates
 /// start_y - start y position in map coordinates
 /// goal_x - goal x position in map coordinates
@@ -17,11 +19,16 @@
 /// resolution - scale of the map coodinates (scales vertices of obstacles and start/goal)
 /// bounds - boundary of map
 /// obstacles - triple nested list of obstacle vertecis in map coordinates
+/// diagnostics_frequency - rate the timing metrics are published
+/// trace_file - writes a Chrome trace of the planner on shutdown if set
 /// PUBLISHES:
 ///   map (nav_msgs::OccupancyGrid>): free/occupied/buffer zone for planning
 ///   global_path (nav_msgs::GridCells): complete path from planner
 ///   visited_cells (nav_msgs::GridCells): cells updated during replanning
 ///   start_goal (nav_msgs::GridCells): start/goal positions
+///   /diagnostics (diagnostic_msgs::DiagnosticArray): planning latency
+
+#include <memory>
 
 #include <ros/ros.h>
 #include <ros/console.h>
@@ -31,8 +38,10 @@
 #include <geometry_msgs/Point.h>
 #include <xmlrpcpp/XmlRpcValue.h>
 
+#include <rigid2d/ros_instrumentation.hpp>
 #include "planner/grid_map.hpp"
 #include "planner/dstar_light.hpp"
+#include "planner/hierarchical_planner.hpp"
 
 using rigid2d::Vector2D;
 
@@ -59,6 +68,8 @@ int main(int argc, char** argv)
   auto bounding_radius = 0.0;             // bounding radius around robot for collisions
   auto viz_rad = 0.0;                     // visibility radius for map updates
   auto freq = 10.0;                       // frequency of node
+  std::string planner_type = "dstar";     // grid search algorithm
+  auto sector_size = 10;                  // cells along edge of HPA* sector
 
 
   // start/goal
@@ -77,6 +88,8 @@ int main(int argc, char** argv)
   nh.getParam("grid_resolution", grid_resolution);
   nh.getParam("viz_rad", viz_rad);
   nh.getParam("frequency", freq);
+  nh.getParam("planner_type", planner_type);
+  nh.getParam("sector_size", sector_size);
 
   nh.getParam("start_x", start_x);
   nh.getParam("start_y", start_y);
@@ -87,6 +100,18 @@ int main(int argc, char** argv)
   node_handle.getParam("/bounds", map_bound);
   node_handle.getParam("/obstacles", obstacles);
 
+  if (planner_type != "dstar" and planner_type != "jps" and planner_type != "hpa")
+  {
+    ROS_FATAL("Unknown planner_type %s, use dstar, jps, or hpa", planner_type.c_str());
+    return 1;
+  }
+
+  if (sector_size <= 0)
+  {
+    ROS_FATAL("sector_size must be positive, got %d", sector_size);
+    return 1;
+  }
+
 
   const auto xmin = static_cast<double>(map_bound[0][0]) * obs_resolution;
   const auto xmax = static_cast<double>(map_bound[0][1]) * obs_resolution;
@@ -193,12 +218,44 @@ int main(int argc, char** argv)
   // number of cells visibile for map update
   const auto vizd = std::round(viz_rad / grid_resolution);
 
+  // static map planners only plan once
+  const auto static_map = (planner_type == "jps" or planner_type == "hpa");
+
+  // timing metrics of the planner, created before the first plan so it is traced
+  rigid2d::DiagnosticsPublisher diagnostics(node_handle, nh, "grid_planner");
+
   // TODO add check if plan succeeds
   // start planning
   std::cout << "Currently Planning " <<  std::endl;
-  planner::DStarLight dstar(gridmap, vizd);
-  dstar.initPath(start, goal);
-  dstar.planPath();
+
+  // only the selected planner is constructed
+  std::unique_ptr<planner::DStarLight> dstar;
+
+  // path and expanded cells from static map planners
+  std::vector<Vector2D> static_path, static_visited;
+
+  if (!static_map)
+  {
+    dstar.reset(new planner::DStarLight(gridmap, vizd));
+    dstar->initPath(start, goal);
+    dstar->planPath();
+  }
+
+  else
+  {
+    planner::HierarchicalPlanner hplanner(gridmap, sector_size);
+
+    const auto found = (planner_type == "jps") ? hplanner.planJPS(start, goal) :
+                                                 hplanner.planHPA(start, goal);
+    if (!found)
+    {
+      ROS_WARN("No path found by %s", planner_type.c_str());
+    }
+
+    hplanner.getPath(static_path);
+    hplanner.getVisited(static_visited);
+    gridmap.getGridViz(map);
+  }
 
 
   // global path msg
@@ -218,24 +275,33 @@ int main(int argc, char** argv)
   {
     ros::spinOnce();
 
-    // plan until goal reached
-    dstar.pathTraversal();
-
-    // internal map to LPA*
-    map.clear();
-    dstar.getGridViz(map);
-
     // path viz
     std::vector<Vector2D> path;
-    dstar.getPath(path);
-
-    // path_msg.cells.clear();
-    gridCellPath(path, path_msg);
-
 
     // visited cells for debugging
     std::vector<Vector2D> visted_cells;
-    dstar.getVisited(visted_cells);
+
+    if (!static_map)
+    {
+      // plan until goal reached
+      dstar->pathTraversal();
+
+      // internal map to LPA*
+      map.clear();
+      dstar->getGridViz(map);
+
+      dstar->getPath(path);
+      dstar->getVisited(visted_cells);
+    }
+
+    else
+    {
+      path = static_path;
+      visted_cells = static_visited;
+    }
+
+    // path_msg.cells.clear();
+    gridCellPath(path, path_msg);
 
     // visit_msg.cells.clear();
     gridCellPath(visted_cells, visit_msg);
@@ -256,6 +322,8 @@ int main(int argc, char** argv)
     path_msg.header.stamp = ros::Time::now();
     path_pub.publish(path_msg);
 
+    diagnostics.publish(ros::Time::now());
+
     // publsih start/goal
     sg_pub.publish(sg_msg);
     ///////////////////////////////////////////////
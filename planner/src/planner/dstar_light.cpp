@@ -6,6 +6,9 @@
 #include <cmath>
 #include <set>
 
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
+
 #include "planner/dstar_light.hpp"
 
 
@@ -39,6 +42,8 @@ DStarLight::DStarLight(GridMap &gridmap, double vizd)
 
 void DStarLight::planPath()
 {
+  RIGID2D_SCOPED_TIMER("dstar.plan");
+
   // clear previously visited cells for viz
   visited.clear();
 
@@ -91,6 +96,8 @@ void DStarLight::planPath()
       visited.push_back(min_cell.id);
     }
   }
+
+  RIGID2D_RECORD("dstar.visited", visited.size());
 }
 
 
@@ -99,7 +106,7 @@ void DStarLight::pathTraversal()
   // goal reached
   if (start_id == goal_id and !goal_reached)
   {
-    std::cout << "Goal Reached" << std::endl;
+    RIGID2D_LOG(rigid2d::LogLevel::Info, "dstar.goal_reached");
     goal_reached = true;
     return;
   }
@@ -0,0 +1,843 @@
+// \file
+/// \brief Jump Point Search and HPA* on a static 2D grid
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "planner/hierarchical_planner.hpp"
+
+
+namespace planner
+{
+
+// cost of a diagonal move in cells
+static const double diag_cost = std::sqrt(2.0);
+
+// border openings shorter than this get a single entrance
+// in the middle, longer ones get an entrance at each end
+static constexpr int max_single_entrance = 6;
+
+// default cost of a cell
+static constexpr double inf_cost = 1e12;
+
+
+HierarchicalPlanner::HierarchicalPlanner(const GridMap &gridmap, unsigned int sector_size)
+                                          : gridmap(gridmap),
+                                            sector_size(sector_size)
+{
+  if (sector_size == 0)
+  {
+    throw std::invalid_argument("Sector size must be at least one cell");
+  }
+
+  const auto grid_size = gridmap.getGridSize();
+  xsize = grid_size.at(0);
+  ysize = grid_size.at(1);
+
+  sectors_i = (xsize + this->sector_size - 1) / this->sector_size;
+  sectors_j = (ysize + this->sector_size - 1) / this->sector_size;
+
+  full_box.imin = 0;
+  full_box.imax = xsize - 1;
+  full_box.jmin = 0;
+  full_box.jmax = ysize - 1;
+
+  // only free cells are traversable
+  std::vector<Cell> cells;
+  gridmap.getGrid(cells);
+
+  blocked.assign(cells.size(), 1);
+  for(unsigned int i = 0; i < cells.size(); i++)
+  {
+    blocked.at(i) = (cells.at(i).state != 0);
+  }
+
+  g.assign(cells.size(), inf_cost);
+  parent.assign(cells.size(), -1);
+  closed.assign(cells.size(), false);
+
+  buildAbstraction();
+}
+
+
+bool HierarchicalPlanner::planJPS(const Vector2D &start, const Vector2D &goal)
+{
+  RIGID2D_SCOPED_TIMER("jps.plan");
+
+  path.clear();
+  visited.clear();
+
+  const auto start_cell = worldCell(start);
+  const auto goal_cell = worldCell(goal);
+
+  if (start_cell == -1 or goal_cell == -1)
+  {
+    std::cout << "ERROR: start/goal position NOT valid" << std::endl;
+    return false;
+  }
+
+  if (!searchJPS(start_cell, goal_cell, full_box))
+  {
+    return false;
+  }
+
+  path.push_back(start_cell);
+  appendCells(goal_cell, path);
+
+  return true;
+}
+
+
+bool HierarchicalPlanner::planHPA(const Vector2D &start, const Vector2D &goal)
+{
+  RIGID2D_SCOPED_TIMER("hpa.plan");
+
+  path.clear();
+  visited.clear();
+
+  const auto start_cell = worldCell(start);
+  const auto goal_cell = worldCell(goal);
+
+  if (start_cell == -1 or goal_cell == -1)
+  {
+    std::cout << "ERROR: start/goal position NOT valid" << std::endl;
+    return false;
+  }
+
+  // temporarily add start/goal to the abstract graph
+  // unless they are already an entrance
+  const int num_nodes = abs_nodes.size();
+
+  const auto start_id = abstractNode(start_cell);
+  if (start_id >= num_nodes)
+  {
+    connectInSector(start_id);
+  }
+
+  const auto goal_id = abstractNode(goal_cell);
+  if (goal_id >= num_nodes and goal_id != start_id)
+  {
+    connectInSector(goal_id);
+  }
+
+  std::vector<int> nodes;
+  const auto found = searchAbstract(start_id, goal_id, nodes);
+
+  auto refined = found;
+  if (found)
+  {
+    path.push_back(start_cell);
+
+    // refine each abstract edge
+    for(unsigned int k = 1; k < nodes.size() and refined; k++)
+    {
+      const auto from = abs_nodes.at(nodes.at(k-1)).cell;
+      const auto to = abs_nodes.at(nodes.at(k)).cell;
+
+      // entrance, the cells are adjacent across the border
+      if (sectorID(from) != sectorID(to))
+      {
+        path.push_back(to);
+      }
+
+      // path inside a sector, the query fails if it cannot be refined
+      else if (searchJPS(from, to, sectorBox(from)))
+      {
+        appendCells(to, path);
+      }
+
+      else
+      {
+        refined = false;
+      }
+    }
+
+    if (!refined)
+    {
+      std::cout << "ERROR: abstract path could NOT be refined" << std::endl;
+      path.clear();
+    }
+  }
+
+  removeQueryNodes(num_nodes);
+
+  return refined;
+}
+
+
+void HierarchicalPlanner::getPath(std::vector<Vector2D> &path) const
+{
+  path.clear();
+  for(const auto id : this->path)
+  {
+    path.push_back(gridmap.grid2World(id / ysize, id % ysize));
+  }
+}
+
+
+void HierarchicalPlanner::getVisited(std::vector<Vector2D> &cells) const
+{
+  cells.clear();
+  for(const auto id : visited)
+  {
+    cells.push_back(gridmap.grid2World(id / ysize, id % ysize));
+  }
+}
+
+
+double HierarchicalPlanner::pathLength() const
+{
+  auto length = 0.0;
+  for(unsigned int k = 1; k < path.size(); k++)
+  {
+    const auto p1 = gridmap.grid2World(path.at(k-1) / ysize, path.at(k-1) % ysize);
+    const auto p2 = gridmap.grid2World(path.at(k) / ysize, path.at(k) % ysize);
+    length += euclideanDistance(p1.x, p1.y, p2.x, p2.y);
+  }
+
+  return length;
+}
+
+
+unsigned int HierarchicalPlanner::numAbstractNodes() const
+{
+  return abs_nodes.size();
+}
+
+
+void HierarchicalPlanner::buildAbstraction()
+{
+  abs_nodes.clear();
+  sector_nodes.assign(sectors_i * sectors_j, std::vector<int>());
+  cell_node.assign(blocked.size(), -1);
+
+  // entrances along the border with the next
+  // sector in each direction
+  for(auto si = 0; si < sectors_i; si++)
+  {
+    for(auto sj = 0; sj < sectors_j; sj++)
+    {
+      const auto i0 = si * sector_size;
+      const auto j0 = sj * sector_size;
+
+      if (si + 1 < sectors_i)
+      {
+        const auto len = std::min(sector_size, ysize - j0);
+        addEntrances(i0 + sector_size - 1, j0, 0, 1, 1, 0, len);
+      }
+
+      if (sj + 1 < sectors_j)
+      {
+        const auto len = std::min(sector_size, xsize - i0);
+        addEntrances(i0, j0 + sector_size - 1, 1, 0, 0, 1, len);
+      }
+    }
+  }
+
+  // each pair of entrances in a sector is connected once
+  for(unsigned int id = 0; id < abs_nodes.size(); id++)
+  {
+    connectInSector(id);
+  }
+}
+
+
+void HierarchicalPlanner::addEntrances(int i0, int j0, int di, int dj, int oi, int oj, int len)
+{
+  // add a node on both sides of the border
+  auto addEntrance = [&](int k)
+  {
+    const auto c1 = (i0 + k * di) * ysize + (j0 + k * dj);
+    const auto c2 = c1 + oi * ysize + oj;
+
+    const auto n1 = abstractNode(c1);
+    const auto n2 = abstractNode(c2);
+
+    abs_nodes.at(n1).edges.push_back({n2, 1.0});
+    abs_nodes.at(n2).edges.push_back({n1, 1.0});
+  };
+
+  // find openings where both sides are free
+  auto run = 0;
+  for(auto k = 0; k <= len; k++)
+  {
+    auto open = false;
+    if (k < len)
+    {
+      const auto c1 = (i0 + k * di) * ysize + (j0 + k * dj);
+      const auto c2 = c1 + oi * ysize + oj;
+      open = !blocked.at(c1) and !blocked.at(c2);
+    }
+
+    if (open)
+    {
+      run++;
+      continue;
+    }
+
+    // end of opening
+    if (run > 0)
+    {
+      const auto first = k - run;
+      const auto last = k - 1;
+
+      if (run < max_single_entrance)
+      {
+        addEntrance((first + last) / 2);
+      }
+
+      else
+      {
+        addEntrance(first);
+        addEntrance(last);
+      }
+    }
+
+    run = 0;
+  }
+}
+
+
+int HierarchicalPlanner::abstractNode(int cell)
+{
+  if (cell_node.at(cell) != -1)
+  {
+    return cell_node.at(cell);
+  }
+
+  AbstractNode node;
+  node.cell = cell;
+  node.sector = sectorID(cell);
+
+  const int id = abs_nodes.size();
+  abs_nodes.push_back(node);
+  cell_node.at(cell) = id;
+  sector_nodes.at(node.sector).push_back(id);
+
+  return id;
+}
+
+
+void HierarchicalPlanner::connectInSector(int id)
+{
+  const auto cell = abs_nodes.at(id).cell;
+  const auto sector = abs_nodes.at(id).sector;
+
+  // cost to every cell in the sector
+  searchGrid(cell, -1, sectorBox(cell));
+
+  // only connect to nodes with a smaller ID
+  // so each pair is connected once
+  for(const auto other : sector_nodes.at(sector))
+  {
+    const auto d = g.at(abs_nodes.at(other).cell);
+    if (other < id and d < inf_cost)
+    {
+      abs_nodes.at(id).edges.push_back({other, d});
+      abs_nodes.at(other).edges.push_back({id, d});
+    }
+  }
+}
+
+
+void HierarchicalPlanner::removeQueryNodes(unsigned int num_nodes)
+{
+  for(auto id = num_nodes; id < abs_nodes.size(); id++)
+  {
+    const auto &node = abs_nodes.at(id);
+
+    // edges to query nodes were appended last
+    for(const auto &edge : node.edges)
+    {
+      auto &edges = abs_nodes.at(edge.id).edges;
+      while(!edges.empty() and edges.back().id >= static_cast<int>(num_nodes))
+      {
+        edges.pop_back();
+      }
+    }
+
+    auto &nodes = sector_nodes.at(node.sector);
+    while(!nodes.empty() and nodes.back() >= static_cast<int>(num_nodes))
+    {
+      nodes.pop_back();
+    }
+
+    cell_node.at(node.cell) = -1;
+  }
+
+  abs_nodes.resize(num_nodes);
+}
+
+
+bool HierarchicalPlanner::searchAbstract(int start, int goal, std::vector<int> &nodes)
+{
+  const auto num_nodes = abs_nodes.size();
+  const auto goal_cell = abs_nodes.at(goal).cell;
+
+  // the abstract graph is small so the state is not kept
+  std::vector<double> ag(num_nodes, inf_cost);
+  std::vector<int> aparent(num_nodes, -1);
+  std::vector<bool> aclosed(num_nodes, false);
+  open_queue open;
+
+  ag.at(start) = 0.0;
+  open.push({octile(abs_nodes.at(start).cell, goal_cell), 0.0, start});
+
+  while(!open.empty())
+  {
+    const OpenEntry min_node = open.top();
+    open.pop();
+
+    // stale entry
+    if (aclosed.at(min_node.id) or min_node.g > ag.at(min_node.id))
+    {
+      continue;
+    }
+
+    if (min_node.id == goal)
+    {
+      for(auto id = goal; id != -1; id = aparent.at(id))
+      {
+        nodes.push_back(id);
+      }
+      std::reverse(nodes.begin(), nodes.end());
+
+      return true;
+    }
+
+    aclosed.at(min_node.id) = true;
+    visited.push_back(abs_nodes.at(min_node.id).cell);
+
+    for(const auto &edge : abs_nodes.at(min_node.id).edges)
+    {
+      const auto g_new = ag.at(min_node.id) + edge.d;
+      if (!aclosed.at(edge.id) and g_new < ag.at(edge.id))
+      {
+        ag.at(edge.id) = g_new;
+        aparent.at(edge.id) = min_node.id;
+        open.push({g_new + octile(abs_nodes.at(edge.id).cell, goal_cell), g_new, edge.id});
+      }
+    }
+  }
+
+  return false;
+}
+
+
+bool HierarchicalPlanner::searchGrid(int start, int goal, const GridBox &box)
+{
+  resetSearch();
+
+  g.at(start) = 0.0;
+  touched.push_back(start);
+  open_list.push({(goal == -1) ? 0.0 : octile(start, goal), 0.0, start});
+
+  while(!open_list.empty())
+  {
+    const OpenEntry min_node = open_list.top();
+    open_list.pop();
+
+    // stale entry
+    if (closed[min_node.id] or min_node.g > g[min_node.id])
+    {
+      continue;
+    }
+
+    if (min_node.id == goal)
+    {
+      return true;
+    }
+
+    closed[min_node.id] = true;
+
+    const auto i = min_node.id / ysize;
+    const auto j = min_node.id % ysize;
+
+    // 8-connected neighbors
+    for(auto di = -1; di <= 1; di++)
+    {
+      for(auto dj = -1; dj <= 1; dj++)
+      {
+        const auto diag = (di != 0 and dj != 0);
+
+        if ((di == 0 and dj == 0) or !freeCell(i + di, j + dj, box))
+        {
+          continue;
+        }
+
+        // do not cut corners
+        if (diag and (!freeCell(i + di, j, box) or !freeCell(i, j + dj, box)))
+        {
+          continue;
+        }
+
+        const auto id = (i + di) * ysize + (j + dj);
+        const auto g_new = g[min_node.id] + (diag ? diag_cost : 1.0);
+
+        if (!closed[id] and g_new < g[id])
+        {
+          if (g[id] >= inf_cost)
+          {
+            touched.push_back(id);
+          }
+
+          g[id] = g_new;
+          parent[id] = min_node.id;
+          open_list.push({g_new + ((goal == -1) ? 0.0 : octile(id, goal)), g_new, id});
+        }
+      }
+    }
+  }
+
+  // expanded all reachable cells
+  return goal == -1;
+}
+
+
+bool HierarchicalPlanner::searchJPS(int start, int goal, const GridBox &box)
+{
+  resetSearch();
+
+  g.at(start) = 0.0;
+  touched.push_back(start);
+  open_list.push({octile(start, goal), 0.0, start});
+
+  std::vector<std::pair<int, int>> dirs;
+
+  while(!open_list.empty())
+  {
+    const OpenEntry min_node = open_list.top();
+    open_list.pop();
+
+    // stale entry
+    if (closed[min_node.id] or min_node.g > g[min_node.id])
+    {
+      continue;
+    }
+
+    if (min_node.id == goal)
+    {
+      return true;
+    }
+
+    closed[min_node.id] = true;
+    visited.push_back(min_node.id);
+
+    const auto i = min_node.id / ysize;
+    const auto j = min_node.id % ysize;
+
+    prunedDirections(min_node.id, parent[min_node.id], box, dirs);
+
+    for(const auto &dir : dirs)
+    {
+      const auto id = jump(i + dir.first, j + dir.second, dir.first, dir.second, goal, box);
+      if (id == -1 or closed[id])
+      {
+        continue;
+      }
+
+      // jump points are on a straight or diagonal line
+      const auto g_new = g[min_node.id] + octile(min_node.id, id);
+
+      if (g_new < g[id])
+      {
+        if (g[id] >= inf_cost)
+        {
+          touched.push_back(id);
+        }
+
+        g[id] = g_new;
+        parent[id] = min_node.id;
+        open_list.push({g_new + octile(id, goal), g_new, id});
+      }
+    }
+  }
+
+  return false;
+}
+
+
+int HierarchicalPlanner::jump(int i, int j, int di, int dj, int goal, const GridBox &box) const
+{
+  while(true)
+  {
+    if (!freeCell(i, j, box))
+    {
+      return -1;
+    }
+
+    const auto id = i * ysize + j;
+    if (id == goal)
+    {
+      return id;
+    }
+
+    // diagonal, stop if a straight scan finds a jump point
+    if (di != 0 and dj != 0)
+    {
+      if (jump(i + di, j, di, 0, goal, box) != -1 or
+          jump(i, j + dj, 0, dj, goal, box) != -1)
+      {
+        return id;
+      }
+
+      // the next step may not cut a corner
+      if (!freeCell(i + di, j, box) or !freeCell(i, j + dj, box))
+      {
+        return -1;
+      }
+    }
+
+    // along a row, forced neighbor on either side
+    else if (di != 0)
+    {
+      if ((freeCell(i, j - 1, box) and !freeCell(i - di, j - 1, box)) or
+          (freeCell(i, j + 1, box) and !freeCell(i - di, j + 1, box)))
+      {
+        return id;
+      }
+    }
+
+    // along a column, forced neighbor on either side
+    else
+    {
+      if ((freeCell(i - 1, j, box) and !freeCell(i - 1, j - dj, box)) or
+          (freeCell(i + 1, j, box) and !freeCell(i + 1, j - dj, box)))
+      {
+        return id;
+      }
+    }
+
+    i += di;
+    j += dj;
+  }
+}
+
+
+void HierarchicalPlanner::prunedDirections(int id, int parent_id, const GridBox &box,
+                                           std::vector<std::pair<int, int>> &dirs) const
+{
+  dirs.clear();
+
+  const auto i = id / ysize;
+  const auto j = id % ysize;
+
+  // start expands all neighbors
+  if (parent_id == -1)
+  {
+    for(auto di = -1; di <= 1; di++)
+    {
+      for(auto dj = -1; dj <= 1; dj++)
+      {
+        if (di == 0 and dj == 0)
+        {
+          continue;
+        }
+
+        if (di == 0 or dj == 0 or (freeCell(i + di, j, box) and freeCell(i, j + dj, box)))
+        {
+          dirs.emplace_back(di, dj);
+        }
+      }
+    }
+
+    return;
+  }
+
+  // direction of travel
+  const auto pi = parent_id / ysize;
+  const auto pj = parent_id % ysize;
+  const auto di = (i > pi) - (i < pi);
+  const auto dj = (j > pj) - (j < pj);
+
+  if (di != 0 and dj != 0)
+  {
+    const auto free_i = freeCell(i + di, j, box);
+    const auto free_j = freeCell(i, j + dj, box);
+
+    if (free_j)
+    {
+      dirs.emplace_back(0, dj);
+    }
+
+    if (free_i)
+    {
+      dirs.emplace_back(di, 0);
+    }
+
+    if (free_i and free_j)
+    {
+      dirs.emplace_back(di, dj);
+    }
+  }
+
+  else if (di != 0)
+  {
+    const auto free_next = freeCell(i + di, j, box);
+    const auto free_left = freeCell(i, j - 1, box);
+    const auto free_right = freeCell(i, j + 1, box);
+
+    if (free_next)
+    {
+      dirs.emplace_back(di, 0);
+
+      if (free_left)
+      {
+        dirs.emplace_back(di, -1);
+      }
+
+      if (free_right)
+      {
+        dirs.emplace_back(di, 1);
+      }
+    }
+
+    if (free_left)
+    {
+      dirs.emplace_back(0, -1);
+    }
+
+    if (free_right)
+    {
+      dirs.emplace_back(0, 1);
+    }
+  }
+
+  else
+  {
+    const auto free_next = freeCell(i, j + dj, box);
+    const auto free_up = freeCell(i - 1, j, box);
+    const auto free_down = freeCell(i + 1, j, box);
+
+    if (free_next)
+    {
+      dirs.emplace_back(0, dj);
+
+      if (free_up)
+      {
+        dirs.emplace_back(-1, dj);
+      }
+
+      if (free_down)
+      {
+        dirs.emplace_back(1, dj);
+      }
+    }
+
+    if (free_up)
+    {
+      dirs.emplace_back(-1, 0);
+    }
+
+    if (free_down)
+    {
+      dirs.emplace_back(1, 0);
+    }
+  }
+}
+
+
+void HierarchicalPlanner::appendCells(int goal, std::vector<int> &cells) const
+{
+  std::vector<int> points;
+  for(auto id = goal; id != -1; id = parent[id])
+  {
+    points.push_back(id);
+  }
+  std::reverse(points.begin(), points.end());
+
+  // consecutive points are on a straight or diagonal line
+  for(unsigned int k = 1; k < points.size(); k++)
+  {
+    auto i = points.at(k-1) / ysize;
+    auto j = points.at(k-1) % ysize;
+    const auto ti = points.at(k) / ysize;
+    const auto tj = points.at(k) % ysize;
+
+    while(i != ti or j != tj)
+    {
+      i += (ti > i) - (ti < i);
+      j += (tj > j) - (tj < j);
+      cells.push_back(i * ysize + j);
+    }
+  }
+}
+
+
+void HierarchicalPlanner::resetSearch()
+{
+  // only reset the cells the last search visited
+  for(const auto id : touched)
+  {
+    g[id] = inf_cost;
+    parent[id] = -1;
+    closed[id] = false;
+  }
+  touched.clear();
+
+  open_list = open_queue();
+}
+
+
+bool HierarchicalPlanner::freeCell(int i, int j, const GridBox &box) const
+{
+  if (i < box.imin or i > box.imax or j < box.jmin or j > box.jmax)
+  {
+    return false;
+  }
+
+  return !blocked[i * ysize + j];
+}
+
+
+GridBox HierarchicalPlanner::sectorBox(int cell) const
+{
+  const auto i = cell / ysize;
+  const auto j = cell % ysize;
+
+  GridBox box;
+  box.imin = (i / sector_size) * sector_size;
+  box.imax = std::min(box.imin + sector_size, xsize) - 1;
+  box.jmin = (j / sector_size) * sector_size;
+  box.jmax = std::min(box.jmin + sector_size, ysize) - 1;
+
+  return box;
+}
+
+
+int HierarchicalPlanner::sectorID(int cell) const
+{
+  const auto i = cell / ysize;
+  const auto j = cell % ysize;
+
+  return (i / sector_size) * sectors_j + (j / sector_size);
+}
+
+
+double HierarchicalPlanner::octile(int id1, int id2) const
+{
+  const auto di = std::abs(id1 / ysize - id2 / ysize);
+  const auto dj = std::abs(id1 % ysize - id2 % ysize);
+
+  return std::max(di, dj) + (diag_cost - 1.0) * std::min(di, dj);
+}
+
+
+int HierarchicalPlanner::worldCell(const Vector2D &p) const
+{
+  const GridCoordinates gc = gridmap.world2Grid(p.x, p.y);
+
+  if (!gridmap.worldBounds(gc.i, gc.j))
+  {
+    return -1;
+  }
+
+  const auto id = gc.i * ysize + gc.j;
+  return blocked.at(id) ? -1 : id;
+}
+
+} // end namespace
@@ -3,6 +3,11 @@
 
 
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
 
 #include "planner/potential_field.hpp"
 
@@ -38,7 +43,13 @@ PotentialField::PotentialField(obstacle_map &obs_map,
                                  qthresh(qthresh),
                                  w_att(w_att),
                                  w_rep(w_rep),
-                                 goal_reached(false)
+                                 goal_reached(false),
+                                 use_field(false),
+                                 field_xmin(0.0),
+                                 field_ymin(0.0),
+                                 field_res(0.0),
+                                 field_cols(0),
+                                 field_rows(0)
 {
 }
 
@@ -56,13 +67,15 @@ void PotentialField::initPath(const Vector2D &start, const Vector2D &goal)
 
 bool PotentialField::planPath()
 {
+  RIGID2D_SCOPED_TIMER("potential_field.plan");
+
   if(!goalReached())
   // while(!goalReached())
   {
-    const Vector2D Urep = accumulateRepulsiveGradient();
+    const Vector2D Urep = repulsiveGradientAt(q);
     // std::cout << "Repulsive: " << Urep << std::endl;
 
-    const Vector2D Uatt = attractiveGradient();
+    const Vector2D Uatt = attractiveGradient(q, qg);
     // std::cout << "Attractive: " << Uatt << std::endl;
 
     const Vector2D Dn = descentDirection(Urep, Uatt);
@@ -96,7 +109,248 @@ void PotentialField::getPath(std::vector<Vector2D> &path) const
 }
 
 
-Vector2D PotentialField::accumulateRepulsiveGradient() const
+void PotentialField::buildField(double xmin, double xmax,
+                                double ymin, double ymax,
+                                double resolution,
+                                unsigned int num_threads)
+{
+  if (resolution <= 0.0 or xmax <= xmin or ymax <= ymin)
+  {
+    throw std::invalid_argument("Invalid bounds or resolution for potential field");
+  }
+
+  if (num_threads == 0)
+  {
+    num_threads = defaultNumThreads();
+  }
+
+  // the samples include both bounds
+  field_xmin = xmin;
+  field_ymin = ymin;
+  field_res = resolution;
+  field_cols = static_cast<unsigned int>(std::ceil((xmax - xmin) / resolution)) + 1;
+  field_rows = static_cast<unsigned int>(std::ceil((ymax - ymin) / resolution)) + 1;
+
+  sdf.assign(field_cols * field_rows, 0.0);
+  rep_field.assign(field_cols * field_rows, Vector2D(0.0, 0.0));
+
+  // each row is independent
+  parallelFor(0, field_rows, num_threads, [&](unsigned int, unsigned int lo, unsigned int hi)
+  {
+    for(auto i = lo; i < hi; i++)
+    {
+      for(unsigned int j = 0; j < field_cols; j++)
+      {
+        const Vector2D p(field_xmin + j * field_res, field_ymin + i * field_res);
+        sdf[i * field_cols + j] = exactSignedDistance(p);
+        rep_field[i * field_cols + j] = accumulateRepulsiveGradient(p);
+      }
+    }
+  });
+
+  use_field = true;
+}
+
+
+double PotentialField::signedDistance(const Vector2D &p) const
+{
+  unsigned int idx = 0;
+  auto tx = 0.0, ty = 0.0;
+
+  if (!fieldCell(p, idx, tx, ty))
+  {
+    return exactSignedDistance(p);
+  }
+
+  const auto d00 = sdf[idx];
+  const auto d01 = sdf[idx + 1];
+  const auto d10 = sdf[idx + field_cols];
+  const auto d11 = sdf[idx + field_cols + 1];
+
+  return (1.0 - ty) * ((1.0 - tx) * d00 + tx * d01) +
+          ty * ((1.0 - tx) * d10 + tx * d11);
+}
+
+
+Vector2D PotentialField::distanceGradient(const Vector2D &p) const
+{
+  unsigned int idx = 0;
+  auto tx = 0.0, ty = 0.0;
+
+  if (!fieldCell(p, idx, tx, ty))
+  {
+    return Vector2D(0.0, 0.0);
+  }
+
+  const auto d00 = sdf[idx];
+  const auto d01 = sdf[idx + 1];
+  const auto d10 = sdf[idx + field_cols];
+  const auto d11 = sdf[idx + field_cols + 1];
+
+  // derivative of the bilinear interpolation
+  Vector2D grad;
+  grad.x = ((1.0 - ty) * (d01 - d00) + ty * (d11 - d10)) / field_res;
+  grad.y = ((1.0 - tx) * (d10 - d00) + tx * (d11 - d01)) / field_res;
+
+  return grad;
+}
+
+
+unsigned int PotentialField::planPaths(const std::vector<Vector2D> &starts,
+                                       const Vector2D &goal,
+                                       unsigned int max_iter,
+                                       std::vector<std::vector<Vector2D>> &paths,
+                                       std::vector<bool> &reached,
+                                       unsigned int num_threads) const
+{
+  if (num_threads == 0)
+  {
+    num_threads = defaultNumThreads();
+  }
+
+  paths.assign(starts.size(), std::vector<Vector2D>());
+
+  // std::vector<bool> can not be written from several threads
+  std::vector<char> done(starts.size(), 0);
+
+  parallelFor(0, starts.size(), num_threads, [&](unsigned int, unsigned int lo, unsigned int hi)
+  {
+    for(auto k = lo; k < hi; k++)
+    {
+      auto &kpath = paths[k];
+      kpath.reserve(max_iter + 1);
+
+      auto p = starts[k];
+      kpath.push_back(p);
+
+      for(unsigned int iter = 0; iter < max_iter; iter++)
+      {
+        if (euclideanDistance(p.x, p.y, goal.x, goal.y) < eps)
+        {
+          done[k] = 1;
+          break;
+        }
+
+        p = descentStep(p, goal);
+        kpath.push_back(p);
+      }
+
+      // reached on the final step
+      if (euclideanDistance(p.x, p.y, goal.x, goal.y) < eps)
+      {
+        done[k] = 1;
+      }
+    }
+  });
+
+  reached.assign(done.begin(), done.end());
+  return std::count(done.begin(), done.end(), 1);
+}
+
+
+Vector2D PotentialField::repulsiveGradientAt(const Vector2D &p) const
+{
+  unsigned int idx = 0;
+  auto tx = 0.0, ty = 0.0;
+
+  if (!fieldCell(p, idx, tx, ty))
+  {
+    return accumulateRepulsiveGradient(p);
+  }
+
+  const auto &u00 = rep_field[idx];
+  const auto &u01 = rep_field[idx + 1];
+  const auto &u10 = rep_field[idx + field_cols];
+  const auto &u11 = rep_field[idx + field_cols + 1];
+
+  Vector2D Urep;
+  Urep.x = (1.0 - ty) * ((1.0 - tx) * u00.x + tx * u01.x) +
+            ty * ((1.0 - tx) * u10.x + tx * u11.x);
+  Urep.y = (1.0 - ty) * ((1.0 - tx) * u00.y + tx * u01.y) +
+            ty * ((1.0 - tx) * u10.y + tx * u11.y);
+
+  return Urep;
+}
+
+
+bool PotentialField::fieldCell(const Vector2D &p, unsigned int &idx, double &tx, double &ty) const
+{
+  if (!use_field)
+  {
+    return false;
+  }
+
+  const auto fx = (p.x - field_xmin) / field_res;
+  const auto fy = (p.y - field_ymin) / field_res;
+
+  // needs a sample on both sides
+  if (fx < 0.0 or fy < 0.0 or fx >= field_cols - 1 or fy >= field_rows - 1)
+  {
+    return false;
+  }
+
+  const auto j = static_cast<unsigned int>(fx);
+  const auto i = static_cast<unsigned int>(fy);
+
+  idx = i * field_cols + j;
+  tx = fx - j;
+  ty = fy - i;
+
+  return true;
+}
+
+
+double PotentialField::exactSignedDistance(const Vector2D &p) const
+{
+  auto min_dist = 1e12;
+  auto inside = false;
+
+  for(const auto &poly : obs_map)
+  {
+    // convex and counter-clockwise so inside is
+    // on the left of every edge
+    auto left_all = !poly.empty();
+
+    for(unsigned int i = 0; i < poly.size(); i++)
+    {
+      const auto &v1 = poly.at(i);
+      const auto &v2 = poly.at((i + 1) % poly.size());
+
+      const ClosePoint clpt = signMinDist2Line(v1, v2, p);
+
+      // distance to the edge or the closer vertex
+      if (clpt.on_seg)
+      {
+        min_dist = std::min(min_dist, std::fabs(clpt.sign_d));
+      }
+
+      else
+      {
+        const auto &v = (clpt.t < 0.0) ? v1 : v2;
+        min_dist = std::min(min_dist, euclideanDistance(v.x, v.y, p.x, p.y));
+      }
+
+      if (clpt.sign_d <= 0.0)
+      {
+        left_all = false;
+      }
+    }
+
+    inside = inside or left_all;
+  }
+
+  return inside ? -min_dist : min_dist;
+}
+
+
+Vector2D PotentialField::descentStep(const Vector2D &p, const Vector2D &goal) const
+{
+  const Vector2D Dn = descentDirection(repulsiveGradientAt(p), attractiveGradient(p, goal));
+  return Vector2D(p.x - step * Dn.x, p.y - step * Dn.y);
+}
+
+
+Vector2D PotentialField::accumulateRepulsiveGradient(const Vector2D &p) const
 {
   Vector2D Urep(0.0, 0.0);
 
@@ -127,7 +381,7 @@ Vector2D PotentialField::accumulateRepulsiveGradient() const
       }
 
       // min distance to from edge between vertices to current position
-      ClosePoint clpt = signMinDist2Line(v1, v2, q);
+      ClosePoint clpt = signMinDist2Line(v1, v2, p);
 
       // update nominal distance and the postion of the closest point
       //  min on edge: v1 => v2
@@ -141,7 +395,7 @@ Vector2D PotentialField::accumulateRepulsiveGradient() const
       // closer to v1
       else if (clpt.t < 0.0)
       {
-        const auto nom_dist = euclideanDistance(v1.x, v1.y, q.x, q.y);
+        const auto nom_dist = euclideanDistance(v1.x, v1.y, p.x, p.y);
         if (nom_dist < min_dist)
         {
           q0 = v1;
@@ -153,7 +407,7 @@ Vector2D PotentialField::accumulateRepulsiveGradient() const
       // closer to v2
       else
       {
-        const auto nom_dist = euclideanDistance(v2.x, v2.y, q.x, q.y);
+        const auto nom_dist = euclideanDistance(v2.x, v2.y, p.x, p.y);
         if (nom_dist < min_dist)
         {
           q0 = v2;
@@ -164,7 +418,7 @@ Vector2D PotentialField::accumulateRepulsiveGradient() const
     } // end inner loop
 
     // repulsive gradient for obstacle
-    const Vector2D Uobs = repulsiveGradient(q0, min_dist);
+    const Vector2D Uobs = repulsiveGradient(p, q0, min_dist);
 
     // accumulate gradient
     Urep += Uobs;
@@ -175,7 +429,7 @@ Vector2D PotentialField::accumulateRepulsiveGradient() const
 }
 
 
-Vector2D PotentialField::repulsiveGradient(const Vector2D &q0, double d) const
+Vector2D PotentialField::repulsiveGradient(const Vector2D &p, const Vector2D &q0, double d) const
 {
   // TODO check if d ~0.0
 
@@ -188,8 +442,8 @@ Vector2D PotentialField::repulsiveGradient(const Vector2D &q0, double d) const
 
     // unit vector
     // current position minus closest point
-    Urep.x = (q0.x - q.x) / d;
-    Urep.y = (q0.y - q.y) / d;
+    Urep.x = (q0.x - p.x) / d;
+    Urep.y = (q0.y - p.y) / d;
 
     // weight the unit vector
     Urep *= w_rep * (1.0 / (qthresh - d)) * (1.0 / d*d);
@@ -199,16 +453,16 @@ Vector2D PotentialField::repulsiveGradient(const Vector2D &q0, double d) const
 }
 
 
-Vector2D PotentialField::attractiveGradient() const
+Vector2D PotentialField::attractiveGradient(const Vector2D &p, const Vector2D &goal) const
 {
-  // euclidean distance from current position (q) to goal (qd)
-  const auto dg = euclideanDistance(q.x, q.y, qg.x, qg.y);
+  // euclidean distance from position (p) to goal
+  const auto dg = euclideanDistance(p.x, p.y, goal.x, goal.y);
 
   // attractive gradient for this obstacle
   Vector2D Uatt(0.0, 0.0);
 
-  Uatt.x = w_att * (q.x - qg.x);
-  Uatt.y = w_att * (q.y - qg.y);
+  Uatt.x = w_att * (p.x - goal.x);
+  Uatt.y = w_att * (p.y - goal.y);
 
   if (dg > dthresh)
   {
@@ -225,7 +479,7 @@ bool PotentialField::goalReached()
   // euclidean distance from current position (q) to goal (qd)
   if (euclideanDistance(q.x, q.y, qg.x, qg.y) < eps and !goal_reached)
   {
-    std::cout << "Goal Reached" << std::endl;
+    RIGID2D_LOG(rigid2d::LogLevel::Info, "potential_field.goal_reached");
     goal_reached = true;
     return true;
   }
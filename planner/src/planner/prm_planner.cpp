@@ -5,50 +5,75 @@
 #include <algorithm>
 #include <iostream>
 
+#include <rigid2d/instrumentation.hpp>
+#include <rigid2d/logging.hpp>
+
 #include "planner/prm_planner.hpp"
 
 
 namespace planner
 {
 
-PRMPlanner::PRMPlanner(RoadMap &prm) : prm(prm)
+PRMPlanner::PRMPlanner(const RoadMap &prm) : prm(prm),
+                                             g(prm.numNodes(), 1e12),
+                                             parent(prm.numNodes(), -1),
+                                             closed(prm.numNodes(), false),
+                                             start_id(-1),
+                                             goal_id(-1),
+                                             curr_id(-1)
 {
-  prm.getRoadMap(roadmap);
-  start_id = roadmap.at(roadmap.size()-2).id;
-  goal_id = roadmap.at(roadmap.size()-1).id;
+}
 
-  // update cost of start
-  roadmap.at(start_id).f = 0.0;
-  roadmap.at(start_id).g = 0.0;
 
-  // add the start
-  open_list.push_back(roadmap.at(start_id));
+bool PRMPlanner::planPath()
+{
+  // start node is at position n-2
+  // goal node is at position n-1
+  const int num_nodes = prm.numNodes();
+  return planPath(num_nodes - 2, num_nodes - 1);
 }
 
 
-bool PRMPlanner::planPath()
+bool PRMPlanner::planPath(int start, int goal)
 {
+  RIGID2D_SCOPED_TIMER("prm.plan");
+
+  resetQuery();
+
+  start_id = start;
+  goal_id = goal;
+
+  // update cost of start
+  g.at(start_id) = 0.0;
+  touched.push_back(start_id);
+
+  // add the start
+  open_list.push({heuristic(start_id), 0.0, start_id});
 
   while (!open_list.empty())
   {
     // node with min cost
-    std::sort(open_list.begin(), open_list.end(), SortCost());
-    auto it = open_list.begin();
-    const Node min_node = (*it);
+    const OpenEntry min_node = open_list.top();
 
     // remove min node from open set
-    open_list.erase(it);
+    open_list.pop();
+
+    // stale entry, a cheaper path was found after it was pushed
+    if (closed[min_node.id] or min_node.g > g[min_node.id])
+    {
+      continue;
+    }
 
     curr_id = min_node.id;
 
     if (curr_id == goal_id)
     {
-      std::cout << "Goal reached!" <<  std::endl;
+      RIGID2D_LOG(rigid2d::LogLevel::Debug, "prm.goal_reached", {{"touched", static_cast<double>(touched.size())}});
       return true;
     }
 
     // add current node to closed set
-    closed_set.insert(curr_id);
+    closed[curr_id] = true;
 
     // compose cost of neighboring cells to the current node
     // and enqueue them
@@ -57,20 +82,40 @@ bool PRMPlanner::planPath()
   return false;
 }
 
-void PRMPlanner::exploreNeighbors()
+
+void PRMPlanner::resetQuery()
 {
-  // loop across nodes adjacency list
-  for(unsigned int i = 0; i < roadmap.at(curr_id).edges.size(); i++)
+  // the road map may have been rebuilt since the last query
+  if (g.size() != prm.numNodes())
   {
-    // index ID of a neighboring node
-    const auto nid = roadmap.at(curr_id).edges.at(i).id;
+    g.assign(prm.numNodes(), 1e12);
+    parent.assign(prm.numNodes(), -1);
+    closed.assign(prm.numNodes(), false);
+    touched.clear();
+  }
+
+  // only reset the nodes the last query visited
+  for(const auto id : touched)
+  {
+    g[id] = 1e12;
+    parent[id] = -1;
+    closed[id] = false;
+  }
+  touched.clear();
+
+  open_list = {};
+  curr_id = -1;
+}
 
-    // edge(s s')
-    const auto edge = roadmap.at(curr_id).edges.at(i);
 
+void PRMPlanner::exploreNeighbors()
+{
+  // loop across nodes adjacency list
+  for(const auto &edge : prm.adjacentEdges(curr_id))
+  {
     // the neighbor is on closed list
-    auto search_closed = closed_set.find(nid);
-    if (search_closed != closed_set.end())
+    // or the edge is blocked
+    if (closed[edge.id] or !prm.edgeFree(curr_id, edge))
     {
       continue;
     }
@@ -81,121 +126,70 @@ void PRMPlanner::exploreNeighbors()
 
 void PRMPlanner::updateNode(const Edge &edge)
 {
-  // TODO: add edge between parent(s) and s' in strigh line
-
-  // temp node, may need to update prm node based on this one
-  Node temp_node = roadmap.at(edge.id);
-
   // compose costs
   // g(s, s')
-  temp_node.g = roadmap.at(curr_id).g + edge.d;
-  // f(s') = g(s, s') + h(s')
-  temp_node.f = temp_node.g + heuristic(edge.id);
-
-  // set neighbor's parent
-  temp_node.parent_id = curr_id;
+  auto g_new = g[curr_id] + edge.d;
+  auto parent_new = curr_id;
 
   // get parent ID and check for path optimization
-  auto ps_id = roadmap.at(curr_id).parent_id;
-
-  // there is no parent because this is the start node
-  bool at_start = false;
-  if (ps_id == -1)
-  {
-    at_start = true;
-    ps_id = curr_id;
-  }
+  // there is no parent at the start node
+  const auto ps_id = parent[curr_id];
 
-  // check for line of sight from (s s')
-  if (prm.stlnPathCollision(roadmap.at(ps_id).point, roadmap.at(edge.id).point))
+  // check for line of sight from parent(s) to s'
+  if (ps_id != -1 and
+      prm.stlnPathCollision(prm.nodePoint(ps_id), prm.nodePoint(edge.id)))
   {
-    Node parent_node = roadmap.at(ps_id);
-
-    // distance from parent(s) to s'
-    const auto d = euclideanDistance(parent_node.point.x,
-                                     parent_node.point.y,
-                                     roadmap.at(edge.id).point.x,
-                                     roadmap.at(edge.id).point.y);
+    const auto &ps = prm.nodePoint(ps_id);
+    const auto &sp = prm.nodePoint(edge.id);
 
     // true cost from parent(s) to s'
-    const auto gps = parent_node.g + d;
+    const auto gps = g[ps_id] + euclideanDistance(ps.x, ps.y, sp.x, sp.y);
 
-    if (gps < temp_node.g or at_start)
+    if (gps < g_new)
     {
-      temp_node.g = gps;
-      temp_node.f = gps + heuristic(edge.id);
-      temp_node.parent_id = ps_id;
-
-
-      auto it = std::find_if(open_list.begin(), open_list.end(), MatchesID(edge.id));
-      if (it != open_list.end())
-      {
-        (*it) = temp_node;
-        roadmap.at(edge.id) = temp_node;
-      }
-
-      else
-      {
-        roadmap.at(edge.id) = temp_node;
-        open_list.push_back(temp_node);
-      }
+      g_new = gps;
+      parent_new = ps_id;
     }
   }
 
-  else
+  // not on the open list or found a cheaper path
+  if (g_new < g[edge.id])
   {
-    // if on open set compare true cost and update if needed
-    auto it = std::find_if(open_list.begin(), open_list.end(), MatchesID(edge.id));
-    if (it != open_list.end())
+    if (rigid2d::almost_equal(g[edge.id], 1e12))
     {
-      // NOTE: this means this node has already been added to the open list
-      //       but may need to update its costs
-      // id should be the same as node
-      Node open_node = (*it);
-
-      if (temp_node.g < open_node.g)
-      {
-        (*it) = temp_node;
-        // update prm based on temp node
-        roadmap.at(edge.id) = temp_node;
-      }
+      touched.push_back(edge.id);
     }
 
-    // not on open set then add it
-    else
-    {
-      roadmap.at(edge.id) = temp_node;
-      open_list.push_back(temp_node);
-    }
+    g[edge.id] = g_new;
+    parent[edge.id] = parent_new;
+
+    // f(s') = g(s, s') + h(s')
+    open_list.push({g_new + heuristic(edge.id), g_new, edge.id});
   }
 }
 
 
-void PRMPlanner::getPath(std::vector<Vector2D> &path)
+void PRMPlanner::getPath(std::vector<Vector2D> &path) const
 {
   auto id = curr_id;
 
   while(id != -1)
   {
-    Node node = roadmap.at(id);
-    path.push_back(node.point);
-
-    id = node.parent_id;
+    path.push_back(prm.nodePoint(id));
+    id = parent[id];
   }
 
   std::reverse(path.begin(), path.end());
 }
 
 
-double PRMPlanner::heuristic(const int id)
+double PRMPlanner::heuristic(const int id) const
 {
   // distance from node to goal
-  const auto h = euclideanDistance(roadmap.at(id).point.x,
-                                   roadmap.at(id).point.y,
-                                   roadmap.at(goal_id).point.x,
-                                   roadmap.at(goal_id).point.y);
+  const auto &p = prm.nodePoint(id);
+  const auto &pg = prm.nodePoint(goal_id);
 
-  return h;
+  return euclideanDistance(p.x, p.y, pg.x, pg.y);
 }
 
 } // end namespace
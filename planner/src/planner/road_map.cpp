@@ -4,7 +4,9 @@
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
-#include <unordered_map>
+#include <fstream>
+#include <algorithm>
+#include <limits>
 
 #include "planner/road_map.hpp"
 
@@ -12,6 +14,69 @@
 namespace planner
 {
 
+// collision state of an edge
+static constexpr std::uint8_t edge_unknown = 0;
+static constexpr std::uint8_t edge_free = 1;
+static constexpr std::uint8_t edge_blocked = 2;
+
+// spare edge slots per node for connecting start and goal
+static constexpr unsigned int spare_edges = 2;
+
+// binary road map file, values are written in the native byte order
+static constexpr char roadmap_magic[4] = {'P', 'R', 'M', 'B'};
+static constexpr std::uint32_t roadmap_version = 2;
+
+
+/// \brief Write a value to a binary file
+template <typename T>
+static void writeBinary(std::ofstream &file, const T &value)
+{
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+
+/// \brief Read a value from a binary file
+template <typename T>
+static void readBinary(std::ifstream &file, T &value)
+{
+  file.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+
+/// \brief 64 bit FNV-1a hash of the obstacle polygons
+/// \param obs_map - coordinates of all polygons in Cspace
+/// \return - hash of the polygon count, vertex counts and vertices
+static std::uint64_t obstacleMapHash(const obstacle_map &obs_map)
+{
+  auto hash = 14695981039346656037ULL;
+  const auto mix = [&hash](const void *data, std::size_t size)
+  {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for(std::size_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  };
+
+  const auto num_polygons = static_cast<std::uint64_t>(obs_map.size());
+  mix(&num_polygons, sizeof(num_polygons));
+
+  for(const auto &poly : obs_map)
+  {
+    const auto num_vertices = static_cast<std::uint64_t>(poly.size());
+    mix(&num_vertices, sizeof(num_vertices));
+
+    for(const auto &v : poly)
+    {
+      mix(&v.x, sizeof(v.x));
+      mix(&v.y, sizeof(v.y));
+    }
+  }
+
+  return hash;
+}
+
+
 
 bool lnSegIntersectPolygon(const polygon &poly,
                            const Vector2D &p1,
@@ -125,7 +190,9 @@ RoadMap::RoadMap(double xmin, double xmax,
                  double ymin, double ymax,
                  double bnd_rad,
                  unsigned int neighbors, unsigned int num_nodes,
-                 obstacle_map obs_map)
+                 obstacle_map obs_map,
+                 unsigned int num_threads,
+                 bool lazy_edges)
                     : xmin(xmin),
                       xmax(xmax),
                       ymin(ymin),
@@ -133,7 +200,10 @@ RoadMap::RoadMap(double xmin, double xmax,
                       bnd_rad(bnd_rad),
                       k(neighbors),
                       n(num_nodes),
-                      obs_map(obs_map)
+                      obs_map(obs_map),
+                      num_threads(num_threads == 0 ? defaultNumThreads() : num_threads),
+                      lazy_edges(lazy_edges),
+                      attached(false)
 {
   // TODO: add check to make sure start/goal are within bounds
 
@@ -150,6 +220,27 @@ void RoadMap::getRoadMap(std::vector<Node> &roadmap) const
 }
 
 
+unsigned int RoadMap::numNodes() const
+{
+  return nodes.size();
+}
+
+
+const Vector2D &RoadMap::nodePoint(int id) const
+{
+  return nodes.at(id).point;
+}
+
+
+EdgeRange RoadMap::adjacentEdges(int id) const
+{
+  EdgeRange range;
+  range.first = edges.data() + edge_offsets.at(id);
+  range.last = range.first + edge_count.at(id);
+  return range;
+}
+
+
 void RoadMap::printRoadMap() const
 {
   for(const auto &nd : nodes)
@@ -158,7 +249,7 @@ void RoadMap::printRoadMap() const
     std::cout << nd.id << "| ";
 
 
-    for(const auto &ed : nd.edges)
+    for(const auto &ed : adjacentEdges(nd.id))
     {
       std::cout << "id: " <<  ed.id << " ";
     }
@@ -167,60 +258,361 @@ void RoadMap::printRoadMap() const
 }
 
 
-
-void RoadMap::constructRoadMap(const Vector2D &start, const Vector2D &goal)
+void RoadMap::constructRoadMap()
 {
   // clear prvious graph
   nodes.clear();
+  edge_offsets.clear();
+  edge_count.clear();
+  edges.clear();
+  attached = false;
+
+  // start adding nodes
+  // each thread seeds its own generator from this
+  sampleNodes(rigid2d::threadGenerator()());
+
+  // add edges
+  connectNodes();
+}
+
+
+void RoadMap::constructRoadMap(const Vector2D &start, const Vector2D &goal)
+{
+  // the road map is kept between queries
+  if (nodes.empty())
+  {
+    constructRoadMap();
+  }
+
+  // add start and end goals
+  if(!attachStartGoal(start, goal))
+  {
+    std::cout << "ERROR: Disconnected graph" << std::endl;
+  }
+}
+
+
+bool RoadMap::attachStartGoal(const Vector2D &start, const Vector2D &goal)
+{
+  if (nodes.empty())
+  {
+    std::cout << "ERROR: road map NOT constructed" << std::endl;
+    return false;
+  }
+
+  // remove previous query
+  detachStartGoal();
 
   if (!isFreeSpace(start) and !collideWalls(start))
   {
     std::cout << "ERROR: starting position NOT valid" << std::endl;
-    return;
+    return false;
   }
 
   if (!isFreeSpace(goal) and !collideWalls(goal))
   {
     std::cout << "ERROR: goal position NOT valid" << std::endl;
+    return false;
+  }
+
+  Node start_node, goal_node;
+  start_node.id = n;
+  start_node.point = start;
+  goal_node.id = n + 1;
+  goal_node.point = goal;
+
+  nodes.push_back(start_node);
+  nodes.push_back(goal_node);
+  attached = true;
+
+  // connect both to the road map, then add the edge between them once
+  attachNode(start_node.id);
+  attachNode(goal_node.id);
+
+  if (lazy_edges or stlnPathCollision(start, goal))
+  {
+    const auto d = euclideanDistance(start.x, start.y, goal.x, goal.y);
+    const auto state = lazy_edges ? edge_unknown : edge_free;
+
+    appendEdge(start_node.id, {goal_node.id, d}, state);
+    appendEdge(goal_node.id, {start_node.id, d}, state);
+  }
+
+  // start node has neighbors
+  if (edge_count.at(start_node.id) == 0)
+  {
+    std::cout << "ERROR: start node NOT connected to PRM" << std::endl;
+    return false;
+  }
+
+  // goal node has neighbors
+  if (edge_count.at(goal_node.id) == 0)
+  {
+    std::cout << "ERROR: goal node NOT connected to PRM" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+void RoadMap::detachStartGoal()
+{
+  if (!attached)
+  {
     return;
   }
 
-  // start adding nodes
-  while(nodes.size() < n)
+  const int num_nodes = n;
+
+  for(auto id = num_nodes; id < num_nodes + 2; id++)
   {
-    Vector2D q = randomPoint();
-    // Vector2D q = hc.at(i);
+    for(const auto &ed : adjacentEdges(id))
+    {
+      // edges to start/goal were appended last
+      if (ed.id < num_nodes)
+      {
+        auto &count = edge_count.at(ed.id);
+        while(count > 0 and edges.at(edge_offsets.at(ed.id) + count - 1).id >= num_nodes)
+        {
+          count--;
+        }
+      }
+    }
+
+    edge_count.at(id) = 0;
+  }
+
+  nodes.resize(n);
+  attached = false;
+}
+
+
+bool RoadMap::edgeFree(int id, const Edge &edge) const
+{
+  const auto idx = static_cast<std::size_t>(&edge - edges.data());
+  auto state = edge_state.at(idx).load(std::memory_order_relaxed);
 
-    if(!collideWalls(q) and isFreeSpace(q))
+  if (state == edge_unknown)
+  {
+    state = stlnPathCollision(nodes.at(id).point, nodes.at(edge.id).point) ? edge_free : edge_blocked;
+    edge_state.at(idx).store(state, std::memory_order_relaxed);
+
+    // the same edge stored in the opposite direction
+    const auto first = edge_offsets.at(edge.id);
+    for(auto i = first; i < first + edge_count.at(edge.id); i++)
     {
-      addNode(q);
+      if (edges.at(i).id == id)
+      {
+        edge_state.at(i).store(state, std::memory_order_relaxed);
+        break;
+      }
     }
-  } // end while loop
+  }
 
-  // add edges
-  for(auto &nd : nodes)
+  return state == edge_free;
+}
+
+
+bool RoadMap::saveRoadMap(const std::string &filename) const
+{
+  if (nodes.empty())
   {
-    // find kNN
-    std::vector<int> neighbors;
-    nearestNeighbors(nd, neighbors);
+    std::cout << "ERROR: road map NOT constructed" << std::endl;
+    return false;
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    std::cout << "ERROR: could NOT open " << filename << std::endl;
+    return false;
+  }
+
+  // header
+  file.write(roadmap_magic, sizeof(roadmap_magic));
+  writeBinary(file, roadmap_version);
+  writeBinary(file, xmin);
+  writeBinary(file, xmax);
+  writeBinary(file, ymin);
+  writeBinary(file, ymax);
+  writeBinary(file, bnd_rad);
+  writeBinary(file, static_cast<std::uint32_t>(k));
+  writeBinary(file, static_cast<std::uint32_t>(n));
+  writeBinary(file, obstacleMapHash(obs_map));
+
+  // nodes
+  for(unsigned int i = 0; i < n; i++)
+  {
+    writeBinary(file, nodes.at(i).point.x);
+    writeBinary(file, nodes.at(i).point.y);
+  }
 
-    for(const auto neighbor_id : neighbors)
+  // degree of each node, the edges to start/goal are left out
+  // they are always at the end of a node's edges
+  std::vector<std::uint32_t> degree(n, 0);
+  for(unsigned int i = 0; i < n; i++)
+  {
+    for(const auto &ed : adjacentEdges(i))
     {
-      // adds edge from nd to neighbor
-      // and from neighbor to nd
-      if(stlnPathCollision(nd.point, nodes.at(neighbor_id).point))
+      if (ed.id < static_cast<int>(n))
       {
-        addEdge(nd.id, neighbor_id);
+        degree.at(i)++;
       }
-    } // end inner loop
-  } // end outer loop
+    }
+    writeBinary(file, degree.at(i));
+  }
 
-  // add start and end goals
-  if(!addStartGoalConfig(start, goal))
+  // edges
+  for(unsigned int i = 0; i < n; i++)
   {
-    std::cout << "ERROR: Disconnected graph" << std::endl;
+    const auto first = edge_offsets.at(i);
+    for(auto j = first; j < first + degree.at(i); j++)
+    {
+      writeBinary(file, static_cast<std::int32_t>(edges.at(j).id));
+      writeBinary(file, edges.at(j).d);
+      writeBinary(file, edge_state.at(j).load(std::memory_order_relaxed));
+    }
   }
 
+  return static_cast<bool>(file);
+}
+
+
+bool RoadMap::loadRoadMap(const std::string &filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    std::cout << "ERROR: could NOT open " << filename << std::endl;
+    return false;
+  }
+
+  char magic[sizeof(roadmap_magic)];
+  std::uint32_t version = 0, file_k = 0, file_n = 0;
+  std::uint64_t file_obs_hash = 0;
+  double file_xmin = 0.0, file_xmax = 0.0, file_ymin = 0.0, file_ymax = 0.0, file_bnd_rad = 0.0;
+
+  file.read(magic, sizeof(magic));
+  readBinary(file, version);
+  readBinary(file, file_xmin);
+  readBinary(file, file_xmax);
+  readBinary(file, file_ymin);
+  readBinary(file, file_ymax);
+  readBinary(file, file_bnd_rad);
+  readBinary(file, file_k);
+  readBinary(file, file_n);
+  readBinary(file, file_obs_hash);
+
+  if (!file or !std::equal(magic, magic + sizeof(magic), roadmap_magic) or version != roadmap_version)
+  {
+    std::cout << "ERROR: " << filename << " is NOT a road map" << std::endl;
+    return false;
+  }
+
+  // road map must have been built for this map
+  if (!rigid2d::almost_equal(file_xmin, xmin) or !rigid2d::almost_equal(file_xmax, xmax) or
+      !rigid2d::almost_equal(file_ymin, ymin) or !rigid2d::almost_equal(file_ymax, ymax) or
+      !rigid2d::almost_equal(file_bnd_rad, bnd_rad) or file_k != k or file_n <= k)
+  {
+    std::cout << "ERROR: road map in " << filename << " was built with different parameters" << std::endl;
+    return false;
+  }
+
+  // edges were collision checked against the obstacles it was built with
+  if (file_obs_hash != obstacleMapHash(obs_map))
+  {
+    std::cout << "ERROR: road map in " << filename << " was built for a different obstacle map" << std::endl;
+    return false;
+  }
+
+  // bytes left after the header bound the number of nodes and edges
+  const auto header_end = file.tellg();
+  file.seekg(0, std::ios::end);
+  const auto body_bytes = static_cast<std::uint64_t>(file.tellg() - header_end);
+  file.seekg(header_end);
+
+  constexpr std::uint64_t node_bytes = 2 * sizeof(double) + sizeof(std::uint32_t);
+  constexpr std::uint64_t edge_bytes = sizeof(std::int32_t) + sizeof(double) + sizeof(std::uint8_t);
+  if (!file or body_bytes < file_n * node_bytes)
+  {
+    std::cout << "ERROR: " << filename << " is truncated" << std::endl;
+    return false;
+  }
+
+  // parsed into locals, the road map is only replaced once the whole file is valid
+  std::vector<Node> file_nodes(file_n);
+  for(unsigned int i = 0; i < file_n; i++)
+  {
+    file_nodes.at(i).id = i;
+    readBinary(file, file_nodes.at(i).point.x);
+    readBinary(file, file_nodes.at(i).point.y);
+  }
+
+  std::vector<unsigned int> degree(file_n, 0);
+  std::uint64_t num_edges = 0;
+  for(unsigned int i = 0; i < file_n; i++)
+  {
+    std::uint32_t deg = 0;
+    readBinary(file, deg);
+
+    // no self loops or repeated neighbors
+    if (deg >= file_n)
+    {
+      std::cout << "ERROR: " << filename << " is corrupt" << std::endl;
+      return false;
+    }
+
+    degree.at(i) = deg;
+    num_edges += deg;
+  }
+
+  // the edges must fit in the rest of the file and in the adjacency offsets
+  const auto num_slots = num_edges + static_cast<std::uint64_t>(spare_edges) * file_n + 2 * (k + 1);
+  if (!file or num_edges * edge_bytes > body_bytes - file_n * node_bytes or
+      num_slots > std::numeric_limits<unsigned int>::max())
+  {
+    std::cout << "ERROR: " << filename << " is truncated" << std::endl;
+    return false;
+  }
+
+  std::vector<Edge> file_edges(num_edges);
+  std::vector<std::uint8_t> file_states(num_edges);
+  for(std::size_t e = 0; e < num_edges; e++)
+  {
+    std::int32_t id = -1;
+    auto &edge = file_edges[e];
+    auto &state = file_states[e];
+
+    readBinary(file, id);
+    readBinary(file, edge.d);
+    readBinary(file, state);
+
+    if (!file or id < 0 or id >= static_cast<std::int32_t>(file_n) or
+        (state != edge_unknown and state != edge_free and state != edge_blocked))
+    {
+      std::cout << "ERROR: " << filename << " is corrupt" << std::endl;
+      return false;
+    }
+
+    edge.id = id;
+  }
+
+  nodes = std::move(file_nodes);
+  n = file_n;
+  attached = false;
+  allocateAdjacency(degree);
+
+  std::size_t e = 0;
+  for(unsigned int i = 0; i < n; i++)
+  {
+    for(unsigned int j = 0; j < degree.at(i); j++, e++)
+    {
+      appendEdge(i, file_edges.at(e), file_states.at(e));
+    }
+  }
+
+  return true;
 }
 
 
@@ -238,97 +630,214 @@ bool RoadMap::stlnPathCollision(const Vector2D &p1, const Vector2D &p2) const
 }
 
 
-bool RoadMap::addStartGoalConfig(const Vector2D &start, const Vector2D &goal)
+void RoadMap::sampleNodes(unsigned long seed)
 {
-  const auto start_id = addNode(start);
-  const auto goal_id = addNode(goal);
+  nodes.resize(n);
 
+  parallelFor(0, n, num_threads, [&](unsigned int t, unsigned int lo, unsigned int hi)
+  {
+    // generator owned by this thread
+    rigid2d::Xoshiro256 gen(seed, t);
 
-  // KNN for start
-  std::vector<int> neighbors;
-  nearestNeighbors(nodes.at(start_id), neighbors);
+    for(auto i = lo; i < hi; i++)
+    {
+      // rejection sampling
+      Vector2D q = randomPoint(gen);
+      while(collideWalls(q) or !isFreeSpace(q))
+      {
+        q = randomPoint(gen);
+      }
 
-  for(const auto neighbor_id : neighbors)
+      nodes[i].id = i;
+      nodes[i].point = q;
+    }
+  });
+}
+
+
+void RoadMap::connectNodes()
+{
+  const unsigned int num_nodes = nodes.size();
+
+  // kNN of every node, stored k per node
+  std::vector<int> knn(num_nodes * k, -1);
+
+  parallelFor(0, num_nodes, num_threads, [&](unsigned int, unsigned int lo, unsigned int hi)
+  {
+    std::vector<std::pair<double, int>> candidates;
+    std::vector<int> neighbors;
+
+    for(auto i = lo; i < hi; i++)
+    {
+      nearestNeighbors(i, candidates, neighbors);
+      std::copy(neighbors.begin(), neighbors.end(), knn.begin() + i * k);
+    }
+  });
+
+  // true if node j has node i as one of its kNN
+  auto isNeighbor = [&](int j, int i)
+  {
+    const auto first = knn.begin() + j * k;
+    return std::find(first, first + k, i) != first + k;
+  };
+
+  // collision check the candidate edges, each thread writes the
+  // valid edges to its own buffer
+  // with lazy validation the check is deferred to the search
+  std::vector<std::vector<std::pair<int, int>>> buffers(num_threads);
+
+  parallelFor(0, num_nodes, num_threads, [&](unsigned int t, unsigned int lo, unsigned int hi)
   {
-      // adds edge from nd to neighbor
-      // and from neighbor to nd
-      if(stlnPathCollision(nodes.at(start_id).point, nodes.at(neighbor_id).point))
+    auto &buffer = buffers[t];
+
+    for(auto i = lo; i < hi; i++)
+    {
+      for(unsigned int m = 0; m < k; m++)
       {
-        addEdge(nodes.at(start_id).id, neighbor_id);
+        const int j = knn[i * k + m];
+
+        // make sure not to add edge to self
+        // if both nodes are each others neighbor only check the edge once
+        if (j == -1 or j == static_cast<int>(i) or (j < static_cast<int>(i) and isNeighbor(j, i)))
+        {
+          continue;
+        }
+
+        if (lazy_edges or stlnPathCollision(nodes[i].point, nodes[j].point))
+        {
+          buffer.emplace_back(i, j);
+        }
       }
-  }
+    }
+  });
 
-  // start node has neighbors
-  if (nodes.at(start_id).edges.empty())
+  // merge buffers into the CSR adjacency
+  // edges are undirected so each is stored in both directions
+  std::vector<unsigned int> degree(num_nodes, 0);
+  for(const auto &buffer : buffers)
   {
-    std::cout << "ERROR: start node NOT connected to PRM" << std::endl;
-    return false;
+    for(const auto &ed : buffer)
+    {
+      degree[ed.first]++;
+      degree[ed.second]++;
+    }
   }
 
-  // KNN for goal
-  neighbors.clear();
-  nearestNeighbors(nodes.at(goal_id), neighbors);
+  allocateAdjacency(degree);
 
-  for(const auto neighbor_id : neighbors)
+  const auto state = lazy_edges ? edge_unknown : edge_free;
+  for(const auto &buffer : buffers)
   {
-      // adds edge from nd to neighbor
-      // and from neighbor to nd
-      if(stlnPathCollision(nodes.at(goal_id).point, nodes.at(neighbor_id).point))
-      {
-        addEdge(nodes.at(goal_id).id, neighbor_id);
-      }
+    for(const auto &ed : buffer)
+    {
+      // distance between nodes
+      const auto &p1 = nodes[ed.first].point;
+      const auto &p2 = nodes[ed.second].point;
+      const auto d = euclideanDistance(p1.x, p1.y, p2.x, p2.y);
+
+      appendEdge(ed.first, {ed.second, d}, state);
+      appendEdge(ed.second, {ed.first, d}, state);
+    }
   }
+}
 
-  // goal node has neighbors
-  if (nodes.at(goal_id).edges.empty())
+
+void RoadMap::allocateAdjacency(const std::vector<unsigned int> &degree)
+{
+  const unsigned int num_nodes = degree.size();
+
+  // slots for the road map nodes followed by start and goal
+  // the goal may also connect to the start
+  edge_offsets.assign(num_nodes + 3, 0);
+  for(unsigned int i = 0; i < num_nodes; i++)
   {
-    std::cout << "ERROR: goal node NOT connected to PRM" << std::endl;
-    return false;
+    edge_offsets[i + 1] = edge_offsets[i] + degree[i] + spare_edges;
   }
+  edge_offsets[num_nodes + 1] = edge_offsets[num_nodes] + k + 1;
+  edge_offsets[num_nodes + 2] = edge_offsets[num_nodes + 1] + k + 1;
 
-  return true;
+  edge_count.assign(num_nodes + 2, 0);
+  edges.assign(edge_offsets.back(), Edge());
+  edge_state = std::vector<std::atomic<std::uint8_t>>(edge_offsets.back());
 }
 
 
+void RoadMap::attachNode(int id)
+{
+  std::vector<std::pair<double, int>> candidates;
+  std::vector<int> neighbors;
+  nearestNeighbors(id, candidates, neighbors);
+
+  for(const auto neighbor_id : neighbors)
+  {
+    // the edge between start and goal is added by attachStartGoal()
+    if (neighbor_id >= static_cast<int>(n))
+    {
+      continue;
+    }
 
+    // adds edge from id to neighbor
+    // and from neighbor to id
+    const auto &p1 = nodes.at(id).point;
+    const auto &p2 = nodes.at(neighbor_id).point;
 
+    if (lazy_edges or stlnPathCollision(p1, p2))
+    {
+      const auto d = euclideanDistance(p1.x, p1.y, p2.x, p2.y);
+      const auto state = lazy_edges ? edge_unknown : edge_free;
 
-void RoadMap::nearestNeighbors(const Node &query, std::vector<int> &neighbors) const
+      appendEdge(id, {neighbor_id, d}, state);
+      appendEdge(neighbor_id, {id, d}, state);
+    }
+  }
+}
+
+
+void RoadMap::appendEdge(int id, const Edge &edge, std::uint8_t state)
+{
+  const auto slot = edge_offsets.at(id) + edge_count.at(id);
+  if (slot >= edge_offsets.at(id + 1))
+  {
+    throw std::invalid_argument("No free edge slots for node in road map");
+  }
+
+  edges[slot] = edge;
+  edge_state[slot].store(state, std::memory_order_relaxed);
+  edge_count.at(id)++;
+}
+
+
+void RoadMap::nearestNeighbors(int query_id,
+                               std::vector<std::pair<double, int>> &candidates,
+                               std::vector<int> &neighbors) const
 {
   // // TODO: find better method than searching all neighbors i.e kd trees
-  neighbors.reserve(k);
+  const auto &query = nodes[query_id].point;
 
-  // map distance to node index
-  // the size is size-1 b/c we do not want to compose distance to self
-  std::unordered_map<double, unsigned int> umap(nodes.size()-1);
-  std::vector<double> distances(nodes.size()-1);
+  candidates.clear();
+  candidates.reserve(nodes.size() - 1);
 
-  unsigned int i = 0;
   for(const auto &nd : nodes)
   {
     // do not compute distance to self
-    if (query.id == nd.id)
+    if (query_id == nd.id)
     {
       continue;
     }
 
-    const auto d = euclideanDistance(nd.point.x, nd.point.y, query.point.x, query.point.y);
-    distances.at(i) = d;
-    umap.insert({d, nd.id});
-
-    i++;
+    const auto d = euclideanDistance(nd.point.x, nd.point.y, query.x, query.y);
+    candidates.emplace_back(d, nd.id);
   } // end loop
 
-  // sort in descending order
-  std::sort(distances.begin(), distances.end(), std::greater<double>());
+  // only the k closest need to be ordered
+  const auto kth = std::min<std::size_t>(k, candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + kth, candidates.end());
 
-  // pop off kth NN
-  for(unsigned int i = 0; i < k; i++)
+  neighbors.clear();
+  for(std::size_t i = 0; i < kth; i++)
   {
-    neighbors.push_back(umap.at(distances.back()));
-    // std::cout << umap.at(distances.back()) << std::endl;
-    distances.pop_back();
-  } // end loop
+    neighbors.push_back(candidates[i].second);
+  }
 }
 
 
@@ -524,59 +1033,11 @@ bool RoadMap::lnSegClose2Polygon(const polygon &poly,
 }
 
 
-int RoadMap::addNode(const Vector2D &q)
-{
-  Node nd;
-  nd.id = nodes.size();
-  nd.point = q;
-  nodes.push_back(nd);
-  return nd.id;
-}
-
-
-void RoadMap::addEdge(int id1, int id2)
-{
-  // make sure not to add edge to self
-  if (id1 == id2)
-  {
-    return;
-  }
-
-  // distance between nodes
-  const auto d = euclideanDistance(nodes.at(id1).point.x, nodes.at(id1).point.y, \
-                                   nodes.at(id2).point.x, nodes.at(id2).point.y);
-
-
-  // check if edge exists between id1 -> id2
-  if (!nodes.at(id1).edgeExists(id2))
-  {
-    Edge edge12;
-    edge12.id = id2;
-    edge12.d = d;
-
-    nodes.at(id1).edges.push_back(edge12);
-    nodes.at(id1).id_set.insert(id2);
-  }
-
-
-  // check if edge exists between id2 -> id1
-  if (!nodes.at(id2).edgeExists(id1))
-  {
-    Edge edge21;
-    edge21.id = id1;
-    edge21.d = d;
-
-    nodes.at(id2).edges.push_back(edge21);
-    nodes.at(id2).id_set.insert(id1);
-  }
-}
-
-
-Vector2D RoadMap::randomPoint() const
+Vector2D RoadMap::randomPoint(rigid2d::Xoshiro256 &gen) const
 {
   Vector2D v;
-  v.x = sampleUniformDistribution(xmin, xmax);
-  v.y = sampleUniformDistribution(ymin, ymax);
+  v.x = xmin + (xmax - xmin) * gen.uniform();
+  v.y = ymin + (ymax - ymin) * gen.uniform();
   return v;
 }
 
@@ -13,6 +13,7 @@
 /// qthresh - obstacle range of influence
 /// w_att - weighting factor the attactive component
 /// w_rep - weighting factor the repulsive component
+/// field_resolution - spacing of the precomputed distance/gradient field (0 disables the field)
 /// start_x - start x position in map coordinates
 /// start_y - start y position in map coordinates
 /// goal_x - goal x position in map coordinates
@@ -61,6 +62,7 @@ int main(int argc, char** argv)
   auto qthresh = 0.0;                     // repulsive potenial range of influence
   auto w_att = 0.0;                       // weight attractive potential
   auto w_rep = 0.0;                       // weight repulsive potential
+  auto field_resolution = 0.0;            // spacing of precomputed field
 
   auto freq = 10.0;                       // frequency of node
 
@@ -85,6 +87,7 @@ int main(int argc, char** argv)
   nh.getParam("qthresh", qthresh);
   nh.getParam("w_att", w_att);
   nh.getParam("w_rep", w_rep);
+  nh.getParam("field_resolution", field_resolution);
 
   // start/goal
   nh.getParam("start_x", start_x);
@@ -98,11 +101,11 @@ int main(int argc, char** argv)
   node_handle.getParam("/obstacles", obstacles);
 
 
-  // const auto xmin = static_cast<double>(map_bound[0][0]) * obs_resolution;
-  // const auto xmax = static_cast<double>(map_bound[0][1]) * obs_resolution;
-  //
-  // const auto ymin = static_cast<double>(map_bound[1][0]) * obs_resolution;
-  // const auto ymax = static_cast<double>(map_bound[1][1]) * obs_resolution;
+  const auto xmin = static_cast<double>(map_bound[0][0]) * obs_resolution;
+  const auto xmax = static_cast<double>(map_bound[0][1]) * obs_resolution;
+
+  const auto ymin = static_cast<double>(map_bound[1][0]) * obs_resolution;
+  const auto ymax = static_cast<double>(map_bound[1][1]) * obs_resolution;
 
   ROS_INFO("Marker frame_id %s", frame_id.c_str());
 
@@ -195,6 +198,13 @@ int main(int argc, char** argv)
                                    dthresh, qthresh,
                                    w_att, w_rep);
 
+  // repulsive gradient becomes a lookup
+  if (field_resolution > 0.0)
+  {
+    potfield.buildField(xmin, xmax, ymin, ymax, field_resolution);
+    ROS_INFO("Built potential field with resolution %f", field_resolution);
+  }
+
   // specify start/goal
   potfield.initPath(start, goal);
 
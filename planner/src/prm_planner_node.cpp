@@ -10,6 +10,9 @@
 /// bounding_radius - radius around robot for detecting collistions
 /// nearest_neighbors - nearest neighbors for connecting edges to nodes
 /// num_nodes - number of nodes in roadmap
+/// num_threads - threads used to construct the roadmap (0 uses all cores)
+/// lazy_edges - defer edge collision checks until the search expands them
+/// roadmap_file - binary roadmap loaded if it exists, otherwise the new roadmap is saved to it (optional)
 /// start_x - start x position in map coordinates
 /// start_y - start y position in map coordinates
 /// goal_x - goal x position in map coordinates
@@ -44,12 +47,14 @@ using rigid2d::Vector2D;
 
 
 /// \brief - Fills a marker array with deisred contents
-/// \param nodes - nodes and edges in prm
+/// \param nodes - nodes in prm
+/// \param prm - road map containing the edges
 /// \param color - color of spheres and lines
 /// \param prm - set to true if marker array is for prm
 /// nodes_array[out] - sphere markers for nodes
 /// edges_array[out] - line list markers for edges
 void prmMarkerArray(const std::vector<planner::Node> &nodes,
+                     const planner::RoadMap &prm,
                      visualization_msgs::MarkerArray &nodes_array,
                      visualization_msgs::MarkerArray &edges_array,
                      std::string color);
@@ -82,6 +87,9 @@ int main(int argc, char** argv)
   auto bounding_radius = 0.0;              // bounding radius around robot for collisions
   auto nearest_neighbors = 0;             // number of NN in PRM
   auto num_nodes = 0;                     // number of nodes in PRM
+  auto num_threads = 0;                   // threads used to build the PRM
+  auto lazy_edges = false;                // validate edges during the search
+  std::string roadmap_file;               // saved PRM
 
   // start/goal
   auto start_x = 0.0;
@@ -93,6 +101,9 @@ int main(int argc, char** argv)
   nh.getParam("bounding_radius", bounding_radius);
   nh.getParam("nearest_neighbors", nearest_neighbors);
   nh.getParam("num_nodes", num_nodes);
+  nh.getParam("num_threads", num_threads);
+  nh.getParam("lazy_edges", lazy_edges);
+  nh.getParam("roadmap_file", roadmap_file);
 
   nh.getParam("start_x", start_x);
   nh.getParam("start_y", start_y);
@@ -137,7 +148,9 @@ int main(int argc, char** argv)
                        bounding_radius,
                        nearest_neighbors,
                        num_nodes,
-                       obs_map);
+                       obs_map,
+                       num_threads,
+                       lazy_edges);
 
   // WARNING: start/goal must be within bounds of map
   // TODO: fix this it places node outside of bounds
@@ -149,8 +162,28 @@ int main(int argc, char** argv)
   Vector2D goal(goal_x * obs_resolution, goal_y * obs_resolution);
 
 
-  // construct the prm
-  prm.constructRoadMap(start, goal);
+  // construct the prm once, it is reused for every start/goal
+  if (roadmap_file.empty() or !prm.loadRoadMap(roadmap_file))
+  {
+    prm.constructRoadMap();
+
+    if (!roadmap_file.empty() and !prm.saveRoadMap(roadmap_file))
+    {
+      ROS_WARN("Failed to save road map to %s", roadmap_file.c_str());
+    }
+  }
+
+  else
+  {
+    ROS_INFO("Loaded road map from %s", roadmap_file.c_str());
+  }
+
+  // connect the start/goal to the prm
+  if (!prm.attachStartGoal(start, goal))
+  {
+    ROS_WARN("Start/goal NOT connected to road map");
+  }
+
   std::vector<planner::Node> nodes;
   prm.getRoadMap(nodes);
 
@@ -162,7 +195,7 @@ int main(int argc, char** argv)
   nodes_array.markers.resize(nodes.size());
   edges_array.markers.resize(nodes.size());
 
-  prmMarkerArray(nodes, nodes_array, edges_array, "green");
+  prmMarkerArray(nodes, prm, nodes_array, edges_array, "green");
 
 
   // find shortest path
@@ -191,6 +224,7 @@ int main(int argc, char** argv)
 
 
 void prmMarkerArray(const std::vector<planner::Node> &nodes,
+                     const planner::RoadMap &prm,
                      visualization_msgs::MarkerArray &nodes_array,
                      visualization_msgs::MarkerArray &edges_array,
                      std::string color)
@@ -283,9 +317,9 @@ void prmMarkerArray(const std::vector<planner::Node> &nodes,
     }
 
     // loop across adjacency list
-    for(unsigned int j = 0; j < nodes.at(i).edges.size(); j++)
+    for(const auto &edge : prm.adjacentEdges(i))
     {
-      const auto adj_id = nodes.at(i).edges.at(j).id;
+      const auto adj_id = edge.id;
 
       geometry_msgs::Point adj_pt; // adjacent node point
       adj_pt.x = nodes.at(adj_id).point.x;
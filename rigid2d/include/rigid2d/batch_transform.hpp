@@ -0,0 +1,190 @@
+#ifndef BATCH_TRANSFORM_INCLUDE_GUARD_HPP
+#define BATCH_TRANSFORM_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Transforms batches of points stored as structure of arrays
+///
+/// The kernels use AVX2 or SSE2 when the CPU supports them and fall back
+/// to a scalar loop otherwise. Every code path does the same multiplies and
+/// adds in the same order, and the kernels are built with -ffp-contract=off
+/// so the compiler does not fuse them, the results are identical on every CPU.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "rigid2d/rigid2d.hpp"
+
+
+namespace rigid2d
+{
+  /// \brief Points stored as structure of arrays
+  template <typename T>
+  struct PointBatch
+  {
+    std::vector<T> x;     // x coordinates
+    std::vector<T> y;     // y coordinates
+
+    /// \brief Number of points
+    /// \return size
+    std::size_t size() const { return x.size(); }
+
+    /// \brief Checks if there are no points
+    /// \return true if empty
+    bool empty() const { return x.empty(); }
+
+    /// \brief Changes the number of points
+    /// \param n - number of points
+    void resize(std::size_t n) { x.resize(n); y.resize(n); }
+
+    /// \brief Allocates memory for points
+    /// \param n - number of points
+    void reserve(std::size_t n) { x.reserve(n); y.reserve(n); }
+
+    /// \brief Removes all points
+    void clear() { x.clear(); y.clear(); }
+
+    /// \brief Appends a point
+    /// \param px - x coordinate
+    /// \param py - y coordinate
+    void push_back(T px, T py) { x.push_back(px); y.push_back(py); }
+  };
+
+  typedef PointBatch<float> PointBatchf;
+  typedef PointBatch<double> PointBatchd;
+
+
+  /// \brief Instruction sets used by the kernels
+  enum class SimdLevel
+  {
+    Scalar,
+    SSE2,
+    AVX2
+  };
+
+  /// \brief Best instruction set supported by the CPU
+  /// \return level detected at runtime
+  SimdLevel supportedSimdLevel();
+
+  /// \brief Instruction set the kernels currently use
+  /// \return level in use
+  SimdLevel simdLevel();
+
+  /// \brief Selects the instruction set, used to compare the code paths
+  /// \param level - requested level, clamped to the supported level
+  /// \return level in use
+  SimdLevel setSimdLevel(SimdLevel level);
+
+
+  /// \brief Transforms points, the output may alias the input
+  /// \param T - the transform
+  /// \param x - x coordinates
+  /// \param y - y coordinates
+  /// x_out[out] - transformed x coordinates
+  /// y_out[out] - transformed y coordinates
+  /// \param n - number of points
+  void transformPoints(const Transform2D &T, const double *x, const double *y,
+                       double *x_out, double *y_out, std::size_t n);
+
+  /// \copydoc transformPoints(const Transform2D&, const double*, const double*, double*, double*, std::size_t)
+  void transformPoints(const Transform2D &T, const float *x, const float *y,
+                       float *x_out, float *y_out, std::size_t n);
+
+  /// \brief Converts range measurements to points and transforms them
+  /// \param T - the transform, from the sensor to the output frame
+  /// \param range - range of each beam
+  /// \param dir_x - cosine of each beam angle
+  /// \param dir_y - sine of each beam angle
+  /// x_out[out] - x coordinates of the beam end points
+  /// y_out[out] - y coordinates of the beam end points
+  /// \param n - number of beams
+  void polarToPoints(const Transform2D &T, const float *range,
+                     const double *dir_x, const double *dir_y,
+                     double *x_out, double *y_out, std::size_t n);
+
+  /// \copydoc polarToPoints(const Transform2D&, const float*, const double*, const double*, double*, double*, std::size_t)
+  void polarToPoints(const Transform2D &T, const float *range,
+                     const float *dir_x, const float *dir_y,
+                     float *x_out, float *y_out, std::size_t n);
+
+
+  /// \brief Transforms a batch of points
+  /// \param Tf - the transform
+  /// \param points - points to transform
+  /// out[out] - transformed points, may be the same batch as the input
+  template <typename T>
+  void transformPoints(const Transform2D &Tf, const PointBatch<T> &points, PointBatch<T> &out)
+  {
+    out.resize(points.size());
+    transformPoints(Tf, points.x.data(), points.y.data(), out.x.data(), out.y.data(), points.size());
+  }
+
+
+  /// \brief Angles of the beams in one revolution of the scanner
+  /// \param beam_min - start angle of scan
+  /// \param beam_max - end angle of scan
+  /// \param beam_delta - increment scan angle
+  /// \param include_max - true if a beam at exactly beam_max is part of the scan
+  /// \return angle of each beam, the next beam after the last starts at beam_min again,
+  ///         at most 65536 beams if the increment never reaches the end angle
+  std::vector<double> beamAngles(double beam_min, double beam_max, double beam_delta,
+                                 bool include_max = false);
+
+
+  /// \brief Unit vectors of beam angles
+  /// \param angles - angle of each beam
+  /// dirs[out] - cosine and sine of each beam angle
+  template <typename T>
+  void beamDirections(const std::vector<double> &angles, PointBatch<T> &dirs)
+  {
+    dirs.resize(angles.size());
+    for(std::size_t i = 0; i < angles.size(); i++)
+    {
+      dirs.x[i] = static_cast<T>(std::cos(angles[i]));
+      dirs.y[i] = static_cast<T>(std::sin(angles[i]));
+    }
+  }
+
+
+  /// \brief End points of the beams within the range limits of a scan
+  /// \param Tf - the transform, from the sensor to the output frame
+  /// \param range - range of each beam
+  /// \param dirs - beam directions, repeated if the scan has more beams
+  /// \param range_min - min valid range
+  /// \param range_max - max valid range, excluded
+  /// end_points[out] - end points of the valid beams in scan order
+  template <typename T>
+  void scanEndPoints(const Transform2D &Tf, const std::vector<float> &range,
+                     const PointBatch<T> &dirs, double range_min, double range_max,
+                     PointBatch<T> &end_points)
+  {
+    end_points.resize(range.size());
+    if (dirs.empty())
+    {
+      end_points.clear();
+      return;
+    }
+
+    // the beam angles repeat every dirs.size() beams
+    for(std::size_t start = 0; start < range.size(); start += dirs.size())
+    {
+      const auto n = std::min(dirs.size(), range.size() - start);
+      polarToPoints(Tf, range.data() + start, dirs.x.data(), dirs.y.data(),
+                    end_points.x.data() + start, end_points.y.data() + start, n);
+    }
+
+    // keep the valid beams, always writes and only advances on a valid beam
+    std::size_t num_valid = 0;
+    for(std::size_t i = 0; i < range.size(); i++)
+    {
+      const double r = range[i];
+      end_points.x[num_valid] = end_points.x[i];
+      end_points.y[num_valid] = end_points.y[i];
+      num_valid += (r >= range_min) & (r < range_max);
+    }
+
+    end_points.resize(num_valid);
+  }
+} // end namespace
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef COMPUTE_STAGE_INCLUDE_GUARD_HPP
+#define COMPUTE_STAGE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Runs expensive work on its own thread when triggered
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace rigid2d
+{
+  /// \brief Calls a function on a worker thread each time it is triggered.
+  ///        The worker sleeps on a condition variable while idle. Triggers
+  ///        that arrive while the function runs are coalesced into a single
+  ///        run afterwards, so the work always sees the latest inputs and
+  ///        never queues up behind a slow consumer.
+  class ComputeStage
+  {
+  public:
+    /// \brief Starts the worker thread
+    /// \param work - function called once per (coalesced) trigger
+    explicit ComputeStage(std::function<void()> work);
+
+    /// \brief Stops and joins the worker, a pending trigger is dropped
+    ~ComputeStage();
+
+    ComputeStage(const ComputeStage &) = delete;
+    ComputeStage &operator=(const ComputeStage &) = delete;
+
+    /// \brief Wakes the worker, safe to call from any thread
+    void trigger();
+
+    /// \brief Stops the worker after the current run, does nothing if already stopped
+    void stop();
+
+    /// \brief Waits until no run is pending or in progress
+    /// \param timeout - max time to wait
+    /// \return true if idle
+    bool waitIdle(const std::chrono::milliseconds &timeout);
+
+    /// \brief Number of times the function was called
+    /// \return runs
+    unsigned long runs() const;
+
+    /// \brief Number of triggers merged into a pending run
+    /// \return coalesced triggers
+    unsigned long coalesced() const;
+
+  private:
+    /// \brief Worker thread loop
+    void loop();
+
+
+    std::function<void()> work;
+    std::mutex mtx;                     // guards the flags below
+    std::condition_variable wake_cv;    // signals a trigger or stop
+    std::condition_variable idle_cv;    // signals the end of a run
+    bool pending, running, stopping;
+    std::atomic<unsigned long> num_runs, num_coalesced;
+    std::thread worker;                 // started last so the members above are ready
+  };
+} // end namespace
+
+#endif
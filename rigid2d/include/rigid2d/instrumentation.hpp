@@ -0,0 +1,273 @@
+#ifndef INSTRUMENTATION_INCLUDE_GUARD_HPP
+#define INSTRUMENTATION_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Scoped timers, counters, and histograms for the hot paths
+///
+/// Use the RIGID2D_* macros to instrument code. They register the metric
+/// once per call site and only cost an atomic update per call afterwards.
+/// Define RIGID2D_DISABLE_INSTRUMENTATION to compile them out.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace rigid2d
+{
+  /// \brief Distribution of non-negative integer values in power of two buckets
+  class Histogram
+  {
+  public:
+    /// \brief Empty histogram
+    /// \param name - name of the metric
+    explicit Histogram(const std::string &name);
+
+    /// \brief Adds a value
+    /// \param value - the value
+    void add(uint64_t value);
+
+    /// \brief Name of the metric
+    /// \return the name, valid for the life of the histogram
+    const std::string &name() const;
+
+    /// \brief Number of values added
+    /// \return count
+    uint64_t count() const;
+
+    /// \brief Sum of values added
+    /// \return sum
+    uint64_t sum() const;
+
+    /// \brief Smallest value added
+    /// \return min, 0 if empty
+    uint64_t min() const;
+
+    /// \brief Largest value added
+    /// \return max, 0 if empty
+    uint64_t max() const;
+
+    /// \brief Approximate value below which a fraction of the values fall
+    /// \param p - fraction in [0, 1]
+    /// \return value at the middle of the bucket containing the percentile
+    double percentile(double p) const;
+
+    /// \brief Removes all values
+    void reset();
+
+  private:
+    std::string metric_name;
+    std::atomic<uint64_t> num, total, lowest, highest;
+    std::array<std::atomic<uint64_t>, 64> buckets;      // bucket i holds [2^(i-1), 2^i)
+  };
+
+
+  /// \brief Monotonic event counter
+  class Counter
+  {
+  public:
+    /// \brief Counter at zero
+    /// \param name - name of the metric
+    explicit Counter(const std::string &name);
+
+    /// \brief Increments the counter
+    /// \param n - amount to add
+    void add(int64_t n = 1)
+    {
+      total.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /// \brief Name of the metric
+    /// \return the name
+    const std::string &name() const;
+
+    /// \brief Current value
+    /// \return value
+    int64_t value() const;
+
+    /// \brief Sets the counter to zero
+    void reset();
+
+  private:
+    std::string metric_name;
+    std::atomic<int64_t> total;
+  };
+
+
+  /// \brief Kinds of metrics
+  enum class MetricType
+  {
+    Timer,
+    Counter,
+    Histogram
+  };
+
+
+  /// \brief Snapshot of a metric
+  struct MetricSummary
+  {
+    std::string name;                   // name of metric
+    MetricType type = MetricType::Counter;
+    uint64_t count = 0;                 // number of values, value of a counter
+    double mean = 0.0;                  // timers in microseconds
+    double min = 0.0, max = 0.0;
+    double p50 = 0.0, p90 = 0.0, p99 = 0.0;
+  };
+
+
+  /// \brief Process wide registry of metrics and trace events
+  class Metrics
+  {
+  public:
+    /// \brief The registry
+    /// \return the registry
+    static Metrics &instance();
+
+    /// \brief Latency histogram in nanoseconds, created on first use
+    /// \param name - name of timer
+    /// \return the histogram, valid for the life of the process
+    Histogram &timer(const std::string &name);
+
+    /// \brief Counter, created on first use
+    /// \param name - name of counter
+    /// \return the counter, valid for the life of the process
+    Counter &counter(const std::string &name);
+
+    /// \brief Value histogram, created on first use
+    /// \param name - name of histogram
+    /// \return the histogram, valid for the life of the process
+    Histogram &histogram(const std::string &name);
+
+    /// \brief Snapshot of every metric
+    /// summaries[out] - metrics sorted by name
+    void summary(std::vector<MetricSummary> &summaries) const;
+
+    /// \brief Clears every metric and trace event
+    void reset();
+
+    /// \brief Starts or stops recording trace events
+    /// \param enable - true to record
+    /// \param max_events - max events kept per thread, later events are dropped
+    void enableTrace(bool enable, unsigned int max_events = 1 << 20);
+
+    /// \brief Checks if trace events are recorded
+    /// \return true if recording
+    bool traceEnabled() const
+    {
+      return tracing.load(std::memory_order_relaxed);
+    }
+
+    /// \brief Records a complete event on the calling thread
+    /// \param name - name of event, must outlive the registry
+    /// \param start_ns - start time from now()
+    /// \param duration_ns - duration
+    void traceEvent(const std::string &name, uint64_t start_ns, uint64_t duration_ns);
+
+    /// \brief Writes the trace events in the Chrome trace event format,
+    ///        open the file in chrome://tracing or Perfetto
+    /// \param filename - name of json file
+    /// \return true if written
+    bool writeChromeTrace(const std::string &filename) const;
+
+    /// \brief Monotonic time since the registry was created
+    /// \return time (ns)
+    uint64_t now() const
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch).count();
+    }
+
+  private:
+    /// \brief Trace events of one thread
+    struct TraceBuffer;
+
+    Metrics();
+
+    /// \brief Trace buffer of the calling thread
+    /// \return the buffer
+    TraceBuffer &threadBuffer();
+
+
+    const std::chrono::steady_clock::time_point epoch;
+    mutable std::mutex mtx;                                   // guards the metric lists
+    std::vector<std::unique_ptr<Histogram>> timers;
+    std::vector<std::unique_ptr<Counter>> counters;
+    std::vector<std::unique_ptr<Histogram>> histograms;
+
+    std::atomic<bool> tracing;
+    std::atomic<unsigned int> max_trace_events;
+    std::vector<std::shared_ptr<TraceBuffer>> trace_buffers;  // one per thread
+  };
+
+
+  /// \brief Adds the time from construction to destruction to a timer
+  class ScopedTimer
+  {
+  public:
+    /// \brief Starts timing
+    /// \param timer - latency histogram
+    explicit ScopedTimer(Histogram &timer) : timer(timer), start(Metrics::instance().now())
+    {
+    }
+
+    /// \brief Stops timing
+    ~ScopedTimer()
+    {
+      auto &metrics = Metrics::instance();
+      const auto duration = metrics.now() - start;
+      timer.add(duration);
+
+      if (metrics.traceEnabled())
+      {
+        metrics.traceEvent(timer.name(), start, duration);
+      }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  private:
+    Histogram &timer;
+    uint64_t start;
+  };
+} // end namespace
+
+
+#define RIGID2D_CONCAT_IMPL(a, b) a##b
+#define RIGID2D_CONCAT(a, b) RIGID2D_CONCAT_IMPL(a, b)
+
+#ifndef RIGID2D_DISABLE_INSTRUMENTATION
+
+/// \brief Times the rest of the enclosing scope
+#define RIGID2D_SCOPED_TIMER(name) \
+  static rigid2d::Histogram &RIGID2D_CONCAT(rigid2d_timer_, __LINE__) = \
+    rigid2d::Metrics::instance().timer(name); \
+  rigid2d::ScopedTimer RIGID2D_CONCAT(rigid2d_scoped_timer_, __LINE__)(RIGID2D_CONCAT(rigid2d_timer_, __LINE__))
+
+/// \brief Adds to a counter
+#define RIGID2D_COUNT(name, n) \
+  do { \
+    static rigid2d::Counter &rigid2d_counter = rigid2d::Metrics::instance().counter(name); \
+    rigid2d_counter.add(n); \
+  } while (0)
+
+/// \brief Adds a value to a histogram
+#define RIGID2D_RECORD(name, value) \
+  do { \
+    static rigid2d::Histogram &rigid2d_histogram = rigid2d::Metrics::instance().histogram(name); \
+    rigid2d_histogram.add(value); \
+  } while (0)
+
+#else
+
+#define RIGID2D_SCOPED_TIMER(name) do {} while (0)
+#define RIGID2D_COUNT(name, n) do {} while (0)
+#define RIGID2D_RECORD(name, value) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef JOINT_INDEX_INCLUDE_GUARD_HPP
+#define JOINT_INDEX_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Locates the wheel joints in joint state messages
+
+#include <string>
+#include <vector>
+
+
+namespace rigid2d
+{
+  /// \brief Finds the indices of the left and right wheel joints in the
+  ///        names of a joint state message. The indices found for the
+  ///        previous message are checked first, the names are only searched
+  ///        again when the layout of the message changes.
+  class WheelJointIndex
+  {
+  public:
+    /// \brief Joint names to look for
+    /// \param left_joint - name of left wheel joint
+    /// \param right_joint - name of right wheel joint
+    WheelJointIndex(const std::string &left_joint, const std::string &right_joint);
+
+    /// \brief Indices of the wheel joints
+    /// \param names - joint names in the message
+    /// left_idx[out] - index of left wheel joint
+    /// right_idx[out] - index of right wheel joint
+    /// \throws std::invalid_argument if a wheel joint is not in the names
+    void lookup(const std::vector<std::string> &names,
+                unsigned int &left_idx, unsigned int &right_idx);
+
+    /// \brief Number of times the names were searched
+    /// \return searches
+    unsigned long searches() const;
+
+  private:
+    /// \brief Checks if a cached index still refers to a joint
+    /// \param names - joint names in the message
+    /// \param idx - cached index
+    /// \param joint - name of joint
+    /// \return true if the name at the index matches
+    bool cached(const std::vector<std::string> &names, int idx, const std::string &joint) const;
+
+    /// \brief Index of a joint
+    /// \param names - joint names in the message
+    /// \param joint - name of joint
+    /// \return index of joint, -1 if not found
+    int search(const std::vector<std::string> &names, const std::string &joint);
+
+
+    std::string left_joint, right_joint;      // wheel joint names
+    int left_idx, right_idx;                  // indices in the last message, -1 if unknown
+    unsigned long num_searches;               // number of searches
+  };
+} // end namespace
+
+#endif
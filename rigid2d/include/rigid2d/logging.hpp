@@ -0,0 +1,107 @@
+#ifndef LOGGING_INCLUDE_GUARD_HPP
+#define LOGGING_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Leveled, structured, and rate limited logging
+///
+/// Messages are written as "event key=value ..." to a sink which defaults to
+/// stderr. Nodes route the sink to rosconsole so the libraries do not depend
+/// on ROS.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+
+
+namespace rigid2d
+{
+  /// \brief Severity of a message
+  enum class LogLevel
+  {
+    Debug,
+    Info,
+    Warn,
+    Error
+  };
+
+
+  /// \brief Named value attached to a message
+  struct LogField
+  {
+    const char *key;
+    double value;
+  };
+
+
+  /// \brief Function receiving the formatted messages
+  typedef std::function<void(LogLevel, const std::string &)> LogSink;
+
+
+  /// \brief Replaces the sink, an empty sink restores stderr
+  /// \param sink - receives the formatted messages
+  void setLogSink(LogSink sink);
+
+  /// \brief Sets the least severe level that is logged, defaults to Info
+  /// \param level - min level
+  void setLogLevel(LogLevel level);
+
+  /// \brief Checks if a level is logged
+  /// \param level - severity
+  /// \return true if logged
+  bool logEnabled(LogLevel level);
+
+  /// \brief Logs an event
+  /// \param level - severity
+  /// \param event - what happened
+  void logEvent(LogLevel level, const std::string &event);
+
+  /// \brief Logs an event with named values
+  /// \param level - severity
+  /// \param event - what happened
+  /// \param fields - named values
+  void logEvent(LogLevel level, const std::string &event, std::initializer_list<LogField> fields);
+
+
+  /// \brief Allows at most one message per period
+  class RateLimiter
+  {
+  public:
+    RateLimiter();
+
+    /// \brief Checks if a message may be logged now
+    /// \param period - min time between messages (s)
+    /// \return true if allowed
+    bool allow(double period);
+
+    /// \brief Number of messages blocked since the last allowed one
+    /// \return suppressed messages
+    uint64_t suppressed() const;
+
+  private:
+    std::atomic<int64_t> last;            // time of last allowed message (ns), -1 if none
+    std::atomic<uint64_t> blocked;        // messages blocked since then
+  };
+} // end namespace
+
+
+/// \brief Logs if the level is enabled, the arguments are passed to logEvent()
+#define RIGID2D_LOG(level, ...) \
+  do { \
+    if (rigid2d::logEnabled(level)) \
+    { \
+      rigid2d::logEvent(level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+/// \brief Logs at most once per period (s) from this call site
+#define RIGID2D_LOG_THROTTLE(period, level, ...) \
+  do { \
+    static rigid2d::RateLimiter rigid2d_limiter; \
+    if (rigid2d::logEnabled(level) and rigid2d_limiter.allow(period)) \
+    { \
+      rigid2d::logEvent(level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#endif
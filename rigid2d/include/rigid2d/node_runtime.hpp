@@ -0,0 +1,99 @@
+#ifndef NODE_RUNTIME_INCLUDE_GUARD_HPP
+#define NODE_RUNTIME_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Event driven main loop for nodes that react to messages
+
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+
+namespace rigid2d
+{
+  /// \brief Replaces a polling while(ok()) { spinOnce(); ... } loop.
+  ///
+  /// spin() sleeps on the callback queue until a message, service request,
+  /// or timer event arrives, dispatches everything that is ready, and then
+  /// runs the node's step once. The step keeps the usual "new message" flag
+  /// checks, it just no longer runs when nothing happened. An idle node
+  /// uses no CPU and the step runs as soon as the callbacks that woke it
+  /// return. Periodic publishing is done with every().
+  class NodeRuntime
+  {
+  public:
+    /// \brief Event loop on the global callback queue
+    /// \param nh - node handle the timers are created on
+    /// \param shutdown_poll - max time (s) between checks for shutdown while idle
+    explicit NodeRuntime(ros::NodeHandle &nh, double shutdown_poll = 0.1)
+                         : nh(nh),
+                           shutdown_poll(shutdown_poll),
+                           num_wakeups(0)
+    {
+    }
+
+    NodeRuntime(const NodeRuntime &) = delete;
+    NodeRuntime &operator=(const NodeRuntime &) = delete;
+
+    /// \brief Calls a function at a fixed rate from the event loop, the
+    ///        step also runs after each call
+    /// \param frequency - rate (Hz)
+    /// \param fn - called with the time of the event
+    void every(double frequency, std::function<void(const ros::Time &)> fn)
+    {
+      if (frequency <= 0.0)
+      {
+        throw std::invalid_argument("Timer frequency must be positive");
+      }
+
+      timers.push_back(nh.createTimer(ros::Duration(1.0 / frequency),
+                                      [fn](const ros::TimerEvent &event)
+                                      {
+                                        fn(event.current_real);
+                                      }));
+    }
+
+    /// \brief Dispatches callbacks until shutdown and runs the step after each batch
+    /// \param step - work that depends on the callbacks, may be empty
+    void spin(const std::function<void()> &step)
+    {
+      auto queue = ros::getGlobalCallbackQueue();
+      const ros::WallDuration timeout(shutdown_poll);
+
+      while (nh.ok())
+      {
+        // blocks until a callback is ready
+        if (queue->callOne(timeout) != ros::CallbackQueue::Called)
+        {
+          continue;
+        }
+
+        // everything else that arrived meanwhile
+        queue->callAvailable();
+        num_wakeups++;
+
+        if (step)
+        {
+          step();
+        }
+      }
+    }
+
+    /// \brief Number of times the step ran
+    /// \return wakeups
+    unsigned long wakeups() const
+    {
+      return num_wakeups;
+    }
+
+  private:
+    ros::NodeHandle &nh;
+    double shutdown_poll;                 // max sleep while idle (s)
+    unsigned long num_wakeups;            // batches of callbacks dispatched
+    std::vector<ros::Timer> timers;       // periodic functions
+  };
+} // end namespace
+
+#endif
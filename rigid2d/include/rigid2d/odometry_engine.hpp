@@ -0,0 +1,133 @@
+#ifndef ODOMETRY_ENGINE_INCLUDE_GUARD_HPP
+#define ODOMETRY_ENGINE_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Integrates timestamped wheel encoders and keeps a history of poses
+///
+/// One engine is shared by every consumer of the odometry in a process.
+/// Encoders are integrated as they arrive and the poses are stored in a fixed
+/// size ring, so the pose at the timestamp of a scan can be looked up later
+/// rather than each consumer integrating the encoders again.
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "rigid2d/diff_drive.hpp"
+
+
+namespace rigid2d
+{
+  /// \brief Wheel encoder angles at a time
+  struct EncoderSample
+  {
+    double stamp = 0.0;     // time (s)
+    double left = 0.0;      // left wheel angle (rad)
+    double right = 0.0;     // right wheel angle (rad)
+  };
+
+
+  /// \brief Thread-safe odometry with a history of poses
+  class OdometryEngine
+  {
+  public:
+    /// \brief Starts the odometry at the pose of a robot
+    /// \param drive - initial pose and geometry of the robot
+    /// \param history_size - max number of poses kept
+    /// \throws std::invalid_argument if the history size is zero
+    OdometryEngine(const DiffDrive &drive, std::size_t history_size);
+
+    /// \brief Integrates one encoder reading. The first reading only sets the
+    ///        reference angles of the wheels.
+    /// \param stamp - time of reading
+    /// \param left - left wheel angle
+    /// \param right - right wheel angle
+    /// \return false if the reading is not newer than the last one and was ignored
+    bool addEncoders(double stamp, double left, double right);
+
+    /// \brief Integrates a batch of encoder readings in order
+    /// \param samples - encoder readings
+    /// \return number of readings integrated
+    std::size_t addEncoders(const std::vector<EncoderSample> &samples);
+
+    /// \brief Moves the robot and clears the history, the reference angles
+    ///        of the wheels are kept
+    /// \param pose - new pose
+    void reset(const Pose &pose);
+
+    /// \brief Most recent pose
+    /// \return pose
+    Pose pose() const;
+
+    /// \brief Time of the most recent reading
+    /// \return stamp, 0 if there are no readings
+    double stamp() const;
+
+    /// \brief Body twist of the last reading, as in DiffDrive::wheelsToTwist
+    /// \return twist over one reading
+    Twist2D lastTwist() const;
+
+    /// \brief Pose at a time, the wheel velocities are constant between
+    ///        readings so the twist between them is integrated exactly
+    /// \param stamp - the time, clamped to the span of the history
+    /// \return pose at time
+    Pose poseAt(double stamp) const;
+
+    /// \brief Body twist that moves the robot from its pose at one time to
+    ///        the next in one time unit, as in DiffDrive::wheelsToTwist
+    /// \param from - start time, clamped to the span of the history
+    /// \param to - end time, clamped to the span of the history
+    /// \return twist from the wheel rotations between the times
+    Twist2D twistBetween(double from, double to) const;
+
+    /// \brief Checks if a time is within the span of the history
+    /// \param stamp - the time
+    /// \return true if the pose at the time is interpolated rather than clamped
+    bool contains(double stamp) const;
+
+    /// \brief Number of poses in the history
+    /// \return size
+    std::size_t size() const;
+
+    /// \brief Max number of poses in the history
+    /// \return capacity
+    std::size_t capacity() const;
+
+  private:
+    /// \brief Pose and accumulated wheel rotation at a reading
+    struct Entry
+    {
+      double stamp = 0.0;     // time of reading
+      Pose pose;              // pose at reading
+      double left = 0.0;      // accumulated left wheel rotation
+      double right = 0.0;     // accumulated right wheel rotation
+      Twist2D step;           // twist from the previous reading
+    };
+
+    /// \brief Integrates a reading, the lock must be held
+    /// \param stamp - time of reading
+    /// \param left - left wheel angle
+    /// \param right - right wheel angle
+    /// \return false if the reading was ignored
+    bool integrate(double stamp, double left, double right);
+
+    /// \brief Entry in the history, oldest first
+    /// \param i - index from the oldest entry
+    /// \return entry
+    const Entry &at(std::size_t i) const;
+
+    /// \brief Index of the first entry after a time, binary search
+    /// \param stamp - the time, within the span of the history
+    /// \return index from the oldest entry, in [1, size)
+    std::size_t upper(double stamp) const;
+
+
+    mutable std::mutex mtx;           // guards every member below
+    DiffDrive drive;                  // integrates the readings
+    std::vector<Entry> history;       // ring of entries
+    std::size_t head, count;          // oldest entry and number of entries
+    double left_total, right_total;   // accumulated wheel rotation
+    bool started;                     // true once the reference wheel angles are set
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef PATH_PUBLISHER_INCLUDE_GUARD_HPP
+#define PATH_PUBLISHER_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Publishes a bounded and decimated trajectory as a nav_msgs/Path
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <nav_msgs/Path.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include "rigid2d/trajectory.hpp"
+
+
+namespace rigid2d
+{
+  /// \brief Records poses with a TrajectoryRecorder and publishes them at
+  ///        a fixed rate. The full path is only serialized when it has subscribers. The
+  ///        optional delta topic (<topic>_delta) carries the poses recorded
+  ///        since the previous publish so a subscriber can append them.
+  class PathPublisher
+  {
+  public:
+    /// \brief Advertise the path topics
+    /// \param nh - node handle the topics are advertised on
+    /// \param topic - path topic
+    /// \param frame_id - frame of the poses
+    /// \param capacity - max number of poses kept
+    /// \param min_distance - min distance between recorded poses
+    /// \param min_angle - min change in heading between recorded poses
+    /// \param publish_frequency - max rate the topics are published
+    /// \param publish_delta - true to advertise the delta topic
+    /// \throws std::invalid_argument if the publish frequency is not positive
+    PathPublisher(ros::NodeHandle &nh, const std::string &topic, const std::string &frame_id,
+                  unsigned int capacity, double min_distance, double min_angle,
+                  double publish_frequency, bool publish_delta)
+                  : recorder(capacity, min_distance, min_angle),
+                    frame_id(frame_id),
+                    delta_seq(0)
+    {
+      if (publish_frequency <= 0.0)
+      {
+        throw std::invalid_argument("Path publish frequency must be positive");
+      }
+      publish_period = ros::Duration(1.0 / publish_frequency);
+
+      path_pub = nh.advertise<nav_msgs::Path>(topic, 1);
+      if (publish_delta)
+      {
+        delta_pub = nh.advertise<nav_msgs::Path>(topic + "_delta", 10);
+      }
+    }
+
+    /// \brief Records a pose if it moved far enough from the last one
+    /// \param pose - the pose
+    /// \param stamp - time of the pose
+    /// \return true if the pose was recorded
+    bool record(const Pose &pose, const ros::Time &stamp)
+    {
+      return recorder.addPose(pose, stamp.toSec());
+    }
+
+    /// \brief Publishes the path and the poses recorded since the last
+    ///        publish if the publish period has elapsed
+    /// \param now - current time
+    /// \return true if published
+    bool publish(const ros::Time &now)
+    {
+      if (now - last_publish < publish_period)
+      {
+        return false;
+      }
+      last_publish = now;
+
+      if (path_pub.getNumSubscribers() != 0)
+      {
+        recorder.poses(poses);
+        fillPath(path_msg);
+        path_pub.publish(path_msg);
+      }
+
+      if (delta_pub)
+      {
+        const auto seq = recorder.posesSince(delta_seq, poses);
+        if (seq != delta_seq)
+        {
+          fillPath(path_msg);
+          delta_pub.publish(path_msg);
+        }
+        delta_seq = seq;
+      }
+
+      return true;
+    }
+
+    /// \brief Access the recorded trajectory
+    /// \return the recorder
+    const TrajectoryRecorder &trajectory() const
+    {
+      return recorder;
+    }
+
+  private:
+    /// \brief Converts the poses to a path message
+    /// msg[out] - the path
+    void fillPath(nav_msgs::Path &msg) const
+    {
+      msg.header.stamp = ros::Time::now();
+      msg.header.frame_id = frame_id;
+      msg.poses.resize(poses.size());
+
+      for(unsigned int i = 0; i < poses.size(); i++)
+      {
+        auto &pose_msg = msg.poses[i];
+        pose_msg.header.stamp = ros::Time(poses[i].stamp);
+        pose_msg.header.frame_id = frame_id;
+        pose_msg.pose.position.x = poses[i].pose.x;
+        pose_msg.pose.position.y = poses[i].pose.y;
+        pose_msg.pose.position.z = 0.0;
+
+        // rotation about z
+        pose_msg.pose.orientation.x = 0.0;
+        pose_msg.pose.orientation.y = 0.0;
+        pose_msg.pose.orientation.z = std::sin(0.5 * poses[i].pose.theta);
+        pose_msg.pose.orientation.w = std::cos(0.5 * poses[i].pose.theta);
+      }
+    }
+
+
+    TrajectoryRecorder recorder;              // bounded trajectory
+    std::string frame_id;                     // frame of the poses
+    ros::Duration publish_period;             // min time between publishes
+    ros::Time last_publish;                   // time of the last publish
+    unsigned long delta_seq;                  // sequence number of the last published delta
+    ros::Publisher path_pub;                  // full path
+    ros::Publisher delta_pub;                 // new poses only
+    std::vector<StampedPose> poses;           // reused between publishes
+    nav_msgs::Path path_msg;                  // reused between publishes
+  };
+} // end namespace
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef ROS_INSTRUMENTATION_INCLUDE_GUARD_HPP
+#define ROS_INSTRUMENTATION_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Publishes the metrics as diagnostics and routes the logs to rosconsole
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include "rigid2d/instrumentation.hpp"
+#include "rigid2d/logging.hpp"
+
+
+namespace rigid2d
+{
+  /// \brief Reads the private parameters diagnostics_frequency and trace_file,
+  ///        publishes every metric on /diagnostics, and writes the
+  ///        Chrome trace to trace_file on destruction if it is set.
+  class DiagnosticsPublisher
+  {
+  public:
+    /// \brief Advertise the diagnostics and route the logs to rosconsole
+    /// \param nh - public node handle
+    /// \param nhp - private node handle with the parameters
+    /// \param name - name of the diagnostic status
+    DiagnosticsPublisher(ros::NodeHandle &nh, ros::NodeHandle &nhp, const std::string &name)
+                         : name(name)
+    {
+      double frequency = 1.0;
+      nhp.getParam("diagnostics_frequency", frequency);
+      nhp.getParam("trace_file", trace_file);
+
+      publish_period = ros::Duration(frequency > 0.0 ? 1.0 / frequency : 1.0);
+      diag_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+
+      if (!trace_file.empty())
+      {
+        Metrics::instance().enableTrace(true);
+        ROS_INFO("Recording trace events to %s", trace_file.c_str());
+      }
+
+      setLogLevel(LogLevel::Debug);
+      setLogSink([](LogLevel level, const std::string &msg)
+      {
+        switch (level)
+        {
+          case LogLevel::Debug:
+            ROS_DEBUG_STREAM(msg);
+            break;
+          case LogLevel::Info:
+            ROS_INFO_STREAM(msg);
+            break;
+          case LogLevel::Warn:
+            ROS_WARN_STREAM(msg);
+            break;
+          default:
+            ROS_ERROR_STREAM(msg);
+        }
+      });
+    }
+
+    ~DiagnosticsPublisher()
+    {
+      setLogSink(LogSink());
+
+      if (!trace_file.empty())
+      {
+        Metrics::instance().enableTrace(false);
+        Metrics::instance().writeChromeTrace(trace_file);
+      }
+    }
+
+    DiagnosticsPublisher(const DiagnosticsPublisher &) = delete;
+    DiagnosticsPublisher &operator=(const DiagnosticsPublisher &) = delete;
+
+    /// \brief Publishes the metrics if the publish period has elapsed
+    /// \param now - current time
+    /// \return true if published
+    bool publish(const ros::Time &now)
+    {
+      if (now - last_publish < publish_period)
+      {
+        return false;
+      }
+      last_publish = now;
+
+      if (diag_pub.getNumSubscribers() == 0)
+      {
+        return false;
+      }
+
+      Metrics::instance().summary(summaries);
+
+      diagnostic_msgs::DiagnosticArray msg;
+      msg.header.stamp = now;
+
+      diagnostic_msgs::DiagnosticStatus status;
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.name = name;
+      status.hardware_id = name;
+      status.message = "metrics";
+
+      for(const auto &s : summaries)
+      {
+        if (s.type == MetricType::Counter)
+        {
+          addValue(status, s.name, static_cast<double>(s.count));
+          continue;
+        }
+
+        // timers are in us
+        addValue(status, s.name + ".count", static_cast<double>(s.count));
+        addValue(status, s.name + ".mean", s.mean);
+        addValue(status, s.name + ".p50", s.p50);
+        addValue(status, s.name + ".p99", s.p99);
+        addValue(status, s.name + ".max", s.max);
+      }
+
+      msg.status.push_back(status);
+      diag_pub.publish(msg);
+
+      return true;
+    }
+
+  private:
+    /// \brief Appends a key/value pair
+    /// \param status - diagnostic status
+    /// \param key - name of the value
+    /// \param value - the value
+    static void addValue(diagnostic_msgs::DiagnosticStatus &status,
+                         const std::string &key, double value)
+    {
+      diagnostic_msgs::KeyValue kv;
+      kv.key = key;
+
+      std::ostringstream ss;
+      ss << value;
+      kv.value = ss.str();
+
+      status.values.push_back(kv);
+    }
+
+
+    std::string name;                         // name of the diagnostic status
+    std::string trace_file;                   // Chrome trace, empty if not traced
+    ros::Publisher diag_pub;
+    ros::Duration publish_period;
+    ros::Time last_publish;
+    std::vector<MetricSummary> summaries;
+  };
+} // end namespace
+
+#endif
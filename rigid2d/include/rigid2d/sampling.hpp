@@ -0,0 +1,186 @@
+#ifndef SAMPLING_INCLUDE_GUARD_HPP
+#define SAMPLING_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Random number generators and samplers
+///
+/// Every thread draws from its own xoshiro256** generator, so sampling is
+/// thread-safe without locks. The generators of all threads derive from one
+/// seed, set with seedSampling(). Work split across threads is reproducible
+/// when each task constructs a Xoshiro256 from samplingSeed() and its own
+/// stream id rather than using the generator of whichever thread runs it.
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <eigen3/Eigen/Dense>
+
+
+namespace rigid2d
+{
+  using Eigen::MatrixXd;
+  using Eigen::VectorXd;
+  using Eigen::Ref;
+
+  /// \brief xoshiro256** pseudo random number generator, meets the
+  ///        requirements of UniformRandomBitGenerator
+  class Xoshiro256
+  {
+  public:
+    typedef std::uint64_t result_type;
+
+    /// \brief Seeds the generator
+    /// \param seed - seed shared by all streams
+    /// \param stream - id of the stream, streams with the same seed are independent
+    explicit Xoshiro256(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+    /// \brief Restarts the generator
+    /// \param seed - seed shared by all streams
+    /// \param stream - id of the stream
+    void seed(std::uint64_t seed, std::uint64_t stream = 0);
+
+    /// \brief Advances the generator by 2^128 draws
+    void jump();
+
+    /// \brief Next random number
+    /// \return uniformly distributed 64 bit integer
+    result_type operator()()
+    {
+      const auto result = rotl(s[1] * 5, 7) * 9;
+      const auto t = s[1] << 17;
+
+      s[2] ^= s[0];
+      s[3] ^= s[1];
+      s[1] ^= s[2];
+      s[0] ^= s[3];
+      s[2] ^= t;
+      s[3] = rotl(s[3], 45);
+
+      return result;
+    }
+
+    /// \brief Next random number in [0, 1)
+    /// \return uniformly distributed double with 53 random bits
+    double uniform()
+    {
+      return static_cast<double>(operator()() >> 11) * 0x1.0p-53;
+    }
+
+    /// \brief Smallest value returned
+    static constexpr result_type min() { return 0; }
+
+    /// \brief Largest value returned
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+  private:
+    static result_type rotl(result_type x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    std::uint64_t s[4];       // state
+  };
+
+
+  /// \brief Seeds the generators of all threads, they restart on their next draw
+  /// \param seed - the seed
+  void seedSampling(std::uint64_t seed);
+
+  /// \brief Seed of the generators, random until seedSampling() is called
+  /// \return the seed
+  std::uint64_t samplingSeed();
+
+  /// \brief Generator owned by the calling thread. Threads are given streams
+  ///        in the order they first draw a number.
+  /// \return the generator
+  Xoshiro256 &threadGenerator();
+
+
+  /// \brief Samples a standard normal distribution
+  /// \param gen - the generator
+  /// \return a random sample
+  double standardNormal(Xoshiro256 &gen);
+
+  /// \brief Fills an array with samples of a uniform distribution
+  /// \param gen - the generator
+  /// out[out] - the samples
+  /// \param n - number of samples
+  /// \param min - lower bound
+  /// \param max - upper bound, excluded
+  void fillUniform(Xoshiro256 &gen, double *out, std::size_t n, double min = 0.0, double max = 1.0);
+
+  /// \brief Fills an array with samples of a standard normal distribution,
+  ///        generated in pairs with the Box-Muller transform
+  /// \param gen - the generator
+  /// out[out] - the samples
+  /// \param n - number of samples
+  void fillStandardNormal(Xoshiro256 &gen, double *out, std::size_t n);
+
+  /// \brief Fills an array with samples of a normal distribution
+  /// \param gen - the generator
+  /// out[out] - the samples
+  /// \param n - number of samples
+  /// \param mu - mean of distribution
+  /// \param sigma - standard deviation of distribution
+  void fillNormal(Xoshiro256 &gen, double *out, std::size_t n, double mu, double sigma);
+
+
+  /// \brief Samples a multivariate normal distribution. The covariance is
+  ///        factorized once when it is set rather than on every sample.
+  class MultivariateNormal
+  {
+  public:
+    /// \brief Empty distribution
+    MultivariateNormal();
+
+    /// \brief Zero mean distribution
+    /// \param cov - covariance matrix
+    /// \throws std::invalid_argument if the covariance is not square
+    explicit MultivariateNormal(const MatrixXd &cov);
+
+    /// \brief Distribution with a mean
+    /// \param mu - mean
+    /// \param cov - covariance matrix
+    /// \throws std::invalid_argument if the dimensions do not agree
+    MultivariateNormal(const VectorXd &mu, const MatrixXd &cov);
+
+    /// \brief Changes the covariance, the mean is kept if the dimension is unchanged
+    /// \param cov - covariance matrix
+    /// \throws std::invalid_argument if the covariance is not square
+    void setCovariance(const MatrixXd &cov);
+
+    /// \brief Changes the mean
+    /// \param mu - mean
+    /// \throws std::invalid_argument if the dimension differs from the covariance
+    void setMean(const VectorXd &mu);
+
+    /// \brief Draws a sample with the generator of the calling thread
+    /// \return the sample
+    VectorXd sample() const;
+
+    /// \brief Draws a sample
+    /// \param gen - the generator
+    /// \return the sample
+    VectorXd sample(Xoshiro256 &gen) const;
+
+    /// \brief Draws many samples
+    /// \param gen - the generator
+    /// \param n - number of samples
+    /// samples[out] - one sample per column
+    void sample(Xoshiro256 &gen, std::size_t n, MatrixXd &samples) const;
+
+    /// \brief Dimension of the distribution
+    /// \return dimension
+    int dim() const;
+
+    /// \brief Mean of the distribution
+    /// \return mean
+    const VectorXd &mean() const;
+
+    /// \brief Lower triangular Cholesky factor of the covariance
+    /// \return factor
+    const MatrixXd &factor() const;
+
+  private:
+    VectorXd mu;      // mean
+    MatrixXd L;       // Cholesky factor of covariance
+  };
+} // end namespace
+
+#endif
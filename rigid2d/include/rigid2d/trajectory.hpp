@@ -0,0 +1,85 @@
+#ifndef TRAJECTORY_INCLUDE_GUARD_HPP
+#define TRAJECTORY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Bounded and decimated record of a robot's trajectory
+
+#include <vector>
+
+#include "rigid2d/diff_drive.hpp"
+
+
+namespace rigid2d
+{
+  /// \brief pose at a time
+  struct StampedPose
+  {
+    double stamp = 0.0;     // time (s)
+    Pose pose;              // pose at the time
+  };
+
+
+  /// \brief Keeps the most recent poses of a trajectory in a fixed size
+  ///        ring buffer. A pose is only recorded once the robot has moved
+  ///        a min distance or turned a min angle from the last recorded pose,
+  ///        so memory is bounded and a stationary robot records nothing.
+  ///        Every recorded pose gets a sequence number, callers keep the last
+  ///        number they have seen to retreive only the poses that are new.
+  class TrajectoryRecorder
+  {
+  public:
+    /// \brief Create a recorder
+    /// \param capacity - max number of poses kept
+    /// \param min_distance - min distance between recorded poses
+    /// \param min_angle - min change in heading between recorded poses
+    /// \throws std::invalid_argument when the capacity is zero
+    TrajectoryRecorder(unsigned int capacity, double min_distance, double min_angle);
+
+    /// \brief Records a pose if it moved far enough from the last one
+    /// \param pose - the pose
+    /// \param stamp - time of the pose
+    /// \return true if the pose was recorded
+    bool addPose(const Pose &pose, double stamp);
+
+    /// \brief Retreive the poses kept
+    /// poses[out] - poses from oldest to newest
+    void poses(std::vector<StampedPose> &poses) const;
+
+    /// \brief Retreive the poses recorded after a sequence number, poses that
+    ///        were dropped from the buffer are skipped
+    /// \param seq - sequence number returned by a previous call, 0 for all
+    /// poses[out] - new poses from oldest to newest
+    /// \return sequence number of the newest pose
+    unsigned long posesSince(unsigned long seq, std::vector<StampedPose> &poses) const;
+
+    /// \brief Number of poses kept
+    /// \return size of the buffer
+    unsigned int size() const;
+
+    /// \brief Max number of poses kept
+    /// \return capacity of the buffer
+    unsigned int capacity() const;
+
+    /// \brief Number of poses ever recorded, also the sequence number of the newest pose
+    /// \return number of poses recorded
+    unsigned long numRecorded() const;
+
+    /// \brief Removes all poses
+    void clear();
+
+  private:
+    /// \brief Copies the newest poses in order
+    /// \param num - number of poses to copy
+    /// poses[out] - poses from oldest to newest
+    void copyNewest(unsigned int num, std::vector<StampedPose> &poses) const;
+
+
+    std::vector<StampedPose> buffer;  // ring buffer of poses
+    unsigned int head;                // index the next pose is written to
+    unsigned int count;               // number of poses in buffer
+    unsigned long recorded;           // number of poses ever recorded
+    double min_distance;              // min distance between recorded poses
+    double min_angle;                 // min change in heading between recorded poses
+  };
+} // end namespace
+
+#endif
@@ -6,6 +6,8 @@
 #include <random>
 #include <eigen3/Eigen/Dense>
 
+#include "rigid2d/sampling.hpp"
+
 
 
 namespace rigid2d
@@ -14,16 +16,13 @@ namespace rigid2d
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
 
-/// \brief Returns a random number engine
-std::mt19937_64 &getTwister();
-
-/// \brief Samples a normal distribution with a specified mean and variance
+/// \brief Samples a normal distribution with the generator of the calling thread
 /// \param mu - mean of distribution
-/// \param sigma - variance of distribution
+/// \param sigma - standard deviation of distribution
 /// \returns a random sample
 double sampleNormalDistribution(const double mu, const double sigma);
 
-/// \brief Samples a uniform real distribution
+/// \brief Samples a uniform real distribution with the generator of the calling thread
 /// \param min - lower bound
 /// \param max - upper bound
 /// \returns a random sample
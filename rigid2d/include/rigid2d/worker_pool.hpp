@@ -0,0 +1,77 @@
+#ifndef WORKER_POOL_INCLUDE_GUARD_HPP
+#define WORKER_POOL_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Runs queued tasks on a fixed set of worker threads
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace rigid2d
+{
+  /// \brief Runs tasks in the order they are posted on a fixed set of
+  ///        threads. The workers sleep on a condition variable while the
+  ///        queue is empty. A pool with no threads runs each task on the
+  ///        caller when it is posted, which keeps the results reproducible.
+  ///        Tasks must not throw.
+  class WorkerPool
+  {
+  public:
+    /// \brief Starts the workers
+    /// \param num_threads - number of worker threads, 0 runs tasks on the caller
+    explicit WorkerPool(unsigned int num_threads);
+
+    /// \brief Stops and joins the workers, queued tasks are dropped
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /// \brief Queues a task, safe to call from any thread including a worker.
+    ///        Tasks posted after stop are dropped.
+    /// \param task - function to run
+    void post(std::function<void()> task);
+
+    /// \brief Stops the workers after their current tasks, does nothing if already stopped
+    void stop();
+
+    /// \brief Waits until the queue is empty and no task is running
+    /// \param timeout - max time to wait
+    /// \return true if idle
+    bool waitIdle(const std::chrono::milliseconds &timeout);
+
+    /// \brief Number of worker threads
+    /// \return threads
+    unsigned int size() const;
+
+    /// \brief Number of tasks waiting to run
+    /// \return tasks
+    std::size_t pending() const;
+
+    /// \brief Number of tasks run
+    /// \return tasks
+    unsigned long completed() const;
+
+  private:
+    /// \brief Worker thread loop
+    void loop();
+
+
+    mutable std::mutex mtx;                       // guards the queue and flags below
+    std::condition_variable wake_cv;              // signals a task or stop
+    std::condition_variable idle_cv;              // signals the end of a task
+    std::deque<std::function<void()>> tasks;      // tasks waiting to run
+    unsigned int running;                         // tasks in progress
+    bool stopping;
+    std::atomic<unsigned long> num_completed;
+    std::vector<std::thread> workers;             // started last so the members above are ready
+  };
+} // end namespace
+
+#endif
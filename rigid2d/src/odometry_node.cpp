@@ -4,6 +4,8 @@
 /// \author Boston Cleek
 /// \date 1/23/20
 ///
+/// PARAMETERS:
+///   frequency - min rate the odometry is published without new joint states
 /// PUBLISHES:
 ///   odom (nav_msgs/Odometry): Pose of robot in odom frame and twist in body frame
 ///
@@ -26,14 +28,18 @@
 #include <vector>
 #include <iostream>
 #include <exception>
+#include <memory>
 
 #include "rigid2d/diff_drive.hpp"
 #include "rigid2d/set_pose.h"
+#include "rigid2d/node_runtime.hpp"
+#include "rigid2d/joint_index.hpp"
 
 // global variables
 static std::string left_wheel_joint, right_wheel_joint;    // joint names
+static std::unique_ptr<rigid2d::WheelJointIndex> joint_index; // wheel joints in joint states
 static double left, right;                                 // wheel angular positions
-// static bool message;                                       // callback flag
+static bool message;                                       // joint states callback flag
 
 static rigid2d::Pose pose_srv;                             // pose set by srv
 static bool srv_active;                                    // set pose srv activated
@@ -68,35 +74,13 @@ bool setPoseService(rigid2d::set_pose::Request &req,
 /// \param msg - contains the encoder readings and joint names
 void jointStatesCallback(const sensor_msgs::JointState::ConstPtr &msg)
 {
-  std::vector<std::string> names = msg->name;
-  std::vector<std::string>::iterator iter;
-  int left_idx, right_idx;
-
-  iter = std::find(names.begin(), names.end(), left_wheel_joint);
-  left_idx = std::distance(names.begin(), iter);
-
-  iter = std::find(names.begin(), names.end(), right_wheel_joint);
-  right_idx = std::distance(names.begin(), iter);
-
-  if (left_idx > 1)
-  {
-    throw std::invalid_argument("Left wheel index not found in Odometer.");
-  }
-
-  if (right_idx > 1)
-  {
-    throw std::invalid_argument("Right wheel index not found in Odometer.");
-  }
-
-
-  // ROS_INFO("left index: %d", left_idx);
-  // ROS_INFO("right index: %d", right_idx);
-
+  unsigned int left_idx = 0, right_idx = 0;
+  joint_index->lookup(msg->name, left_idx, right_idx);
 
   left = msg->position.at(left_idx);
   right = msg->position.at(right_idx);
 
-  // message = true;
+  message = true;
 }
 
 
@@ -117,6 +101,7 @@ int main(int argc, char** argv)
 
   std::string odom_frame_id, body_frame_id;
   auto wheel_base = 0.0, wheel_radius = 0.0;
+  auto frequency = 30.0;
 
 
   // node_handle.getParam("odom_frame_id", odom_frame_id);
@@ -127,6 +112,7 @@ int main(int argc, char** argv)
 
   nh.getParam("odom_frame_id", odom_frame_id);
   nh.getParam("body_frame_id", body_frame_id);
+  nh.getParam("frequency", frequency);
 
   node_handle.getParam("/wheel_base", wheel_base);
   node_handle.getParam("/wheel_radius", wheel_radius);
@@ -134,6 +120,7 @@ int main(int argc, char** argv)
 
   ROS_INFO("odom_frame_id %s", odom_frame_id.c_str());
   ROS_INFO("body_frame_id %s", body_frame_id.c_str());
+  ROS_INFO("frequency %f", frequency);
 
   ROS_INFO("left_wheel_joint %s", left_wheel_joint.c_str());
   ROS_INFO("right_wheel_joint %s", right_wheel_joint.c_str());
@@ -144,9 +131,11 @@ int main(int argc, char** argv)
 
   ROS_INFO("Successfully launched odometer node.");
 
+  joint_index = std::make_unique<rigid2d::WheelJointIndex>(left_wheel_joint, right_wheel_joint);
+
 
   // check if message has been recieved
-  // message = false;
+  message = false;
 
   // service has been requested
   srv_active = false;
@@ -166,9 +155,15 @@ int main(int argc, char** argv)
   current_time = ros::Time::now();
   last_time = ros::Time::now();
 
-  while(node_handle.ok())
+  // body twist
+  rigid2d::Twist2D vb;
+
+  // sleeps until joint states or a set pose request arrive,
+  // the timer keeps the transform fresh while the wheels are idle
+  rigid2d::NodeRuntime runtime(node_handle);
+  runtime.every(frequency, [](const ros::Time &) {});
+  runtime.spin([&]()
   {
-    ros::spinOnce();
     current_time = ros::Time::now();
 
 
@@ -182,10 +177,17 @@ int main(int argc, char** argv)
 
 
     // joint states call back flag
-    // if (message)
-    // {
-    // update odom
-    drive.updateOdometry(left, right);
+    if (message)
+    {
+      // update odom
+      drive.updateOdometry(left, right);
+
+      // body twist
+      rigid2d::WheelVelocities vel = drive.wheelVelocities();
+      vb = drive.wheelsToTwist(vel);
+
+      message = false;
+    }
 
     // pose relative to odom frame
     pose = drive.pose();
@@ -199,10 +201,6 @@ int main(int argc, char** argv)
 
 
 
-    // body twist
-    rigid2d::WheelVelocities vel = drive.wheelVelocities();
-    rigid2d::Twist2D vb = drive.wheelsToTwist(vel);
-
 
     // convert yaw to Quaternion
     tf2::Quaternion q;
@@ -244,13 +242,11 @@ int main(int argc, char** argv)
     odom.twist.twist.angular.z = vb.w;
 
     odom_pub.publish(odom);
-    //   message = false;
-    // }
 
 
 
     last_time = current_time;
-  }
+  });
   return 0;
 }
 
@@ -0,0 +1,382 @@
+/// \file
+/// \brief Transforms batches of points stored as structure of arrays
+
+#include <atomic>
+#include <cmath>
+
+#include "rigid2d/batch_transform.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RIGID2D_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace rigid2d
+{
+
+namespace
+{
+  /// \brief Rotation and translation of a transform
+  struct Coefficients
+  {
+    double c, s;        // cosine and sine of rotation
+    double tx, ty;      // translation
+  };
+
+  /// \brief Rotation and translation of a transform
+  /// \param T - the transform
+  /// \return coefficients
+  Coefficients coefficients(const Transform2D &T)
+  {
+    const TransformData2D d = T.displacement();
+    return {std::cos(d.theta), std::sin(d.theta), d.x, d.y};
+  }
+
+
+  /// \brief Transforms points one at a time
+  template <typename T>
+  void transformScalar(const Coefficients &k, const T *x, const T *y,
+                       T *x_out, T *y_out, std::size_t i, std::size_t n)
+  {
+    const T c = static_cast<T>(k.c), s = static_cast<T>(k.s);
+    const T tx = static_cast<T>(k.tx), ty = static_cast<T>(k.ty);
+    for(; i < n; i++)
+    {
+      const T px = x[i], py = y[i];
+      x_out[i] = c * px - s * py + tx;
+      y_out[i] = s * px + c * py + ty;
+    }
+  }
+
+  /// \brief Converts and transforms beams one at a time
+  template <typename T>
+  void polarScalar(const Coefficients &k, const float *range, const T *dir_x, const T *dir_y,
+                   T *x_out, T *y_out, std::size_t i, std::size_t n)
+  {
+    const T c = static_cast<T>(k.c), s = static_cast<T>(k.s);
+    const T tx = static_cast<T>(k.tx), ty = static_cast<T>(k.ty);
+    for(; i < n; i++)
+    {
+      const T r = static_cast<T>(range[i]);
+      const T px = r * dir_x[i], py = r * dir_y[i];
+      x_out[i] = c * px - s * py + tx;
+      y_out[i] = s * px + c * py + ty;
+    }
+  }
+
+
+#ifdef RIGID2D_BATCH_X86
+  // SSE2 is part of x86-64, the AVX2 kernels are only called when the
+  // CPU supports them. The AVX2 kernels clear the upper halves of the
+  // registers before the scalar tail, otherwise the SSE code that runs
+  // afterwards (e.g. std::exp) pays a state transition penalty.
+
+  void transformSSE2(const Coefficients &k, const double *x, const double *y,
+                     double *x_out, double *y_out, std::size_t n)
+  {
+    const __m128d c = _mm_set1_pd(k.c), s = _mm_set1_pd(k.s);
+    const __m128d tx = _mm_set1_pd(k.tx), ty = _mm_set1_pd(k.ty);
+
+    std::size_t i = 0;
+    for(; i + 2 <= n; i += 2)
+    {
+      const __m128d px = _mm_loadu_pd(x + i), py = _mm_loadu_pd(y + i);
+      _mm_storeu_pd(x_out + i, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(c, px), _mm_mul_pd(s, py)), tx));
+      _mm_storeu_pd(y_out + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(s, px), _mm_mul_pd(c, py)), ty));
+    }
+    transformScalar(k, x, y, x_out, y_out, i, n);
+  }
+
+  void transformSSE2(const Coefficients &k, const float *x, const float *y,
+                     float *x_out, float *y_out, std::size_t n)
+  {
+    const __m128 c = _mm_set1_ps(static_cast<float>(k.c)), s = _mm_set1_ps(static_cast<float>(k.s));
+    const __m128 tx = _mm_set1_ps(static_cast<float>(k.tx)), ty = _mm_set1_ps(static_cast<float>(k.ty));
+
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      const __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+      _mm_storeu_ps(x_out + i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, px), _mm_mul_ps(s, py)), tx));
+      _mm_storeu_ps(y_out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, px), _mm_mul_ps(c, py)), ty));
+    }
+    transformScalar(k, x, y, x_out, y_out, i, n);
+  }
+
+  void polarSSE2(const Coefficients &k, const float *range, const double *dir_x, const double *dir_y,
+                 double *x_out, double *y_out, std::size_t n)
+  {
+    const __m128d c = _mm_set1_pd(k.c), s = _mm_set1_pd(k.s);
+    const __m128d tx = _mm_set1_pd(k.tx), ty = _mm_set1_pd(k.ty);
+
+    std::size_t i = 0;
+    for(; i + 2 <= n; i += 2)
+    {
+      const __m128 r2 = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(range + i)));
+      const __m128d r = _mm_cvtps_pd(r2);
+      const __m128d px = _mm_mul_pd(r, _mm_loadu_pd(dir_x + i));
+      const __m128d py = _mm_mul_pd(r, _mm_loadu_pd(dir_y + i));
+      _mm_storeu_pd(x_out + i, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(c, px), _mm_mul_pd(s, py)), tx));
+      _mm_storeu_pd(y_out + i, _mm_add_pd(_mm_add_pd(_mm_mul_pd(s, px), _mm_mul_pd(c, py)), ty));
+    }
+    polarScalar(k, range, dir_x, dir_y, x_out, y_out, i, n);
+  }
+
+  void polarSSE2(const Coefficients &k, const float *range, const float *dir_x, const float *dir_y,
+                 float *x_out, float *y_out, std::size_t n)
+  {
+    const __m128 c = _mm_set1_ps(static_cast<float>(k.c)), s = _mm_set1_ps(static_cast<float>(k.s));
+    const __m128 tx = _mm_set1_ps(static_cast<float>(k.tx)), ty = _mm_set1_ps(static_cast<float>(k.ty));
+
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      const __m128 r = _mm_loadu_ps(range + i);
+      const __m128 px = _mm_mul_ps(r, _mm_loadu_ps(dir_x + i));
+      const __m128 py = _mm_mul_ps(r, _mm_loadu_ps(dir_y + i));
+      _mm_storeu_ps(x_out + i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, px), _mm_mul_ps(s, py)), tx));
+      _mm_storeu_ps(y_out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, px), _mm_mul_ps(c, py)), ty));
+    }
+    polarScalar(k, range, dir_x, dir_y, x_out, y_out, i, n);
+  }
+
+
+  __attribute__((target("avx2")))
+  void transformAVX2(const Coefficients &k, const double *x, const double *y,
+                     double *x_out, double *y_out, std::size_t n)
+  {
+    const __m256d c = _mm256_set1_pd(k.c), s = _mm256_set1_pd(k.s);
+    const __m256d tx = _mm256_set1_pd(k.tx), ty = _mm256_set1_pd(k.ty);
+
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      const __m256d px = _mm256_loadu_pd(x + i), py = _mm256_loadu_pd(y + i);
+      _mm256_storeu_pd(x_out + i, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(c, px), _mm256_mul_pd(s, py)), tx));
+      _mm256_storeu_pd(y_out + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(s, px), _mm256_mul_pd(c, py)), ty));
+    }
+    _mm256_zeroupper();
+    transformScalar(k, x, y, x_out, y_out, i, n);
+  }
+
+  __attribute__((target("avx2")))
+  void transformAVX2(const Coefficients &k, const float *x, const float *y,
+                     float *x_out, float *y_out, std::size_t n)
+  {
+    const __m256 c = _mm256_set1_ps(static_cast<float>(k.c)), s = _mm256_set1_ps(static_cast<float>(k.s));
+    const __m256 tx = _mm256_set1_ps(static_cast<float>(k.tx)), ty = _mm256_set1_ps(static_cast<float>(k.ty));
+
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+      _mm256_storeu_ps(x_out + i, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(c, px), _mm256_mul_ps(s, py)), tx));
+      _mm256_storeu_ps(y_out + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s, px), _mm256_mul_ps(c, py)), ty));
+    }
+    _mm256_zeroupper();
+    transformScalar(k, x, y, x_out, y_out, i, n);
+  }
+
+  __attribute__((target("avx2")))
+  void polarAVX2(const Coefficients &k, const float *range, const double *dir_x, const double *dir_y,
+                 double *x_out, double *y_out, std::size_t n)
+  {
+    const __m256d c = _mm256_set1_pd(k.c), s = _mm256_set1_pd(k.s);
+    const __m256d tx = _mm256_set1_pd(k.tx), ty = _mm256_set1_pd(k.ty);
+
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      const __m256d r = _mm256_cvtps_pd(_mm_loadu_ps(range + i));
+      const __m256d px = _mm256_mul_pd(r, _mm256_loadu_pd(dir_x + i));
+      const __m256d py = _mm256_mul_pd(r, _mm256_loadu_pd(dir_y + i));
+      _mm256_storeu_pd(x_out + i, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(c, px), _mm256_mul_pd(s, py)), tx));
+      _mm256_storeu_pd(y_out + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(s, px), _mm256_mul_pd(c, py)), ty));
+    }
+    _mm256_zeroupper();
+    polarScalar(k, range, dir_x, dir_y, x_out, y_out, i, n);
+  }
+
+  __attribute__((target("avx2")))
+  void polarAVX2(const Coefficients &k, const float *range, const float *dir_x, const float *dir_y,
+                 float *x_out, float *y_out, std::size_t n)
+  {
+    const __m256 c = _mm256_set1_ps(static_cast<float>(k.c)), s = _mm256_set1_ps(static_cast<float>(k.s));
+    const __m256 tx = _mm256_set1_ps(static_cast<float>(k.tx)), ty = _mm256_set1_ps(static_cast<float>(k.ty));
+
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      const __m256 r = _mm256_loadu_ps(range + i);
+      const __m256 px = _mm256_mul_ps(r, _mm256_loadu_ps(dir_x + i));
+      const __m256 py = _mm256_mul_ps(r, _mm256_loadu_ps(dir_y + i));
+      _mm256_storeu_ps(x_out + i, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(c, px), _mm256_mul_ps(s, py)), tx));
+      _mm256_storeu_ps(y_out + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(s, px), _mm256_mul_ps(c, py)), ty));
+    }
+    _mm256_zeroupper();
+    polarScalar(k, range, dir_x, dir_y, x_out, y_out, i, n);
+  }
+#endif
+
+
+  /// \brief Detects the instruction set once
+  /// \return best level supported
+  SimdLevel detectSimdLevel()
+  {
+#ifdef RIGID2D_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+  }
+
+  std::atomic<SimdLevel> &activeLevel()
+  {
+    static std::atomic<SimdLevel> level(supportedSimdLevel());
+    return level;
+  }
+
+
+  /// \brief Calls the kernel for the active instruction set
+  template <typename T>
+  void dispatchTransform(const Transform2D &Tf, const T *x, const T *y,
+                         T *x_out, T *y_out, std::size_t n)
+  {
+    const Coefficients k = coefficients(Tf);
+    switch (activeLevel().load(std::memory_order_relaxed))
+    {
+#ifdef RIGID2D_BATCH_X86
+      case SimdLevel::AVX2:
+        transformAVX2(k, x, y, x_out, y_out, n);
+        return;
+
+      case SimdLevel::SSE2:
+        transformSSE2(k, x, y, x_out, y_out, n);
+        return;
+#endif
+      default:
+        transformScalar(k, x, y, x_out, y_out, 0, n);
+    }
+  }
+
+  /// \brief Calls the kernel for the active instruction set
+  template <typename T>
+  void dispatchPolar(const Transform2D &Tf, const float *range, const T *dir_x, const T *dir_y,
+                     T *x_out, T *y_out, std::size_t n)
+  {
+    const Coefficients k = coefficients(Tf);
+    switch (activeLevel().load(std::memory_order_relaxed))
+    {
+#ifdef RIGID2D_BATCH_X86
+      case SimdLevel::AVX2:
+        polarAVX2(k, range, dir_x, dir_y, x_out, y_out, n);
+        return;
+
+      case SimdLevel::SSE2:
+        polarSSE2(k, range, dir_x, dir_y, x_out, y_out, n);
+        return;
+#endif
+      default:
+        polarScalar(k, range, dir_x, dir_y, x_out, y_out, 0, n);
+    }
+  }
+} // end anonymous namespace
+
+
+SimdLevel supportedSimdLevel()
+{
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+
+SimdLevel simdLevel()
+{
+  return activeLevel().load();
+}
+
+
+SimdLevel setSimdLevel(SimdLevel level)
+{
+  const auto supported = supportedSimdLevel();
+  if (static_cast<int>(level) > static_cast<int>(supported))
+  {
+    level = supported;
+  }
+
+  activeLevel().store(level);
+  return level;
+}
+
+
+void transformPoints(const Transform2D &T, const double *x, const double *y,
+                     double *x_out, double *y_out, std::size_t n)
+{
+  dispatchTransform(T, x, y, x_out, y_out, n);
+}
+
+
+void transformPoints(const Transform2D &T, const float *x, const float *y,
+                     float *x_out, float *y_out, std::size_t n)
+{
+  dispatchTransform(T, x, y, x_out, y_out, n);
+}
+
+
+void polarToPoints(const Transform2D &T, const float *range,
+                   const double *dir_x, const double *dir_y,
+                   double *x_out, double *y_out, std::size_t n)
+{
+  dispatchPolar(T, range, dir_x, dir_y, x_out, y_out, n);
+}
+
+
+void polarToPoints(const Transform2D &T, const float *range,
+                   const float *dir_x, const float *dir_y,
+                   float *x_out, float *y_out, std::size_t n)
+{
+  dispatchPolar(T, range, dir_x, dir_y, x_out, y_out, n);
+}
+
+
+std::vector<double> beamAngles(double beam_min, double beam_max, double beam_delta,
+                               bool include_max)
+{
+  // guards against a beam increment that never reaches the end angle
+  const std::size_t max_beams = 65536;
+
+  std::vector<double> angles;
+
+  // start beam angle at the min and increment until the
+  // scan wraps around to the start
+  auto beam_angle = beam_min;
+  while (angles.size() < max_beams)
+  {
+    angles.push_back(beam_angle);
+
+    // update beam angle
+    beam_angle += beam_delta;
+
+    // max angle is negative
+    if (beam_max < 0.0 and (beam_angle < beam_max or (!include_max and beam_angle == beam_max)))
+    {
+      break;
+    }
+
+    // max angle is positive
+    else if (beam_max >= 0.0 and (beam_angle > beam_max or (!include_max and beam_angle == beam_max)))
+    {
+      break;
+    }
+  }
+
+  return angles;
+}
+
+} // end namespace
@@ -0,0 +1,107 @@
+/// \file
+/// \brief Runs expensive work on its own thread when triggered
+
+#include "rigid2d/compute_stage.hpp"
+
+
+namespace rigid2d
+{
+
+ComputeStage::ComputeStage(std::function<void()> work)
+                           : work(std::move(work)),
+                             pending(false),
+                             running(false),
+                             stopping(false),
+                             num_runs(0),
+                             num_coalesced(0),
+                             worker(&ComputeStage::loop, this)
+{
+}
+
+
+ComputeStage::~ComputeStage()
+{
+  stop();
+}
+
+
+void ComputeStage::trigger()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (pending)
+    {
+      num_coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+    pending = true;
+  }
+  wake_cv.notify_one();
+}
+
+
+void ComputeStage::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  wake_cv.notify_one();
+
+  if (worker.joinable())
+  {
+    worker.join();
+  }
+}
+
+
+bool ComputeStage::waitIdle(const std::chrono::milliseconds &timeout)
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  return idle_cv.wait_for(lock, timeout, [this]()
+  {
+    return (!pending and !running) or stopping;
+  });
+}
+
+
+unsigned long ComputeStage::runs() const
+{
+  return num_runs.load(std::memory_order_relaxed);
+}
+
+
+unsigned long ComputeStage::coalesced() const
+{
+  return num_coalesced.load(std::memory_order_relaxed);
+}
+
+
+void ComputeStage::loop()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true)
+  {
+    wake_cv.wait(lock, [this]() { return pending or stopping; });
+    if (stopping)
+    {
+      break;
+    }
+
+    pending = false;
+    running = true;
+
+    // triggers during the run set pending again
+    lock.unlock();
+    work();
+    num_runs.fetch_add(1, std::memory_order_relaxed);
+    lock.lock();
+
+    running = false;
+    idle_cv.notify_all();
+  }
+
+  running = false;
+  idle_cv.notify_all();
+}
+
+} // end namespace
@@ -0,0 +1,411 @@
+/// \file
+/// \brief Scoped timers, counters, and histograms for the hot paths
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#include "rigid2d/instrumentation.hpp"
+
+
+namespace rigid2d
+{
+
+/// \brief Bucket of a value, bucket i holds [2^(i-1), 2^i)
+/// \param value - the value
+/// \return bucket index
+static unsigned int bucketIndex(uint64_t value)
+{
+  unsigned int idx = 0;
+  while (value != 0 and idx < 63)
+  {
+    value >>= 1;
+    idx++;
+  }
+  return idx;
+}
+
+
+/// \brief Atomically lowers a value
+/// \param target - value to lower
+/// \param value - candidate
+static void atomicMin(std::atomic<uint64_t> &target, uint64_t value)
+{
+  auto curr = target.load(std::memory_order_relaxed);
+  while (value < curr and !target.compare_exchange_weak(curr, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+
+/// \brief Atomically raises a value
+/// \param target - value to raise
+/// \param value - candidate
+static void atomicMax(std::atomic<uint64_t> &target, uint64_t value)
+{
+  auto curr = target.load(std::memory_order_relaxed);
+  while (value > curr and !target.compare_exchange_weak(curr, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+
+Histogram::Histogram(const std::string &name) : metric_name(name)
+{
+  reset();
+}
+
+
+void Histogram::add(uint64_t value)
+{
+  num.fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(value, std::memory_order_relaxed);
+  buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  atomicMin(lowest, value);
+  atomicMax(highest, value);
+}
+
+
+const std::string &Histogram::name() const
+{
+  return metric_name;
+}
+
+
+uint64_t Histogram::count() const
+{
+  return num.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Histogram::sum() const
+{
+  return total.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Histogram::min() const
+{
+  return count() == 0 ? 0 : lowest.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Histogram::max() const
+{
+  return highest.load(std::memory_order_relaxed);
+}
+
+
+double Histogram::percentile(double p) const
+{
+  const auto n = count();
+  if (n == 0)
+  {
+    return 0.0;
+  }
+
+  p = std::min(std::max(p, 0.0), 1.0);
+
+  // nearest rank
+  const auto rank = std::max(static_cast<uint64_t>(std::ceil(p * n)), static_cast<uint64_t>(1));
+
+  uint64_t seen = 0;
+  for(unsigned int i = 0; i < buckets.size(); i++)
+  {
+    seen += buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank)
+    {
+      if (i == 0)
+      {
+        return 0.0;
+      }
+
+      // middle of [2^(i-1), 2^i) clamped to the observed range
+      const auto lo = static_cast<double>(static_cast<uint64_t>(1) << (i - 1));
+      const auto mid = 1.5 * lo;
+      return std::min(std::max(mid, static_cast<double>(min())), static_cast<double>(max()));
+    }
+  }
+
+  return static_cast<double>(max());
+}
+
+
+void Histogram::reset()
+{
+  num.store(0, std::memory_order_relaxed);
+  total.store(0, std::memory_order_relaxed);
+  lowest.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  highest.store(0, std::memory_order_relaxed);
+  for(auto &bucket : buckets)
+  {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+
+Counter::Counter(const std::string &name) : metric_name(name), total(0)
+{
+}
+
+
+const std::string &Counter::name() const
+{
+  return metric_name;
+}
+
+
+int64_t Counter::value() const
+{
+  return total.load(std::memory_order_relaxed);
+}
+
+
+void Counter::reset()
+{
+  total.store(0, std::memory_order_relaxed);
+}
+
+
+/// \brief Complete trace event
+struct TraceEvent
+{
+  const std::string *name = nullptr;    // name of timer
+  uint64_t start = 0;                   // start time (ns)
+  uint64_t duration = 0;                // duration (ns)
+};
+
+
+struct Metrics::TraceBuffer
+{
+  std::mutex mtx;                       // guards events, only contended while writing the trace
+  std::vector<TraceEvent> events;
+  unsigned int tid = 0;                 // small thread ID for the trace
+  unsigned long dropped = 0;            // events over the cap
+};
+
+
+Metrics &Metrics::instance()
+{
+  static Metrics metrics;
+  return metrics;
+}
+
+
+Metrics::Metrics() : epoch(std::chrono::steady_clock::now()),
+                     tracing(false),
+                     max_trace_events(1 << 20)
+{
+}
+
+
+/// \brief Finds or creates a metric in a list
+/// \param list - metrics of one type
+/// \param name - name of metric
+/// \return the metric
+template <typename T>
+static T &findOrCreate(std::vector<std::unique_ptr<T>> &list, const std::string &name)
+{
+  for(auto &metric : list)
+  {
+    if (metric->name() == name)
+    {
+      return *metric;
+    }
+  }
+
+  list.emplace_back(new T(name));
+  return *list.back();
+}
+
+
+Histogram &Metrics::timer(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return findOrCreate(timers, name);
+}
+
+
+Counter &Metrics::counter(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return findOrCreate(counters, name);
+}
+
+
+Histogram &Metrics::histogram(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return findOrCreate(histograms, name);
+}
+
+
+/// \brief Snapshot of a histogram
+/// \param hist - the histogram
+/// \param type - type of metric
+/// \param scale - multiplies the values
+/// \return summary
+static MetricSummary summarize(const Histogram &hist, MetricType type, double scale)
+{
+  MetricSummary s;
+  s.name = hist.name();
+  s.type = type;
+  s.count = hist.count();
+  s.mean = s.count == 0 ? 0.0 : scale * static_cast<double>(hist.sum()) / s.count;
+  s.min = scale * hist.min();
+  s.max = scale * hist.max();
+  s.p50 = scale * hist.percentile(0.5);
+  s.p90 = scale * hist.percentile(0.9);
+  s.p99 = scale * hist.percentile(0.99);
+  return s;
+}
+
+
+void Metrics::summary(std::vector<MetricSummary> &summaries) const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+
+  summaries.clear();
+  for(const auto &hist : timers)
+  {
+    // ns to us
+    summaries.push_back(summarize(*hist, MetricType::Timer, 1e-3));
+  }
+
+  for(const auto &hist : histograms)
+  {
+    summaries.push_back(summarize(*hist, MetricType::Histogram, 1.0));
+  }
+
+  for(const auto &cnt : counters)
+  {
+    MetricSummary s;
+    s.name = cnt->name();
+    s.type = MetricType::Counter;
+    s.count = cnt->value();
+    summaries.push_back(s);
+  }
+
+  std::sort(summaries.begin(), summaries.end(),
+            [](const MetricSummary &a, const MetricSummary &b) { return a.name < b.name; });
+}
+
+
+void Metrics::reset()
+{
+  std::lock_guard<std::mutex> lock(mtx);
+
+  for(auto &hist : timers)
+  {
+    hist->reset();
+  }
+
+  for(auto &hist : histograms)
+  {
+    hist->reset();
+  }
+
+  for(auto &cnt : counters)
+  {
+    cnt->reset();
+  }
+
+  for(auto &buffer : trace_buffers)
+  {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mtx);
+    buffer->events.clear();
+    buffer->dropped = 0;
+  }
+}
+
+
+void Metrics::enableTrace(bool enable, unsigned int max_events)
+{
+  max_trace_events.store(max_events, std::memory_order_relaxed);
+  tracing.store(enable, std::memory_order_relaxed);
+}
+
+
+Metrics::TraceBuffer &Metrics::threadBuffer()
+{
+  // the registry keeps the buffer alive after the thread exits
+  thread_local std::shared_ptr<TraceBuffer> buffer;
+  if (!buffer)
+  {
+    buffer = std::make_shared<TraceBuffer>();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    buffer->tid = trace_buffers.size() + 1;
+    trace_buffers.push_back(buffer);
+  }
+
+  return *buffer;
+}
+
+
+void Metrics::traceEvent(const std::string &name, uint64_t start_ns, uint64_t duration_ns)
+{
+  auto &buffer = threadBuffer();
+
+  std::lock_guard<std::mutex> lock(buffer.mtx);
+  if (buffer.events.size() >= max_trace_events.load(std::memory_order_relaxed))
+  {
+    buffer.dropped++;
+    return;
+  }
+
+  buffer.events.push_back({&name, start_ns, duration_ns});
+}
+
+
+bool Metrics::writeChromeTrace(const std::string &filename) const
+{
+  std::ofstream file(filename);
+  if (!file)
+  {
+    std::cout << "ERROR: Could not open trace file: " << filename << std::endl;
+    return false;
+  }
+
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    buffers = trace_buffers;
+  }
+
+  file << "{\"traceEvents\":[";
+
+  bool first = true;
+  for(const auto &buffer : buffers)
+  {
+    std::lock_guard<std::mutex> lock(buffer->mtx);
+    for(const auto &event : buffer->events)
+    {
+      if (!first)
+      {
+        file << ",";
+      }
+      first = false;
+
+      // timestamps in us
+      file << "\n{\"name\":\"" << *event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+           << buffer->tid << ",\"ts\":" << event.start * 1e-3
+           << ",\"dur\":" << event.duration * 1e-3 << "}";
+    }
+  }
+
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  if (!file)
+  {
+    std::cout << "ERROR: Could not write trace file: " << filename << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+} // end namespace
@@ -0,0 +1,76 @@
+/// \file
+/// \brief Locates the wheel joints in joint state messages
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "rigid2d/joint_index.hpp"
+
+
+namespace rigid2d
+{
+
+WheelJointIndex::WheelJointIndex(const std::string &left_joint,
+                                 const std::string &right_joint)
+                                  : left_joint(left_joint),
+                                    right_joint(right_joint),
+                                    left_idx(-1),
+                                    right_idx(-1),
+                                    num_searches(0)
+{
+}
+
+
+void WheelJointIndex::lookup(const std::vector<std::string> &names,
+                             unsigned int &left, unsigned int &right)
+{
+  if (!cached(names, left_idx, left_joint))
+  {
+    left_idx = search(names, left_joint);
+    if (left_idx == -1)
+    {
+      throw std::invalid_argument("Left wheel joint " + left_joint + " not found in joint states.");
+    }
+  }
+
+  if (!cached(names, right_idx, right_joint))
+  {
+    right_idx = search(names, right_joint);
+    if (right_idx == -1)
+    {
+      throw std::invalid_argument("Right wheel joint " + right_joint + " not found in joint states.");
+    }
+  }
+
+  left = static_cast<unsigned int>(left_idx);
+  right = static_cast<unsigned int>(right_idx);
+}
+
+
+unsigned long WheelJointIndex::searches() const
+{
+  return num_searches;
+}
+
+
+bool WheelJointIndex::cached(const std::vector<std::string> &names, int idx,
+                             const std::string &joint) const
+{
+  return idx >= 0 and static_cast<unsigned int>(idx) < names.size() and names[idx] == joint;
+}
+
+
+int WheelJointIndex::search(const std::vector<std::string> &names, const std::string &joint)
+{
+  num_searches++;
+
+  const auto iter = std::find(names.begin(), names.end(), joint);
+  if (iter == names.end())
+  {
+    return -1;
+  }
+
+  return static_cast<int>(std::distance(names.begin(), iter));
+}
+
+} // end namespace
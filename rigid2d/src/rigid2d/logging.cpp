@@ -0,0 +1,146 @@
+/// \file
+/// \brief Leveled, structured, and rate limited logging
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include "rigid2d/logging.hpp"
+
+
+namespace rigid2d
+{
+
+/// \brief State shared by all loggers
+struct LogState
+{
+  std::mutex mtx;                       // guards the sink
+  LogSink sink;                         // empty for stderr
+  std::atomic<int> level{static_cast<int>(LogLevel::Info)};
+};
+
+
+/// \brief The logging state
+/// \return state
+static LogState &logState()
+{
+  static LogState state;
+  return state;
+}
+
+
+/// \brief Name of a level
+/// \param level - severity
+/// \return name
+static const char *levelName(LogLevel level)
+{
+  switch (level)
+  {
+    case LogLevel::Debug:
+      return "DEBUG";
+    case LogLevel::Info:
+      return "INFO";
+    case LogLevel::Warn:
+      return "WARN";
+    default:
+      return "ERROR";
+  }
+}
+
+
+/// \brief Passes a message to the sink
+/// \param level - severity
+/// \param msg - formatted message
+static void emit(LogLevel level, const std::string &msg)
+{
+  auto &state = logState();
+  std::lock_guard<std::mutex> lock(state.mtx);
+
+  if (state.sink)
+  {
+    state.sink(level, msg);
+  }
+
+  else
+  {
+    std::cerr << "[" << levelName(level) << "] " << msg << std::endl;
+  }
+}
+
+
+void setLogSink(LogSink sink)
+{
+  auto &state = logState();
+  std::lock_guard<std::mutex> lock(state.mtx);
+  state.sink = std::move(sink);
+}
+
+
+void setLogLevel(LogLevel level)
+{
+  logState().level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+
+bool logEnabled(LogLevel level)
+{
+  return static_cast<int>(level) >= logState().level.load(std::memory_order_relaxed);
+}
+
+
+void logEvent(LogLevel level, const std::string &event)
+{
+  emit(level, event);
+}
+
+
+void logEvent(LogLevel level, const std::string &event, std::initializer_list<LogField> fields)
+{
+  std::ostringstream ss;
+  ss << event;
+  for(const auto &field : fields)
+  {
+    ss << " " << field.key << "=" << field.value;
+  }
+
+  emit(level, ss.str());
+}
+
+
+RateLimiter::RateLimiter() : last(-1), blocked(0)
+{
+}
+
+
+bool RateLimiter::allow(double period)
+{
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()).count();
+  const auto period_ns = static_cast<int64_t>(period * 1e9);
+
+  auto prev = last.load(std::memory_order_relaxed);
+  if (prev >= 0 and now - prev < period_ns)
+  {
+    blocked.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // another thread may have won the race for this period
+  if (!last.compare_exchange_strong(prev, now, std::memory_order_relaxed))
+  {
+    blocked.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  blocked.store(0, std::memory_order_relaxed);
+  return true;
+}
+
+
+uint64_t RateLimiter::suppressed() const
+{
+  return blocked.load(std::memory_order_relaxed);
+}
+
+} // end namespace
@@ -0,0 +1,261 @@
+/// \file
+/// \brief Integrates timestamped wheel encoders and keeps a history of poses
+
+#include <stdexcept>
+
+#include "rigid2d/odometry_engine.hpp"
+
+
+namespace rigid2d
+{
+
+OdometryEngine::OdometryEngine(const DiffDrive &drive, std::size_t history_size)
+  : drive(drive),
+    history(history_size),
+    head(0),
+    count(0),
+    left_total(0.0),
+    right_total(0.0),
+    started(false)
+{
+  if (history_size == 0)
+  {
+    throw std::invalid_argument("Odometry history size must be positive");
+  }
+}
+
+
+bool OdometryEngine::addEncoders(double stamp, double left, double right)
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return integrate(stamp, left, right);
+}
+
+
+std::size_t OdometryEngine::addEncoders(const std::vector<EncoderSample> &samples)
+{
+  std::lock_guard<std::mutex> lock(mtx);
+
+  std::size_t num_integrated = 0;
+  for(const auto &sample : samples)
+  {
+    num_integrated += integrate(sample.stamp, sample.left, sample.right);
+  }
+
+  return num_integrated;
+}
+
+
+void OdometryEngine::reset(const Pose &pose)
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  drive.reset(pose);
+  head = 0;
+  count = 0;
+}
+
+
+Pose OdometryEngine::pose() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return drive.pose();
+}
+
+
+double OdometryEngine::stamp() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return (count == 0) ? 0.0 : at(count - 1).stamp;
+}
+
+
+Twist2D OdometryEngine::lastTwist() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return (count == 0) ? Twist2D() : at(count - 1).step;
+}
+
+
+Pose OdometryEngine::poseAt(double stamp) const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if (count == 0)
+  {
+    return drive.pose();
+  }
+
+  if (stamp <= at(0).stamp)
+  {
+    return at(0).pose;
+  }
+
+  if (stamp >= at(count - 1).stamp)
+  {
+    return at(count - 1).pose;
+  }
+
+  const auto i = upper(stamp);
+  const auto &a = at(i - 1);
+  const auto &b = at(i);
+
+  // fraction of the twist from a to b completed at the time
+  const auto frac = (stamp - a.stamp) / (b.stamp - a.stamp);
+  Twist2D Vb;
+  Vb.w = frac * b.step.w;
+  Vb.vx = frac * b.step.vx;
+  Vb.vy = frac * b.step.vy;
+
+  const Transform2D Twa(Vector2D(a.pose.x, a.pose.y), a.pose.theta);
+  const Transform2D Tab = Transform2D().integrateTwist(Vb);
+  const TransformData2D Twr = (Twa * Tab).displacement();
+
+  Pose pose;
+  pose.theta = normalize_angle_PI(Twr.theta);
+  pose.x = Twr.x;
+  pose.y = Twr.y;
+  return pose;
+}
+
+
+Twist2D OdometryEngine::twistBetween(double from, double to) const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if (count == 0)
+  {
+    return Twist2D();
+  }
+
+  // accumulated wheel rotation at a time, linear between readings
+  auto rotation = [this](double stamp, double &left, double &right)
+  {
+    if (stamp <= at(0).stamp)
+    {
+      left = at(0).left;
+      right = at(0).right;
+      return;
+    }
+
+    if (stamp >= at(count - 1).stamp)
+    {
+      left = at(count - 1).left;
+      right = at(count - 1).right;
+      return;
+    }
+
+    const auto i = upper(stamp);
+    const auto &a = at(i - 1);
+    const auto &b = at(i);
+    const auto frac = (stamp - a.stamp) / (b.stamp - a.stamp);
+    left = a.left + frac * (b.left - a.left);
+    right = a.right + frac * (b.right - a.right);
+  };
+
+  double left_from = 0.0, right_from = 0.0, left_to = 0.0, right_to = 0.0;
+  rotation(from, left_from, right_from);
+  rotation(to, left_to, right_to);
+
+  WheelVelocities vel;
+  vel.ul = left_to - left_from;
+  vel.ur = right_to - right_from;
+  return drive.wheelsToTwist(vel);
+}
+
+
+bool OdometryEngine::contains(double stamp) const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return (count != 0) && (stamp >= at(0).stamp) && (stamp <= at(count - 1).stamp);
+}
+
+
+std::size_t OdometryEngine::size() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return count;
+}
+
+
+std::size_t OdometryEngine::capacity() const
+{
+  return history.size();
+}
+
+
+bool OdometryEngine::integrate(double stamp, double left, double right)
+{
+  if (count != 0 && stamp <= at(count - 1).stamp)
+  {
+    return false;
+  }
+
+  Entry entry;
+  entry.stamp = stamp;
+
+  if (!started)
+  {
+    // the first reading sets the wheel angles without moving the robot
+    const auto pose = drive.pose();
+    drive.updateOdometry(left, right);
+    drive.reset(pose);
+    started = true;
+  }
+
+  else
+  {
+    // the change in wheel angles since the last reading
+    const auto vel = drive.updateOdometry(left, right);
+    left_total += vel.ul;
+    right_total += vel.ur;
+    entry.step = drive.wheelsToTwist(vel);
+  }
+
+  entry.pose = drive.pose();
+  entry.left = left_total;
+  entry.right = right_total;
+
+  // overwrite the oldest entry once the ring is full
+  if (count < history.size())
+  {
+    history[(head + count) % history.size()] = entry;
+    count++;
+  }
+
+  else
+  {
+    history[head] = entry;
+    head = (head + 1) % history.size();
+  }
+
+  return true;
+}
+
+
+const OdometryEngine::Entry &OdometryEngine::at(std::size_t i) const
+{
+  return history[(head + i) % history.size()];
+}
+
+
+std::size_t OdometryEngine::upper(double stamp) const
+{
+  std::size_t lo = 1, hi = count - 1;
+  while(lo < hi)
+  {
+    const auto mid = lo + (hi - lo) / 2;
+    if (at(mid).stamp > stamp)
+    {
+      hi = mid;
+    }
+
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+
+  return lo;
+}
+
+} // end namespace
@@ -0,0 +1,271 @@
+/// \file
+/// \brief Random number generators and samplers
+
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include "rigid2d/sampling.hpp"
+#include "rigid2d/rigid2d.hpp"
+
+
+namespace rigid2d
+{
+
+namespace
+{
+  /// \brief splitmix64 generator, expands a seed into generator states
+  /// x[out] - state, advanced by one step
+  /// \return next random number
+  std::uint64_t splitmix64(std::uint64_t &x)
+  {
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+
+  /// \brief Seed of every thread's generator
+  std::atomic<std::uint64_t> &globalSeed()
+  {
+    static std::atomic<std::uint64_t> seed((static_cast<std::uint64_t>(std::random_device{}()) << 32)
+                                           ^ std::random_device{}());
+    return seed;
+  }
+
+  std::atomic<std::uint64_t> seed_epoch(0);     // incremented when the seed changes
+  std::atomic<std::uint64_t> next_stream(0);    // stream of the next thread to draw
+
+
+  /// \brief Generator of a thread and the seed it was started with
+  struct ThreadGenerator
+  {
+    Xoshiro256 gen;
+    std::uint64_t stream = next_stream.fetch_add(1);
+    std::uint64_t epoch = ~0ULL;
+  };
+
+
+  /// \brief Box-Muller transform of pairs of uniform samples in place
+  /// out[in/out] - uniform samples in [0, 1), replaced by normal samples
+  /// \param n - number of samples, even
+  void boxMuller(double *out, std::size_t n)
+  {
+    for(std::size_t i = 0; i < n; i += 2)
+    {
+      // 1 - u is in (0, 1], the log is finite
+      const auto r = std::sqrt(-2.0 * std::log(1.0 - out[i]));
+      const auto a = 2.0 * PI * out[i+1];
+      out[i] = r * std::cos(a);
+      out[i+1] = r * std::sin(a);
+    }
+  }
+} // end anonymous namespace
+
+
+Xoshiro256::Xoshiro256(std::uint64_t seed, std::uint64_t stream)
+{
+  this->seed(seed, stream);
+}
+
+
+void Xoshiro256::seed(std::uint64_t seed, std::uint64_t stream)
+{
+  // hash the stream so the splitmix64 sequences of nearby streams do not overlap
+  std::uint64_t h = stream;
+  std::uint64_t x = seed ^ splitmix64(h);
+  for(auto &word : s)
+  {
+    word = splitmix64(x);
+  }
+}
+
+
+void Xoshiro256::jump()
+{
+  static const std::uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                       0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+
+  std::uint64_t t[4] = {0, 0, 0, 0};
+  for(const auto j : JUMP)
+  {
+    for(int b = 0; b < 64; b++)
+    {
+      if (j & (1ULL << b))
+      {
+        for(int w = 0; w < 4; w++)
+        {
+          t[w] ^= s[w];
+        }
+      }
+      operator()();
+    }
+  }
+
+  for(int w = 0; w < 4; w++)
+  {
+    s[w] = t[w];
+  }
+}
+
+
+void seedSampling(std::uint64_t seed)
+{
+  globalSeed().store(seed);
+  seed_epoch.fetch_add(1);
+}
+
+
+std::uint64_t samplingSeed()
+{
+  return globalSeed().load();
+}
+
+
+Xoshiro256 &threadGenerator()
+{
+  thread_local ThreadGenerator state;
+
+  // restart after the seed changes
+  const auto epoch = seed_epoch.load();
+  if (state.epoch != epoch)
+  {
+    state.gen.seed(globalSeed().load(), state.stream);
+    state.epoch = epoch;
+  }
+
+  return state.gen;
+}
+
+
+double standardNormal(Xoshiro256 &gen)
+{
+  const auto u1 = gen.uniform();
+  const auto u2 = gen.uniform();
+  return std::sqrt(-2.0 * std::log(1.0 - u1)) * std::cos(2.0 * PI * u2);
+}
+
+
+void fillUniform(Xoshiro256 &gen, double *out, std::size_t n, double min, double max)
+{
+  const auto scale = max - min;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    out[i] = min + scale * gen.uniform();
+  }
+}
+
+
+void fillStandardNormal(Xoshiro256 &gen, double *out, std::size_t n)
+{
+  // draw all the uniform samples then transform them, the second
+  // loop has no dependence on the generator state
+  const auto pairs = n & ~static_cast<std::size_t>(1);
+  fillUniform(gen, out, pairs);
+  boxMuller(out, pairs);
+
+  if (pairs != n)
+  {
+    out[pairs] = standardNormal(gen);
+  }
+}
+
+
+void fillNormal(Xoshiro256 &gen, double *out, std::size_t n, double mu, double sigma)
+{
+  fillStandardNormal(gen, out, n);
+  for(std::size_t i = 0; i < n; i++)
+  {
+    out[i] = mu + sigma * out[i];
+  }
+}
+
+
+MultivariateNormal::MultivariateNormal()
+{
+}
+
+
+MultivariateNormal::MultivariateNormal(const MatrixXd &cov)
+{
+  setCovariance(cov);
+}
+
+
+MultivariateNormal::MultivariateNormal(const VectorXd &mean, const MatrixXd &cov)
+{
+  setCovariance(cov);
+  setMean(mean);
+}
+
+
+void MultivariateNormal::setCovariance(const MatrixXd &cov)
+{
+  if (cov.rows() != cov.cols())
+  {
+    throw std::invalid_argument("Covariance matrix is not square");
+  }
+
+  if (mu.size() != cov.rows())
+  {
+    mu = VectorXd::Zero(cov.rows());
+  }
+
+  L = cov.llt().matrixL();
+}
+
+
+void MultivariateNormal::setMean(const VectorXd &mean)
+{
+  if (mean.size() != L.rows())
+  {
+    throw std::invalid_argument("Mean and covariance dimensions do not agree");
+  }
+
+  mu = mean;
+}
+
+
+VectorXd MultivariateNormal::sample() const
+{
+  return sample(threadGenerator());
+}
+
+
+VectorXd MultivariateNormal::sample(Xoshiro256 &gen) const
+{
+  VectorXd z(mu.size());
+  fillStandardNormal(gen, z.data(), z.size());
+  return mu + L.triangularView<Eigen::Lower>() * z;
+}
+
+
+void MultivariateNormal::sample(Xoshiro256 &gen, std::size_t n, MatrixXd &samples) const
+{
+  samples.resize(mu.size(), n);
+  fillStandardNormal(gen, samples.data(), samples.size());
+  samples = L.triangularView<Eigen::Lower>() * samples;
+  samples.colwise() += mu;
+}
+
+
+int MultivariateNormal::dim() const
+{
+  return static_cast<int>(mu.size());
+}
+
+
+const VectorXd &MultivariateNormal::mean() const
+{
+  return mu;
+}
+
+
+const MatrixXd &MultivariateNormal::factor() const
+{
+  return L;
+}
+
+} // end namespace
@@ -0,0 +1,123 @@
+/// \file
+/// \brief Bounded and decimated record of a robot's trajectory
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "rigid2d/trajectory.hpp"
+#include "rigid2d/utilities.hpp"
+
+
+namespace rigid2d
+{
+
+TrajectoryRecorder::TrajectoryRecorder(unsigned int capacity, double min_distance, double min_angle)
+                                      : head(0),
+                                        count(0),
+                                        recorded(0),
+                                        min_distance(min_distance),
+                                        min_angle(min_angle)
+{
+  if (capacity == 0)
+  {
+    throw std::invalid_argument("Trajectory capacity must be greater than zero");
+  }
+
+  buffer.resize(capacity);
+}
+
+
+bool TrajectoryRecorder::addPose(const Pose &pose, double stamp)
+{
+  if (count != 0)
+  {
+    // last recorded pose
+    const auto &last = buffer.at((head + buffer.size() - 1) % buffer.size()).pose;
+
+    const auto d = euclideanDistance(last.x, last.y, pose.x, pose.y);
+    const auto dtheta = std::fabs(normalize_angle_PI(pose.theta - last.theta));
+
+    if (d < min_distance and dtheta < min_angle)
+    {
+      return false;
+    }
+  }
+
+  // overwrites the oldest pose once full
+  buffer.at(head) = {stamp, pose};
+  head = (head + 1) % buffer.size();
+
+  if (count < buffer.size())
+  {
+    count++;
+  }
+
+  recorded++;
+
+  return true;
+}
+
+
+void TrajectoryRecorder::poses(std::vector<StampedPose> &poses) const
+{
+  copyNewest(count, poses);
+}
+
+
+unsigned long TrajectoryRecorder::posesSince(unsigned long seq, std::vector<StampedPose> &poses) const
+{
+  // the recorder was cleared after seq was retreived
+  if (seq > recorded)
+  {
+    seq = 0;
+  }
+
+  const auto num = std::min<unsigned long>(recorded - seq, count);
+  copyNewest(static_cast<unsigned int>(num), poses);
+
+  return recorded;
+}
+
+
+unsigned int TrajectoryRecorder::size() const
+{
+  return count;
+}
+
+
+unsigned int TrajectoryRecorder::capacity() const
+{
+  return buffer.size();
+}
+
+
+unsigned long TrajectoryRecorder::numRecorded() const
+{
+  return recorded;
+}
+
+
+void TrajectoryRecorder::clear()
+{
+  head = 0;
+  count = 0;
+  recorded = 0;
+}
+
+
+void TrajectoryRecorder::copyNewest(unsigned int num, std::vector<StampedPose> &poses) const
+{
+  poses.clear();
+  poses.reserve(num);
+
+  // index of the oldest pose to copy
+  const auto first = (head + buffer.size() - num) % buffer.size();
+
+  for(unsigned int i = 0; i < num; i++)
+  {
+    poses.push_back(buffer[(first + i) % buffer.size()]);
+  }
+}
+
+} // end namespace
@@ -3,56 +3,37 @@
 
 
 #include "rigid2d/utilities.hpp"
+#include "rigid2d/sampling.hpp"
 
 
 
 namespace rigid2d
 {
 
-std::mt19937_64 &getTwister()
-{
-  static std::random_device rd;
-  static std::mt19937_64 gen(rd());
-  return gen;
-}
-
-
 double sampleNormalDistribution(const double mu, const double sigma)
 {
-  std::normal_distribution<double> dis(mu, sigma);
-  return dis(getTwister());
+  return mu + sigma * standardNormal(threadGenerator());
 }
 
 
 double sampleUniformDistribution(const double min, const double max)
 {
-  std::uniform_real_distribution<double> dis(min, max);
-  return dis(getTwister());
+  return min + (max - min) * threadGenerator().uniform();
 }
 
 
 VectorXd sampleStandardNormal(int n)
 {
-  VectorXd rand_vec = VectorXd::Zero(n);
-  for(auto i = 0; i < n; i++)
-  {
-    std::normal_distribution<double> dis(0, 1);
-    rand_vec(i) = dis(getTwister());
-  }
+  VectorXd rand_vec(n);
+  fillStandardNormal(threadGenerator(), rand_vec.data(), n);
   return rand_vec;
 }
 
 
 VectorXd sampleMultivariateDistribution(MatrixXd cov)
 {
-  // must be square
-  int dim = cov.cols();
-  VectorXd rand_vec = sampleStandardNormal(dim);
-
-  // cholesky decomposition
-  MatrixXd L( cov.llt().matrixL() );
-
-  return L * rand_vec;
+  // factorizes the covariance, cache a MultivariateNormal to sample it repeatedly
+  return MultivariateNormal(cov).sample();
 }
 
 
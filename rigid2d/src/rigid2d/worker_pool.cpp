@@ -0,0 +1,132 @@
+/// \file
+/// \brief Runs queued tasks on a fixed set of worker threads
+
+#include "rigid2d/worker_pool.hpp"
+
+
+namespace rigid2d
+{
+
+WorkerPool::WorkerPool(unsigned int num_threads)
+                       : running(0),
+                         stopping(false),
+                         num_completed(0)
+{
+  workers.reserve(num_threads);
+  for(unsigned int i = 0; i < num_threads; i++)
+  {
+    workers.emplace_back(&WorkerPool::loop, this);
+  }
+}
+
+
+WorkerPool::~WorkerPool()
+{
+  stop();
+}
+
+
+void WorkerPool::post(std::function<void()> task)
+{
+  if (workers.empty())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (stopping)
+      {
+        return;
+      }
+    }
+
+    task();
+    num_completed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stopping)
+    {
+      return;
+    }
+    tasks.push_back(std::move(task));
+  }
+  wake_cv.notify_one();
+}
+
+
+void WorkerPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+    tasks.clear();
+  }
+  wake_cv.notify_all();
+
+  for(auto &worker : workers)
+  {
+    if (worker.joinable())
+    {
+      worker.join();
+    }
+  }
+  idle_cv.notify_all();
+}
+
+
+bool WorkerPool::waitIdle(const std::chrono::milliseconds &timeout)
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  return idle_cv.wait_for(lock, timeout, [this]()
+  {
+    return (tasks.empty() and running == 0) or stopping;
+  });
+}
+
+
+unsigned int WorkerPool::size() const
+{
+  return static_cast<unsigned int>(workers.size());
+}
+
+
+std::size_t WorkerPool::pending() const
+{
+  std::lock_guard<std::mutex> lock(mtx);
+  return tasks.size();
+}
+
+
+unsigned long WorkerPool::completed() const
+{
+  return num_completed.load(std::memory_order_relaxed);
+}
+
+
+void WorkerPool::loop()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true)
+  {
+    wake_cv.wait(lock, [this]() { return !tasks.empty() or stopping; });
+    if (stopping)
+    {
+      break;
+    }
+
+    auto task = std::move(tasks.front());
+    tasks.pop_front();
+    running++;
+
+    lock.unlock();
+    task();
+    num_completed.fetch_add(1, std::memory_order_relaxed);
+    lock.lock();
+
+    running--;
+    idle_cv.notify_all();
+  }
+}
+
+} // end namespace
@@ -0,0 +1,173 @@
+/// \file
+/// \brief unit tests for the batch transform kernels
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+#include "rigid2d/batch_transform.hpp"
+
+using rigid2d::PointBatchd;
+using rigid2d::PointBatchf;
+using rigid2d::SimdLevel;
+using rigid2d::Transform2D;
+using rigid2d::Vector2D;
+
+
+/// \brief Points on a spiral, the count is not a multiple of the vector width
+/// points[out] - the points
+static void spiral(PointBatchd &points)
+{
+  for(int i = 0; i < 37; i++)
+  {
+    points.push_back(0.1 * i * std::cos(0.3 * i), 0.1 * i * std::sin(0.3 * i));
+  }
+}
+
+
+/// \brief Tests the batch matches transforming one point at a time
+TEST(BatchTransformTest, MatchesTransform2D)
+{
+  const Transform2D T(Vector2D(1.5, -2.0), 0.7);
+
+  PointBatchd points;
+  spiral(points);
+
+  PointBatchd out;
+  rigid2d::transformPoints(T, points, out);
+  ASSERT_EQ(out.size(), points.size());
+
+  for(unsigned int i = 0; i < points.size(); i++)
+  {
+    const Vector2D v = T(Vector2D(points.x[i], points.y[i]));
+    ASSERT_NEAR(out.x[i], v.x, 1e-12);
+    ASSERT_NEAR(out.y[i], v.y, 1e-12);
+  }
+
+  // float precision
+  PointBatchf pointsf, outf;
+  for(unsigned int i = 0; i < points.size(); i++)
+  {
+    pointsf.push_back(static_cast<float>(points.x[i]), static_cast<float>(points.y[i]));
+  }
+
+  rigid2d::transformPoints(T, pointsf, outf);
+  for(unsigned int i = 0; i < points.size(); i++)
+  {
+    ASSERT_NEAR(outf.x[i], out.x[i], 1e-5);
+    ASSERT_NEAR(outf.y[i], out.y[i], 1e-5);
+  }
+}
+
+
+/// \brief Tests the output may be the input
+TEST(BatchTransformTest, InPlace)
+{
+  const Transform2D T(Vector2D(0.5, 0.25), -1.2);
+
+  PointBatchd points, expected;
+  spiral(points);
+  rigid2d::transformPoints(T, points, expected);
+
+  rigid2d::transformPoints(T, points, points);
+  ASSERT_EQ(points.x, expected.x);
+  ASSERT_EQ(points.y, expected.y);
+}
+
+
+/// \brief Tests every instruction set gives identical results
+TEST(BatchTransformTest, SimdLevels)
+{
+  const Transform2D T(Vector2D(-3.0, 4.0), 2.1);
+  const auto supported = rigid2d::supportedSimdLevel();
+
+  PointBatchd points;
+  spiral(points);
+
+  std::vector<float> range(points.size());
+  for(unsigned int i = 0; i < range.size(); i++)
+  {
+    range[i] = 0.05f * i;
+  }
+
+  PointBatchd dirs;
+  std::vector<double> angles;
+  for(unsigned int i = 0; i < range.size(); i++)
+  {
+    angles.push_back(rigid2d::deg2rad(10.0 * i));
+  }
+  rigid2d::beamDirections(angles, dirs);
+
+  ASSERT_EQ(rigid2d::setSimdLevel(SimdLevel::Scalar), SimdLevel::Scalar);
+  PointBatchd ref, ref_polar;
+  rigid2d::transformPoints(T, points, ref);
+  ref_polar.resize(range.size());
+  rigid2d::polarToPoints(T, range.data(), dirs.x.data(), dirs.y.data(),
+                         ref_polar.x.data(), ref_polar.y.data(), range.size());
+
+  for(const auto level : {SimdLevel::SSE2, SimdLevel::AVX2})
+  {
+    rigid2d::setSimdLevel(level);
+
+    PointBatchd out, polar;
+    rigid2d::transformPoints(T, points, out);
+    polar.resize(range.size());
+    rigid2d::polarToPoints(T, range.data(), dirs.x.data(), dirs.y.data(),
+                           polar.x.data(), polar.y.data(), range.size());
+
+    ASSERT_EQ(out.x, ref.x);
+    ASSERT_EQ(out.y, ref.y);
+    ASSERT_EQ(polar.x, ref_polar.x);
+    ASSERT_EQ(polar.y, ref_polar.y);
+  }
+
+  ASSERT_EQ(rigid2d::setSimdLevel(supported), supported);
+}
+
+
+/// \brief Tests the scan end points skip invalid beams and repeat the beam angles
+TEST(BatchTransformTest, ScanEndPoints)
+{
+  const Transform2D T(Vector2D(1.0, 2.0), rigid2d::PI / 2.0);
+
+  // four beams at 0, 90, 180, 270 degrees
+  PointBatchd dirs;
+  rigid2d::beamDirections({0.0, rigid2d::PI / 2.0, rigid2d::PI, 3.0 * rigid2d::PI / 2.0}, dirs);
+
+  // two revolutions, the second beam of each is out of range
+  const std::vector<float> range = {1.0f, 5.0f, 2.0f, 0.5f, 1.0f, 0.01f, 2.0f, 0.5f};
+
+  PointBatchd end_points;
+  rigid2d::scanEndPoints(T, range, dirs, 0.12, 3.5, end_points);
+  ASSERT_EQ(end_points.size(), 6u);
+
+  std::vector<unsigned int> valid = {0, 2, 3, 4, 6, 7};
+  for(unsigned int k = 0; k < valid.size(); k++)
+  {
+    const auto i = valid[k];
+    const auto a = (i % 4) * rigid2d::PI / 2.0;
+    const Vector2D v = T(Vector2D(range[i] * std::cos(a), range[i] * std::sin(a)));
+    ASSERT_NEAR(end_points.x[k], v.x, 1e-12);
+    ASSERT_NEAR(end_points.y[k], v.y, 1e-12);
+  }
+}
+
+
+/// \brief Tests the beam angles stop at the end angle and at the beam limit
+TEST(BatchTransformTest, BeamAngles)
+{
+  // quarter turns, exact in binary
+  const auto angles = rigid2d::beamAngles(0.0, 2.0, 0.5);
+  ASSERT_EQ(angles, std::vector<double>({0.0, 0.5, 1.0, 1.5}));
+
+  // a beam at the end angle is kept if requested
+  const auto inclusive = rigid2d::beamAngles(0.0, 2.0, 0.5, true);
+  ASSERT_EQ(inclusive, std::vector<double>({0.0, 0.5, 1.0, 1.5, 2.0}));
+
+  // negative end angle
+  const auto negative = rigid2d::beamAngles(0.0, -1.0, -0.5);
+  ASSERT_EQ(negative, std::vector<double>({0.0, -0.5}));
+
+  // an increment away from the end angle never reaches it
+  ASSERT_EQ(rigid2d::beamAngles(0.0, 1.0, -0.5).size(), 65536u);
+}
@@ -0,0 +1,77 @@
+/// \file
+/// \brief unit tests for the compute stage
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "rigid2d/compute_stage.hpp"
+
+
+/// \brief Tests each trigger on an idle stage runs the work once
+TEST(ComputeStageTest, Trigger)
+{
+  std::atomic<int> calls(0);
+  rigid2d::ComputeStage stage([&calls]() { calls++; });
+
+  ASSERT_TRUE(stage.waitIdle(std::chrono::milliseconds(1000)));
+  ASSERT_EQ(calls.load(), 0);
+
+  for(int i = 1; i <= 3; i++)
+  {
+    stage.trigger();
+    ASSERT_TRUE(stage.waitIdle(std::chrono::milliseconds(1000)));
+    ASSERT_EQ(calls.load(), i);
+  }
+
+  ASSERT_EQ(stage.runs(), 3u);
+}
+
+
+/// \brief Tests triggers during a run are merged into one more run
+TEST(ComputeStageTest, Coalesce)
+{
+  std::atomic<bool> release(false);
+  std::atomic<int> calls(0);
+  rigid2d::ComputeStage stage([&]()
+  {
+    calls++;
+    while (!release)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  stage.trigger();
+  while (calls.load() == 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // the first run is blocked
+  for(int i = 0; i < 10; i++)
+  {
+    stage.trigger();
+  }
+  release = true;
+
+  ASSERT_TRUE(stage.waitIdle(std::chrono::milliseconds(1000)));
+  ASSERT_EQ(calls.load(), 2);
+  ASSERT_EQ(stage.coalesced(), 9u);
+}
+
+
+/// \brief Tests the stage stops without running a pending trigger
+TEST(ComputeStageTest, Stop)
+{
+  std::atomic<int> calls(0);
+  rigid2d::ComputeStage stage([&calls]() { calls++; });
+
+  stage.stop();
+  stage.trigger();
+  stage.stop();
+
+  ASSERT_EQ(calls.load(), 0);
+  ASSERT_TRUE(stage.waitIdle(std::chrono::milliseconds(10)));
+}
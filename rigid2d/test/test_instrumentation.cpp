@@ -0,0 +1,159 @@
+/// \file
+/// \brief unit tests for instrumentation and logging
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rigid2d/instrumentation.hpp"
+#include "rigid2d/logging.hpp"
+
+
+/// \brief Tests the histogram statistics
+TEST(InstrumentationTest, Histogram)
+{
+  rigid2d::Histogram hist("hist");
+  ASSERT_EQ(hist.count(), 0u);
+  ASSERT_DOUBLE_EQ(hist.percentile(0.5), 0.0);
+
+  for(unsigned int i = 1; i <= 100; i++)
+  {
+    hist.add(i);
+  }
+
+  ASSERT_EQ(hist.count(), 100u);
+  ASSERT_EQ(hist.sum(), 5050u);
+  ASSERT_EQ(hist.min(), 1u);
+  ASSERT_EQ(hist.max(), 100u);
+
+  // within the power of two bucket of the true value
+  ASSERT_GE(hist.percentile(0.5), 32.0);
+  ASSERT_LT(hist.percentile(0.5), 64.0);
+  ASSERT_GE(hist.percentile(0.99), 64.0);
+  ASSERT_LE(hist.percentile(0.99), 100.0);
+
+  hist.reset();
+  ASSERT_EQ(hist.count(), 0u);
+  ASSERT_EQ(hist.max(), 0u);
+}
+
+
+/// \brief Tests the macros share one metric per name across threads
+TEST(InstrumentationTest, Registry)
+{
+  auto &metrics = rigid2d::Metrics::instance();
+  ASSERT_EQ(&metrics.counter("test.count"), &metrics.counter("test.count"));
+
+  std::vector<std::thread> threads;
+  for(unsigned int t = 0; t < 4; t++)
+  {
+    threads.emplace_back([]()
+    {
+      for(unsigned int i = 0; i < 1000; i++)
+      {
+        RIGID2D_SCOPED_TIMER("test.timer");
+        RIGID2D_COUNT("test.count", 1);
+        RIGID2D_RECORD("test.value", i);
+      }
+    });
+  }
+
+  for(auto &th : threads)
+  {
+    th.join();
+  }
+
+  ASSERT_EQ(metrics.counter("test.count").value(), 4000);
+  ASSERT_EQ(metrics.timer("test.timer").count(), 4000u);
+  ASSERT_EQ(metrics.histogram("test.value").max(), 999u);
+
+  std::vector<rigid2d::MetricSummary> summaries;
+  metrics.summary(summaries);
+
+  bool found = false;
+  for(const auto &s : summaries)
+  {
+    if (s.name == "test.timer")
+    {
+      found = true;
+      ASSERT_EQ(s.type, rigid2d::MetricType::Timer);
+      ASSERT_EQ(s.count, 4000u);
+      ASSERT_LE(s.p50, s.max);
+    }
+  }
+  ASSERT_TRUE(found);
+}
+
+
+/// \brief Tests the trace is written as Chrome trace events
+TEST(InstrumentationTest, ChromeTrace)
+{
+  auto &metrics = rigid2d::Metrics::instance();
+  metrics.reset();
+  metrics.enableTrace(true, 2);
+
+  for(unsigned int i = 0; i < 3; i++)
+  {
+    RIGID2D_SCOPED_TIMER("test.trace");
+  }
+  metrics.enableTrace(false);
+
+  const std::string filename = "test_instrumentation_trace.json";
+  ASSERT_TRUE(metrics.writeChromeTrace(filename));
+
+  std::ifstream file(filename);
+  std::stringstream ss;
+  ss << file.rdbuf();
+  const auto trace = ss.str();
+  std::remove(filename.c_str());
+
+  ASSERT_EQ(trace.find("{\"traceEvents\":["), 0u);
+
+  // capped at 2 events
+  unsigned int num_events = 0;
+  for(auto pos = trace.find("\"ph\":\"X\""); pos != std::string::npos;
+      pos = trace.find("\"ph\":\"X\"", pos + 1))
+  {
+    num_events++;
+  }
+  ASSERT_EQ(num_events, 2u);
+  ASSERT_NE(trace.find("\"name\":\"test.trace\""), std::string::npos);
+}
+
+
+/// \brief Tests structured messages, levels, and rate limiting
+TEST(InstrumentationTest, Logging)
+{
+  std::vector<std::string> messages;
+  rigid2d::setLogSink([&messages](rigid2d::LogLevel, const std::string &msg)
+  {
+    messages.push_back(msg);
+  });
+
+  rigid2d::setLogLevel(rigid2d::LogLevel::Info);
+  RIGID2D_LOG(rigid2d::LogLevel::Debug, "hidden");
+  RIGID2D_LOG(rigid2d::LogLevel::Warn, "resample", {{"neff", 12.5}, {"n", 3}});
+
+  for(unsigned int i = 0; i < 10; i++)
+  {
+    RIGID2D_LOG_THROTTLE(60.0, rigid2d::LogLevel::Info, "throttled");
+  }
+
+  rigid2d::setLogSink(rigid2d::LogSink());
+
+  ASSERT_EQ(messages.size(), 2u);
+  ASSERT_EQ(messages.at(0), "resample neff=12.5 n=3");
+  ASSERT_EQ(messages.at(1), "throttled");
+
+  rigid2d::RateLimiter limiter;
+  ASSERT_TRUE(limiter.allow(60.0));
+  ASSERT_FALSE(limiter.allow(60.0));
+  ASSERT_FALSE(limiter.allow(60.0));
+  ASSERT_EQ(limiter.suppressed(), 2u);
+  ASSERT_TRUE(limiter.allow(0.0));
+  ASSERT_EQ(limiter.suppressed(), 0u);
+}
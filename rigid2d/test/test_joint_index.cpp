@@ -0,0 +1,56 @@
+/// \file
+/// \brief unit tests for the wheel joint index
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rigid2d/joint_index.hpp"
+
+
+/// \brief Tests the joints are found and the names are only searched once
+TEST(WheelJointIndexTest, Cached)
+{
+  rigid2d::WheelJointIndex index("left_wheel_axle", "right_wheel_axle");
+  const std::vector<std::string> names = {"left_wheel_axle", "right_wheel_axle"};
+
+  unsigned int left = 0, right = 0;
+  index.lookup(names, left, right);
+  ASSERT_EQ(left, 0u);
+  ASSERT_EQ(right, 1u);
+  ASSERT_EQ(index.searches(), 2u);
+
+  for(int i = 0; i < 10; i++)
+  {
+    index.lookup(names, left, right);
+  }
+  ASSERT_EQ(left, 0u);
+  ASSERT_EQ(right, 1u);
+  ASSERT_EQ(index.searches(), 2u);
+}
+
+
+/// \brief Tests only the joints that moved in a new message layout are searched again
+TEST(WheelJointIndexTest, Reordered)
+{
+  rigid2d::WheelJointIndex index("left_wheel_axle", "right_wheel_axle");
+
+  unsigned int left = 0, right = 0;
+  index.lookup({"left_wheel_axle", "right_wheel_axle"}, left, right);
+  index.lookup({"caster", "right_wheel_axle", "left_wheel_axle"}, left, right);
+  ASSERT_EQ(left, 2u);
+  ASSERT_EQ(right, 1u);
+  ASSERT_EQ(index.searches(), 3u);
+}
+
+
+/// \brief Tests a missing joint throws
+TEST(WheelJointIndexTest, Missing)
+{
+  rigid2d::WheelJointIndex index("left_wheel_axle", "right_wheel_axle");
+
+  unsigned int left = 0, right = 0;
+  ASSERT_THROW(index.lookup({"left_wheel_axle"}, left, right), std::invalid_argument);
+  ASSERT_THROW(index.lookup({}, left, right), std::invalid_argument);
+}
@@ -0,0 +1,133 @@
+/// \file
+/// \brief unit tests for the odometry engine
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+#include "rigid2d/odometry_engine.hpp"
+
+using rigid2d::DiffDrive;
+using rigid2d::EncoderSample;
+using rigid2d::OdometryEngine;
+using rigid2d::Pose;
+
+
+/// \brief Encoder readings with constant wheel velocities
+/// \param n - number of readings
+/// \param dt - time between readings
+/// \param ul - left wheel velocity
+/// \param ur - right wheel velocity
+/// \return readings starting at time 1 with wheel angles of 0.5
+static std::vector<EncoderSample> constantVelocity(int n, double dt, double ul, double ur)
+{
+  std::vector<EncoderSample> samples(n);
+  for(int i = 0; i < n; i++)
+  {
+    samples[i].stamp = 1.0 + i * dt;
+    samples[i].left = rigid2d::normalize_angle_PI(0.5 + i * dt * ul);
+    samples[i].right = rigid2d::normalize_angle_PI(0.5 + i * dt * ur);
+  }
+  return samples;
+}
+
+
+/// \brief Tests the engine integrates the same poses as DiffDrive
+TEST(OdometryEngineTest, MatchesDiffDrive)
+{
+  const DiffDrive drive(Pose(), 0.16, 0.033);
+  OdometryEngine engine(drive, 100);
+
+  const auto samples = constantVelocity(500, 0.001, 4.0, 6.0);
+  ASSERT_EQ(engine.addEncoders(samples), samples.size());
+
+  // DiffDrive with the reference angles set by the first reading
+  DiffDrive expected(Pose(), 0.16, 0.033);
+  expected.updateOdometry(samples[0].left, samples[0].right);
+  expected.reset(Pose());
+  for(unsigned int i = 1; i < samples.size(); i++)
+  {
+    expected.updateOdometry(samples[i].left, samples[i].right);
+  }
+
+  ASSERT_NEAR(engine.pose().theta, expected.pose().theta, 1e-12);
+  ASSERT_NEAR(engine.pose().x, expected.pose().x, 1e-12);
+  ASSERT_NEAR(engine.pose().y, expected.pose().y, 1e-12);
+  ASSERT_DOUBLE_EQ(engine.stamp(), samples.back().stamp);
+
+  // the ring keeps the newest poses
+  ASSERT_EQ(engine.size(), 100u);
+  ASSERT_EQ(engine.capacity(), 100u);
+  ASSERT_FALSE(engine.contains(samples[399].stamp - 1e-6));
+  ASSERT_TRUE(engine.contains(samples[400].stamp));
+
+  // readings that are not newer are ignored
+  ASSERT_FALSE(engine.addEncoders(samples.back().stamp, 0.0, 0.0));
+  ASSERT_NEAR(engine.pose().x, expected.pose().x, 1e-12);
+}
+
+
+/// \brief Tests the pose between readings is on the arc followed by the robot
+TEST(OdometryEngineTest, PoseAt)
+{
+  const double wheel_base = 0.16, wheel_radius = 0.033, ul = 3.0, ur = 5.0;
+  const DiffDrive drive(Pose(), wheel_base, wheel_radius);
+  OdometryEngine engine(drive, 1000);
+  engine.addEncoders(constantVelocity(200, 0.01, ul, ur));
+
+  // constant body twist per second
+  const auto w = wheel_radius * (ur - ul) / wheel_base;
+  const auto vx = wheel_radius * 0.5 * (ul + ur);
+
+  for(const auto t : {1.0, 1.0037, 1.5, 1.9951, 2.99})
+  {
+    const auto dt = t - 1.0;
+    const auto theta = w * dt;
+    const Pose pose = engine.poseAt(t);
+    ASSERT_NEAR(pose.theta, theta, 1e-9);
+    ASSERT_NEAR(pose.x, vx / w * std::sin(theta), 1e-9);
+    ASSERT_NEAR(pose.y, vx / w * (1.0 - std::cos(theta)), 1e-9);
+  }
+
+  // clamped outside the history
+  ASSERT_DOUBLE_EQ(engine.poseAt(0.0).x, 0.0);
+  ASSERT_DOUBLE_EQ(engine.poseAt(10.0).x, engine.pose().x);
+
+  // twist between two times moves the robot from one pose to the other
+  const auto t0 = 1.2345, t1 = 1.7891;
+  const auto twist = engine.twistBetween(t0, t1);
+  ASSERT_NEAR(twist.w, w * (t1 - t0), 1e-9);
+  ASSERT_NEAR(twist.vx, vx * (t1 - t0), 1e-9);
+
+  const Pose p0 = engine.poseAt(t0), p1 = engine.poseAt(t1);
+  const rigid2d::Transform2D T0(rigid2d::Vector2D(p0.x, p0.y), p0.theta);
+  const auto T1 = (T0 * rigid2d::Transform2D().integrateTwist(twist)).displacement();
+  ASSERT_NEAR(T1.x, p1.x, 1e-9);
+  ASSERT_NEAR(T1.y, p1.y, 1e-9);
+}
+
+
+/// \brief Tests the wheel rotation is accumulated across angle wrapping
+TEST(OdometryEngineTest, Reset)
+{
+  const DiffDrive drive(Pose(), 0.16, 0.033);
+  OdometryEngine engine(drive, 100);
+  ASSERT_THROW(OdometryEngine(drive, 0), std::invalid_argument);
+
+  // the wheels turn more than a revolution
+  engine.addEncoders(constantVelocity(101, 0.1, 8.0, 8.0));
+  const auto twist = engine.twistBetween(2.0, 10.0);
+  ASSERT_NEAR(twist.vx, 0.033 * 8.0 * 8.0, 1e-9);
+  ASSERT_NEAR(twist.w, 0.0, 1e-12);
+
+  Pose pose;
+  pose.x = 2.0;
+  engine.reset(pose);
+  ASSERT_EQ(engine.size(), 0u);
+  ASSERT_DOUBLE_EQ(engine.poseAt(5.0).x, 2.0);
+
+  // the next reading moves the robot from the new pose
+  const auto angle = rigid2d::normalize_angle_PI(0.5 + 10.1 * 8.0);
+  engine.addEncoders(11.1, angle, angle);
+  ASSERT_NEAR(engine.pose().x, 2.0 + 0.033 * 8.0 * 0.1, 1e-9);
+}
@@ -0,0 +1,118 @@
+/// \file
+/// \brief unit tests for the random number generators and samplers
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "rigid2d/sampling.hpp"
+
+using rigid2d::MultivariateNormal;
+using rigid2d::Xoshiro256;
+
+
+/// \brief Tests a seed and stream always give the same sequence
+TEST(SamplingTest, Reproducible)
+{
+  Xoshiro256 a(42, 3), b(42, 3), c(42, 4);
+
+  bool differs = false;
+  for(int i = 0; i < 100; i++)
+  {
+    const auto x = a();
+    ASSERT_EQ(x, b());
+    differs |= (x != c());
+  }
+  ASSERT_TRUE(differs);
+
+  // restarting gives the sequence again
+  a.seed(42, 3);
+  b.seed(42, 3);
+  b.jump();
+  Xoshiro256 d(42, 3);
+  ASSERT_EQ(a(), d());
+  ASSERT_NE(b(), d());
+}
+
+
+/// \brief Tests the moments of the bulk fills
+TEST(SamplingTest, Moments)
+{
+  Xoshiro256 gen(7);
+  const std::size_t n = 200001;
+  std::vector<double> u(n), z(n);
+
+  rigid2d::fillUniform(gen, u.data(), n, -1.0, 3.0);
+  rigid2d::fillNormal(gen, z.data(), n, 2.0, 0.5);
+
+  double u_sum = 0.0, z_sum = 0.0, z_sqrd = 0.0;
+  for(std::size_t i = 0; i < n; i++)
+  {
+    ASSERT_GE(u[i], -1.0);
+    ASSERT_LT(u[i], 3.0);
+    ASSERT_TRUE(std::isfinite(z[i]));
+    u_sum += u[i];
+    z_sum += z[i];
+    z_sqrd += (z[i] - 2.0) * (z[i] - 2.0);
+  }
+
+  ASSERT_NEAR(u_sum / n, 1.0, 0.01);
+  ASSERT_NEAR(z_sum / n, 2.0, 0.01);
+  ASSERT_NEAR(std::sqrt(z_sqrd / n), 0.5, 0.01);
+}
+
+
+/// \brief Tests the sample covariance matches the distribution
+TEST(SamplingTest, MultivariateNormal)
+{
+  Eigen::MatrixXd cov(3,3);
+  cov << 2.0, 0.5, 0.1,
+         0.5, 1.0, -0.3,
+         0.1, -0.3, 0.5;
+  Eigen::VectorXd mu(3);
+  mu << 1.0, -2.0, 0.5;
+
+  const MultivariateNormal mvn(mu, cov);
+  ASSERT_EQ(mvn.dim(), 3);
+  ASSERT_TRUE((mvn.factor() * mvn.factor().transpose()).isApprox(cov));
+
+  Xoshiro256 gen(11);
+  Eigen::MatrixXd samples;
+  mvn.sample(gen, 100000, samples);
+  ASSERT_EQ(samples.cols(), 100000);
+
+  const Eigen::VectorXd mean = samples.rowwise().mean();
+  const Eigen::MatrixXd centered = samples.colwise() - mean;
+  const Eigen::MatrixXd sample_cov = centered * centered.transpose() / (samples.cols() - 1);
+
+  ASSERT_LT((mean - mu).cwiseAbs().maxCoeff(), 0.02);
+  ASSERT_LT((sample_cov - cov).cwiseAbs().maxCoeff(), 0.03);
+
+  // a single sample from the same state matches the first column
+  Xoshiro256 g1(11), g2(11);
+  Eigen::MatrixXd one;
+  mvn.sample(g1, 1, one);
+  ASSERT_TRUE(one.col(0).isApprox(mvn.sample(g2)));
+
+  ASSERT_THROW(MultivariateNormal(Eigen::MatrixXd::Zero(2,3)), std::invalid_argument);
+  ASSERT_THROW(MultivariateNormal(mu, Eigen::MatrixXd::Identity(2,2)), std::invalid_argument);
+}
+
+
+/// \brief Tests reseeding restarts the generator of every thread
+TEST(SamplingTest, ThreadGenerators)
+{
+  rigid2d::seedSampling(5);
+  ASSERT_EQ(rigid2d::samplingSeed(), 5u);
+
+  const auto first = rigid2d::threadGenerator()();
+  rigid2d::seedSampling(5);
+  ASSERT_EQ(rigid2d::threadGenerator()(), first);
+
+  // another thread draws from a different stream
+  std::uint64_t other = 0;
+  std::thread t([&other](){ other = rigid2d::threadGenerator()(); });
+  t.join();
+  ASSERT_NE(other, first);
+}
@@ -0,0 +1,117 @@
+/// \file
+/// \brief unit tests for trajectory recorder
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+#include "rigid2d/trajectory.hpp"
+
+
+/// \brief Tests poses closer than the min distance and angle are skipped
+TEST(TrajectoryTest, Decimation)
+{
+  rigid2d::TrajectoryRecorder traj(10, 0.1, 0.2);
+
+  rigid2d::Pose pose;
+  ASSERT_TRUE(traj.addPose(pose, 0.0));
+
+  // small move
+  pose.x = 0.05;
+  ASSERT_FALSE(traj.addPose(pose, 1.0));
+
+  // far enough
+  pose.x = 0.1;
+  ASSERT_TRUE(traj.addPose(pose, 2.0));
+
+  // turn in place across -PI/PI
+  pose.theta = 3.1;
+  ASSERT_TRUE(traj.addPose(pose, 3.0));
+  pose.theta = -3.1;
+  ASSERT_FALSE(traj.addPose(pose, 4.0));
+
+  ASSERT_EQ(traj.size(), 3u);
+  ASSERT_EQ(traj.numRecorded(), 3u);
+}
+
+
+/// \brief Tests the oldest poses are dropped once full
+TEST(TrajectoryTest, RingBuffer)
+{
+  rigid2d::TrajectoryRecorder traj(4, 0.0, 0.0);
+
+  rigid2d::Pose pose;
+  for(int i = 0; i < 10; i++)
+  {
+    pose.x = i;
+    traj.addPose(pose, i);
+  }
+
+  std::vector<rigid2d::StampedPose> poses;
+  traj.poses(poses);
+
+  ASSERT_EQ(traj.size(), 4u);
+  ASSERT_EQ(traj.capacity(), 4u);
+  ASSERT_EQ(poses.size(), 4u);
+  for(unsigned int i = 0; i < poses.size(); i++)
+  {
+    ASSERT_NEAR(poses.at(i).pose.x, 6.0 + i, 1e-12);
+    ASSERT_NEAR(poses.at(i).stamp, 6.0 + i, 1e-12);
+  }
+}
+
+
+/// \brief Tests retreiving the poses recorded since a sequence number
+TEST(TrajectoryTest, PosesSince)
+{
+  rigid2d::TrajectoryRecorder traj(4, 0.0, 0.0);
+  std::vector<rigid2d::StampedPose> poses;
+
+  rigid2d::Pose pose;
+  pose.x = 1.0;
+  traj.addPose(pose, 0.0);
+  pose.x = 2.0;
+  traj.addPose(pose, 1.0);
+
+  auto seq = traj.posesSince(0, poses);
+  ASSERT_EQ(seq, 2u);
+  ASSERT_EQ(poses.size(), 2u);
+
+  // nothing new
+  seq = traj.posesSince(seq, poses);
+  ASSERT_EQ(seq, 2u);
+  ASSERT_TRUE(poses.empty());
+
+  pose.x = 3.0;
+  traj.addPose(pose, 2.0);
+  seq = traj.posesSince(seq, poses);
+  ASSERT_EQ(seq, 3u);
+  ASSERT_EQ(poses.size(), 1u);
+  ASSERT_NEAR(poses.at(0).pose.x, 3.0, 1e-12);
+
+  // more new poses than the capacity
+  for(int i = 0; i < 6; i++)
+  {
+    pose.x = 4.0 + i;
+    traj.addPose(pose, 3.0 + i);
+  }
+
+  seq = traj.posesSince(seq, poses);
+  ASSERT_EQ(seq, 9u);
+  ASSERT_EQ(poses.size(), 4u);
+  ASSERT_NEAR(poses.front().pose.x, 6.0, 1e-12);
+
+  // cleared after seq was retreived
+  traj.clear();
+  traj.addPose(pose, 10.0);
+  seq = traj.posesSince(seq, poses);
+  ASSERT_EQ(seq, 1u);
+  ASSERT_EQ(poses.size(), 1u);
+}
+
+
+/// \brief Tests zero capacity is rejected
+TEST(TrajectoryTest, ZeroCapacity)
+{
+  ASSERT_THROW(rigid2d::TrajectoryRecorder(0, 0.0, 0.0), std::invalid_argument);
+}
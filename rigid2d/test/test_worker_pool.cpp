@@ -0,0 +1,91 @@
+/// \file
+/// \brief unit tests for the worker pool
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "rigid2d/worker_pool.hpp"
+
+
+/// \brief Tests every posted task runs once
+TEST(WorkerPoolTest, Post)
+{
+  std::atomic<int> calls(0);
+  rigid2d::WorkerPool pool(3);
+  ASSERT_EQ(pool.size(), 3u);
+
+  for(int i = 0; i < 100; i++)
+  {
+    pool.post([&calls]() { calls++; });
+  }
+
+  ASSERT_TRUE(pool.waitIdle(std::chrono::milliseconds(1000)));
+  ASSERT_EQ(calls.load(), 100);
+  ASSERT_EQ(pool.completed(), 100u);
+  ASSERT_EQ(pool.pending(), 0u);
+}
+
+
+/// \brief Tests a pool without threads runs tasks on the caller, including
+///        tasks posted by a task
+TEST(WorkerPoolTest, Inline)
+{
+  rigid2d::WorkerPool pool(0);
+  const auto caller = std::this_thread::get_id();
+
+  int calls = 0;
+  pool.post([&]()
+  {
+    ASSERT_EQ(std::this_thread::get_id(), caller);
+    calls++;
+    pool.post([&calls]() { calls++; });
+  });
+
+  ASSERT_EQ(calls, 2);
+  ASSERT_TRUE(pool.waitIdle(std::chrono::milliseconds(10)));
+}
+
+
+/// \brief Tests stop drops the queued tasks and later posts
+TEST(WorkerPoolTest, Stop)
+{
+  std::atomic<bool> release(false);
+  std::atomic<int> calls(0);
+  rigid2d::WorkerPool pool(1);
+
+  pool.post([&]()
+  {
+    calls++;
+    while (!release)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  while (calls.load() == 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // the first task is blocked
+  for(int i = 0; i < 10; i++)
+  {
+    pool.post([&calls]() { calls++; });
+  }
+  ASSERT_EQ(pool.pending(), 10u);
+
+  // stop clears the queue then waits for the blocked task
+  std::thread stopper([&pool]() { pool.stop(); });
+  while (pool.pending() != 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  release = true;
+  stopper.join();
+
+  pool.post([&calls]() { calls++; });
+  ASSERT_EQ(calls.load(), 1);
+  ASSERT_TRUE(pool.waitIdle(std::chrono::milliseconds(10)));
+}
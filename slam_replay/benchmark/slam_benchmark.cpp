@@ -0,0 +1,154 @@
+/// \file
+/// \brief Benchmarks of the SLAM engines on a simulated log
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include <rigid2d/utilities.hpp>
+#include <bmapping/grid_mapper.hpp>
+#include <nuslam/landmarks.hpp>
+
+#include "slam_replay/log_simulator.hpp"
+#include "slam_replay/replay_runner.hpp"
+
+
+using slam_replay::LogRecord;
+
+
+/// \brief Simulated log shared by all benchmarks, same seed every run
+/// \return the log
+static const std::vector<LogRecord> &simulatedLog()
+{
+  static const std::vector<LogRecord> records = []()
+  {
+    auto config = slam_replay::defaultSimulation();
+    config.num_scans = 100;
+
+    std::vector<LogRecord> log;
+    slam_replay::simulateLog(slam_replay::defaultWorld(), config, log);
+    return log;
+  }();
+
+  return records;
+}
+
+
+/// \brief Adds the latency percentiles of each stage as counters,
+///        a replay that stopped early is reported as an error
+/// \param state - benchmark state
+/// \param stats - performance of the last replay
+static void reportStages(benchmark::State &state, const slam_replay::ReplayStats &stats)
+{
+  if (!stats.failure.empty())
+  {
+    state.SkipWithError(stats.failure.c_str());
+    return;
+  }
+
+  for(const auto &stage : stats.stages)
+  {
+    state.counters[stage.name + "_p50_us"] = stage.percentile(0.5);
+    state.counters[stage.name + "_p99_us"] = stage.percentile(0.99);
+  }
+
+  state.counters["position_rmse"] = stats.error.positionRMSE();
+  state.counters["peak_memory_kB"] = stats.peak_memory_kb;
+}
+
+
+/// \brief Full RBPF replay, the argument is the number of particles
+static void BM_ParticleFilterReplay(benchmark::State &state)
+{
+  const auto &records = simulatedLog();
+  const auto header = slam_replay::defaultSimulation().header;
+
+  slam_replay::ReplayConfig config;
+  config.num_particles = state.range(0);
+
+  slam_replay::ReplayStats stats;
+  for(auto _ : state)
+  {
+    slam_replay::replayParticleFilter(header, records, config, stats);
+  }
+
+  state.SetItemsProcessed(state.iterations() * records.size());
+  reportStages(state, stats);
+}
+BENCHMARK(BM_ParticleFilterReplay)->Arg(10)->Arg(40)->Unit(benchmark::kMillisecond);
+
+
+/// \brief Full landmark detection and EKF replay
+static void BM_EKFReplay(benchmark::State &state)
+{
+  const auto &records = simulatedLog();
+  const auto header = slam_replay::defaultSimulation().header;
+
+  slam_replay::ReplayConfig config;
+
+  slam_replay::ReplayStats stats;
+  for(auto _ : state)
+  {
+    slam_replay::replayEKF(header, records, config, stats);
+  }
+
+  state.SetItemsProcessed(state.iterations() * records.size());
+  reportStages(state, stats);
+}
+BENCHMARK(BM_EKFReplay)->Unit(benchmark::kMillisecond);
+
+
+/// \brief Landmark detection on a single scan
+static void BM_LandmarkDetection(benchmark::State &state)
+{
+  const auto &records = simulatedLog();
+  const auto header = slam_replay::defaultSimulation().header;
+
+  nuslam::LaserProperties props(header.beam_min, header.beam_max, header.beam_delta,
+                                header.range_min, header.range_max);
+  nuslam::Landmarks landmarks(props, slam_replay::ReplayConfig().cluster_epsilon);
+
+  unsigned int i = 0;
+  for(auto _ : state)
+  {
+    landmarks.featureDetection(records[i].ranges);
+    benchmark::DoNotOptimize(landmarks.lm.data());
+    i = (i + 1) % records.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LandmarkDetection);
+
+
+/// \brief Integrating a single scan into an occupancy grid
+static void BM_IntegrateScan(benchmark::State &state)
+{
+  const auto &records = simulatedLog();
+  const auto header = slam_replay::defaultSimulation().header;
+  const slam_replay::ReplayConfig config;
+
+  bmapping::LaserProperties props(header.beam_min, header.beam_max, header.beam_delta,
+                                  header.range_min, header.range_max,
+                                  config.z_hit, config.z_short, config.z_max,
+                                  config.z_rand, config.sigma_hit);
+
+  rigid2d::Transform2D Trs;
+  bmapping::GridMapper grid(config.map_resolution, config.map_min, config.map_max,
+                            config.map_min, config.map_max, props, Trs);
+
+  unsigned int i = 0;
+  for(auto _ : state)
+  {
+    const auto &truth = records[i].truth;
+    grid.integrateScan(records[i].ranges,
+                       rigid2d::Transform2D(rigid2d::Vector2D(truth.x, truth.y), truth.theta));
+    i = (i + 1) % records.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IntegrateScan);
+
+
+BENCHMARK_MAIN();
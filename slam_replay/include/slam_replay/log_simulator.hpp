@@ -0,0 +1,68 @@
+#ifndef LOG_SIMULATOR_GUARD_HPP
+#define LOG_SIMULATOR_GUARD_HPP
+/// \file
+/// \brief Generates deterministic replay logs of a diff drive robot in a room with cylinders
+
+#include <vector>
+
+#include <rigid2d/rigid2d.hpp>
+#include "slam_replay/replay_log.hpp"
+
+
+namespace slam_replay
+{
+  using rigid2d::Vector2D;
+
+
+  /// \brief Rectangular room with cylindrical landmarks
+  struct SimulatedWorld
+  {
+    double xmin = -1.5, xmax = 1.5;           // walls along x
+    double ymin = -1.5, ymax = 1.5;           // walls along y
+    std::vector<Vector2D> landmarks;          // centers of cylinders
+    double landmark_radius = 0.04;            // radius of cylinders
+  };
+
+
+  /// \brief Motion, noise, and sensor settings of a simulated log
+  struct SimulationConfig
+  {
+    unsigned int seed = 0;                    // random seed
+    unsigned int num_scans = 500;             // number of records
+    double scan_rate = 5.0;                   // scans per second
+    double vx = 0.1;                          // forward velocity
+    double w = 0.2;                           // angular velocity
+    double range_noise = 0.005;               // std of range noise
+    double wheel_slip = 0.01;                 // std of fractional wheel slip
+    LogHeader header;                         // lidar and robot properties
+  };
+
+
+  /// \brief Default world, a room with a grid of cylinders
+  /// \return the world
+  SimulatedWorld defaultWorld();
+
+  /// \brief Default settings, a TurtleBot3 with an LDS-01 lidar
+  /// \return the settings
+  SimulationConfig defaultSimulation();
+
+  /// \brief Drives the robot around a circle and records scans, noisy
+  ///        encoders, and the ground truth pose
+  /// \param world - the room
+  /// \param config - motion, noise, and sensor settings
+  /// records[out] - simulated log
+  void simulateLog(const SimulatedWorld &world, const SimulationConfig &config,
+                   std::vector<LogRecord> &records);
+
+  /// \brief Range of a single beam
+  /// \param world - the room
+  /// \param x - x position of lidar
+  /// \param y - y position of lidar
+  /// \param angle - angle of beam in the world frame
+  /// \param range_max - max range of lidar
+  /// \return distance to the first surface hit, range_max if there is none
+  double castRay(const SimulatedWorld &world, double x, double y, double angle,
+                 double range_max);
+} // end namespace
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef REPLAY_LOG_GUARD_HPP
+#define REPLAY_LOG_GUARD_HPP
+/// \file
+/// \brief Compact binary log of laser scans and wheel encoders for offline replay
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <rigid2d/diff_drive.hpp>
+
+
+namespace slam_replay
+{
+  using rigid2d::Pose;
+  using rigid2d::WheelEncoders;
+
+
+  /// \brief Sensor and robot properties shared by all records
+  struct LogHeader
+  {
+    float beam_min = 0.0;         // start angle of scan (rad)
+    float beam_max = 0.0;         // end angle of scan (rad)
+    float beam_delta = 0.0;       // increment between beams (rad)
+    float range_min = 0.0;        // min range of lidar
+    float range_max = 0.0;        // max range of lidar
+    double wheel_base = 0.0;      // distance between wheels
+    double wheel_radius = 0.0;    // radius of wheels
+  };
+
+
+  /// \brief One laser scan with the wheel encoders at the time of the scan
+  struct LogRecord
+  {
+    double stamp = 0.0;           // time (s)
+    WheelEncoders encoders;       // wheel angles (rad)
+    bool has_truth = false;       // true if the ground truth pose is known
+    Pose truth;                   // ground truth pose
+    std::vector<float> ranges;    // laser scan
+  };
+
+
+  /// \brief Writes a log one record at a time
+  class LogWriter
+  {
+  public:
+    /// \brief Opens the log and writes the header
+    /// \param filename - name of log file
+    /// \param header - sensor and robot properties
+    LogWriter(const std::string &filename, const LogHeader &header);
+
+    /// \brief Checks the log was opened
+    /// \return true if records can be written
+    bool isOpen() const;
+
+    /// \brief Appends a record
+    /// \param record - scan and encoders
+    void write(const LogRecord &record);
+
+  private:
+    std::ofstream file;
+  };
+
+
+  /// \brief Reads a log one record at a time
+  class LogReader
+  {
+  public:
+    /// \brief Opens the log and reads the header
+    /// \param filename - name of log file
+    LogReader(const std::string &filename);
+
+    /// \brief Checks the log was opened and has a valid header
+    /// \return true if records can be read
+    bool isOpen() const;
+
+    /// \brief Retreive the header
+    /// \return sensor and robot properties
+    const LogHeader &header() const;
+
+    /// \brief Reads the next record
+    /// record[out] - scan and encoders
+    /// \return false at the end of the log
+    bool next(LogRecord &record);
+
+  private:
+    std::ifstream file;
+    LogHeader log_header;
+    bool valid;
+  };
+
+
+  /// \brief Writes a complete log
+  /// \param filename - name of log file
+  /// \param header - sensor and robot properties
+  /// \param records - scans and encoders
+  /// \return true if the log is written
+  bool saveLog(const std::string &filename, const LogHeader &header,
+               const std::vector<LogRecord> &records);
+
+  /// \brief Reads a complete log
+  /// \param filename - name of log file
+  /// header[out] - sensor and robot properties
+  /// records[out] - scans and encoders
+  /// \return true if the log is read
+  bool loadLog(const std::string &filename, LogHeader &header,
+               std::vector<LogRecord> &records);
+} // end namespace
+
+#endif
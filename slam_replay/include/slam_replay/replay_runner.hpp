@@ -0,0 +1,214 @@
+#ifndef REPLAY_RUNNER_GUARD_HPP
+#define REPLAY_RUNNER_GUARD_HPP
+/// \file
+/// \brief Replays a log through the SLAM engines and measures their performance
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <rigid2d/rigid2d.hpp>
+#include "slam_replay/replay_log.hpp"
+
+
+namespace slam_replay
+{
+  using rigid2d::Transform2D;
+
+
+  /// \brief Latency samples of one stage of an engine
+  struct StageLatency
+  {
+    std::string name;                 // name of stage
+    std::vector<double> samples;      // latency of each call (us)
+
+    /// \brief Latency below which a fraction of the samples fall
+    /// \param p - fraction in [0, 1]
+    /// \return latency (us), 0 if there are no samples
+    double percentile(double p) const;
+
+    /// \brief Mean latency
+    /// \return latency (us), 0 if there are no samples
+    double mean() const;
+  };
+
+
+  /// \brief Measures the latency of a stage, the time from
+  ///        construction to destruction is added to the stage
+  class ScopedStageTimer
+  {
+  public:
+    /// \brief Starts the timer
+    /// \param stage - stage the latency is added to
+    explicit ScopedStageTimer(StageLatency &stage);
+
+    /// \brief Stops the timer
+    ~ScopedStageTimer();
+
+    ScopedStageTimer(const ScopedStageTimer &) = delete;
+    ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+
+  private:
+    StageLatency &stage;
+    std::chrono::steady_clock::time_point start;
+  };
+
+
+  /// \brief Error between an estimated and a ground truth trajectory. Both
+  ///        are compared relative to their first pose since the estimate
+  ///        starts at the origin of the map.
+  class TrajectoryError
+  {
+  public:
+    /// \brief No poses
+    TrajectoryError();
+
+    /// \brief Adds a pose pair
+    /// \param estimate - estimated transform from map to robot
+    /// \param truth - ground truth pose
+    void add(const Transform2D &estimate, const Pose &truth);
+
+    /// \brief Number of pose pairs
+    /// \return number of pairs
+    unsigned int size() const;
+
+    /// \brief Root mean square position error
+    /// \return error in world units
+    double positionRMSE() const;
+
+    /// \brief Root mean square heading error
+    /// \return error (rad)
+    double headingRMSE() const;
+
+  private:
+    bool has_origin;                  // true once the first truth pose is set
+    Transform2D T_origin_inv;         // inverse of first truth pose
+    unsigned int count;               // number of pose pairs
+    double position_sq_sum;           // sum of squared position errors
+    double heading_sq_sum;            // sum of squared heading errors
+  };
+
+
+  /// \brief Parameters of the engines, defaults match the launch files
+  struct ReplayConfig
+  {
+    unsigned int seed = 0;            // seed of the random engines
+
+    // particle filter
+    int num_particles = 40;
+    int num_samples_mode = 50;
+    double srr = 0.1, srt = 0.2, str = 0.1, stt = 0.2;
+    double motion_noise_theta = 1e-10, motion_noise_x = 1e-10, motion_noise_y = 1e-10;
+    double sample_range_theta = 1e-10, sample_range_x = 1e-8, sample_range_y = 1e-8;
+    double z_hit = 0.95, z_short = 0.0, z_max = 0.04, z_rand = 0.01, sigma_hit = 0.5;
+    double map_min = -2.0, map_max = 2.0, map_resolution = 0.05;
+    bool correlative_matcher = true;  // propose with the correlative matcher rather than ICP
+    double match_linear_window = 0.1, match_angular_window = 0.1;
+    int match_depth = 3;
+    double match_min_score = -1.0;
+    bool scan_filter = false;         // score decimated beams and integrate every valid return
+    double filter_min_spacing = 0.05, filter_max_angle_gap = 0.05;
+    double filter_isolation_distance = 0.15;
+    int filter_max_beams = 120;
+
+    // Monte Carlo localization
+    int mcl_min_particles = 100, mcl_max_particles = 5000;
+    double mcl_kld_error = 0.01, mcl_kld_z = 2.326;
+    double mcl_bin_xy = 0.1, mcl_bin_theta = 0.1745;
+    double mcl_srr = 0.05, mcl_srt = 0.05, mcl_str = 0.05, mcl_stt = 0.05;
+    double mcl_update_distance = 0.05, mcl_update_angle = 0.1;
+    int mcl_max_beams = 60;
+    bool mcl_beam_model = false;      // score with the beam model rather than the likelihood field
+    int mcl_beam_angles = 360;
+    double mcl_lambda_short = 0.1;
+
+    // submap graph SLAM
+    int submap_scans = 20;
+    double submap_node_distance = 0.02, submap_node_angle = 0.05;
+    double submap_loop_linear_window = 0.5, submap_loop_angular_window = 0.3;
+    int submap_loop_depth = 4;
+    double submap_loop_min_score = -0.3;
+    double submap_loop_search_distance = 1.0;
+    int submap_loop_min_gap = 40;
+    int submap_optimize_every = 20;
+    double submap_huber_scale = 1.0;
+    unsigned int submap_threads = 2;
+
+    // EKF
+    int num_landmarks = 25;
+    double md_max = 1e7, md_min = 20000.0;
+    double cluster_epsilon = 0.075;
+  };
+
+
+  /// \brief Performance of one replay
+  struct ReplayStats
+  {
+    std::string engine;               // name of engine
+    std::vector<StageLatency> stages; // latency of each stage
+    unsigned int num_scans = 0;       // scans processed
+    double wall_time = 0.0;           // total time (s)
+    long peak_memory_kb = 0;          // peak resident memory of the process
+    TrajectoryError error;            // error against ground truth
+    TrajectoryError optimized_error;  // error of the optimized trajectory, graph SLAM only
+    std::string failure;              // why the replay stopped early, empty if it finished
+
+    /// \brief Scans processed per second
+    /// \return throughput
+    double scansPerSecond() const;
+
+    /// \brief Prints a report
+    /// \param os - stream to output to
+    void print(std::ostream &os) const;
+  };
+
+
+  /// \brief Seeds every random engine used by the SLAM libraries
+  /// \param seed - the seed
+  void seedRandomEngines(unsigned int seed);
+
+  /// \brief Peak resident memory of the process
+  /// \return memory (kB)
+  long peakMemoryKB();
+
+  /// \brief Replays a log through the RBPF SLAM, an engine that throws
+  ///        stops the replay and the stats cover the scans before it
+  /// \param header - lidar and robot properties
+  /// \param records - the log
+  /// \param config - engine parameters
+  /// stats[out] - performance of the replay
+  void replayParticleFilter(const LogHeader &header, const std::vector<LogRecord> &records,
+                            const ReplayConfig &config, ReplayStats &stats);
+
+  /// \brief Replays a log through the submap graph SLAM, an engine that throws
+  ///        stops the replay and the stats cover the scans before it. The
+  ///        error of the trajectory is also measured after the last optimization.
+  /// \param header - lidar and robot properties
+  /// \param records - the log
+  /// \param config - engine parameters
+  /// stats[out] - performance of the replay
+  void replaySubmapSLAM(const LogHeader &header, const std::vector<LogRecord> &records,
+                        const ReplayConfig &config, ReplayStats &stats);
+
+  /// \brief Replays a log through Monte Carlo localization. The map is built
+  ///        first from the scans at the ground truth poses and loaded from
+  ///        its rviz map, as a prebuilt map would be.
+  /// \param header - lidar and robot properties
+  /// \param records - the log
+  /// \param config - engine parameters
+  /// stats[out] - performance of the replay
+  void replayLocalization(const LogHeader &header, const std::vector<LogRecord> &records,
+                          const ReplayConfig &config, ReplayStats &stats);
+
+  /// \brief Replays a log through the landmark detector and EKF SLAM, an engine
+  ///        that throws stops the replay and the stats cover the scans before it
+  /// \param header - lidar and robot properties
+  /// \param records - the log
+  /// \param config - engine parameters
+  /// stats[out] - performance of the replay
+  void replayEKF(const LogHeader &header, const std::vector<LogRecord> &records,
+                 const ReplayConfig &config, ReplayStats &stats);
+} // end namespace
+
+#endif
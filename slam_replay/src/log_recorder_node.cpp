@@ -0,0 +1,160 @@
+/// \file
+/// \brief Records laser scans and wheel encoders to a replay log
+///
+/// \author Boston Cleek
+///
+/// PARAMETERS:
+///   log_file - name of the log file
+///   left_wheel_joint - name of left wheel joint
+///   right_wheel_joint - name of right wheel joint
+///   beam_min - starting angle of lidar (degrees)
+///   beam_max - ending angle of lidar (degrees)
+///   beam_delta - change in angle between laser measurements (degrees)
+///   range_min - min range of lidar
+///   range_max - max range of lidar
+/// SUBSCRIBES:
+///   scan (sensor_msgs/LaserScan): Lidar scan
+///   joint_states (sensor_msgs/JointState): angular wheel positions
+///   /gazebo/model_states (gazebo_msgs/ModelStates): ground truth pose, optional
+
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/LaserScan.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <tf2/LinearMath/Matrix3x3.h>
+#include <tf2/LinearMath/Quaternion.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <rigid2d/rigid2d.hpp>
+#include "slam_replay/replay_log.hpp"
+
+
+using rigid2d::deg2rad;
+
+using slam_replay::LogHeader;
+using slam_replay::LogRecord;
+using slam_replay::LogWriter;
+
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "log_recorder");
+  ros::NodeHandle nh("~");
+  ros::NodeHandle node_handle;
+
+  std::string log_file = "slam.log";
+  std::string left_wheel_joint, right_wheel_joint;
+  double beam_min = 0.0, beam_max = 0.0, beam_delta = 0.0;
+  double range_min = 0.0, range_max = 0.0;
+  double wheel_base = 0.0, wheel_radius = 0.0;
+
+  nh.getParam("log_file", log_file);
+  nh.getParam("left_wheel_joint", left_wheel_joint);
+  nh.getParam("right_wheel_joint", right_wheel_joint);
+  nh.getParam("beam_min", beam_min);
+  nh.getParam("beam_max", beam_max);
+  nh.getParam("beam_delta", beam_delta);
+  nh.getParam("range_min", range_min);
+  nh.getParam("range_max", range_max);
+
+  node_handle.getParam("/wheel_base", wheel_base);
+  node_handle.getParam("/wheel_radius", wheel_radius);
+
+  ROS_INFO("log_file %s", log_file.c_str());
+  ROS_INFO("left_wheel_joint %s", left_wheel_joint.c_str());
+  ROS_INFO("right_wheel_joint %s", right_wheel_joint.c_str());
+
+  LogHeader header;
+  header.beam_min = deg2rad(beam_min);
+  header.beam_max = deg2rad(beam_max);
+  header.beam_delta = deg2rad(beam_delta);
+  header.range_min = range_min;
+  header.range_max = range_max;
+  header.wheel_base = wheel_base;
+  header.wheel_radius = wheel_radius;
+
+  LogWriter writer(log_file, header);
+  if (!writer.isOpen())
+  {
+    ROS_ERROR("Could not open %s", log_file.c_str());
+    return 1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  // latest encoders and ground truth, written with each scan
+  LogRecord record;
+  bool encoders_received = false;
+  unsigned long num_records = 0;
+
+
+  auto jointStatesCallback = [&](const sensor_msgs::JointState::ConstPtr &msg)
+  {
+    const auto left = std::find(msg->name.begin(), msg->name.end(), left_wheel_joint);
+    const auto right = std::find(msg->name.begin(), msg->name.end(), right_wheel_joint);
+
+    if (left == msg->name.end() or right == msg->name.end())
+    {
+      ROS_ERROR_ONCE("Wheel joints not found in joint_states");
+      return;
+    }
+
+    record.encoders.left = msg->position.at(std::distance(msg->name.begin(), left));
+    record.encoders.right = msg->position.at(std::distance(msg->name.begin(), right));
+    encoders_received = true;
+  };
+
+
+  auto modelCallback = [&](const gazebo_msgs::ModelStates::ConstPtr &msg)
+  {
+    const auto robot = std::find(msg->name.begin(), msg->name.end(), "diff_drive");
+    if (robot == msg->name.end())
+    {
+      return;
+    }
+
+    const auto &pose = msg->pose.at(std::distance(msg->name.begin(), robot));
+
+    tf2::Quaternion q(pose.orientation.x, pose.orientation.y,
+                      pose.orientation.z, pose.orientation.w);
+    auto roll = 0.0, pitch = 0.0 , yaw = 0.0;
+    tf2::Matrix3x3(q).getRPY(roll, pitch, yaw);
+
+    record.has_truth = true;
+    record.truth.theta = yaw;
+    record.truth.x = pose.position.x;
+    record.truth.y = pose.position.y;
+  };
+
+
+  auto scanCallback = [&](const sensor_msgs::LaserScan::ConstPtr &msg)
+  {
+    if (!encoders_received)
+    {
+      return;
+    }
+
+    record.stamp = msg->header.stamp.toSec();
+    record.ranges = msg->ranges;
+    writer.write(record);
+
+    num_records++;
+    ROS_INFO_THROTTLE(10.0, "Recorded %lu scans", num_records);
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+
+  ros::Subscriber scan_sub = node_handle.subscribe<sensor_msgs::LaserScan>("scan", 10, scanCallback);
+  ros::Subscriber joint_sub = node_handle.subscribe<sensor_msgs::JointState>("joint_states", 10, jointStatesCallback);
+  ros::Subscriber model_sub = node_handle.subscribe<gazebo_msgs::ModelStates>("/gazebo/model_states", 1, modelCallback);
+
+  ros::spin();
+
+  ROS_INFO("Wrote %lu scans to %s", num_records, log_file.c_str());
+
+  return 0;
+}
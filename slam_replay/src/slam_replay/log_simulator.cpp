@@ -0,0 +1,160 @@
+/// \file
+/// \brief Generates deterministic replay logs of a diff drive robot in a room with cylinders
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+#include "slam_replay/log_simulator.hpp"
+
+
+namespace slam_replay
+{
+
+SimulatedWorld defaultWorld()
+{
+  SimulatedWorld world;
+
+  for(auto x = -1.0; x <= 1.0; x += 1.0)
+  {
+    for(auto y = -1.0; y <= 1.0; y += 1.0)
+    {
+      // leave the center of the room open
+      if (x != 0.0 or y != 0.0)
+      {
+        world.landmarks.push_back(Vector2D(x, y));
+      }
+    }
+  }
+
+  return world;
+}
+
+
+SimulationConfig defaultSimulation()
+{
+  SimulationConfig config;
+  config.header.beam_min = 0.0;
+  config.header.beam_max = 2.0 * rigid2d::PI;
+  config.header.beam_delta = rigid2d::deg2rad(1.0);
+  config.header.range_min = 0.12;
+  config.header.range_max = 3.5;
+  config.header.wheel_base = 0.16;
+  config.header.wheel_radius = 0.033;
+
+  return config;
+}
+
+
+double castRay(const SimulatedWorld &world, double x, double y, double angle,
+               double range_max)
+{
+  const auto dx = std::cos(angle);
+  const auto dy = std::sin(angle);
+
+  auto range = range_max;
+
+  // walls, the lidar is inside the room
+  if (dx > 1e-12)
+  {
+    range = std::min(range, (world.xmax - x) / dx);
+  }
+
+  else if (dx < -1e-12)
+  {
+    range = std::min(range, (world.xmin - x) / dx);
+  }
+
+  if (dy > 1e-12)
+  {
+    range = std::min(range, (world.ymax - y) / dy);
+  }
+
+  else if (dy < -1e-12)
+  {
+    range = std::min(range, (world.ymin - y) / dy);
+  }
+
+  // cylinders, nearest positive root of |p + t*d - c| = r
+  const auto r2 = world.landmark_radius * world.landmark_radius;
+  for(const auto &c : world.landmarks)
+  {
+    const auto ox = x - c.x;
+    const auto oy = y - c.y;
+    const auto b = ox * dx + oy * dy;
+    const auto disc = b * b - (ox * ox + oy * oy - r2);
+
+    if (disc < 0.0)
+    {
+      continue;
+    }
+
+    const auto t = -b - std::sqrt(disc);
+    if (t > 0.0 and t < range)
+    {
+      range = t;
+    }
+  }
+
+  return range;
+}
+
+
+void simulateLog(const SimulatedWorld &world, const SimulationConfig &config,
+                 std::vector<LogRecord> &records)
+{
+  std::mt19937_64 gen(config.seed);
+  std::normal_distribution<double> range_noise(0.0, config.range_noise);
+  std::normal_distribution<double> slip(0.0, config.wheel_slip);
+
+  const auto &header = config.header;
+  const auto dt = 1.0 / config.scan_rate;
+  const auto num_beams = static_cast<unsigned int>(
+                         std::round((header.beam_max - header.beam_min) / header.beam_delta));
+
+  // ideal wheel speeds for the commanded twist
+  rigid2d::Pose pose;
+  rigid2d::DiffDrive robot(pose, header.wheel_base, header.wheel_radius);
+
+  rigid2d::Twist2D cmd;
+  cmd.vx = config.vx * dt;
+  cmd.w = config.w * dt;
+  const auto wheels = robot.twistToWheels(cmd);
+
+  WheelEncoders encoders;
+
+  records.clear();
+  records.reserve(config.num_scans);
+
+  for(unsigned int k = 0; k < config.num_scans; k++)
+  {
+    LogRecord record;
+    record.stamp = k * dt;
+    record.encoders = encoders;
+    record.has_truth = true;
+    record.truth = robot.pose();
+
+    record.ranges.resize(num_beams);
+    for(unsigned int i = 0; i < num_beams; i++)
+    {
+      const auto angle = record.truth.theta + header.beam_min + i * header.beam_delta;
+      auto range = castRay(world, record.truth.x, record.truth.y, angle, header.range_max);
+
+      if (range < header.range_max)
+      {
+        range += range_noise(gen);
+      }
+
+      record.ranges[i] = static_cast<float>(range);
+    }
+
+    records.push_back(std::move(record));
+
+    // the robot moves with the ideal twist while the encoders slip
+    robot.feedforward(cmd);
+    encoders.left += wheels.ul * (1.0 + slip(gen));
+    encoders.right += wheels.ur * (1.0 + slip(gen));
+  }
+}
+
+} // end namespace
@@ -0,0 +1,215 @@
+/// \file
+/// \brief Compact binary log of laser scans and wheel encoders for offline replay
+
+#include <iostream>
+#include <cstring>
+
+#include "slam_replay/replay_log.hpp"
+
+
+namespace slam_replay
+{
+
+// file format identifier and version
+static const char log_magic[4] = {'S', 'L', 'O', 'G'};
+static constexpr uint32_t log_version = 1;
+
+
+/// \brief Writes a value as raw bytes
+/// \param file - output stream
+/// \param value - value to write
+template <typename T>
+static void writeBinary(std::ostream &file, const T &value)
+{
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+
+/// \brief Reads a value from raw bytes
+/// \param file - input stream
+/// value[out] - value read
+/// \return true if the value is read
+template <typename T>
+static bool readBinary(std::istream &file, T &value)
+{
+  file.read(reinterpret_cast<char *>(&value), sizeof(T));
+  return static_cast<bool>(file);
+}
+
+
+LogWriter::LogWriter(const std::string &filename, const LogHeader &header)
+                    : file(filename, std::ios::binary)
+{
+  if (!file)
+  {
+    std::cout << "ERROR: could NOT open " << filename << std::endl;
+    return;
+  }
+
+  file.write(log_magic, sizeof(log_magic));
+  writeBinary(file, log_version);
+
+  writeBinary(file, header.beam_min);
+  writeBinary(file, header.beam_max);
+  writeBinary(file, header.beam_delta);
+  writeBinary(file, header.range_min);
+  writeBinary(file, header.range_max);
+  writeBinary(file, header.wheel_base);
+  writeBinary(file, header.wheel_radius);
+}
+
+
+bool LogWriter::isOpen() const
+{
+  return static_cast<bool>(file);
+}
+
+
+void LogWriter::write(const LogRecord &record)
+{
+  writeBinary(file, record.stamp);
+  writeBinary(file, record.encoders.left);
+  writeBinary(file, record.encoders.right);
+
+  const uint8_t has_truth = record.has_truth;
+  writeBinary(file, has_truth);
+  if (record.has_truth)
+  {
+    writeBinary(file, record.truth.theta);
+    writeBinary(file, record.truth.x);
+    writeBinary(file, record.truth.y);
+  }
+
+  const uint32_t num_ranges = record.ranges.size();
+  writeBinary(file, num_ranges);
+  file.write(reinterpret_cast<const char *>(record.ranges.data()),
+             num_ranges * sizeof(float));
+}
+
+
+LogReader::LogReader(const std::string &filename) : file(filename, std::ios::binary),
+                                                    valid(false)
+{
+  if (!file)
+  {
+    std::cout << "ERROR: could NOT open " << filename << std::endl;
+    return;
+  }
+
+  char magic[4];
+  uint32_t version = 0;
+  file.read(magic, sizeof(magic));
+
+  if (!file or std::memcmp(magic, log_magic, sizeof(magic)) != 0 or
+      !readBinary(file, version) or version != log_version)
+  {
+    std::cout << "ERROR: " << filename << " is NOT a replay log" << std::endl;
+    return;
+  }
+
+  valid = readBinary(file, log_header.beam_min) and
+          readBinary(file, log_header.beam_max) and
+          readBinary(file, log_header.beam_delta) and
+          readBinary(file, log_header.range_min) and
+          readBinary(file, log_header.range_max) and
+          readBinary(file, log_header.wheel_base) and
+          readBinary(file, log_header.wheel_radius);
+
+  if (!valid)
+  {
+    std::cout << "ERROR: " << filename << " header is truncated" << std::endl;
+  }
+}
+
+
+bool LogReader::isOpen() const
+{
+  return valid;
+}
+
+
+const LogHeader &LogReader::header() const
+{
+  return log_header;
+}
+
+
+bool LogReader::next(LogRecord &record)
+{
+  if (!valid)
+  {
+    return false;
+  }
+
+  uint8_t has_truth = 0;
+  uint32_t num_ranges = 0;
+
+  if (!readBinary(file, record.stamp) or
+      !readBinary(file, record.encoders.left) or
+      !readBinary(file, record.encoders.right) or
+      !readBinary(file, has_truth))
+  {
+    return false;
+  }
+
+  record.has_truth = has_truth;
+  if (record.has_truth and
+      !(readBinary(file, record.truth.theta) and
+        readBinary(file, record.truth.x) and
+        readBinary(file, record.truth.y)))
+  {
+    return false;
+  }
+
+  if (!readBinary(file, num_ranges))
+  {
+    return false;
+  }
+
+  record.ranges.resize(num_ranges);
+  file.read(reinterpret_cast<char *>(record.ranges.data()), num_ranges * sizeof(float));
+
+  return static_cast<bool>(file);
+}
+
+
+bool saveLog(const std::string &filename, const LogHeader &header,
+             const std::vector<LogRecord> &records)
+{
+  LogWriter writer(filename, header);
+  if (!writer.isOpen())
+  {
+    return false;
+  }
+
+  for(const auto &record : records)
+  {
+    writer.write(record);
+  }
+
+  return writer.isOpen();
+}
+
+
+bool loadLog(const std::string &filename, LogHeader &header,
+             std::vector<LogRecord> &records)
+{
+  LogReader reader(filename);
+  if (!reader.isOpen())
+  {
+    return false;
+  }
+
+  header = reader.header();
+
+  records.clear();
+  LogRecord record;
+  while(reader.next(record))
+  {
+    records.push_back(record);
+  }
+
+  return true;
+}
+
+} // end namespace
@@ -0,0 +1,614 @@
+/// \file
+/// \brief Replays a log through the SLAM engines and measures their performance
+
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <sys/resource.h>
+
+#include <rigid2d/utilities.hpp>
+#include <bmapping/particle_filter.hpp>
+#include <bmapping/monte_carlo_localization.hpp>
+#include <bmapping/submap_slam.hpp>
+#include <nuslam/ekf_filter.hpp>
+#include <nuslam/landmarks.hpp>
+
+#include "slam_replay/replay_runner.hpp"
+
+
+namespace slam_replay
+{
+
+double StageLatency::percentile(double p) const
+{
+  if (samples.empty())
+  {
+    return 0.0;
+  }
+
+  // nearest rank
+  std::vector<double> sorted = samples;
+  const auto rank = std::ceil(p * sorted.size());
+  const auto k = std::min<std::size_t>(rank < 1.0 ? 0 : static_cast<std::size_t>(rank) - 1,
+                                       sorted.size() - 1);
+
+  std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+  return sorted[k];
+}
+
+
+double StageLatency::mean() const
+{
+  if (samples.empty())
+  {
+    return 0.0;
+  }
+
+  return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+
+ScopedStageTimer::ScopedStageTimer(StageLatency &stage) : stage(stage),
+                                                          start(std::chrono::steady_clock::now())
+{
+}
+
+
+ScopedStageTimer::~ScopedStageTimer()
+{
+  const std::chrono::duration<double, std::micro> dt = std::chrono::steady_clock::now() - start;
+  stage.samples.push_back(dt.count());
+}
+
+
+TrajectoryError::TrajectoryError() : has_origin(false),
+                                     count(0),
+                                     position_sq_sum(0.0),
+                                     heading_sq_sum(0.0)
+{
+}
+
+
+void TrajectoryError::add(const Transform2D &estimate, const Pose &truth)
+{
+  const Transform2D T_truth(rigid2d::Vector2D(truth.x, truth.y), truth.theta);
+
+  if (!has_origin)
+  {
+    T_origin_inv = T_truth.inv();
+    has_origin = true;
+  }
+
+  // truth relative to its first pose
+  const auto d_truth = (T_origin_inv * T_truth).displacement();
+  const auto d_est = estimate.displacement();
+
+  const auto dx = d_est.x - d_truth.x;
+  const auto dy = d_est.y - d_truth.y;
+  const auto dtheta = rigid2d::normalize_angle_PI(d_est.theta - d_truth.theta);
+
+  position_sq_sum += dx * dx + dy * dy;
+  heading_sq_sum += dtheta * dtheta;
+  count++;
+}
+
+
+unsigned int TrajectoryError::size() const
+{
+  return count;
+}
+
+
+double TrajectoryError::positionRMSE() const
+{
+  return count ? std::sqrt(position_sq_sum / count) : 0.0;
+}
+
+
+double TrajectoryError::headingRMSE() const
+{
+  return count ? std::sqrt(heading_sq_sum / count) : 0.0;
+}
+
+
+double ReplayStats::scansPerSecond() const
+{
+  return (wall_time > 0.0) ? num_scans / wall_time : 0.0;
+}
+
+
+void ReplayStats::print(std::ostream &os) const
+{
+  os << "engine: " << engine << "\n";
+  os << "scans: " << num_scans
+     << "  wall time: " << wall_time << " s"
+     << "  throughput: " << scansPerSecond() << " scans/s"
+     << "  peak memory: " << peak_memory_kb << " kB\n";
+
+  os << std::left << std::setw(12) << "stage" << std::right
+     << std::setw(12) << "mean(us)"
+     << std::setw(12) << "p50"
+     << std::setw(12) << "p90"
+     << std::setw(12) << "p99"
+     << std::setw(12) << "max" << "\n";
+
+  for(const auto &stage : stages)
+  {
+    os << std::left << std::setw(12) << stage.name << std::right << std::fixed << std::setprecision(1)
+       << std::setw(12) << stage.mean()
+       << std::setw(12) << stage.percentile(0.5)
+       << std::setw(12) << stage.percentile(0.9)
+       << std::setw(12) << stage.percentile(0.99)
+       << std::setw(12) << stage.percentile(1.0) << "\n";
+    os.unsetf(std::ios::fixed);
+    os << std::setprecision(6);
+  }
+
+  if (!failure.empty())
+  {
+    os << "replay stopped after " << num_scans << " scans: " << failure << "\n";
+  }
+
+  if (error.size() != 0)
+  {
+    os << "trajectory error (" << error.size() << " poses): position rmse "
+       << error.positionRMSE() << ", heading rmse " << error.headingRMSE() << " rad\n";
+  }
+
+  if (optimized_error.size() != 0)
+  {
+    os << "optimized trajectory error (" << optimized_error.size() << " poses): position rmse "
+       << optimized_error.positionRMSE() << ", heading rmse " << optimized_error.headingRMSE() << " rad\n";
+  }
+}
+
+
+void seedRandomEngines(unsigned int seed)
+{
+  rigid2d::seedSampling(seed);
+}
+
+
+long peakMemoryKB()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  // kilobytes on linux
+  return usage.ru_maxrss;
+}
+
+
+/// \brief Odometry from encoders relative to the first record
+class ReplayOdometry
+{
+public:
+  /// \param header - robot properties
+  /// \param records - the log
+  ReplayOdometry(const LogHeader &header, const std::vector<LogRecord> &records)
+                : drive(Pose(), header.wheel_base, header.wheel_radius)
+  {
+    if (!records.empty())
+    {
+      offset = records.front().encoders;
+    }
+  }
+
+  /// \brief Updates the odometry
+  /// \param record - scan and encoders
+  /// \return twist since the previous record
+  rigid2d::Twist2D update(const LogRecord &record)
+  {
+    drive.updateOdometry(record.encoders.left - offset.left,
+                         record.encoders.right - offset.right);
+    return drive.wheelsToTwist(drive.wheelVelocities());
+  }
+
+  /// \brief Current pose
+  /// \return odometry pose
+  Pose pose() const
+  {
+    return drive.pose();
+  }
+
+private:
+  rigid2d::DiffDrive drive;
+  WheelEncoders offset;
+};
+
+
+void replayParticleFilter(const LogHeader &header, const std::vector<LogRecord> &records,
+                          const ReplayConfig &config, ReplayStats &stats)
+{
+  seedRandomEngines(config.seed);
+
+  bmapping::LaserProperties props(header.beam_min, header.beam_max, header.beam_delta,
+                                  header.range_min, header.range_max,
+                                  config.z_hit, config.z_short, config.z_max,
+                                  config.z_rand, config.sigma_hit);
+
+  Transform2D Trs, robot_pose;
+  bmapping::GridMapper grid(config.map_resolution, config.map_min, config.map_max,
+                            config.map_min, config.map_max, props, Trs);
+  bmapping::ScanAlignment aligner(props, Trs);
+
+  bmapping::ParticleFilter pf(config.num_particles, config.num_samples_mode,
+                              config.srr, config.srt, config.str, config.stt,
+                              config.motion_noise_theta, config.motion_noise_x,
+                              config.motion_noise_y, config.sample_range_theta,
+                              config.sample_range_x, config.sample_range_y,
+                              aligner, robot_pose, grid);
+  if (config.correlative_matcher)
+  {
+    pf.useCorrelativeMatcher(bmapping::CorrelativeScanMatcher(config.match_linear_window,
+                                                              config.match_angular_window,
+                                                              config.match_depth,
+                                                              config.match_min_score));
+  }
+
+  if (config.scan_filter)
+  {
+    pf.useScanFilter(bmapping::ScanFilter(props, config.filter_min_spacing,
+                                          config.filter_max_angle_gap,
+                                          config.filter_isolation_distance,
+                                          static_cast<unsigned int>(std::max(config.filter_max_beams, 0))));
+  }
+
+  ReplayOdometry odometry(header, records);
+  Pose prev_odom;
+  std::vector<int8_t> map;
+
+  stats = ReplayStats();
+  stats.engine = config.scan_filter ? "particle_filter_filtered" : "particle_filter";
+  stats.stages = {{"odometry", {}}, {"slam", {}}, {"map", {}}};
+  for(auto &stage : stats.stages)
+  {
+    stage.samples.reserve(records.size());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    for(const auto &record : records)
+    {
+      rigid2d::Twist2D u;
+      Pose odom;
+      {
+        ScopedStageTimer timer(stats.stages[0]);
+        u = odometry.update(record);
+        odom = odometry.pose();
+      }
+
+      {
+        ScopedStageTimer timer(stats.stages[1]);
+        pf.SLAM(record.ranges, u, odom, prev_odom);
+      }
+      prev_odom = odom;
+
+      {
+        ScopedStageTimer timer(stats.stages[2]);
+        pf.bestMap().gridMap(map);
+      }
+
+      if (record.has_truth)
+      {
+        stats.error.add(pf.getRobotState(), record.truth);
+      }
+
+      stats.num_scans++;
+    }
+  }
+
+  catch(const std::exception &e)
+  {
+    stats.failure = e.what();
+  }
+
+  const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+  stats.wall_time = dt.count();
+  stats.peak_memory_kb = peakMemoryKB();
+}
+
+
+void replaySubmapSLAM(const LogHeader &header, const std::vector<LogRecord> &records,
+                      const ReplayConfig &config, ReplayStats &stats)
+{
+  seedRandomEngines(config.seed);
+
+  bmapping::LaserProperties props(header.beam_min, header.beam_max, header.beam_delta,
+                                  header.range_min, header.range_max,
+                                  config.z_hit, config.z_short, config.z_max,
+                                  config.z_rand, config.sigma_hit);
+
+  Transform2D Trs;
+  bmapping::GridMapper grid(config.map_resolution, config.map_min, config.map_max,
+                            config.map_min, config.map_max, props, Trs);
+
+  bmapping::SubmapSLAM slam(grid, config.submap_scans,
+                            config.submap_node_distance, config.submap_node_angle,
+                            bmapping::CorrelativeScanMatcher(config.match_linear_window,
+                                                             config.match_angular_window,
+                                                             config.match_depth,
+                                                             config.match_min_score),
+                            bmapping::CorrelativeScanMatcher(config.submap_loop_linear_window,
+                                                             config.submap_loop_angular_window,
+                                                             config.submap_loop_depth,
+                                                             config.submap_loop_min_score),
+                            config.submap_loop_search_distance, config.submap_loop_min_gap,
+                            config.submap_optimize_every,
+                            config.submap_huber_scale, config.submap_threads);
+
+  ReplayOdometry odometry(header, records);
+  std::vector<int8_t> map;
+
+  // records of the scans added to the graph
+  std::vector<std::size_t> node_records;
+
+  stats = ReplayStats();
+  stats.engine = "submap_slam";
+  stats.stages = {{"odometry", {}}, {"slam", {}}, {"map", {}}};
+  for(auto &stage : stats.stages)
+  {
+    stage.samples.reserve(records.size());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    for(std::size_t n = 0; n < records.size(); n++)
+    {
+      const auto &record = records[n];
+      Pose odom;
+      {
+        ScopedStageTimer timer(stats.stages[0]);
+        odometry.update(record);
+        odom = odometry.pose();
+      }
+
+      {
+        ScopedStageTimer timer(stats.stages[1]);
+        if (slam.addScan(record.ranges, odom))
+        {
+          node_records.push_back(n);
+        }
+      }
+
+      {
+        ScopedStageTimer timer(stats.stages[2]);
+        slam.gridMap(map);
+      }
+
+      if (record.has_truth)
+      {
+        stats.error.add(slam.getRobotState(), record.truth);
+      }
+
+      stats.num_scans++;
+    }
+
+    slam.finish();
+  }
+
+  catch(const std::exception &e)
+  {
+    stats.failure = e.what();
+  }
+
+  const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+  stats.wall_time = dt.count();
+  stats.peak_memory_kb = peakMemoryKB();
+
+  const auto trajectory = slam.trajectory();
+  for(std::size_t k = 0; k < node_records.size() and k < trajectory.size(); k++)
+  {
+    const auto &record = records[node_records[k]];
+    if (record.has_truth)
+    {
+      stats.optimized_error.add(trajectory[k], record.truth);
+    }
+  }
+}
+
+
+void replayLocalization(const LogHeader &header, const std::vector<LogRecord> &records,
+                        const ReplayConfig &config, ReplayStats &stats)
+{
+  seedRandomEngines(config.seed);
+
+  stats = ReplayStats();
+  stats.engine = config.mcl_beam_model ? "localization_beam" : "localization";
+  stats.stages = {{"odometry", {}}, {"localization", {}}};
+  for(auto &stage : stats.stages)
+  {
+    stage.samples.reserve(records.size());
+  }
+
+  // ground truth relative to the first pose, where the odometry starts
+  std::vector<Transform2D> truth;
+  Transform2D T_origin_inv;
+  for(const auto &record : records)
+  {
+    if (!record.has_truth)
+    {
+      stats.failure = "log has no ground truth to build the map";
+      return;
+    }
+
+    const Transform2D T_truth(rigid2d::Vector2D(record.truth.x, record.truth.y), record.truth.theta);
+    if (truth.empty())
+    {
+      T_origin_inv = T_truth.inv();
+    }
+    truth.push_back(T_origin_inv * T_truth);
+  }
+
+  // the map covers every scan
+  auto xmin = 0.0, xmax = 0.0, ymin = 0.0, ymax = 0.0;
+  for(const auto &T : truth)
+  {
+    const auto d = T.displacement();
+    xmin = std::min(xmin, d.x);
+    xmax = std::max(xmax, d.x);
+    ymin = std::min(ymin, d.y);
+    ymax = std::max(ymax, d.y);
+  }
+
+  bmapping::LaserProperties props(header.beam_min, header.beam_max, header.beam_delta,
+                                  header.range_min, header.range_max,
+                                  config.z_hit, config.z_short, config.z_max,
+                                  config.z_rand, config.sigma_hit);
+
+  Transform2D Trs;
+  const auto margin = header.range_max;
+  bmapping::GridMapper builder(config.map_resolution, xmin - margin, xmax + margin,
+                               ymin - margin, ymax + margin, props, Trs);
+  bmapping::GridMapper grid(builder);
+
+  try
+  {
+    std::vector<int8_t> map;
+    for(std::size_t n = 0; n < records.size(); n++)
+    {
+      builder.integrateScan(records[n].ranges, truth[n]);
+    }
+    builder.gridMap(map);
+
+    // the rviz map of the builder grew with the scans
+    grid = builder;
+    grid.loadMap(map);
+  }
+
+  catch(const std::exception &e)
+  {
+    stats.failure = e.what();
+    return;
+  }
+
+  bmapping::MonteCarloLocalization mcl(grid, config.mcl_min_particles, config.mcl_max_particles,
+                                       config.mcl_kld_error, config.mcl_kld_z,
+                                       config.mcl_bin_xy, config.mcl_bin_theta,
+                                       config.mcl_srr, config.mcl_srt, config.mcl_str, config.mcl_stt,
+                                       config.mcl_update_distance, config.mcl_update_angle,
+                                       config.mcl_max_beams);
+
+  if (config.mcl_beam_model)
+  {
+    mcl.useBeamModel(config.mcl_beam_angles, config.mcl_lambda_short);
+  }
+
+  // the start is known to within a few cells
+  Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+  cov(0,0) = 0.01;
+  cov(1,1) = cov(2,2) = 0.01;
+  mcl.initialize(Eigen::Vector3d::Zero(), cov);
+
+  ReplayOdometry odometry(header, records);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    for(const auto &record : records)
+    {
+      Pose odom;
+      {
+        ScopedStageTimer timer(stats.stages[0]);
+        odometry.update(record);
+        odom = odometry.pose();
+      }
+
+      {
+        ScopedStageTimer timer(stats.stages[1]);
+        mcl.update(record.ranges, odom);
+      }
+
+      stats.error.add(mcl.getRobotState(), record.truth);
+      stats.num_scans++;
+    }
+  }
+
+  catch(const std::exception &e)
+  {
+    stats.failure = e.what();
+  }
+
+  const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+  stats.wall_time = dt.count();
+  stats.peak_memory_kb = peakMemoryKB();
+}
+
+
+void replayEKF(const LogHeader &header, const std::vector<LogRecord> &records,
+               const ReplayConfig &config, ReplayStats &stats)
+{
+  seedRandomEngines(config.seed);
+
+  nuslam::LaserProperties props(header.beam_min, header.beam_max, header.beam_delta,
+                                header.range_min, header.range_max);
+  nuslam::Landmarks landmarks(props, config.cluster_epsilon);
+  nuslam::EKF ekf(config.num_landmarks, config.md_max, config.md_min);
+
+  ReplayOdometry odometry(header, records);
+  std::vector<rigid2d::Vector2D> meas;
+
+  stats = ReplayStats();
+  stats.engine = "ekf";
+  stats.stages = {{"odometry", {}}, {"landmarks", {}}, {"ekf", {}}};
+  for(auto &stage : stats.stages)
+  {
+    stage.samples.reserve(records.size());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    for(const auto &record : records)
+    {
+      rigid2d::Twist2D u;
+      {
+        ScopedStageTimer timer(stats.stages[0]);
+        u = odometry.update(record);
+      }
+
+      {
+        ScopedStageTimer timer(stats.stages[1]);
+        landmarks.featureDetection(record.ranges);
+
+        meas.clear();
+        for(const auto &lm : landmarks.lm)
+        {
+          meas.push_back(rigid2d::Vector2D(lm.x_hat, lm.y_hat));
+        }
+      }
+
+      {
+        ScopedStageTimer timer(stats.stages[2]);
+        ekf.SLAM(meas, u);
+      }
+
+      if (record.has_truth)
+      {
+        stats.error.add(ekf.getRobotState(), record.truth);
+      }
+
+      stats.num_scans++;
+    }
+  }
+
+  catch(const std::exception &e)
+  {
+    stats.failure = e.what();
+  }
+
+  const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+  stats.wall_time = dt.count();
+  stats.peak_memory_kb = peakMemoryKB();
+}
+
+} // end namespace
@@ -0,0 +1,199 @@
+/// \file
+/// \brief Replays a log through the SLAM engines without ROS and reports their performance
+///
+/// \author Boston Cleek
+///
+/// USAGE:
+///   slam_replay simulate <log> [num_scans] [seed] - writes a simulated log
+///   slam_replay run <log> [pf|pf_filter|submap|mcl|mcl_beam|ekf|all] [seed] [trace] - replays a log as fast
+///                                                                                     as possible, optionally
+///                                                                                     writes a Chrome trace
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iomanip>
+
+#include <rigid2d/instrumentation.hpp>
+
+#include "slam_replay/replay_log.hpp"
+#include "slam_replay/log_simulator.hpp"
+#include "slam_replay/replay_runner.hpp"
+
+
+using slam_replay::LogHeader;
+using slam_replay::LogRecord;
+using slam_replay::ReplayConfig;
+using slam_replay::ReplayStats;
+
+
+/// \brief Prints the usage
+void usage()
+{
+  std::cout << "usage:\n"
+            << "  slam_replay simulate <log> [num_scans] [seed]\n"
+            << "  slam_replay run <log> [pf|pf_filter|submap|mcl|mcl_beam|ekf|all] [seed] [trace]" << std::endl;
+}
+
+
+/// \brief Prints the metrics recorded by the instrumented stages
+void printMetrics()
+{
+  std::vector<rigid2d::MetricSummary> summaries;
+  rigid2d::Metrics::instance().summary(summaries);
+
+  std::cout << "stage metrics (timers in us)" << std::endl;
+  for(const auto &s : summaries)
+  {
+    std::cout << "  " << std::left << std::setw(24) << s.name << std::right
+              << " count " << std::setw(8) << s.count;
+
+    if (s.type != rigid2d::MetricType::Counter)
+    {
+      std::cout << std::fixed << std::setprecision(1)
+                << " mean " << std::setw(9) << s.mean
+                << " p50 " << std::setw(9) << s.p50
+                << " p99 " << std::setw(9) << s.p99
+                << " max " << std::setw(9) << s.max;
+      std::cout.unsetf(std::ios_base::floatfield);
+    }
+    std::cout << std::endl;
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    usage();
+    return 1;
+  }
+
+  const std::string command = argv[1];
+  const std::string filename = argv[2];
+
+
+  if (command == "simulate")
+  {
+    auto config = slam_replay::defaultSimulation();
+    if (argc > 3)
+    {
+      config.num_scans = std::strtoul(argv[3], nullptr, 10);
+    }
+
+    if (argc > 4)
+    {
+      config.seed = std::strtoul(argv[4], nullptr, 10);
+    }
+
+    std::vector<LogRecord> records;
+    slam_replay::simulateLog(slam_replay::defaultWorld(), config, records);
+
+    if (!slam_replay::saveLog(filename, config.header, records))
+    {
+      return 1;
+    }
+
+    std::cout << "wrote " << records.size() << " scans to " << filename << std::endl;
+    return 0;
+  }
+
+
+  else if (command == "run")
+  {
+    const std::string engine = (argc > 3) ? argv[3] : "all";
+
+    ReplayConfig config;
+    if (argc > 4)
+    {
+      config.seed = std::strtoul(argv[4], nullptr, 10);
+    }
+
+    if (engine != "pf" and engine != "pf_filter" and engine != "submap" and engine != "mcl" and
+        engine != "mcl_beam" and engine != "ekf" and engine != "all")
+    {
+      usage();
+      return 1;
+    }
+
+    // the whole log is loaded first so file IO is not timed
+    LogHeader header;
+    std::vector<LogRecord> records;
+    if (!slam_replay::loadLog(filename, header, records))
+    {
+      return 1;
+    }
+
+    const std::string trace_file = (argc > 5) ? argv[5] : "";
+    if (!trace_file.empty())
+    {
+      rigid2d::Metrics::instance().enableTrace(true);
+    }
+
+    ReplayStats stats;
+
+    if (engine == "pf" or engine == "all")
+    {
+      slam_replay::replayParticleFilter(header, records, config, stats);
+      stats.print(std::cout);
+      std::cout << std::endl;
+    }
+
+    if (engine == "pf_filter" or engine == "all")
+    {
+      config.scan_filter = true;
+      slam_replay::replayParticleFilter(header, records, config, stats);
+      stats.print(std::cout);
+      std::cout << std::endl;
+    }
+
+    if (engine == "submap" or engine == "all")
+    {
+      slam_replay::replaySubmapSLAM(header, records, config, stats);
+      stats.print(std::cout);
+      std::cout << std::endl;
+    }
+
+    if (engine == "mcl" or engine == "all")
+    {
+      slam_replay::replayLocalization(header, records, config, stats);
+      stats.print(std::cout);
+      std::cout << std::endl;
+    }
+
+    if (engine == "mcl_beam" or engine == "all")
+    {
+      config.mcl_beam_model = true;
+      slam_replay::replayLocalization(header, records, config, stats);
+      stats.print(std::cout);
+      std::cout << std::endl;
+    }
+
+    if (engine == "ekf" or engine == "all")
+    {
+      slam_replay::replayEKF(header, records, config, stats);
+      stats.print(std::cout);
+    }
+
+    std::cout << std::endl;
+    printMetrics();
+
+    if (!trace_file.empty())
+    {
+      rigid2d::Metrics::instance().enableTrace(false);
+      if (!rigid2d::Metrics::instance().writeChromeTrace(trace_file))
+      {
+        return 1;
+      }
+      std::cout << "wrote trace to " << trace_file << std::endl;
+    }
+
+    return 0;
+  }
+
+  usage();
+  return 1;
+}